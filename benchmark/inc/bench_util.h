@@ -0,0 +1,18 @@
+#ifndef _BENCH_UTIL_H_
+#define _BENCH_UTIL_H_
+
+#include <stdint.h>
+
+/* pins the calling thread to the given CPU (negative CPU is ignored) */
+int thread_pin(int cpu);
+
+/* returns CPU time consumed by the calling thread in nanoseconds */
+uint64_t thread_cpuTimeNs();
+
+/* human readable byte sizes (binary prefixes) and speeds (decimal prefixes) */
+float disp_bytesGetNum(uint64_t bytes);
+const char* disp_bytesGetUnits(uint64_t bytes);
+float disp_speedGetNum(uint64_t bps);
+const char* disp_speedGetUnits(uint64_t bps);
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef _HISTOGRAM_H_
+#define _HISTOGRAM_H_
+
+#include <stdint.h>
+
+/* Log-linear histogram: every power-of-two range is split into 2^HIST_SUB_BITS
+ * linear sub-buckets, which bounds the relative quantization error by
+ * 1/2^HIST_SUB_BITS (<1% for the default) over the complete uint64_t range. */
+#ifndef HIST_SUB_BITS
+  #define HIST_SUB_BITS  7
+#endif
+#define HIST_SUB_COUNT     (1u << HIST_SUB_BITS)
+#define HIST_BUCKET_COUNT  ((64 - HIST_SUB_BITS + 1)*HIST_SUB_COUNT)
+
+typedef struct {
+  uint64_t  count;   /** number of recorded values */
+  uint64_t  min;     /** exact minimum value */
+  uint64_t  max;     /** exact maximum value */
+  uint64_t  sum;     /** sum of recorded values (for the mean) */
+  uint64_t *buckets; /** HIST_BUCKET_COUNT bucket counters */
+} hist_t;
+
+
+/** @brief Allocates histogram buckets and resets the histogram.
+ *
+ *  @return Returns '0' on success, '-1' otherwise */
+int hist_init(hist_t *hist);
+
+/** @brief Releases memory allocated by hist_init. */
+void hist_deinit(hist_t *hist);
+
+/** @brief Discards all the recorded values (e.g. after the warm-up phase). */
+void hist_reset(hist_t *hist);
+
+/** @brief Records a single value. */
+void hist_record(hist_t *hist, uint64_t value);
+
+/** @brief Adds all the values recorded in src to dst. */
+void hist_add(hist_t *dst, const hist_t *src);
+
+/** @brief Returns the value at the given percentile (0.0 - 100.0). The value
+ *         is the upper bound of the matching bucket clamped to the exact
+ *         maximum, i.e. never underestimates. */
+uint64_t hist_percentile(const hist_t *hist, double percentile);
+
+#endif
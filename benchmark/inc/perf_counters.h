@@ -0,0 +1,56 @@
+#ifndef _PERF_COUNTERS_H_
+#define _PERF_COUNTERS_H_
+
+#include <stdint.h>
+#include <sys/resource.h>
+
+/* Per-thread event counters captured around a measured region. Counters are
+ * opened with perf_event_open, context switches and page faults fall back to
+ * getrusage and syscalls are counted with the raw_syscalls:sys_enter
+ * tracepoint. Counters not permitted by the kernel (perf_event_paranoid,
+ * virtualized PMU, missing tracefs) are reported as unavailable. */
+typedef enum {
+  PERF_CYCLES=0,
+  PERF_INSTRUCTIONS,
+  PERF_CACHE_MISSES,
+  PERF_CONTEXT_SWITCHES,
+  PERF_PAGE_FAULTS,
+  PERF_SYSCALLS,
+  PERF_COUNTER_COUNT
+} perfCounter_t;
+
+typedef struct {
+  uint64_t  values[PERF_COUNTER_COUNT];
+  uint32_t  valid;    /** bit mask of counters available in the sample */
+  uint32_t  samples;  /** number of accumulated samples */
+} perfSample_t;
+
+typedef struct {
+  int            fds[PERF_COUNTER_COUNT];
+  struct rusage  usage;  /** getrusage snapshot taken by perf_start */
+} perf_t;
+
+
+/** @brief Opens the counters of the calling thread (disabled).
+ *
+ *  @return Returns number of counters available (including fallbacks) */
+int perf_init(perf_t *perf);
+
+/** @brief Closes the counters opened by perf_init. */
+void perf_deinit(perf_t *perf);
+
+/** @brief Resets and enables the counters. */
+void perf_start(perf_t *perf);
+
+/** @brief Disables the counters and reads their values since perf_start. The
+ *         values are scaled if the kernel had to multiplex the counters. */
+void perf_stop(perf_t *perf, perfSample_t *sample);
+
+/** @brief Accumulates samples (e.g. of several threads). A counter stays valid
+ *         only if it is valid in all the accumulated samples. */
+void perf_add(perfSample_t *dst, const perfSample_t *src);
+
+/** @brief Returns counter's short name (e.g. "cycles"). */
+const char* perf_name(perfCounter_t counter);
+
+#endif
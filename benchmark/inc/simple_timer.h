@@ -3,6 +3,8 @@
 
 #include <stdint.h>
 
+/* all the routines use the monotonic clock (immune to NTP/wall-clock jumps) */
+uint64_t stimer_now_ns();
 void stimer_set();
 uint64_t stimer_get_ns();
 uint64_t stimer_get_us();
@@ -0,0 +1,558 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "icom.h"
+#include "notification.h"
+#include "simple_timer.h"
+#include "histogram.h"
+#include "bench_util.h"
+
+#define BASELINE_PORT        (9200)
+#define BASELINE_DURATION_S  (0.5)
+#define BASELINE_SIZES_MAX   (32)
+#define BASELINE_STRING_MAX  (128)
+
+
+////////////////////////////////////////////////////////////////////////////////
+// CUSTOM TYPE DEFINITIONS
+////////////////////////////////////////////////////////////////////////////////
+/* Transports measured by the same engines. All the raw transports use icom's
+ * framing (icomMsgHeader_t followed by the payload), so the difference to the
+ * icom socket scenario is the library's own overhead. */
+typedef enum {
+  TRANSPORT_MEMCPY=0, /** copy between two buffers, no kernel involved */
+  TRANSPORT_TCP,      /** raw send/recv over a loopback TCP connection */
+  TRANSPORT_UNIX,     /** raw send/recv over an AF_UNIX socketpair */
+  TRANSPORT_PIPE,     /** raw write/read over a pair of pipes */
+  TRANSPORT_ICOM,     /** socket_tx/socket_rx icom pair */
+  TRANSPORT_COUNT
+} transport_t;
+
+/* one side of a bidirectional connection */
+typedef struct {
+  transport_t   transport;
+  int           fdRead;
+  int           fdWrite;
+  icom_t       *icom;
+  uint8_t      *buf;       /** receive buffer of raw transports */
+  uint32_t      bufSize;
+} endpoint_t;
+
+/* endpoint pair and the measurement state shared by both threads */
+typedef struct {
+  endpoint_t    a;         /** sender / ping-pong initiator */
+  endpoint_t    b;         /** receiver / echo */
+  uint32_t      size;
+  uint64_t      deadline;
+  int           cpuA;
+  int           cpuB;
+  hist_t        hist;      /** [out] round-trip times */
+  uint64_t      messages;  /** [out] messages received by b */
+  uint64_t      first;     /** [out] monotonic time of the first message */
+  uint64_t      end;       /** [out] monotonic time of the last message */
+  int           status;    /** [out] '0' on success */
+} bench_t;
+
+/* results of all transports for a single message size */
+typedef struct {
+  double    msgPerSec[TRANSPORT_COUNT];
+  uint64_t  rttP50[TRANSPORT_COUNT];
+} result_t;
+
+static const char *g_transportNames[TRANSPORT_COUNT] = {
+  "memcpy", "tcp", "unix", "pipe", "icom"
+};
+static const char *g_icomFlags = "default";
+
+
+////////////////////////////////////////////////////////////////////////////////
+// RAW TRANSPORTS
+////////////////////////////////////////////////////////////////////////////////
+static int fd_writeAll(int fd, struct iovec *iov, int iovcnt){
+  ssize_t ret;
+
+  while(iovcnt > 0){
+    ret = writev(fd, iov, iovcnt);
+    if(ret < 0){
+      if(errno == EINTR) continue;
+      return -1;
+    }
+
+    /* skip fully written vectors, adjust the partially written one */
+    while(iovcnt > 0 && (size_t)ret >= iov->iov_len){
+      ret -= iov->iov_len;
+      iov++;
+      iovcnt--;
+    }
+    if(iovcnt > 0){
+      iov->iov_base  = (uint8_t*)iov->iov_base + ret;
+      iov->iov_len  -= ret;
+    }
+  }
+  return 0;
+}
+
+static int fd_readAll(int fd, void *buf, size_t size){
+  ssize_t ret;
+
+  while(size > 0){
+    ret = read(fd, buf, size);
+    if(ret <= 0){
+      if(ret < 0 && errno == EINTR) continue;
+      return -1;
+    }
+    buf   = (uint8_t*)buf + ret;
+    size -= ret;
+  }
+  return 0;
+}
+
+static int tcp_pair(int *fdConnect, int *fdAccept){
+  struct sockaddr_in addr;
+  int fdListen, one = 1;
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family      = AF_INET;
+  addr.sin_port        = htons(BASELINE_PORT);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+  fdListen = socket(AF_INET, SOCK_STREAM, 0);
+  if(fdListen == -1){
+    _SE("Failed to create socket");
+    return -1;
+  }
+  setsockopt(fdListen, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  if(bind(fdListen, (struct sockaddr*)&addr, sizeof(addr)) || listen(fdListen, 1)){
+    _SE("Failed to bind/listen socket");
+    goto failure_listen;
+  }
+
+  *fdConnect = socket(AF_INET, SOCK_STREAM, 0);
+  if(*fdConnect == -1 || connect(*fdConnect, (struct sockaddr*)&addr, sizeof(addr))){
+    _SE("Failed to connect socket");
+    goto failure_connect;
+  }
+
+  *fdAccept = accept(fdListen, NULL, NULL);
+  if(*fdAccept == -1){
+    _SE("Failed to accept connection");
+    goto failure_connect;
+  }
+
+  /* same socket options as the socket link */
+  setsockopt(*fdConnect, SOL_TCP, TCP_NODELAY, &one, sizeof(one));
+  setsockopt(*fdAccept,  SOL_TCP, TCP_NODELAY, &one, sizeof(one));
+
+  close(fdListen);
+  return 0;
+
+failure_connect:
+  if(*fdConnect != -1) close(*fdConnect);
+failure_listen:
+  close(fdListen);
+  return -1;
+}
+
+/* opens a connected endpoint pair of the given transport */
+int endpoints_open(transport_t transport, endpoint_t *a, endpoint_t *b){
+  char strTx[BASELINE_STRING_MAX], strRx[BASELINE_STRING_MAX];
+  int fds[2], fds2[2];
+
+  memset(a, 0, sizeof(*a));
+  memset(b, 0, sizeof(*b));
+  a->transport = b->transport = transport;
+
+  switch(transport){
+    case TRANSPORT_MEMCPY:
+      return 0;
+
+    case TRANSPORT_TCP:
+      if(tcp_pair(&fds[0], &fds[1]) != 0){
+        return -1;
+      }
+      break;
+
+    case TRANSPORT_UNIX:
+      if(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0){
+        _SE("Failed to create socketpair");
+        return -1;
+      }
+      break;
+
+    case TRANSPORT_PIPE:
+      if(pipe(fds) != 0){
+        _SE("Failed to create pipe");
+        return -1;
+      }
+      if(pipe(fds2) != 0){
+        _SE("Failed to create pipe");
+        close(fds[0]); close(fds[1]);
+        return -1;
+      }
+      a->fdWrite = fds[1];  b->fdRead = fds[0];
+      b->fdWrite = fds2[1]; a->fdRead = fds2[0];
+      return 0;
+
+    case TRANSPORT_ICOM:
+      snprintf(strTx, sizeof(strTx), "socket_tx|%s|127.0.0.1:%d", g_icomFlags, BASELINE_PORT+1);
+      snprintf(strRx, sizeof(strRx), "socket_rx|%s|*:%d", g_icomFlags, BASELINE_PORT+1);
+      b->icom = icom_init(strRx);
+      if(ICOM_IS_ERR(b->icom)){
+        _E("Failed to initialize \"%s\"", strRx);
+        return -1;
+      }
+      a->icom = icom_init(strTx);
+      if(ICOM_IS_ERR(a->icom)){
+        _E("Failed to initialize \"%s\"", strTx);
+        icom_deinit(b->icom);
+        return -1;
+      }
+      return 0;
+
+    default:
+      return -1;
+  }
+
+  /* bidirectional sockets */
+  a->fdRead = a->fdWrite = fds[0];
+  b->fdRead = b->fdWrite = fds[1];
+  return 0;
+}
+
+void endpoints_close(endpoint_t *a, endpoint_t *b){
+  endpoint_t *eps[] = {a, b};
+
+  for(int i=0; i<2; i++){
+    switch(eps[i]->transport){
+      case TRANSPORT_ICOM:
+        icom_deinit(eps[i]->icom);
+        break;
+      case TRANSPORT_PIPE:
+        close(eps[i]->fdRead);
+        close(eps[i]->fdWrite);
+        break;
+      case TRANSPORT_TCP:
+      case TRANSPORT_UNIX:
+        close(eps[i]->fdRead);
+        break;
+      default:
+        break;
+    }
+    free(eps[i]->buf);
+    eps[i]->buf = NULL;
+  }
+}
+
+int ep_send(endpoint_t *ep, void *buf, uint32_t size){
+  icomMsgHeader_t header = {0, 0, size};
+  struct iovec iov[2] = {
+    {&header, sizeof(header)},
+    {buf, size}
+  };
+
+  if(ep->transport == TRANSPORT_ICOM){
+    return (icom_send(ep->icom, buf, size) == ICOM_SUCCESS) ? 0 : -1;
+  }
+  return fd_writeAll(ep->fdWrite, iov, size ? 2 : 1);
+}
+
+int ep_recv(endpoint_t *ep, void **buf, uint32_t *size){
+  icomMsgHeader_t header;
+  unsigned bufSize;
+
+  if(ep->transport == TRANSPORT_ICOM){
+    if(icom_recv(ep->icom, buf, &bufSize) != ICOM_SUCCESS){
+      return -1;
+    }
+    *size = bufSize;
+    return 0;
+  }
+
+  if(fd_readAll(ep->fdRead, &header, sizeof(header)) != 0){
+    return -1;
+  }
+
+  /* grow-only buffer, as the icom receive path does */
+  if(header.bufSize > ep->bufSize){
+    free(ep->buf);
+    ep->buf = (uint8_t*)malloc(header.bufSize);
+    if(!ep->buf){
+      ep->bufSize = 0;
+      return -1;
+    }
+    ep->bufSize = header.bufSize;
+  }
+
+  if(header.bufSize && fd_readAll(ep->fdRead, ep->buf, header.bufSize) != 0){
+    return -1;
+  }
+  *buf  = ep->buf;
+  *size = header.bufSize;
+  return 0;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// ENGINES
+////////////////////////////////////////////////////////////////////////////////
+/* receives (and optionally echoes) until an empty message */
+static void* thread_b(void *p, int echo){
+  bench_t *bench = (bench_t*)p;
+  uint32_t size;
+  void *buf;
+
+  thread_pin(bench->cpuB);
+
+  bench->messages = 0;
+  while(1){
+    if(ep_recv(&bench->b, &buf, &size) != 0){
+      bench->status = -1;
+      break;
+    }
+    if(size == 0){
+      break;
+    }
+    if(echo && ep_send(&bench->b, buf, size) != 0){
+      bench->status = -1;
+      break;
+    }
+
+    bench->end = stimer_now_ns();
+    if(bench->messages++ == 0){
+      bench->first = bench->end;
+    }
+  }
+
+  return NULL;
+}
+
+static void* thread_sink(void *p){
+  return thread_b(p, 0);
+}
+
+static void* thread_echo(void *p){
+  return thread_b(p, 1);
+}
+
+/* memcpy stands in for both directions of the transfer */
+static int run_memcpy(bench_t *bench, uint8_t *src, int pingpong){
+  uint8_t *dst;
+  uint64_t start, now;
+
+  dst = (uint8_t*)malloc(bench->size);
+  if(!dst){
+    return -1;
+  }
+
+  bench->messages = 0;
+  do {
+    start = stimer_now_ns();
+    memcpy(dst, src, bench->size);
+    if(pingpong){
+      memcpy(src, dst, bench->size);
+    }
+    __asm__ volatile("" ::: "memory");
+    now = stimer_now_ns();
+
+    hist_record(&bench->hist, now - start);
+    bench->end = now;
+    if(bench->messages++ == 0){
+      bench->first = now;
+    }
+  } while(now < bench->deadline);
+
+  free(dst);
+  return 0;
+}
+
+/* runs a stream (pingpong == 0) or a ping-pong measurement of a single size */
+int bench_run(bench_t *bench, uint8_t *buf, double duration, int pingpong){
+  uint64_t start;
+  uint32_t size;
+  void *bufRx;
+  pthread_t pid;
+
+  hist_reset(&bench->hist);
+  bench->status   = 0;
+  bench->deadline = stimer_now_ns() + (uint64_t)(duration*1e9);
+
+  if(bench->a.transport == TRANSPORT_MEMCPY){
+    return run_memcpy(bench, buf, pingpong);
+  }
+
+  pthread_create(&pid, NULL, pingpong ? thread_echo : thread_sink, bench);
+  thread_pin(bench->cpuA);
+
+  do {
+    start = stimer_now_ns();
+    if(ep_send(&bench->a, buf, bench->size) != 0){
+      bench->status = -1;
+      break;
+    }
+    if(pingpong){
+      if(ep_recv(&bench->a, &bufRx, &size) != 0){
+        bench->status = -1;
+        break;
+      }
+      hist_record(&bench->hist, stimer_now_ns() - start);
+    }
+  } while(stimer_now_ns() < bench->deadline);
+
+  if(bench->status == 0 && ep_send(&bench->a, buf, 0) != 0){
+    bench->status = -1;
+  }
+  pthread_join(pid, NULL);
+
+  return bench->status;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// DISPLAYING RESULTS
+////////////////////////////////////////////////////////////////////////////////
+static void disp_results(uint32_t *sizes, unsigned sizeCount, result_t *results){
+  printf("### Throughput [messages/s] (icom overhead = raw tcp msg/s / icom msg/s) ###\n");
+  printf("%10s |", "size");
+  for(int t=0; t<TRANSPORT_COUNT; t++){
+    printf("%11s |", g_transportNames[t]);
+  }
+  printf("%9s\n", "overhead");
+  for(unsigned s=0; s<sizeCount; s++){
+    printf("%7.1f %-2s |", disp_bytesGetNum(sizes[s]), disp_bytesGetUnits(sizes[s]));
+    for(int t=0; t<TRANSPORT_COUNT; t++){
+      printf("%11.0f |", results[s].msgPerSec[t]);
+    }
+    printf("%8.2fx\n", results[s].msgPerSec[TRANSPORT_ICOM] > 0
+      ? results[s].msgPerSec[TRANSPORT_TCP]/results[s].msgPerSec[TRANSPORT_ICOM] : 0.0);
+  }
+
+  printf("\n### Round trip, 50th percentile [us] (icom overhead = icom / raw tcp) ###\n");
+  printf("%10s |", "size");
+  for(int t=0; t<TRANSPORT_COUNT; t++){
+    printf("%11s |", g_transportNames[t]);
+  }
+  printf("%9s\n", "overhead");
+  for(unsigned s=0; s<sizeCount; s++){
+    printf("%7.1f %-2s |", disp_bytesGetNum(sizes[s]), disp_bytesGetUnits(sizes[s]));
+    for(int t=0; t<TRANSPORT_COUNT; t++){
+      printf("%11.2f |", results[s].rttP50[t]/1000.0);
+    }
+    printf("%8.2fx\n", results[s].rttP50[TRANSPORT_TCP] > 0
+      ? (double)results[s].rttP50[TRANSPORT_ICOM]/results[s].rttP50[TRANSPORT_TCP] : 0.0);
+  }
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// MAIN
+////////////////////////////////////////////////////////////////////////////////
+static void usage(const char *name){
+  _I("Usage: %s [-z sizes] [-d seconds] [-f flags] [-p cpuTx,cpuRx]", name);
+  _I("  -z: comma separated message sizes (default: 64,4096,65536,1048576)");
+  _I("  -d: duration of every measurement (default: %.1f s)", BASELINE_DURATION_S);
+  _I("  -f: flags of the icom socket scenario (default: \"default\")");
+  _I("  -p: pins the sender/initiator and the receiver/echo threads");
+}
+
+int main(int argc, char *argv[]){
+  uint32_t sizes[BASELINE_SIZES_MAX] = {64, 4096, 65536, 1048576};
+  result_t results[BASELINE_SIZES_MAX];
+  unsigned sizeCount = 4;
+  double duration = BASELINE_DURATION_S;
+  int cpuA = -1, cpuB = -1;
+  uint32_t sizeMax = 0;
+  bench_t bench;
+  uint8_t *buf;
+  char *tok;
+  int opt;
+
+  while((opt = getopt(argc, argv, "z:d:f:p:h")) != -1){
+    switch(opt){
+      case 'z':
+        sizeCount = 0;
+        for(tok=strtok(optarg, ","); tok && sizeCount<BASELINE_SIZES_MAX; tok=strtok(NULL, ",")){
+          sizes[sizeCount++] = strtoul(tok, NULL, 0);
+        }
+        break;
+      case 'd':
+        duration = strtod(optarg, NULL);
+        break;
+      case 'f':
+        g_icomFlags = optarg;
+        break;
+      case 'p':
+        if(sscanf(optarg, "%d,%d", &cpuA, &cpuB) != 2){
+          usage(argv[0]);
+          return 1;
+        }
+        break;
+      default:
+        usage(argv[0]);
+        return 1;
+    }
+  }
+
+  for(unsigned s=0; s<sizeCount; s++){
+    if(sizes[s] == 0){
+      _E("Message size must not be zero");
+      return 1;
+    }
+    sizeMax = (sizes[s] > sizeMax) ? sizes[s] : sizeMax;
+  }
+
+  buf = (uint8_t*)malloc(sizeMax);
+  if(!buf || hist_init(&bench.hist) != 0){
+    _E("Failed to allocate memory");
+    return 1;
+  }
+  memset(buf, 0xa5, sizeMax);
+  memset(results, 0, sizeof(results));
+  bench.cpuA = cpuA;
+  bench.cpuB = cpuB;
+
+  /* a fresh connection per transport, shared by all the sizes */
+  for(int t=0; t<TRANSPORT_COUNT; t++){
+    if(endpoints_open(t, &bench.a, &bench.b) != 0){
+      _E("Failed to open %s transport", g_transportNames[t]);
+      continue;
+    }
+
+    for(unsigned s=0; s<sizeCount; s++){
+      bench.size = sizes[s];
+
+      if(bench_run(&bench, buf, duration, 0) != 0){
+        _E("%s stream failed", g_transportNames[t]);
+        break;
+      }
+      if(bench.messages > 1 && bench.end > bench.first){
+        results[s].msgPerSec[t] = (bench.messages - 1)/((bench.end - bench.first)/1e9);
+      }
+
+      if(bench_run(&bench, buf, duration, 1) != 0){
+        _E("%s ping-pong failed", g_transportNames[t]);
+        break;
+      }
+      results[s].rttP50[t] = hist_percentile(&bench.hist, 50.0);
+    }
+
+    endpoints_close(&bench.a, &bench.b);
+  }
+
+  disp_results(sizes, sizeCount, results);
+
+  hist_deinit(&bench.hist);
+  free(buf);
+  return 0;
+}
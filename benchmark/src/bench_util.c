@@ -0,0 +1,99 @@
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+#include "notification.h"
+#include "bench_util.h"
+
+
+////////////////////////////////////////////////////////////////////////////////
+// THREAD PLACEMENT / ACCOUNTING
+////////////////////////////////////////////////////////////////////////////////
+/* pins the calling thread to the given CPU (negative CPU is ignored) */
+int thread_pin(int cpu){
+  cpu_set_t set;
+
+  if(cpu < 0){
+    return 0;
+  }
+
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  if(pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0){
+    _W("Failed to pin thread to CPU %d", cpu);
+    return -1;
+  }
+  return 0;
+}
+
+uint64_t thread_cpuTimeNs(){
+  struct timespec now;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+  return (uint64_t)now.tv_sec*1000000000ull + (uint64_t)now.tv_nsec;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// DISPLAYING UNITS
+////////////////////////////////////////////////////////////////////////////////
+float disp_bytesGetNum(uint64_t bytes){
+  if(bytes >= 1024*1024*1024){   // GB
+    return bytes/(1024*1024*1024);
+
+  } else if(bytes >= 1024*1024){ // MB
+    return bytes/(1024*1024);
+
+  } else if(bytes >= 1024){      // KB
+    return bytes/(1024);
+
+  } else {                       // bytes
+    return bytes;
+  } 
+}
+
+const char* disp_bytesGetUnits(uint64_t bytes){
+  if(bytes >= 1024*1024*1024){   // GB
+    return "GB";
+
+  } else if(bytes >= 1024*1024){ // MB
+    return "MB";
+
+  } else if(bytes >= 1024){      // KB
+    return "KB";
+
+  } else {                       // bytes
+    return "B";
+  } 
+}
+
+float disp_speedGetNum(uint64_t bps){
+  if(bps >= 1000*1000*1000){   // Gbps
+    return ((float)(bps))/(1000*1000*1000);
+
+  } else if(bps>= 1000*1000){  // Mbps
+    return ((float)(bps))/(1000*1000);
+
+  } else if(bps>= 1000){       // Kbps
+    return ((float)(bps))/(1000);
+
+  } else {                     // bps
+    return (float)bps;
+  } 
+}
+
+const char* disp_speedGetUnits(uint64_t bps){
+  if(bps>= 1000*1000*1000){    // Gbps
+    return "Gbps";
+
+  } else if(bps >= 1000*1000){ // Mbps
+    return "Mbps";
+
+  } else if(bps >= 1000){      // Kbps
+    return "Kbps";
+
+  } else {                     // bps
+    return "bps";
+  } 
+}
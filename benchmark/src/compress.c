@@ -0,0 +1,436 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#include "icom.h"
+#include "notification.h"
+#include "simple_timer.h"
+#include "bench_util.h"
+
+#define COMPRESS_PORT_RELAY  (9100)      /* the sender connects to the relay */
+#define COMPRESS_PORT_RX     (9101)      /* the relay connects to the receiver */
+#define COMPRESS_RATE_MBPS   (100.0)     /* stand-in link rate (MB/s) */
+#define COMPRESS_SIZE        (1048576)
+#define COMPRESS_DURATION_S  (1.0)
+#define COMPRESS_CHUNK       (64*1024)   /* bytes relayed at once */
+#define COMPRESS_STRING_MAX  (128)
+
+#define STATIC_ARRAY_SIZE(a) (sizeof(a)/sizeof(*a))
+
+
+////////////////////////////////////////////////////////////////////////////////
+// CUSTOM TYPE DEFINITIONS
+////////////////////////////////////////////////////////////////////////////////
+/* stand-in of a bandwidth-limited path, i.e. a TCP relay with a token bucket */
+typedef struct {
+  int           fd;        /** listening socket */
+  double        rate;      /** bytes per second */
+  uint64_t      bytes;     /** [out] bytes relayed */
+  int           status;    /** [out] '0' - the sender disconnected, '-1' - failure */
+} relay_t;
+
+/* sender/receiver pair of a single measurement */
+typedef struct {
+  icom_t       *icomTx;
+  icom_t       *icomRx;
+  const void   *buf;
+  uint32_t      size;
+  uint64_t      deadline;  /** monotonic time when the sender stops */
+  uint64_t      sent;      /** [out] messages sent */
+  uint64_t      received;  /** [out] messages received */
+  uint64_t      end;       /** [out] monotonic time of the last message */
+  uint64_t      cpuTx;     /** [out] sender's CPU time in ns */
+  uint64_t      cpuRx;     /** [out] receiver's CPU time in ns */
+  icomStatus_t  statusTx;  /** [out] status of the sender */
+  icomStatus_t  statusRx;  /** [out] status of the receiver */
+} pair_t;
+
+/* message payloads */
+typedef struct {
+  const char   *name;
+  void        (*fill)(uint8_t *buf, uint32_t size);
+} payload_t;
+
+/* sender configurations */
+typedef struct {
+  const char   *name;
+  const char   *flags;
+  const char   *options;
+} txMode_t;
+
+
+////////////////////////////////////////////////////////////////////////////////
+// PAYLOADS
+////////////////////////////////////////////////////////////////////////////////
+/* sensor frame, i.e. zeros with a sample in every 64th 32-bit word */
+static void fill_sparse(uint8_t *buf, uint32_t size){
+  memset(buf, 0, size);
+  for(uint32_t i=0; i+sizeof(uint32_t)<=size; i+=64*sizeof(uint32_t)){
+    uint32_t sample = rand();
+    memcpy(buf+i, &sample, sizeof(sample));
+  }
+}
+
+/* log-like text */
+static void fill_text(uint8_t *buf, uint32_t size){
+  char line[128];
+  uint32_t offset = 0;
+  int n;
+
+  for(unsigned i=0; offset<size; i++){
+    n = snprintf(line, sizeof(line), "%u sensor=%u status=%s temperature=%d.%d\n",
+      1700000000+i, rand()%16, (rand()%8) ? "ok" : "degraded", 40+rand()%10, rand()%10);
+    n = (offset+n <= size) ? n : size-offset;
+    memcpy(buf+offset, line, n);
+    offset += n;
+  }
+}
+
+/* incompressible data */
+static void fill_random(uint8_t *buf, uint32_t size){
+  for(uint32_t i=0; i<size; i++){
+    buf[i] = rand();
+  }
+}
+
+static const payload_t g_payloads[] = {
+  {"sparse", fill_sparse},
+  {"text",   fill_text},
+  {"random", fill_random},
+};
+
+static const txMode_t g_modes[] = {
+  {"as is",    "default",  "default"},
+  {"compress", "compress", "default"},
+  {"adaptive", "compress", "compress_adaptive"},
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// RELAY
+////////////////////////////////////////////////////////////////////////////////
+static int relay_init(relay_t *relay, double rate){
+  struct sockaddr_in addr = {0};
+  int one = 1;
+
+  relay->rate   = rate;
+  relay->bytes  = 0;
+  relay->status = 0;
+  relay->fd     = socket(AF_INET, SOCK_STREAM, 0);
+  if(relay->fd == -1){
+    _SE("Failed to create relay socket");
+    return -1;
+  }
+  setsockopt(relay->fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+  addr.sin_family      = AF_INET;
+  addr.sin_port        = htons(COMPRESS_PORT_RELAY);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if(bind(relay->fd, (struct sockaddr*)&addr, sizeof(addr)) == -1 || listen(relay->fd, 1) == -1){
+    _SE("Failed to bind relay socket");
+    close(relay->fd);
+    return -1;
+  }
+  return 0;
+}
+
+/* forwards the sender's connection to the receiver at the relay's rate */
+void* thread_relay(void *p){
+  relay_t *relay = (relay_t*)p;
+  struct sockaddr_in addr = {0};
+  uint8_t *buf;
+  uint64_t start;
+  int in, out;
+  ssize_t n, m;
+
+  relay->status = -1;
+  buf = (uint8_t*)malloc(COMPRESS_CHUNK);
+  if(!buf){
+    return NULL;
+  }
+
+  in = accept(relay->fd, NULL, NULL);
+  if(in == -1){
+    _SE("Failed to accept relay connection");
+    free(buf);
+    return NULL;
+  }
+  out = socket(AF_INET, SOCK_STREAM, 0);
+  addr.sin_family      = AF_INET;
+  addr.sin_port        = htons(COMPRESS_PORT_RX);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if(out == -1 || connect(out, (struct sockaddr*)&addr, sizeof(addr)) == -1){
+    _SE("Failed to connect relay");
+    goto cleanup;
+  }
+
+  start = stimer_now_ns();
+  while((n = recv(in, buf, COMPRESS_CHUNK, 0)) > 0){
+    /* token bucket, i.e. wait until the link would have carried the bytes */
+    uint64_t due = start + (uint64_t)((relay->bytes + n)*1e9/relay->rate);
+    uint64_t now = stimer_now_ns();
+    if(due > now){
+      struct timespec ts = {(due-now)/1000000000ull, (due-now)%1000000000ull};
+      nanosleep(&ts, NULL);
+    }
+
+    for(m=0; m<n; ){
+      ssize_t r = send(out, buf+m, n-m, 0);
+      if(r == -1){
+        _SE("Relay failed to send");
+        goto cleanup;
+      }
+      m += r;
+    }
+    relay->bytes += n;
+  }
+  relay->status = (n == 0) ? 0 : -1;
+
+cleanup:
+  if(out != -1){
+    shutdown(out, SHUT_RDWR);
+    close(out);
+  }
+  close(in);
+  free(buf);
+  return NULL;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// SENDER / RECEIVER THREADS
+////////////////////////////////////////////////////////////////////////////////
+/* sends until the deadline and terminates the stream with an empty message */
+void* thread_send(void *p){
+  pair_t *pair = (pair_t*)p;
+  uint64_t cpuStart = thread_cpuTimeNs();
+
+  pair->sent     = 0;
+  pair->statusTx = ICOM_SUCCESS;
+  while(stimer_now_ns() < pair->deadline){
+    pair->statusTx = icom_send(pair->icomTx, (void*)pair->buf, pair->size);
+    if(pair->statusTx != ICOM_SUCCESS){
+      break;
+    }
+    pair->sent++;
+  }
+  pair->cpuTx = thread_cpuTimeNs() - cpuStart;
+
+  if(pair->statusTx == ICOM_SUCCESS){
+    pair->statusTx = icom_send(pair->icomTx, (void*)pair->buf, 0);
+  }
+  return NULL;
+}
+
+void* thread_recv(void *p){
+  pair_t *pair = (pair_t*)p;
+  uint64_t cpuStart = thread_cpuTimeNs();
+  void *buf;
+  unsigned bufSize;
+
+  pair->received = 0;
+  while(1){
+    pair->statusRx = icom_recv(pair->icomRx, &buf, &bufSize);
+    if(pair->statusRx != ICOM_SUCCESS || bufSize == 0){
+      break;
+    }
+    if(bufSize != pair->size || memcmp(buf, pair->buf, bufSize) != 0){
+      _E("Received a corrupted message");
+      pair->statusRx = ICOM_ERROR;
+      break;
+    }
+    pair->received++;
+    pair->end = stimer_now_ns();
+  }
+  pair->cpuRx = thread_cpuTimeNs() - cpuStart;
+  return NULL;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// DISPLAYING RESULTS TO THE TERMINAL
+////////////////////////////////////////////////////////////////////////////////
+static inline void disp_header(const char *title){
+  _I("### %s ###", title);
+  _I("%8s |%10s |%10s |%10s |%8s |%11s |%13s |%13s",
+    "payload", "mode", "msg/s", "MB/s", "ratio", "compressed", "tx CPU ns/msg", "rx CPU ns/msg");
+}
+
+static inline void disp_row(const char *payload, const char *mode, const pair_t *pair,
+uint64_t start, const icomCompressStats_t *stats){
+  double seconds = (pair->end - start)/1e9;
+
+  _I("%8s |%10s |%10.1f |%10.1f |%8.2f |%10.1f%% |%13.0f |%13.0f",
+    payload, mode,
+    pair->received/seconds,
+    pair->received*(double)pair->size/seconds/1e6,
+    stats->bytesOut ? (double)stats->bytesIn/stats->bytesOut : 1.0,
+    stats->messages ? 100.0*stats->compressed/stats->messages : 0.0,
+    pair->sent ? (double)pair->cpuTx/pair->sent : 0.0,
+    pair->received ? (double)pair->cpuRx/pair->received : 0.0);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// MEASUREMENTS
+////////////////////////////////////////////////////////////////////////////////
+/* streams the payload through the relay (or directly if the rate is '0') */
+static int run_pair(const uint8_t *buf, uint32_t size, const txMode_t *mode, double rate,
+double duration, pair_t *pair, uint64_t *start, icomCompressStats_t *stats){
+  char str[COMPRESS_STRING_MAX];
+  pthread_t pidTx, pidRx, pidRelay;
+  relay_t relay;
+  int ret = 0;
+
+  memset(pair, 0, sizeof(*pair));
+  pair->buf  = buf;
+  pair->size = size;
+
+  snprintf(str, COMPRESS_STRING_MAX, "socket_rx|default|*:%u", COMPRESS_PORT_RX);
+  pair->icomRx = icom_init(str);
+  if(ICOM_IS_ERR(pair->icomRx)){
+    _E("Failed to initialize Rx communicator \"%s\"", str);
+    return -1;
+  }
+  if(rate > 0 && relay_init(&relay, rate) != 0){
+    icom_deinit(pair->icomRx);
+    return -1;
+  }
+  snprintf(str, COMPRESS_STRING_MAX, "socket_tx|%s|%s|127.0.0.1:%u",
+    mode->flags, mode->options, (rate > 0) ? COMPRESS_PORT_RELAY : COMPRESS_PORT_RX);
+  pair->icomTx = icom_init(str);
+  if(ICOM_IS_ERR(pair->icomTx)){
+    _E("Failed to initialize Tx communicator \"%s\"", str);
+    if(rate > 0){
+      close(relay.fd);
+    }
+    icom_deinit(pair->icomRx);
+    return -1;
+  }
+
+  if(rate > 0){
+    pthread_create(&pidRelay, NULL, thread_relay, &relay);
+  }
+  *start = stimer_now_ns();
+  pair->deadline = *start + (uint64_t)(duration*1e9);
+  pthread_create(&pidRx, NULL, thread_recv, pair);
+  pthread_create(&pidTx, NULL, thread_send, pair);
+  pthread_join(pidTx, NULL);
+  pthread_join(pidRx, NULL);
+
+  if(pair->statusTx != ICOM_SUCCESS || pair->statusRx != ICOM_SUCCESS
+  || pair->received != pair->sent){
+    _E("Transfer failed (tx: %d, rx: %d, %lu/%lu messages)",
+      pair->statusTx, pair->statusRx, pair->received, pair->sent);
+    ret = -1;
+  }
+  icom_getCompressStats(pair->icomTx, stats);
+
+  /* the relay ends once the sender disconnects */
+  icom_deinit(pair->icomTx);
+  if(rate > 0){
+    pthread_join(pidRelay, NULL);
+    close(relay.fd);
+  }
+  icom_deinit(pair->icomRx);
+  return ret;
+}
+
+static int run_rate(uint32_t size, double rate, double duration){
+  char title[COMPRESS_STRING_MAX];
+  icomCompressStats_t stats;
+  uint64_t start;
+  uint8_t *buf;
+  pair_t pair;
+
+  buf = (uint8_t*)malloc(size);
+  if(!buf){
+    _E("Failed to allocate memory");
+    return -1;
+  }
+
+  if(rate > 0){
+    snprintf(title, sizeof(title), "%.1f %s MESSAGES OVER A %.0f MB/s LINK",
+      disp_bytesGetNum(size), disp_bytesGetUnits(size), rate/1e6);
+  } else {
+    snprintf(title, sizeof(title), "%.1f %s MESSAGES OVER LOOPBACK",
+      disp_bytesGetNum(size), disp_bytesGetUnits(size));
+  }
+  disp_header(title);
+
+  for(unsigned p=0; p<STATIC_ARRAY_SIZE(g_payloads); p++){
+    g_payloads[p].fill(buf, size);
+    for(unsigned m=0; m<STATIC_ARRAY_SIZE(g_modes); m++){
+      if(run_pair(buf, size, &g_modes[m], rate, duration, &pair, &start, &stats) != 0){
+        free(buf);
+        return -1;
+      }
+      disp_row(g_payloads[p].name, g_modes[m].name, &pair, start, &stats);
+    }
+  }
+
+  free(buf);
+  return 0;
+}
+
+
+static void usage(const char *name){
+  _I("Usage: %s [-r MB/s,...] [-z size] [-d seconds]", name);
+  _I("  -r  comma separated rates of the stand-in link, a TCP relay throttled by");
+  _I("      a token bucket, '0' connects directly over loopback (default: %.0f,0)",
+    COMPRESS_RATE_MBPS);
+  _I("  -z  message size in bytes (default: %u)", COMPRESS_SIZE);
+  _I("  -d  duration of a single measurement (default: %.1f s)", COMPRESS_DURATION_S);
+}
+
+int main(int argc, char *argv[]){
+  double rates[16] = {COMPRESS_RATE_MBPS*1e6, 0};
+  unsigned rateCount = 2;
+  uint32_t size = COMPRESS_SIZE;
+  double duration = COMPRESS_DURATION_S;
+  char *tok;
+  int opt;
+
+  while((opt = getopt(argc, argv, "r:z:d:h")) != -1){
+    switch(opt){
+      case 'r':
+        rateCount = 0;
+        for(tok=strtok(optarg, ","); tok && rateCount<STATIC_ARRAY_SIZE(rates); tok=strtok(NULL, ",")){
+          rates[rateCount++] = strtod(tok, NULL)*1e6;
+        }
+        break;
+      case 'z':
+        size = strtoul(optarg, NULL, 0);
+        break;
+      case 'd':
+        duration = strtod(optarg, NULL);
+        break;
+      default:
+        usage(argv[0]);
+        return 1;
+    }
+  }
+
+  if(rateCount < 1 || size < 1 || duration <= 0){
+    usage(argv[0]);
+    return 1;
+  }
+
+  for(unsigned r=0; r<rateCount; r++){
+    if(run_rate(size, rates[r], duration) != 0){
+      _E("Compression benchmark failed");
+      return 1;
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,274 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <string.h>
+#include <getopt.h>
+
+#include "icom.h"
+#include "notification.h"
+#include "simple_timer.h"
+#include "bench_util.h"
+
+#define DELTA_PORT          (9100)
+#define DELTA_SIZE          (1048576)
+#define DELTA_DURATION_S    (1.0)
+#define DELTA_RUN           (256)     /* bytes of a single change */
+#define DELTA_STRING_MAX    (128)
+
+#define STATIC_ARRAY_SIZE(a) (sizeof(a)/sizeof(*a))
+
+
+////////////////////////////////////////////////////////////////////////////////
+// CUSTOM TYPE DEFINITIONS
+////////////////////////////////////////////////////////////////////////////////
+/* sender/receiver pair of a single measurement */
+typedef struct {
+  icom_t       *icomTx;
+  icom_t       *icomRx;
+  uint8_t      *buf;       /** frame, changed before every send */
+  uint32_t      size;
+  unsigned      runs;      /** changes per frame */
+  uint64_t      deadline;  /** monotonic time when the sender stops */
+  uint64_t      sent;      /** [out] messages sent */
+  uint64_t      received;  /** [out] messages received */
+  uint64_t      end;       /** [out] monotonic time of the last message */
+  uint64_t      cpuTx;     /** [out] sender's CPU time in ns */
+  uint64_t      cpuRx;     /** [out] receiver's CPU time in ns */
+  icomStatus_t  statusTx;  /** [out] status of the sender */
+  icomStatus_t  statusRx;  /** [out] status of the receiver */
+} pair_t;
+
+/* sender configurations */
+typedef struct {
+  const char   *name;
+  const char   *flags;
+} txMode_t;
+
+static const txMode_t g_modes[] = {
+  {"as is", "default"},
+  {"delta", "delta"},
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// SENDER / RECEIVER THREADS
+////////////////////////////////////////////////////////////////////////////////
+/* changes runs of DELTA_RUN bytes at random offsets (xorshift) */
+static inline void frame_change(uint8_t *buf, uint32_t size, unsigned runs, uint32_t *seed){
+  for(unsigned i=0; i<runs; i++){
+    uint32_t offset;
+    *seed ^= *seed << 13;
+    *seed ^= *seed >> 17;
+    *seed ^= *seed << 5;
+    offset = *seed % (size - DELTA_RUN + 1);
+    for(uint32_t j=0; j<DELTA_RUN; j++){
+      buf[offset+j]++;
+    }
+  }
+}
+
+/* sends until the deadline and terminates the stream with an empty message */
+void* thread_send(void *p){
+  pair_t *pair = (pair_t*)p;
+  uint64_t cpuStart = thread_cpuTimeNs();
+  uint32_t seed = 2463534242u;
+
+  pair->sent     = 0;
+  pair->statusTx = ICOM_SUCCESS;
+  while(stimer_now_ns() < pair->deadline){
+    frame_change(pair->buf, pair->size, pair->runs, &seed);
+    pair->statusTx = icom_send(pair->icomTx, pair->buf, pair->size);
+    if(pair->statusTx != ICOM_SUCCESS){
+      break;
+    }
+    pair->sent++;
+  }
+  pair->cpuTx = thread_cpuTimeNs() - cpuStart;
+
+  if(pair->statusTx == ICOM_SUCCESS){
+    pair->statusTx = icom_send(pair->icomTx, pair->buf, 0);
+  }
+  return NULL;
+}
+
+void* thread_recv(void *p){
+  pair_t *pair = (pair_t*)p;
+  uint64_t cpuStart = thread_cpuTimeNs();
+  void *buf;
+  unsigned bufSize;
+
+  pair->received = 0;
+  while(1){
+    pair->statusRx = icom_recv(pair->icomRx, &buf, &bufSize);
+    if(pair->statusRx != ICOM_SUCCESS || bufSize == 0){
+      break;
+    }
+    if(bufSize != pair->size){
+      _E("Received a corrupted message");
+      pair->statusRx = ICOM_ERROR;
+      break;
+    }
+    pair->received++;
+    pair->end = stimer_now_ns();
+  }
+  pair->cpuRx = thread_cpuTimeNs() - cpuStart;
+  return NULL;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// DISPLAYING RESULTS TO THE TERMINAL
+////////////////////////////////////////////////////////////////////////////////
+static inline void disp_header(const char *title){
+  _I("### %s ###", title);
+  _I("%8s |%6s |%10s |%10s |%14s |%7s |%13s |%13s",
+    "changed", "mode", "msg/s", "MB/s", "wire B/frame", "deltas", "tx CPU ns/msg", "rx CPU ns/msg");
+}
+
+static inline void disp_row(double changed, const char *mode, const pair_t *pair,
+uint64_t start, const icomDeltaStats_t *stats){
+  double seconds = (pair->end - start)/1e9;
+  uint64_t whole = (stats->frames - stats->deltas)*(uint64_t)pair->size;
+
+  _I("%7.1f%% |%6s |%10.1f |%10.1f |%14.0f |%6.1f%% |%13.0f |%13.0f",
+    changed, mode,
+    pair->received/seconds,
+    pair->received*(double)pair->size/seconds/1e6,
+    stats->frames ? (double)(stats->bytesOut + whole)/stats->frames : (double)pair->size,
+    stats->frames ? 100.0*stats->deltas/stats->frames : 0.0,
+    pair->sent ? (double)pair->cpuTx/pair->sent : 0.0,
+    pair->received ? (double)pair->cpuRx/pair->received : 0.0);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// MEASUREMENTS
+////////////////////////////////////////////////////////////////////////////////
+static int run_pair(pair_t *pair, const txMode_t *mode, double duration,
+uint64_t *start, icomDeltaStats_t *stats){
+  char str[DELTA_STRING_MAX];
+  pthread_t pidTx, pidRx;
+  int ret = 0;
+
+  snprintf(str, DELTA_STRING_MAX, "socket_rx|default|*:%u", DELTA_PORT);
+  pair->icomRx = icom_init(str);
+  if(ICOM_IS_ERR(pair->icomRx)){
+    _E("Failed to initialize Rx communicator \"%s\"", str);
+    return -1;
+  }
+  snprintf(str, DELTA_STRING_MAX, "socket_tx|%s|127.0.0.1:%u", mode->flags, DELTA_PORT);
+  pair->icomTx = icom_init(str);
+  if(ICOM_IS_ERR(pair->icomTx)){
+    _E("Failed to initialize Tx communicator \"%s\"", str);
+    icom_deinit(pair->icomRx);
+    return -1;
+  }
+
+  *start = stimer_now_ns();
+  pair->deadline = *start + (uint64_t)(duration*1e9);
+  pthread_create(&pidRx, NULL, thread_recv, pair);
+  pthread_create(&pidTx, NULL, thread_send, pair);
+  pthread_join(pidTx, NULL);
+  pthread_join(pidRx, NULL);
+
+  if(pair->statusTx != ICOM_SUCCESS || pair->statusRx != ICOM_SUCCESS
+  || pair->received != pair->sent){
+    _E("Transfer failed (tx: %d, rx: %d, %lu/%lu messages)",
+      pair->statusTx, pair->statusRx, pair->received, pair->sent);
+    ret = -1;
+  }
+  icom_getDeltaStats(pair->icomTx, stats);
+
+  icom_deinit(pair->icomTx);
+  icom_deinit(pair->icomRx);
+  return ret;
+}
+
+static int run_size(uint32_t size, const double *changes, unsigned changeCount, double duration){
+  char title[DELTA_STRING_MAX];
+  icomDeltaStats_t stats;
+  uint64_t start;
+  pair_t pair;
+
+  memset(&pair, 0, sizeof(pair));
+  pair.size = size;
+  pair.buf  = (uint8_t*)malloc(size);
+  if(!pair.buf){
+    _E("Failed to allocate memory");
+    return -1;
+  }
+  for(uint32_t i=0; i<size; i++){
+    pair.buf[i] = rand();
+  }
+
+  snprintf(title, sizeof(title), "%.1f %s FRAMES OVER LOOPBACK",
+    disp_bytesGetNum(size), disp_bytesGetUnits(size));
+  disp_header(title);
+
+  for(unsigned c=0; c<changeCount; c++){
+    /* runs land at random offsets, the changed share is approximate */
+    pair.runs = (unsigned)(changes[c]/100*size/DELTA_RUN);
+    for(unsigned m=0; m<STATIC_ARRAY_SIZE(g_modes); m++){
+      if(run_pair(&pair, &g_modes[m], duration, &start, &stats) != 0){
+        free(pair.buf);
+        return -1;
+      }
+      disp_row(changes[c], g_modes[m].name, &pair, start, &stats);
+    }
+  }
+
+  free(pair.buf);
+  return 0;
+}
+
+
+static void usage(const char *name){
+  _I("Usage: %s [-c percent,...] [-z size] [-d seconds]", name);
+  _I("  -c  comma separated shares of the frame changed before every send, in");
+  _I("      runs of %u bytes at random offsets (default: 0.1,1,10,50)", DELTA_RUN);
+  _I("  -z  frame size in bytes, at least %u (default: %u)", DELTA_RUN, DELTA_SIZE);
+  _I("  -d  duration of a single measurement (default: %.1f s)", DELTA_DURATION_S);
+}
+
+int main(int argc, char *argv[]){
+  double changes[16] = {0.1, 1, 10, 50};
+  unsigned changeCount = 4;
+  uint32_t size = DELTA_SIZE;
+  double duration = DELTA_DURATION_S;
+  char *tok;
+  int opt;
+
+  while((opt = getopt(argc, argv, "c:z:d:h")) != -1){
+    switch(opt){
+      case 'c':
+        changeCount = 0;
+        for(tok=strtok(optarg, ","); tok && changeCount<STATIC_ARRAY_SIZE(changes); tok=strtok(NULL, ",")){
+          changes[changeCount++] = strtod(tok, NULL);
+        }
+        break;
+      case 'z':
+        size = strtoul(optarg, NULL, 0);
+        break;
+      case 'd':
+        duration = strtod(optarg, NULL);
+        break;
+      default:
+        usage(argv[0]);
+        return 1;
+    }
+  }
+
+  if(changeCount < 1 || size < DELTA_RUN || duration <= 0){
+    usage(argv[0]);
+    return 1;
+  }
+
+  if(run_size(size, changes, changeCount, duration) != 0){
+    _E("Delta benchmark failed");
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,97 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "histogram.h"
+
+
+static inline unsigned hist_index(uint64_t value){
+  unsigned msb, shift;
+
+  /* small values are stored exactly */
+  if(value < HIST_SUB_COUNT){
+    return (unsigned)value;
+  }
+
+  /* otherwise keep HIST_SUB_BITS most significant bits below the leading one */
+  msb   = 63 - __builtin_clzll(value);
+  shift = msb - HIST_SUB_BITS;
+  return (shift + 1)*HIST_SUB_COUNT + (unsigned)(value >> shift) - HIST_SUB_COUNT;
+}
+
+static inline uint64_t hist_upperBound(unsigned index){
+  unsigned shift;
+  uint64_t sub;
+
+  if(index < HIST_SUB_COUNT){
+    return index;
+  }
+
+  shift = index/HIST_SUB_COUNT - 1;
+  sub   = index%HIST_SUB_COUNT + HIST_SUB_COUNT;
+  return ((sub + 1) << shift) - 1;
+}
+
+
+int hist_init(hist_t *hist){
+  hist->buckets = (uint64_t*)malloc(HIST_BUCKET_COUNT*sizeof(uint64_t));
+  if(!hist->buckets){
+    return -1;
+  }
+
+  hist_reset(hist);
+  return 0;
+}
+
+void hist_deinit(hist_t *hist){
+  free(hist->buckets);
+  hist->buckets = NULL;
+}
+
+void hist_reset(hist_t *hist){
+  hist->count = 0;
+  hist->min   = UINT64_MAX;
+  hist->max   = 0;
+  hist->sum   = 0;
+  memset(hist->buckets, 0, HIST_BUCKET_COUNT*sizeof(uint64_t));
+}
+
+void hist_record(hist_t *hist, uint64_t value){
+  hist->buckets[hist_index(value)]++;
+  hist->count++;
+  hist->sum += value;
+  if(value < hist->min) hist->min = value;
+  if(value > hist->max) hist->max = value;
+}
+
+void hist_add(hist_t *dst, const hist_t *src){
+  for(unsigned i=0; i<HIST_BUCKET_COUNT; i++){
+    dst->buckets[i] += src->buckets[i];
+  }
+  dst->count += src->count;
+  dst->sum   += src->sum;
+  if(src->min < dst->min) dst->min = src->min;
+  if(src->max > dst->max) dst->max = src->max;
+}
+
+uint64_t hist_percentile(const hist_t *hist, double percentile){
+  uint64_t rank, seen = 0;
+
+  if(hist->count == 0){
+    return 0;
+  }
+
+  /* rank of the requested sample (1-based, rounded up) */
+  rank = (uint64_t)(percentile/100.0*hist->count + 0.5);
+  if(rank < 1)           rank = 1;
+  if(rank > hist->count) rank = hist->count;
+
+  for(unsigned i=0; i<HIST_BUCKET_COUNT; i++){
+    seen += hist->buckets[i];
+    if(seen >= rank){
+      uint64_t value = hist_upperBound(i);
+      return (value > hist->max) ? hist->max : value;
+    }
+  }
+
+  return hist->max;
+}
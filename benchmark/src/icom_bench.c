@@ -0,0 +1,844 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/wait.h>
+
+#include "icom.h"
+#include "notification.h"
+#include "string_parser.h"
+#include "simple_timer.h"
+#include "histogram.h"
+#include "bench_util.h"
+#include "perf_counters.h"
+
+#define BENCH_SIZES_MAX      (64)
+#define BENCH_RECEIVERS_MAX  (256)
+#define BENCH_DURATION_S     (1.0)
+#define BENCH_WARMUP         (1000)
+#define BENCH_CONNECT_S      (10.0)
+#define BENCH_STRING_MAX     (256)
+
+
+////////////////////////////////////////////////////////////////////////////////
+// CUSTOM TYPE DEFINITIONS
+////////////////////////////////////////////////////////////////////////////////
+typedef enum {
+  MODE_LATENCY=0,  /** ping-pong, the receiver echoes every message */
+  MODE_THROUGHPUT, /** back to back messages */
+  MODE_FANOUT,     /** back to back messages, one receiver thread per link */
+} benchMode_t;
+
+typedef enum {
+  ROLE_BOTH=0,     /** sender and receiver in this invocation */
+  ROLE_TX,         /** sender only (receiver runs elsewhere) */
+  ROLE_RX,         /** receiver only (sender runs elsewhere) */
+} benchRole_t;
+
+typedef enum {
+  FORMAT_TABLE=0,
+  FORMAT_CSV,
+  FORMAT_JSON,
+} benchFormat_t;
+
+/* command line configuration */
+typedef struct {
+  benchMode_t    mode;
+  benchRole_t    role;
+  benchFormat_t  format;
+  const char    *tx;
+  const char    *rx;
+  uint32_t       sizes[BENCH_SIZES_MAX];
+  unsigned       sizeCount;
+  double         duration;
+  uint64_t       warmup;
+  int            cpuTx;
+  int            cpuRx;
+  int            procs;
+  int            perf;
+  FILE          *out;
+} benchArgs_t;
+
+/* measurement of a single side, sent through a pipe in two process runs */
+typedef struct {
+  uint64_t      messages;  /** messages (all the receivers) */
+  uint64_t      first;     /** monotonic time of the first message */
+  uint64_t      end;       /** monotonic time of the last message */
+  uint64_t      cpuTime;   /** CPU time of the side's thread(s) */
+  perfSample_t  perf;      /** event counters of the side's thread(s) */
+  icomStatus_t  status;
+} sideResult_t;
+
+/* receiver thread data structure */
+typedef struct {
+  icom_t       *icom;
+  benchMode_t   mode;
+  int           cpu;
+  int           perf;
+  int           connected; /** connection message already consumed */
+  sideResult_t  result;
+} recvPdata_t;
+
+/* a single output row */
+typedef struct {
+  uint32_t      size;
+  sideResult_t  tx;
+  sideResult_t  rx;
+  int           hasTx;
+  int           hasRx;
+  hist_t       *hist;      /** round-trip times (latency mode, sender side) */
+} benchRow_t;
+
+
+////////////////////////////////////////////////////////////////////////////////
+// OUTPUT
+////////////////////////////////////////////////////////////////////////////////
+static const char *g_modeStrings[]   = {"latency", "throughput", "fanout"};
+static const char *g_roleStrings[]   = {"both", "tx", "rx"};
+static const char *g_formatStrings[] = {"table", "csv", "json"};
+static int g_rowCount = 0;
+
+static void json_string(FILE *out, const char *str){
+  fputc('"', out);
+  for(; str && *str; str++){
+    if(*str == '"' || *str == '\\'){
+      fputc('\\', out);
+    }
+    fputc(*str, out);
+  }
+  fputc('"', out);
+}
+
+/* prints a number, or an empty CSV cell / JSON null / dash if not available */
+static void out_number(const benchArgs_t *args, const char *fmt, int available, double value){
+  if(available){
+    fprintf(args->out, fmt, value);
+  } else {
+    switch(args->format){
+      case FORMAT_JSON:  fprintf(args->out, "null"); break;
+      case FORMAT_CSV:   break;
+      case FORMAT_TABLE:
+      default:           fprintf(args->out, "%*s", atoi(fmt+1), "-"); break;
+    }
+  }
+}
+
+void out_begin(const benchArgs_t *args){
+  switch(args->format){
+    case FORMAT_CSV:
+      fprintf(args->out, "mode,role,tx,rx,size,messages,msg_per_s,gb_per_s,"
+        "tx_cpu_ns_per_msg,rx_cpu_ns_per_msg,min_us,p50_us,p90_us,p99_us,p999_us,max_us");
+      for(int side=0; args->perf && side<2; side++){
+        for(int i=0; i<PERF_COUNTER_COUNT; i++){
+          fprintf(args->out, ",%s_%s_per_msg", side ? "rx" : "tx", perf_name(i));
+        }
+      }
+      fprintf(args->out, "\n");
+      break;
+    case FORMAT_JSON:
+      fprintf(args->out, "{\"mode\": \"%s\", \"role\": \"%s\", \"tx\": ",
+        g_modeStrings[args->mode], g_roleStrings[args->role]);
+      json_string(args->out, args->tx);
+      fprintf(args->out, ", \"rx\": ");
+      json_string(args->out, args->rx);
+      fprintf(args->out, ", \"results\": [");
+      break;
+    case FORMAT_TABLE:
+    default:
+      fprintf(args->out, "### %s (tx: \"%s\", rx: \"%s\") ###\n",
+        g_modeStrings[args->mode], args->tx ? args->tx : "-", args->rx ? args->rx : "-");
+      fprintf(args->out, "%10s |%11s |%11s |%9s |%10s |%10s |%9s |%9s |%9s |%9s |%9s |%9s\n",
+        "size", "messages", "msg/s", "GB/s", "tx ns/msg", "rx ns/msg",
+        "min us", "p50 us", "p90 us", "p99 us", "p99.9 us", "max us");
+      break;
+  }
+  fflush(args->out);
+}
+
+void out_row(const benchArgs_t *args, const benchRow_t *row){
+  /* ping-pong rates are measured by the sender, other rates by receivers */
+  const sideResult_t *rate = (row->hasRx && args->mode != MODE_LATENCY) ? &row->rx : &row->tx;
+  double seconds = (rate->end - rate->first)/1e9;
+  int hasRate = (rate->messages > 1) && (seconds > 0);
+  int hasHist = (row->hist != NULL) && (row->hist->count > 0);
+  double msgPerSec = hasRate ? (rate->messages - 1)/seconds : 0;
+  const char *sep = (args->format == FORMAT_TABLE) ? " |" : ",";
+
+  switch(args->format){
+    case FORMAT_CSV:
+      fprintf(args->out, "%s,%s,\"%s\",\"%s\",%u,%lu,", g_modeStrings[args->mode],
+        g_roleStrings[args->role], args->tx ? args->tx : "", args->rx ? args->rx : "",
+        row->size, rate->messages);
+      break;
+    case FORMAT_JSON:
+      fprintf(args->out, "%s\n  {\"size\": %u, \"messages\": %lu, ",
+        g_rowCount ? "," : "", row->size, rate->messages);
+      break;
+    case FORMAT_TABLE:
+    default:
+      fprintf(args->out, "%7.1f %-2s |%11lu |", disp_bytesGetNum(row->size),
+        disp_bytesGetUnits(row->size), rate->messages);
+      break;
+  }
+
+  /* rates and CPU costs */
+  if(args->format == FORMAT_JSON) fprintf(args->out, "\"msg_per_s\": ");
+  out_number(args, (args->format == FORMAT_TABLE) ? "%11.0f" : "%.1f", hasRate, msgPerSec);
+  fprintf(args->out, "%s", (args->format == FORMAT_JSON) ? ", \"gb_per_s\": " : sep);
+  out_number(args, (args->format == FORMAT_TABLE) ? "%9.3f" : "%.6f", hasRate, msgPerSec*row->size/1e9);
+  fprintf(args->out, "%s", (args->format == FORMAT_JSON) ? ", \"tx_cpu_ns_per_msg\": " : sep);
+  out_number(args, (args->format == FORMAT_TABLE) ? "%10.0f" : "%.1f",
+    row->hasTx && row->tx.messages, row->tx.messages ? (double)row->tx.cpuTime/row->tx.messages : 0);
+  fprintf(args->out, "%s", (args->format == FORMAT_JSON) ? ", \"rx_cpu_ns_per_msg\": " : sep);
+  out_number(args, (args->format == FORMAT_TABLE) ? "%10.0f" : "%.1f",
+    row->hasRx && row->rx.messages, row->rx.messages ? (double)row->rx.cpuTime/row->rx.messages : 0);
+
+  /* round-trip time percentiles */
+  {
+    const char *names[] = {"min_us", "p50_us", "p90_us", "p99_us", "p999_us", "max_us"};
+    double percentiles[] = {0.0, 50.0, 90.0, 99.0, 99.9, 100.0};
+    for(int i=0; i<sizeof(names)/sizeof(*names); i++){
+      uint64_t value = 0;
+      if(hasHist){
+        value = (i == 0) ? row->hist->min : (i == 5) ? row->hist->max
+              : hist_percentile(row->hist, percentiles[i]);
+      }
+      if(args->format == FORMAT_JSON){
+        fprintf(args->out, ", \"%s\": ", names[i]);
+      } else {
+        fprintf(args->out, "%s", sep);
+      }
+      out_number(args, (args->format == FORMAT_TABLE) ? "%9.2f" : "%.3f", hasHist, value/1000.0);
+    }
+  }
+
+  /* event counters per message, on separate lines in the table */
+  for(int side=0; args->perf && side<2; side++){
+    const sideResult_t *result = side ? &row->rx : &row->tx;
+    int hasSide = (side ? row->hasRx : row->hasTx) && result->messages;
+
+    if(args->format == FORMAT_TABLE){
+      fprintf(args->out, "\n%10s |%11s |", "", side ? "rx per msg" : "tx per msg");
+    }
+    for(int i=0; i<PERF_COUNTER_COUNT; i++){
+      switch(args->format){
+        case FORMAT_JSON:  fprintf(args->out, ", \"%s_%s_per_msg\": ", side ? "rx" : "tx", perf_name(i)); break;
+        case FORMAT_CSV:   fprintf(args->out, ","); break;
+        case FORMAT_TABLE:
+        default:           fprintf(args->out, " %s ", perf_name(i)); break;
+      }
+      out_number(args, (args->format == FORMAT_TABLE) ? "%.2f" : "%.3f",
+        hasSide && (result->perf.valid & (1u << i)),
+        result->messages ? (double)result->perf.values[i]/result->messages : 0);
+    }
+  }
+
+  fprintf(args->out, "%s", (args->format == FORMAT_JSON) ? "}" : "\n");
+  fflush(args->out);
+  g_rowCount++;
+}
+
+void out_end(const benchArgs_t *args){
+  if(args->format == FORMAT_JSON){
+    fprintf(args->out, "\n]}\n");
+  }
+  fflush(args->out);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// RECEIVER SIDE
+////////////////////////////////////////////////////////////////////////////////
+/* Consumes (and in latency mode echoes) messages until an empty one, which
+ * terminates the measurement of a single message size. */
+void* thread_recv(void *p){
+  recvPdata_t *pdata = (recvPdata_t*)p;
+  sideResult_t *result = &pdata->result;
+  uint64_t cpuStart;
+  void *buf;
+  unsigned bufSize;
+  int connected = pdata->connected;
+  perf_t perf;
+
+  thread_pin(pdata->cpu);
+  if(pdata->perf){
+    perf_init(&perf);
+    perf_start(&perf);
+  }
+  cpuStart = thread_cpuTimeNs();
+
+  memset(result, 0, sizeof(*result));
+  while(1){
+    result->status = icom_recv(pdata->icom, &buf, &bufSize);
+    if(result->status != ICOM_SUCCESS){
+      break;
+    }
+
+    /* an empty message before any data only establishes the connection */
+    if(bufSize == 0){
+      if(result->messages == 0 && !connected){
+        connected = 1;
+        continue;
+      }
+      break;
+    }
+
+    if(pdata->mode == MODE_LATENCY){
+      result->status = icom_send(pdata->icom, buf, bufSize);
+      if(result->status != ICOM_SUCCESS){
+        break;
+      }
+    }
+
+    result->end = stimer_now_ns();
+    if(result->messages++ == 0){
+      result->first = result->end;
+    }
+  }
+  result->cpuTime = thread_cpuTimeNs() - cpuStart;
+  if(pdata->perf){
+    perf_stop(&perf, &result->perf);
+    perf_deinit(&perf);
+  }
+  pdata->connected = 1;
+
+  return NULL;
+}
+
+/* splits "type|flags[|options]|address" into one communication string per link */
+int rx_split(const char *comString, char ***strArray, unsigned *strCount){
+  char **fields, **addresses;
+  uint32_t fieldCount;
+  unsigned addressCount;
+
+  if(parser_initFields(&fields, &fieldCount, comString, '|') != 0
+  || (fieldCount != 3 && fieldCount != 4)){
+    _E("Invalid communication string \"%s\"", comString);
+    return -1;
+  }
+  if(parser_initStrArray(&addresses, &addressCount, fields[fieldCount-1]) != 0){
+    _E("Invalid communication string \"%s\"", comString);
+    parser_deinitFields(fields, fieldCount);
+    return -1;
+  }
+
+  *strArray = (char**)malloc(addressCount*sizeof(char*));
+  for(unsigned i=0; i<addressCount; i++){
+    (*strArray)[i] = (char*)malloc(BENCH_STRING_MAX);
+    if(fieldCount == 4){
+      snprintf((*strArray)[i], BENCH_STRING_MAX, "%s|%s|%s|%s", fields[0], fields[1], fields[2], addresses[i]);
+    } else {
+      snprintf((*strArray)[i], BENCH_STRING_MAX, "%s|%s|%s", fields[0], fields[1], addresses[i]);
+    }
+  }
+  *strCount = addressCount;
+
+  parser_deinitStrArray(addresses, addressCount);
+  parser_deinitFields(fields, fieldCount);
+  return 0;
+}
+
+/* Runs the receiver side for all the message sizes. The fan-out mode uses an
+ * icom object (and a thread) per link, other modes use a single object. If
+ * fdReady is valid, a byte is written once receivers are bound and results
+ * are written to fdResult instead of being returned. */
+int run_rx(const benchArgs_t *args, sideResult_t *results, int fdReady, int fdResult){
+  recvPdata_t pdata[BENCH_RECEIVERS_MAX];
+  pthread_t pids[BENCH_RECEIVERS_MAX];
+  char **strArray = NULL;
+  unsigned count = 1;
+  int ret = 0;
+
+  if(args->mode == MODE_FANOUT){
+    if(rx_split(args->rx, &strArray, &count) != 0){
+      return -1;
+    }
+    if(count > BENCH_RECEIVERS_MAX){
+      _E("Too many receivers (%u)", count);
+      parser_deinitStrArray(strArray, count);
+      return -1;
+    }
+  }
+
+  for(unsigned i=0; i<count; i++){
+    pdata[i].icom = icom_init(strArray ? strArray[i] : args->rx);
+    pdata[i].mode = args->mode;
+    pdata[i].cpu  = (args->cpuRx < 0) ? -1 : args->cpuRx + i;
+    pdata[i].perf = args->perf;
+    pdata[i].connected = 0;
+    if(ICOM_IS_ERR(pdata[i].icom)){
+      _E("Failed to initialize Rx communicator");
+      while(i-- > 0){
+        icom_deinit(pdata[i].icom);
+      }
+      if(strArray) parser_deinitStrArray(strArray, count);
+      return -1;
+    }
+  }
+
+  if(fdReady >= 0 && write(fdReady, "", 1) != 1){
+    _SW("Failed to signal receiver readiness");
+  }
+
+  for(unsigned s=0; s<args->sizeCount; s++){
+    sideResult_t result = {0};
+
+    for(unsigned i=0; i<count; i++){
+      pthread_create(&pids[i], NULL, thread_recv, &pdata[i]);
+    }
+    for(unsigned i=0; i<count; i++){
+      pthread_join(pids[i], NULL);
+      result.messages += pdata[i].result.messages;
+      result.cpuTime  += pdata[i].result.cpuTime;
+      perf_add(&result.perf, &pdata[i].result.perf);
+      result.end       = (pdata[i].result.end > result.end) ? pdata[i].result.end : result.end;
+      result.first     = (i == 0 || pdata[i].result.first < result.first) ? pdata[i].result.first : result.first;
+      if(pdata[i].result.status != ICOM_SUCCESS){
+        result.status = pdata[i].result.status;
+      }
+    }
+
+    if(fdResult >= 0){
+      if(write(fdResult, &result, sizeof(result)) != sizeof(result)){
+        _SE("Failed to pass receiver results");
+      }
+    } else {
+      results[s] = result;
+    }
+
+    if(result.status != ICOM_SUCCESS){
+      _E("Receiver failed (%d)", result.status);
+      ret = -1;
+      break;
+    }
+  }
+
+  for(unsigned i=0; i<count; i++){
+    icom_deinit(pdata[i].icom);
+  }
+  if(strArray){
+    parser_deinitStrArray(strArray, count);
+  }
+  return ret;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// SENDER SIDE
+////////////////////////////////////////////////////////////////////////////////
+/* the first send connects, the receiver may still be starting up */
+static icomStatus_t tx_connect(icom_t *icom, void *buf, unsigned bufSize){
+  uint64_t deadline = stimer_now_ns() + (uint64_t)(BENCH_CONNECT_S*1e9);
+  icomStatus_t status;
+
+  do {
+    status = icom_send(icom, buf, bufSize);
+    if(status != ICOM_ECONNREFUSED){
+      break;
+    }
+    usleep(10000);
+  } while(stimer_now_ns() < deadline);
+
+  return status;
+}
+
+/* sends messages of a single size for the configured duration, an empty
+ * message terminates the measurement */
+icomStatus_t tx_size(const benchArgs_t *args, icom_t *icom, uint8_t *buf,
+uint32_t size, sideResult_t *result, hist_t *hist, perf_t *perf){
+  uint64_t start, cpuStart, deadline;
+  void *bufRx;
+  unsigned bytes;
+  uint64_t i;
+
+  if(perf) perf_start(perf);
+  cpuStart = thread_cpuTimeNs();
+  memset(result, 0, sizeof(*result));
+  hist_reset(hist);
+
+  deadline = stimer_now_ns() + (uint64_t)(args->duration*1e9);
+  for(i=0; i == 0 || stimer_now_ns() < deadline || (args->mode == MODE_LATENCY && i <= args->warmup); i++){
+    if(args->mode == MODE_LATENCY && i == args->warmup){
+      hist_reset(hist);
+      memset(result, 0, sizeof(*result));
+      if(perf) perf_start(perf);
+      cpuStart = thread_cpuTimeNs();
+    }
+
+    start = stimer_now_ns();
+    result->status = icom_send(icom, buf, size);
+    if(result->status != ICOM_SUCCESS){
+      _E("Failed to send data (%d)", result->status);
+      return result->status;
+    }
+
+    if(args->mode == MODE_LATENCY){
+      result->status = icom_recv(icom, &bufRx, &bytes);
+      if(result->status != ICOM_SUCCESS){
+        _E("Failed to receive echo (%d)", result->status);
+        return result->status;
+      }
+      hist_record(hist, stimer_now_ns() - start);
+    }
+
+    result->end = stimer_now_ns();
+    if(result->messages++ == 0){
+      result->first = start;
+    }
+  }
+  result->cpuTime = thread_cpuTimeNs() - cpuStart;
+  if(perf) perf_stop(perf, &result->perf);
+
+  result->status = icom_send(icom, buf, 0);
+  return result->status;
+}
+
+/* Runs the sender side for all the message sizes and prints the results,
+ * receiver results (if any) are read from the fdResult pipe. */
+int run_tx(const benchArgs_t *args, int fdResult){
+  benchRow_t row;
+  hist_t hist;
+  perf_t perf;
+  uint8_t *buf;
+  icom_t *icom;
+  int ret = 0;
+
+  thread_pin(args->cpuTx);
+
+  icom = icom_init(args->tx);
+  if(ICOM_IS_ERR(icom)){
+    _E("Failed to initialize Tx communicator");
+    return -1;
+  }
+  if(hist_init(&hist) != 0){
+    _E("Failed to allocate histogram");
+    icom_deinit(icom);
+    return -1;
+  }
+  buf = (uint8_t*)malloc(args->sizes[args->sizeCount-1]);
+  if(!buf){
+    _E("Failed to allocate Tx buffer memory");
+    hist_deinit(&hist);
+    icom_deinit(icom);
+    return -1;
+  }
+  for(uint32_t i=0; i<args->sizes[args->sizeCount-1]; i++){
+    buf[i] = rand();
+  }
+  if(args->perf){
+    perf_init(&perf);
+  }
+
+  /* empty message (discarded by the receiver) establishes the connection */
+  if(tx_connect(icom, buf, 0) != ICOM_SUCCESS){
+    _E("Failed to connect");
+    ret = -1;
+  }
+
+  for(unsigned s=0; s<args->sizeCount && ret == 0; s++){
+    memset(&row, 0, sizeof(row));
+    row.size  = args->sizes[s];
+    row.hasTx = 1;
+    row.hist  = (args->mode == MODE_LATENCY) ? &hist : NULL;
+
+    if(tx_size(args, icom, buf, row.size, &row.tx, &hist, args->perf ? &perf : NULL) != ICOM_SUCCESS){
+      ret = -1;
+    }
+
+    if(fdResult >= 0){
+      row.hasRx = (read(fdResult, &row.rx, sizeof(row.rx)) == sizeof(row.rx));
+      if(row.hasRx && row.rx.status != ICOM_SUCCESS){
+        ret = -1;
+      }
+    }
+
+    out_row(args, &row);
+  }
+
+  if(args->perf){
+    perf_deinit(&perf);
+  }
+  free(buf);
+  hist_deinit(&hist);
+  icom_deinit(icom);
+  return ret;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// PROCESS / THREAD PLACEMENT
+////////////////////////////////////////////////////////////////////////////////
+typedef struct {
+  const benchArgs_t *args;
+  int                fdReady;
+  int                fdResult;
+  int                ret;
+} rxThread_t;
+
+static void* thread_rx(void *p){
+  rxThread_t *pdata = (rxThread_t*)p;
+  thread_pin(pdata->args->cpuRx);
+  pdata->ret = run_rx(pdata->args, NULL, pdata->fdReady, pdata->fdResult);
+  return NULL;
+}
+
+/* sender and receiver in a single process, each side on its own thread(s) */
+int run_threads(const benchArgs_t *args){
+  int fdReady[2], fdResult[2];
+  rxThread_t pdata;
+  pthread_t pid;
+  char ready;
+  int ret = -1;
+
+  if(pipe(fdReady) != 0){
+    _SE("Failed to create pipe");
+    return -1;
+  }
+  if(pipe(fdResult) != 0){
+    _SE("Failed to create pipe");
+    goto failure_pipe;
+  }
+
+  /* receiver results of each size are passed through a pipe, which also
+   * synchronizes the sender with the end of the receiver's measurement */
+  pdata = (rxThread_t){args, fdReady[1], fdResult[1], 0};
+  pthread_create(&pid, NULL, thread_rx, &pdata);
+
+  if(read(fdReady[0], &ready, 1) != 1){
+    _E("Receiver failed to start");
+  } else {
+    ret = run_tx(args, fdResult[0]);
+  }
+  pthread_join(pid, NULL);
+
+  close(fdResult[0]);
+  close(fdResult[1]);
+failure_pipe:
+  close(fdReady[0]);
+  close(fdReady[1]);
+  return (ret || pdata.ret) ? -1 : 0;
+}
+
+/* sender in this process, receiver in a child process */
+int run_processes(const benchArgs_t *args){
+  int fdReady[2], fdResult[2];
+  char ready;
+  pid_t pid;
+  int ret, status;
+
+  if(pipe(fdReady) != 0 || pipe(fdResult) != 0){
+    _SE("Failed to create pipe");
+    return -1;
+  }
+
+  pid = fork();
+  if(pid == -1){
+    _SE("Failed to fork");
+    return -1;
+  }
+
+  if(pid == 0){
+    close(fdReady[0]);
+    close(fdResult[0]);
+    ret = run_rx(args, NULL, fdReady[1], fdResult[1]);
+    close(fdReady[1]);
+    close(fdResult[1]);
+    _exit(ret ? 1 : 0);
+  }
+
+  close(fdReady[1]);
+  close(fdResult[1]);
+  if(read(fdReady[0], &ready, 1) != 1){
+    _E("Receiver process failed to start");
+    waitpid(pid, &status, 0);
+    return -1;
+  }
+
+  ret = run_tx(args, fdResult[0]);
+  waitpid(pid, &status, 0);
+
+  close(fdReady[0]);
+  close(fdResult[0]);
+  return (ret || !WIFEXITED(status) || WEXITSTATUS(status)) ? -1 : 0;
+}
+
+/* receiver only, prints its own view of every message size */
+int run_rxOnly(const benchArgs_t *args){
+  sideResult_t results[BENCH_SIZES_MAX];
+  benchRow_t row;
+  int ret;
+
+  memset(results, 0, sizeof(results));
+  ret = run_rx(args, results, -1, -1);
+
+  for(unsigned s=0; s<args->sizeCount; s++){
+    memset(&row, 0, sizeof(row));
+    row.size  = args->sizes[s];
+    row.rx    = results[s];
+    row.hasRx = 1;
+    out_row(args, &row);
+    if(results[s].status != ICOM_SUCCESS){
+      break;
+    }
+  }
+
+  return ret;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// COMMAND LINE
+////////////////////////////////////////////////////////////////////////////////
+static int lookup(const char *str, const char **strings, unsigned count){
+  for(unsigned i=0; i<count; i++){
+    if(strcmp(str, strings[i]) == 0){
+      return i;
+    }
+  }
+  return -1;
+}
+
+/* parses comma separated sizes with optional K/M/G (binary) suffixes */
+static int parse_sizes(benchArgs_t *args, char *str){
+  char *tok, *end;
+  unsigned long long size;
+
+  args->sizeCount = 0;
+  for(tok=strtok(str, ","); tok; tok=strtok(NULL, ",")){
+    size = strtoull(tok, &end, 0);
+    switch(*end){
+      case 'k': case 'K': size <<= 10; end++; break;
+      case 'm': case 'M': size <<= 20; end++; break;
+      case 'g': case 'G': size <<= 30; end++; break;
+    }
+    if(*end != '\0' || size == 0 || size > UINT32_MAX || args->sizeCount == BENCH_SIZES_MAX){
+      _E("Invalid size list");
+      return -1;
+    }
+    args->sizes[args->sizeCount++] = size;
+  }
+
+  /* the sender allocates a single buffer of the largest size */
+  for(unsigned i=1; i<args->sizeCount; i++){
+    if(args->sizes[i] < args->sizes[i-1]){
+      _E("Sizes must be in ascending order");
+      return -1;
+    }
+  }
+  return args->sizeCount ? 0 : -1;
+}
+
+static void usage(const char *name){
+  _I("Usage: %s --tx <com-string> --rx <com-string> [options]", name);
+  _I("  -t, --tx STRING      sender communication string");
+  _I("  -r, --rx STRING      receiver communication string");
+  _I("  -m, --mode MODE      latency | throughput | fanout (default: throughput)");
+  _I("                       fanout uses a receiver object and thread per rx link");
+  _I("  -s, --sizes LIST     ascending sizes, e.g. 64,4K,1M (default: 64,4K,64K,1M)");
+  _I("  -d, --duration SEC   duration per message size (default: %.1f)", BENCH_DURATION_S);
+  _I("  -w, --warmup N       discarded round trips in latency mode (default: %u)", BENCH_WARMUP);
+  _I("  -p, --pin TX,RX      pin sender/receiver threads (fanout: RX, RX+1, ...)");
+  _I("  -n, --procs 1|2      sender and receiver threads in 1 or 2 processes (default: 1)");
+  _I("  -R, --role ROLE      both | tx | rx, run a single side (default: both)");
+  _I("  -c, --counters       per message event counters (cycles, instructions, cache");
+  _I("                       misses, context switches, page faults, syscalls)");
+  _I("  -f, --format FORMAT  table | csv | json (default: table)");
+  _I("  -o, --output FILE    write results to a file (default: stdout)");
+}
+
+int main(int argc, char *argv[]){
+  benchArgs_t args = {
+    .mode = MODE_THROUGHPUT, .role = ROLE_BOTH, .format = FORMAT_TABLE,
+    .sizes = {64, 4096, 65536, 1048576}, .sizeCount = 4,
+    .duration = BENCH_DURATION_S, .warmup = BENCH_WARMUP,
+    .cpuTx = -1, .cpuRx = -1, .procs = 1, .out = stdout,
+  };
+  struct option options[] = {
+    {"tx",       required_argument, 0, 't'},
+    {"rx",       required_argument, 0, 'r'},
+    {"mode",     required_argument, 0, 'm'},
+    {"sizes",    required_argument, 0, 's'},
+    {"duration", required_argument, 0, 'd'},
+    {"warmup",   required_argument, 0, 'w'},
+    {"pin",      required_argument, 0, 'p'},
+    {"procs",    required_argument, 0, 'n'},
+    {"role",     required_argument, 0, 'R'},
+    {"counters", no_argument,       0, 'c'},
+    {"format",   required_argument, 0, 'f'},
+    {"output",   required_argument, 0, 'o'},
+    {"help",     no_argument,       0, 'h'},
+    {0, 0, 0, 0}
+  };
+  int opt, value, ret;
+
+  while((opt = getopt_long(argc, argv, "t:r:m:s:d:w:p:n:R:cf:o:h", options, NULL)) != -1){
+    switch(opt){
+      case 't': args.tx = optarg; break;
+      case 'r': args.rx = optarg; break;
+      case 'd': args.duration = strtod(optarg, NULL); break;
+      case 'w': args.warmup = strtoull(optarg, NULL, 0); break;
+      case 'n': args.procs = atoi(optarg); break;
+      case 'c': args.perf = 1; break;
+      case 'm':
+        if((value = lookup(optarg, g_modeStrings, 3)) < 0) goto failure_usage;
+        args.mode = value;
+        break;
+      case 'R':
+        if((value = lookup(optarg, g_roleStrings, 3)) < 0) goto failure_usage;
+        args.role = value;
+        break;
+      case 'f':
+        if((value = lookup(optarg, g_formatStrings, 3)) < 0) goto failure_usage;
+        args.format = value;
+        break;
+      case 's':
+        if(parse_sizes(&args, optarg) != 0) goto failure_usage;
+        break;
+      case 'p':
+        if(sscanf(optarg, "%d,%d", &args.cpuTx, &args.cpuRx) != 2) goto failure_usage;
+        break;
+      case 'o':
+        args.out = fopen(optarg, "w");
+        if(!args.out){
+          _SE("Failed to open \"%s\"", optarg);
+          return 1;
+        }
+        break;
+      default:
+        goto failure_usage;
+    }
+  }
+
+  if((args.role != ROLE_RX && !args.tx) || (args.role != ROLE_TX && !args.rx)
+  || (args.procs != 1 && args.procs != 2)){
+    goto failure_usage;
+  }
+  out_begin(&args);
+  switch(args.role){
+    case ROLE_TX:
+      ret = run_tx(&args, -1);
+      break;
+    case ROLE_RX:
+      ret = run_rxOnly(&args);
+      break;
+    case ROLE_BOTH:
+    default:
+      ret = (args.procs == 2) ? run_processes(&args) : run_threads(&args);
+      break;
+  }
+  out_end(&args);
+
+  if(args.out != stdout){
+    fclose(args.out);
+  }
+  return ret ? 1 : 0;
+
+failure_usage:
+  usage(argv[0]);
+  return 1;
+}
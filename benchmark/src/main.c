@@ -1,15 +1,21 @@
+#define _GNU_SOURCE
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <pthread.h>
+#include <sched.h>
+#include <time.h>
 #include <string.h>
 #include <errno.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <getopt.h>
 
 #include "icom.h"
 #include "notification.h"
 #include "simple_timer.h"
+#include "histogram.h"
+#include "bench_util.h"
 
 #define AVERAGING_TEST_COUNT     (20)
 #define TEST_SIZE_MIN            (4)
@@ -17,6 +23,16 @@
 #define TEST_SIZE_MAX            (TEST_SIZE_MIN << TEST_SIZE_LOG_INCREMENTS)
 #define STATIC_ARRAY_SIZE(a)     (sizeof(a)/sizeof(*a))
 
+/* ping-pong (latency) benchmark defaults, the number of round trips for large
+ * messages is limited by the byte budget (but never below the minimum) */
+#define LATENCY_ROUNDTRIPS       (1000000)
+#define LATENCY_WARMUP           (10000)
+#define LATENCY_MIN_ROUNDTRIPS   (1000)
+#define LATENCY_BYTE_BUDGET      (1ull << 30)
+
+/* streaming (throughput) benchmark defaults */
+#define STREAM_DURATION_S        (1.0)
+
 
 ////////////////////////////////////////////////////////////////////////////////
 // CUSTOM TYPE DEFINITIONS
@@ -28,6 +44,34 @@ typedef struct {
   unsigned   bufSize;
 } threadPdata_t;
 
+/* echo thread data structure (ping-pong benchmark) */
+typedef struct {
+  icom_t       *icom;
+  uint64_t      count;
+  icomStatus_t  status;
+} echoPdata_t;
+
+/* streaming thread data structure (shared by the sender and the receiver) */
+typedef struct {
+  icom_t       *icom;
+  void         *buf;
+  unsigned      bufSize;
+  uint64_t      count;    /** messages to send, 0 - until the deadline */
+  uint64_t      deadline; /** monotonic deadline in ns (if count is 0) */
+  int           cpu;      /** CPU to pin the thread to, -1 - not pinned */
+  uint64_t      messages; /** [out] number of messages sent/received */
+  uint64_t      end;      /** [out] monotonic time of the last message */
+  uint64_t      cpuTime;  /** [out] thread's CPU time in ns */
+  icomStatus_t  status;   /** [out] status of the last icom operation */
+} streamPdata_t;
+
+/* benchmark modes */
+typedef enum {
+  MODE_TRANSFER=0,
+  MODE_LATENCY,
+  MODE_STREAM,
+} benchMode_t;
+
 
 ////////////////////////////////////////////////////////////////////////////////
 // GLOBALS
@@ -36,82 +80,61 @@ typedef struct {
 const char *g_com_strings[][2] = {
   {"socket_tx|default|127.0.0.1:8889", "socket_rx|default|*:8889"},
   {"socket_tx|zero|127.0.0.1:8889",    "socket_rx|zero|*:8889"},
+  {"socket_tx|default|stripe|127.0.0.1:[8889-8892]", "socket_rx|default|stripe|*:[8889-8892]"},
 };
 
+/* active scenarios, the built-in ones extended from the command line */
+const char *(*g_scenarios)[2] = g_com_strings;
+unsigned      g_scenarioCount = STATIC_ARRAY_SIZE(g_com_strings);
+
 
 ////////////////////////////////////////////////////////////////////////////////
-// DISPLAYING RESULTS TO THE TERMINAL
+// SCENARIOS
 ////////////////////////////////////////////////////////////////////////////////
-float disp_bytesGetNum(uint64_t bytes){
-  if(bytes >= 1024*1024*1024){   // GB
-    return bytes/(1024*1024*1024);
-
-  } else if(bytes >= 1024*1024){ // MB
-    return bytes/(1024*1024);
-
-  } else if(bytes >= 1024){      // KB
-    return bytes/(1024);
-
-  } else {                       // bytes
-    return bytes;
-  } 
-}
-
-const char* disp_bytesGetUnits(uint64_t bytes){
-  if(bytes >= 1024*1024*1024){   // GB
-    return "GB";
-
-  } else if(bytes >= 1024*1024){ // MB
-    return "MB";
-
-  } else if(bytes >= 1024){      // KB
-    return "KB";
-
-  } else {                       // bytes
-    return "B";
-  } 
-}
-
-float disp_speedGetNum(uint64_t bps){
-  if(bps >= 1000*1000*1000){   // Gbps
-    return ((float)(bps))/(1000*1000*1000);
-
-  } else if(bps>= 1000*1000){  // Mbps
-    return ((float)(bps))/(1000*1000);
+/* appends a "<tx-string>;<rx-string>" scenario to the active scenario list */
+int scenario_add(char *arg){
+  const char *(*scenarios)[2];
+  char *rx;
+
+  rx = strchr(arg, ';');
+  if(!rx){
+    _E("Invalid scenario \"%s\", expected \"<tx-string>;<rx-string>\"", arg);
+    return -1;
+  }
+  *rx++ = '\0';
 
-  } else if(bps>= 1000){       // Kbps
-    return ((float)(bps))/(1000);
+  /* the built-in list is static, so the first extension makes a copy */
+  scenarios = malloc((g_scenarioCount+1)*sizeof(*scenarios));
+  if(!scenarios){
+    _E("Failed to allocate memory");
+    return -1;
+  }
+  memcpy(scenarios, g_scenarios, g_scenarioCount*sizeof(*scenarios));
+  if(g_scenarios != g_com_strings){
+    free(g_scenarios);
+  }
 
-  } else {                     // bps
-    return (float)bps;
-  } 
+  scenarios[g_scenarioCount][0] = arg;
+  scenarios[g_scenarioCount][1] = rx;
+  g_scenarios = scenarios;
+  g_scenarioCount++;
+  return 0;
 }
 
-const char* disp_speedGetUnits(uint64_t bps){
-  if(bps>= 1000*1000*1000){    // Gbps
-    return "Gbps";
-
-  } else if(bps >= 1000*1000){ // Mbps
-    return "Mbps";
-
-  } else if(bps >= 1000){      // Kbps
-    return "Kbps";
-
-  } else {                     // bps
-    return "bps";
-  } 
-}
 
+////////////////////////////////////////////////////////////////////////////////
+// DISPLAYING RESULTS TO THE TERMINAL
+////////////////////////////////////////////////////////////////////////////////
 static inline void disp_scenarios(){
   _I("### SCENARIOS ###");
-  for(int i=0; i<STATIC_ARRAY_SIZE(g_com_strings); i++){
-    _I("Scenario - %d (Tx: \"%s\", Rx: \"%s\")", i, g_com_strings[i][0], g_com_strings[i][1]);
+  for(int i=0; i<g_scenarioCount; i++){
+    _I("Scenario - %d (Tx: \"%s\", Rx: \"%s\")", i, g_scenarios[i][0], g_scenarios[i][1]);
   }
 }
 
 static inline void disp_results(
 uint64_t transferSizes[TEST_SIZE_LOG_INCREMENTS],
-uint64_t timing[STATIC_ARRAY_SIZE(g_com_strings)][TEST_SIZE_LOG_INCREMENTS])
+uint64_t timing[][TEST_SIZE_LOG_INCREMENTS])
 {
   _I("### RESULT TABLE ###"); 
   /* header */
@@ -123,12 +146,12 @@ uint64_t timing[STATIC_ARRAY_SIZE(g_com_strings)][TEST_SIZE_LOG_INCREMENTS])
   }
 
   /* body */
-  for(int s=0; s<STATIC_ARRAY_SIZE(g_com_strings); s++){
+  for(int s=0; s<g_scenarioCount; s++){
     printf("\n%2u:|", s);
     for(int i=0; i<TEST_SIZE_LOG_INCREMENTS; i++){
       printf("%5.1f %-4s|", 
-        disp_speedGetNum(transferSizes[i]/(((float)timing[s][i])/10e6)),
-        disp_speedGetUnits(transferSizes[i]/(((float)timing[s][i])/10e6)));
+        disp_speedGetNum(8*transferSizes[i]/(((float)timing[s][i])/1e6)),
+        disp_speedGetUnits(8*transferSizes[i]/(((float)timing[s][i])/1e6)));
   }}
 
   putchar('\n');
@@ -267,49 +290,465 @@ cleanup_icom_init:
 }
 
 
-int main(void){
+////////////////////////////////////////////////////////////////////////////////
+// PING-PONG (LATENCY) BENCHMARKING
+////////////////////////////////////////////////////////////////////////////////
+
+/* echo thread, sends every received message back through the same link */
+void* thread_echo(void *p){
+  echoPdata_t *pdata = (echoPdata_t*)p;
+  void *buf;
+  unsigned bufSize;
+
+  pdata->status = ICOM_SUCCESS;
+  for(uint64_t i=0; i<pdata->count; i++){
+    pdata->status = icom_recv(pdata->icom, &buf, &bufSize);
+    if(pdata->status != ICOM_SUCCESS){
+      break;
+    }
+    pdata->status = icom_send(pdata->icom, buf, bufSize);
+    if(pdata->status != ICOM_SUCCESS){
+      break;
+    }
+  }
+
+  return NULL;
+}
+
+static inline void disp_latencyHeader(int scenario){
+  _I("### LATENCY (round-trip, us) - SCENARIO %d ###", scenario);
+  _I("%10s |%9s |%9s |%9s |%9s |%9s |%9s |%9s",
+    "size", "count", "min", "p50", "p90", "p99", "p99.9", "max");
+}
+
+static inline void disp_latencyRow(uint32_t size, const hist_t *hist){
+  _I("%7.1f %-2s |%9lu |%9.2f |%9.2f |%9.2f |%9.2f |%9.2f |%9.2f",
+    disp_bytesGetNum(size), disp_bytesGetUnits(size),
+    hist->count,
+    hist->min/1000.0,
+    hist_percentile(hist, 50.0)/1000.0,
+    hist_percentile(hist, 90.0)/1000.0,
+    hist_percentile(hist, 99.0)/1000.0,
+    hist_percentile(hist, 99.9)/1000.0,
+    hist->max/1000.0);
+}
+
+/* Measures round-trip times over a single persistent link pair. The receiver
+ * echoes every message back, the first "warmup" samples are discarded. */
+icomStatus_t test_latency(hist_t *hist, icom_t *icomTx, icom_t *icomRx,
+uint32_t transferSize, uint64_t roundtrips, uint64_t warmup, int fdRandom){
+  icomStatus_t ret = ICOM_SUCCESS;
+  echoPdata_t echoPdata;
+  uint8_t *bufTx;
+  void *bufRx;
+  unsigned bytes;
+  pthread_t pid;
+  uint64_t start;
+
+  bufTx = (uint8_t*)malloc(transferSize);
+  if(!bufTx){
+    _E("Failed to allocate Tx buffer memory: %u", transferSize);
+    return ICOM_ENOMEM;
+  }
+  if(read(fdRandom, bufTx, transferSize) == -1){
+    _SW("Failed to randomize buffer memory");
+  }
+
+  echoPdata = (echoPdata_t){icomRx, warmup+roundtrips, ICOM_SUCCESS};
+  pthread_create(&pid, NULL, thread_echo, &echoPdata);
+
+  hist_reset(hist);
+  for(uint64_t i=0; i<warmup+roundtrips; i++){
+    if(i == warmup){
+      hist_reset(hist);
+    }
+
+    start = stimer_now_ns();
+    ret = icom_send(icomTx, bufTx, transferSize);
+    if(ret != ICOM_SUCCESS){
+      _E("Failed to send data (%d)", ret);
+      break;
+    }
+    ret = icom_recv(icomTx, &bufRx, &bytes);
+    if(ret != ICOM_SUCCESS){
+      _E("Failed to receive echo (%d)", ret);
+      break;
+    }
+    hist_record(hist, stimer_now_ns() - start);
+
+    if(bytes != transferSize){
+      _E("Reveived incorrect size (%u, expected: %u)", bytes, transferSize);
+      ret = ICOM_ERROR;
+      break;
+    }
+  }
+
+  /* on failure the echo thread might never get its remaining messages */
+  if(ret != ICOM_SUCCESS){
+    pthread_cancel(pid);
+  }
+  pthread_join(pid, NULL);
+  if(ret == ICOM_SUCCESS && echoPdata.status != ICOM_SUCCESS){
+    _E("Echo thread error (%d)", echoPdata.status);
+    ret = echoPdata.status;
+  }
+
+  free(bufTx);
+  return ret;
+}
+
+int run_latency(uint64_t roundtrips, uint64_t warmup, int fdRandom){
+  icom_t *icomTx, *icomRx;
+  icomStatus_t status;
+  uint64_t count, skip;
+  hist_t hist;
+
+  if(hist_init(&hist) != 0){
+    _E("Failed to allocate histogram");
+    return 1;
+  }
+
+  for(int s=0; s<g_scenarioCount; s++){
+    _I("Communication strings: \"%s\" and \"%s\"", g_scenarios[s][0], g_scenarios[s][1]);
+
+    /* the link pair is kept for all the message sizes of the scenario */
+    icomRx = icom_init(g_scenarios[s][1]);
+    if(ICOM_IS_ERR(icomRx)){
+      _E("Failed to initialize Rx communicator");
+      continue;
+    }
+    icomTx = icom_init(g_scenarios[s][0]);
+    if(ICOM_IS_ERR(icomTx)){
+      _E("Failed to initialize Tx communicator");
+      icom_deinit(icomRx);
+      continue;
+    }
+
+    disp_latencyHeader(s);
+    for(uint64_t size=TEST_SIZE_MIN; size<TEST_SIZE_MAX; size<<=1){
+      count = roundtrips;
+      if(count*size > LATENCY_BYTE_BUDGET){
+        count = LATENCY_BYTE_BUDGET/size;
+      }
+      if(count < LATENCY_MIN_ROUNDTRIPS){
+        count = LATENCY_MIN_ROUNDTRIPS;
+      }
+      skip = (warmup > count/10) ? count/10 : warmup;
+
+      status = test_latency(&hist, icomTx, icomRx, size, count, skip, fdRandom);
+      if(status != ICOM_SUCCESS){
+        _E("Test failed");
+        break;
+      }
+      disp_latencyRow(size, &hist);
+    }
+
+    icom_deinit(icomTx);
+    icom_deinit(icomRx);
+  }
+
+  hist_deinit(&hist);
+  return 0;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// STREAMING (THROUGHPUT) BENCHMARKING
+////////////////////////////////////////////////////////////////////////////////
+
+/* streaming sender, pushes messages back to back and terminates the stream
+ * with an empty message */
+void* thread_streamSend(void *p){
+  streamPdata_t *pdata = (streamPdata_t*)p;
+  uint64_t cpuStart;
+
+  thread_pin(pdata->cpu);
+  cpuStart = thread_cpuTimeNs();
+
+  pdata->messages = 0;
+  pdata->status   = ICOM_SUCCESS;
+  while(pdata->count ? (pdata->messages < pdata->count)
+                     : (stimer_now_ns() < pdata->deadline)){
+    pdata->status = icom_send(pdata->icom, pdata->buf, pdata->bufSize);
+    if(pdata->status != ICOM_SUCCESS){
+      break;
+    }
+    pdata->messages++;
+  }
+  pdata->end     = stimer_now_ns();
+  pdata->cpuTime = thread_cpuTimeNs() - cpuStart;
+
+  /* the terminating message is not a part of the measurement */
+  if(pdata->status == ICOM_SUCCESS){
+    pdata->status = icom_send(pdata->icom, pdata->buf, 0);
+  }
+
+  return NULL;
+}
+
+/* streaming receiver, consumes messages until the empty one */
+void* thread_streamRecv(void *p){
+  streamPdata_t *pdata = (streamPdata_t*)p;
+  uint64_t cpuStart;
+  void *buf;
+  unsigned bufSize;
+
+  thread_pin(pdata->cpu);
+  cpuStart = thread_cpuTimeNs();
+
+  pdata->messages = 0;
+  while(1){
+    pdata->status = icom_recv(pdata->icom, &buf, &bufSize);
+    if(pdata->status != ICOM_SUCCESS || bufSize == 0){
+      break;
+    }
+    if(bufSize != pdata->bufSize){
+      _E("Reveived incorrect size (%u, expected: %u)", bufSize, pdata->bufSize);
+      pdata->status = ICOM_ERROR;
+      break;
+    }
+    pdata->messages++;
+    pdata->end = stimer_now_ns();
+  }
+  pdata->cpuTime = thread_cpuTimeNs() - cpuStart;
+
+  return NULL;
+}
+
+static inline void disp_streamHeader(int scenario){
+  _I("### STREAMING - SCENARIO %d ###", scenario);
+  _I("%10s |%11s |%11s |%9s |%13s |%13s",
+    "size", "messages", "msg/s", "GB/s", "tx CPU ns/msg", "rx CPU ns/msg");
+}
+
+static inline void disp_streamRow(uint32_t size,
+const streamPdata_t *tx, const streamPdata_t *rx, uint64_t start){
+  double seconds = (rx->end - start)/1e9;
+
+  _I("%7.1f %-2s |%11lu |%11.0f |%9.3f |%13.0f |%13.0f",
+    disp_bytesGetNum(size), disp_bytesGetUnits(size),
+    rx->messages,
+    rx->messages/seconds,
+    (double)rx->messages*size/seconds/1e9,
+    (double)tx->cpuTime/tx->messages,
+    (double)rx->cpuTime/rx->messages);
+}
+
+/* Streams messages of a single size over a persistent link pair either for a
+ * fixed message count or for a fixed duration */
+icomStatus_t test_stream(icom_t *icomTx, icom_t *icomRx, uint32_t transferSize,
+uint64_t count, double duration, int cpuTx, int cpuRx, int fdRandom){
+  streamPdata_t tx, rx;
+  pthread_t pidTx, pidRx;
+  uint64_t start;
+  uint8_t *bufTx;
+
+  bufTx = (uint8_t*)malloc(transferSize);
+  if(!bufTx){
+    _E("Failed to allocate Tx buffer memory: %u", transferSize);
+    return ICOM_ENOMEM;
+  }
+  if(read(fdRandom, bufTx, transferSize) == -1){
+    _SW("Failed to randomize buffer memory");
+  }
+
+  rx = (streamPdata_t){icomRx, NULL,  transferSize, 0, 0, cpuRx};
+  pthread_create(&pidRx, NULL, thread_streamRecv, &rx);
+
+  start = stimer_now_ns();
+  tx = (streamPdata_t){icomTx, bufTx, transferSize, count,
+    start + (uint64_t)(duration*1e9), cpuTx};
+  pthread_create(&pidTx, NULL, thread_streamSend, &tx);
+
+  pthread_join(pidTx, NULL);
+  if(tx.status != ICOM_SUCCESS){
+    _E("Transmitter error (%d)", tx.status);
+    pthread_cancel(pidRx);
+  }
+  pthread_join(pidRx, NULL);
+  free(bufTx);
+
+  if(tx.status != ICOM_SUCCESS){
+    return tx.status;
+  }
+  if(rx.status != ICOM_SUCCESS){
+    _E("Receiver error (%d)", rx.status);
+    return rx.status;
+  }
+  if(rx.messages != tx.messages){
+    _E("Received %lu messages, sent %lu", rx.messages, tx.messages);
+    return ICOM_ERROR;
+  }
+
+  disp_streamRow(transferSize, &tx, &rx, start);
+  return ICOM_SUCCESS;
+}
+
+int run_stream(uint64_t count, double duration, int cpuTx, int cpuRx, int fdRandom){
+  icom_t *icomTx, *icomRx;
+  icomStatus_t status;
+
+  for(int s=0; s<g_scenarioCount; s++){
+    _I("Communication strings: \"%s\" and \"%s\"", g_scenarios[s][0], g_scenarios[s][1]);
+
+    /* the link pair is kept for all the message sizes of the scenario */
+    icomRx = icom_init(g_scenarios[s][1]);
+    if(ICOM_IS_ERR(icomRx)){
+      _E("Failed to initialize Rx communicator");
+      continue;
+    }
+    icomTx = icom_init(g_scenarios[s][0]);
+    if(ICOM_IS_ERR(icomTx)){
+      _E("Failed to initialize Tx communicator");
+      icom_deinit(icomRx);
+      continue;
+    }
+
+    disp_streamHeader(s);
+    for(uint64_t size=TEST_SIZE_MIN; size<TEST_SIZE_MAX; size<<=1){
+      status = test_stream(icomTx, icomRx, size, count, duration, cpuTx, cpuRx, fdRandom);
+      if(status != ICOM_SUCCESS){
+        _E("Test failed");
+        break;
+      }
+    }
+
+    icom_deinit(icomTx);
+    icom_deinit(icomRx);
+  }
+
+  return 0;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// ONE-SHOT TRANSFER BENCHMARKING
+////////////////////////////////////////////////////////////////////////////////
+int run_transfer(int fd){
   icomStatus_t status;
-  uint64_t times[STATIC_ARRAY_SIZE(g_com_strings)][TEST_SIZE_LOG_INCREMENTS] = {0};
+  uint64_t times[g_scenarioCount][TEST_SIZE_LOG_INCREMENTS];
   uint64_t sizes[TEST_SIZE_LOG_INCREMENTS];
   uint64_t time;
-  int fd;
 
   /* fill sizes array (used later for plotting) */
   for(int i=0, size=TEST_SIZE_MIN; size<TEST_SIZE_MAX; size=size<<1, i++){
     sizes[i] = size;
   }
 
-  /* initialize file descriptor for generating random data */
-  fd = open("/dev/urandom", O_RDONLY);
-  if(fd == -1){
-    _SE("Failed to open \"%s\"", "/dev/random");
-    return 1;
-  }
+  memset(times, 0, sizeof(times));
 
   /* run all the tests */
-  for(int s=0; s<STATIC_ARRAY_SIZE(g_com_strings); s++){
-    _I("Communication strings: \"%s\" and \"%s\"", g_com_strings[s][0], g_com_strings[s][1]);
+  for(int s=0; s<g_scenarioCount; s++){
+    _I("Communication strings: \"%s\" and \"%s\"", g_scenarios[s][0], g_scenarios[s][1]);
     for(int i=0; i<TEST_SIZE_LOG_INCREMENTS; i++){
       _I("Performing %u tests for %lu bytes", AVERAGING_TEST_COUNT, sizes[i]);
       for(int j=0; j<AVERAGING_TEST_COUNT; j++){
-        status = test(&time, g_com_strings[s], sizes[i], fd);
+        status = test(&time, g_scenarios[s], sizes[i], fd);
         if(status != ICOM_SUCCESS){
           _E("Test failed");
           continue;
         }
         times[s][i] += time;
       }
-      times[s][i] /= TEST_SIZE_LOG_INCREMENTS;
+      times[s][i] /= AVERAGING_TEST_COUNT;
     }
   }
 
-
   /* print scenarios and results to the terminal */
   disp_scenarios();
   disp_results(sizes, times);
 
+  return 0;
+}
+
+
+static void usage(const char *name){
+  _I("Usage: %s [-m transfer|latency|stream] [-n count] [-w warmup] [-d seconds]", name);
+  _I("       [-p tx-cpu,rx-cpu] [-s \"<tx-string>;<rx-string>\"]...");
+  _I("  -m  benchmark mode (default: transfer)");
+  _I("        transfer - one-shot transfers, averaged over %u runs", AVERAGING_TEST_COUNT);
+  _I("        latency  - ping-pong round trips over persistent links");
+  _I("        stream   - back to back messages over persistent links");
+  _I("  -n  latency: round trips per message size (default: %u)", LATENCY_ROUNDTRIPS);
+  _I("      stream:  messages per message size (default: duration based)");
+  _I("  -w  discarded warm-up round trips (default: %u)", LATENCY_WARMUP);
+  _I("  -d  stream duration per message size (default: %.1f s)", STREAM_DURATION_S);
+  _I("  -p  pin sender and receiver threads to the given CPUs (stream mode)");
+  _I("  -s  add a scenario to the built-in ones (can be repeated)");
+}
+
+int main(int argc, char *argv[]){
+  benchMode_t mode = MODE_TRANSFER;
+  uint64_t roundtrips = LATENCY_ROUNDTRIPS;
+  uint64_t warmup = LATENCY_WARMUP;
+  uint64_t count = 0;
+  double duration = STREAM_DURATION_S;
+  int cpuTx = -1, cpuRx = -1;
+  int opt, ret;
+  int fd;
+
+  while((opt = getopt(argc, argv, "m:n:w:d:p:s:h")) != -1){
+    switch(opt){
+      case 'm':
+        if(strcmp(optarg, "transfer") == 0){
+          mode = MODE_TRANSFER;
+        } else if(strcmp(optarg, "latency") == 0){
+          mode = MODE_LATENCY;
+        } else if(strcmp(optarg, "stream") == 0){
+          mode = MODE_STREAM;
+        } else {
+          usage(argv[0]);
+          return 1;
+        }
+        break;
+      case 'n':
+        roundtrips = count = strtoull(optarg, NULL, 0);
+        break;
+      case 'w':
+        warmup = strtoull(optarg, NULL, 0);
+        break;
+      case 'd':
+        duration = strtod(optarg, NULL);
+        break;
+      case 'p':
+        if(sscanf(optarg, "%d,%d", &cpuTx, &cpuRx) != 2){
+          usage(argv[0]);
+          return 1;
+        }
+        break;
+      case 's':
+        if(scenario_add(optarg) != 0){
+          return 1;
+        }
+        break;
+      default:
+        usage(argv[0]);
+        return 1;
+    }
+  }
+
+  /* initialize file descriptor for generating random data */
+  fd = open("/dev/urandom", O_RDONLY);
+  if(fd == -1){
+    _SE("Failed to open \"%s\"", "/dev/urandom");
+    return 1;
+  }
+
+  switch(mode){
+    case MODE_LATENCY:
+      ret = run_latency(roundtrips, warmup, fd);
+      break;
+    case MODE_STREAM:
+      ret = run_stream(count, duration, cpuTx, cpuRx, fd);
+      break;
+    case MODE_TRANSFER:
+    default:
+      ret = run_transfer(fd);
+      break;
+  }
+
   /* cleanup */
   close(fd);
 
-  return 0;
+  return ret;
 }
@@ -0,0 +1,198 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <sys/resource.h>
+#include <linux/perf_event.h>
+
+#include "notification.h"
+#include "perf_counters.h"
+
+static const char *g_perfNames[PERF_COUNTER_COUNT] = {
+  "cycles", "instructions", "cache_misses", "ctx_switches", "page_faults", "syscalls"
+};
+
+static const char *g_tracepointPaths[] = {
+  "/sys/kernel/tracing/events/raw_syscalls/sys_enter/id",
+  "/sys/kernel/debug/tracing/events/raw_syscalls/sys_enter/id",
+};
+
+/* value followed by PERF_FORMAT_TOTAL_TIME_ENABLED and _RUNNING */
+typedef struct {
+  uint64_t value;
+  uint64_t enabled;
+  uint64_t running;
+} perfRead_t;
+
+
+static int perf_tracepointId(uint64_t *id){
+  FILE *fp;
+  int ret;
+
+  for(unsigned i=0; i<sizeof(g_tracepointPaths)/sizeof(*g_tracepointPaths); i++){
+    fp = fopen(g_tracepointPaths[i], "r");
+    if(fp){
+      ret = fscanf(fp, "%lu", id);
+      fclose(fp);
+      return (ret == 1) ? 0 : -1;
+    }
+  }
+  return -1;
+}
+
+static int perf_open(perfCounter_t counter){
+  struct perf_event_attr attr;
+  uint64_t id;
+  int fd;
+
+  memset(&attr, 0, sizeof(attr));
+  attr.size        = sizeof(attr);
+  attr.disabled    = 1;
+  attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+  switch(counter){
+    case PERF_CYCLES:
+      attr.type   = PERF_TYPE_HARDWARE;
+      attr.config = PERF_COUNT_HW_CPU_CYCLES;
+      break;
+    case PERF_INSTRUCTIONS:
+      attr.type   = PERF_TYPE_HARDWARE;
+      attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+      break;
+    case PERF_CACHE_MISSES:
+      attr.type   = PERF_TYPE_HARDWARE;
+      attr.config = PERF_COUNT_HW_CACHE_MISSES;
+      break;
+    case PERF_CONTEXT_SWITCHES:
+      attr.type   = PERF_TYPE_SOFTWARE;
+      attr.config = PERF_COUNT_SW_CONTEXT_SWITCHES;
+      break;
+    case PERF_PAGE_FAULTS:
+      attr.type   = PERF_TYPE_SOFTWARE;
+      attr.config = PERF_COUNT_SW_PAGE_FAULTS;
+      break;
+    case PERF_SYSCALLS:
+      if(perf_tracepointId(&id) != 0){
+        return -1;
+      }
+      attr.type   = PERF_TYPE_TRACEPOINT;
+      attr.config = id;
+      break;
+    default:
+      return -1;
+  }
+
+  /* the kernel part of the transfer is of interest, but restricted
+   * (perf_event_paranoid >= 2) systems only allow user-space counting */
+  fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+  if(fd < 0 && (errno == EACCES || errno == EPERM) && attr.type == PERF_TYPE_HARDWARE){
+    attr.exclude_kernel = 1;
+    attr.exclude_hv     = 1;
+    fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    if(fd >= 0){
+      _W("Counting %s in user space only", g_perfNames[counter]);
+    }
+  }
+
+  return fd;
+}
+
+
+int perf_init(perf_t *perf){
+  int count = 0;
+
+  for(int i=0; i<PERF_COUNTER_COUNT; i++){
+    perf->fds[i] = perf_open(i);
+
+    /* getrusage provides both software events as well */
+    if(perf->fds[i] >= 0 || i == PERF_CONTEXT_SWITCHES || i == PERF_PAGE_FAULTS){
+      count++;
+    }
+  }
+
+  return count;
+}
+
+void perf_deinit(perf_t *perf){
+  for(int i=0; i<PERF_COUNTER_COUNT; i++){
+    if(perf->fds[i] >= 0){
+      close(perf->fds[i]);
+      perf->fds[i] = -1;
+    }
+  }
+}
+
+void perf_start(perf_t *perf){
+  getrusage(RUSAGE_THREAD, &perf->usage);
+
+  for(int i=0; i<PERF_COUNTER_COUNT; i++){
+    if(perf->fds[i] >= 0){
+      ioctl(perf->fds[i], PERF_EVENT_IOC_RESET, 0);
+      ioctl(perf->fds[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+}
+
+void perf_stop(perf_t *perf, perfSample_t *sample){
+  struct rusage usage;
+  perfRead_t data;
+
+  for(int i=0; i<PERF_COUNTER_COUNT; i++){
+    if(perf->fds[i] >= 0){
+      ioctl(perf->fds[i], PERF_EVENT_IOC_DISABLE, 0);
+    }
+  }
+  getrusage(RUSAGE_THREAD, &usage);
+
+  memset(sample, 0, sizeof(*sample));
+  sample->samples = 1;
+
+  for(int i=0; i<PERF_COUNTER_COUNT; i++){
+    if(perf->fds[i] < 0 || read(perf->fds[i], &data, sizeof(data)) != sizeof(data)){
+      continue;
+    }
+
+    /* never scheduled on the PMU (e.g. all hardware counters taken) */
+    if(data.running == 0){
+      continue;
+    }
+
+    if(data.running < data.enabled){
+      data.value = (uint64_t)((double)data.value*data.enabled/data.running);
+    }
+    sample->values[i] = data.value;
+    sample->valid    |= 1u << i;
+  }
+
+  if(!(sample->valid & (1u << PERF_CONTEXT_SWITCHES))){
+    sample->values[PERF_CONTEXT_SWITCHES] =
+      (usage.ru_nvcsw  - perf->usage.ru_nvcsw) + (usage.ru_nivcsw - perf->usage.ru_nivcsw);
+    sample->valid |= 1u << PERF_CONTEXT_SWITCHES;
+  }
+  if(!(sample->valid & (1u << PERF_PAGE_FAULTS))){
+    sample->values[PERF_PAGE_FAULTS] =
+      (usage.ru_minflt - perf->usage.ru_minflt) + (usage.ru_majflt - perf->usage.ru_majflt);
+    sample->valid |= 1u << PERF_PAGE_FAULTS;
+  }
+}
+
+void perf_add(perfSample_t *dst, const perfSample_t *src){
+  if(src->samples == 0){
+    return;
+  }
+
+  dst->valid = dst->samples ? (dst->valid & src->valid) : src->valid;
+  for(int i=0; i<PERF_COUNTER_COUNT; i++){
+    dst->values[i] += src->values[i];
+  }
+  dst->samples += src->samples;
+}
+
+const char* perf_name(perfCounter_t counter){
+  return (counter < PERF_COUNTER_COUNT) ? g_perfNames[counter] : "unknown";
+}
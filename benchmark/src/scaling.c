@@ -0,0 +1,690 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+
+#include "icom.h"
+#include "notification.h"
+#include "simple_timer.h"
+#include "histogram.h"
+#include "bench_util.h"
+
+#define SCALING_PORT_BASE    (9000)
+#define SCALING_LINKS_MAX    (256)
+#define SCALING_DURATION_S   (0.5)
+#define SCALING_SIZES_MAX    (32)
+#define SCALING_STRING_MAX   (128)
+#define SCALING_SENDERS      (16)
+#define SCALING_POLL_USEC    (10000)
+
+
+////////////////////////////////////////////////////////////////////////////////
+// CUSTOM TYPE DEFINITIONS
+////////////////////////////////////////////////////////////////////////////////
+/* a single sender/receiver icom pair, every object has the same link count */
+typedef struct {
+  icom_t       *icomTx;
+  icom_t       *icomRx;
+  unsigned      links;
+  uint32_t      size;      /** message size */
+  uint64_t      deadline;  /** monotonic time when the sender stops */
+  int           cpuTx;     /** sender's CPU, -1 - not pinned */
+  int           cpuRx;     /** receiver's CPU, -1 - not pinned */
+  hist_t        latHist;   /** per-link latencies, from the send call until the
+                               receive call returns (payload timestamps) */
+  uint64_t      sent;      /** [out] messages sent (per link) */
+  uint64_t      received;  /** [out] messages received (per link) */
+  uint64_t      buffers;   /** [out] buffers traversed with icom_nextBuffer */
+  uint64_t      end;       /** [out] monotonic time of the last message */
+  icomStatus_t  statusTx;  /** [out] status of the sender */
+  icomStatus_t  statusRx;  /** [out] status of the receiver */
+} pair_t;
+
+/* a receiver of the ingest sweep, one of the port's SO_REUSEPORT group */
+typedef struct {
+  icom_t       *icom;
+  int           cpu;       /** receiver's CPU, -1 - not pinned */
+  const int    *stop;      /** set once all the senders are done */
+  uint64_t      received;  /** [out] messages received */
+  uint32_t      peerFirst; /** [out] highest peer id before the run */
+  uint32_t      peerLast;  /** [out] highest peer id of the run */
+  uint64_t      end;       /** [out] monotonic time of the last message */
+  icomStatus_t  status;    /** [out] status of the receiver */
+} shard_t;
+
+/* a sender of the ingest sweep, connects for a single run */
+typedef struct {
+  char          str[SCALING_STRING_MAX];
+  uint32_t      size;
+  uint64_t      deadline;
+  uint64_t      sent;      /** [out] messages sent */
+  icomStatus_t  status;    /** [out] status of the sender */
+} sender_t;
+
+/* aggregated results of concurrently running pairs */
+typedef struct {
+  double    msgPerSec;    /** messages per second (all the links) */
+  double    bytesPerSec;  /** bytes per second (all the links) */
+  double    nsPerMsg;     /** wall time per message (all the links), inverse throughput */
+  uint64_t  latP50;       /** per-link latency, 50th percentile */
+  uint64_t  latP99;       /** per-link latency, 99th percentile */
+} result_t;
+
+
+////////////////////////////////////////////////////////////////////////////////
+// SENDER / RECEIVER THREADS
+////////////////////////////////////////////////////////////////////////////////
+/* fans the message out to all the links until the deadline and terminates the
+ * stream with an empty message, every message starts with its send time */
+void* thread_send(void *p){
+  pair_t *pair = (pair_t*)p;
+  uint8_t *buf;
+  uint64_t now;
+
+  thread_pin(pair->cpuTx);
+
+  buf = (uint8_t*)malloc(pair->size);
+  if(!buf){
+    pair->statusTx = ICOM_ENOMEM;
+    return NULL;
+  }
+  memset(buf, 0xa5, pair->size);
+
+  pair->sent     = 0;
+  pair->statusTx = ICOM_SUCCESS;
+  while((now = stimer_now_ns()) < pair->deadline){
+    memcpy(buf, &now, sizeof(now));
+    pair->statusTx = icom_send(pair->icomTx, buf, pair->size);
+    if(pair->statusTx != ICOM_SUCCESS){
+      break;
+    }
+    pair->sent++;
+  }
+
+  if(pair->statusTx == ICOM_SUCCESS){
+    pair->statusTx = icom_send(pair->icomTx, buf, 0);
+  }
+
+  free(buf);
+  return NULL;
+}
+
+/* fans the messages in from all the links and traverses the buffers, the
+ * latency of every link is measured from the timestamp of its buffer */
+void* thread_recv(void *p){
+  pair_t *pair = (pair_t*)p;
+  void *buf, *data;
+  unsigned bufSize, size;
+  uint64_t now, sent;
+
+  thread_pin(pair->cpuRx);
+
+  pair->received = 0;
+  pair->buffers  = 0;
+  while(1){
+    pair->statusRx = icom_recv(pair->icomRx, &buf, &bufSize);
+    if(pair->statusRx != ICOM_SUCCESS || bufSize == 0){
+      break;
+    }
+    now = stimer_now_ns();
+
+    /* (bounded, zero-copy buffers of the same sender are indistinguishable) */
+    data = NULL;
+    for(unsigned i=0; i<pair->links && icom_nextBuffer(pair->icomRx, &data, &size); i++){
+      memcpy(&sent, data, sizeof(sent));
+      hist_record(&pair->latHist, now - sent);
+      pair->buffers++;
+    }
+
+    pair->received++;
+    pair->end = now;
+  }
+
+  return NULL;
+}
+
+
+/* connects, sends until the deadline and disconnects */
+void* thread_ingestSend(void *p){
+  sender_t *sender = (sender_t*)p;
+  icom_t *icom;
+  uint8_t *buf;
+
+  sender->sent   = 0;
+  sender->status = ICOM_SUCCESS;
+
+  buf = (uint8_t*)malloc(sender->size ? sender->size : 1);
+  if(!buf){
+    sender->status = ICOM_ENOMEM;
+    return NULL;
+  }
+  memset(buf, 0xa5, sender->size);
+
+  icom = icom_init(sender->str);
+  if(ICOM_IS_ERR(icom)){
+    sender->status = ICOM_PTR_ERR(icom);
+    free(buf);
+    return NULL;
+  }
+
+  while(stimer_now_ns() < sender->deadline){
+    sender->status = icom_send(icom, buf, sender->size);
+    if(sender->status != ICOM_SUCCESS){
+      break;
+    }
+    sender->sent++;
+  }
+
+  icom_deinit(icom);
+  free(buf);
+  return NULL;
+}
+
+/* receives messages of any sender until the senders are done */
+void* thread_ingestRecv(void *p){
+  shard_t *shard = (shard_t*)p;
+  void *buf;
+  unsigned bufSize;
+
+  thread_pin(shard->cpu);
+
+  shard->received = 0;
+  shard->peerLast = shard->peerFirst;
+  while(1){
+    shard->status = icom_recv(shard->icom, &buf, &bufSize);
+    if(shard->status == ICOM_TIMEOUT && !__atomic_load_n(shard->stop, __ATOMIC_ACQUIRE)){
+      continue;
+    }
+    if(shard->status != ICOM_SUCCESS){
+      break;
+    }
+
+    shard->received++;
+    shard->end = stimer_now_ns();
+    if(icom_getPeer(shard->icom) > shard->peerLast){
+      shard->peerLast = icom_getPeer(shard->icom);
+    }
+  }
+
+  /* the senders are gone, running out of messages is the expected end */
+  if(shard->status == ICOM_TIMEOUT){
+    shard->status = ICOM_SUCCESS;
+  }
+  return NULL;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// PAIR MANAGEMENT
+////////////////////////////////////////////////////////////////////////////////
+static void comString(char *str, const char *type, const char *flags,
+const char *address, unsigned port, unsigned links){
+  if(links == 1){
+    snprintf(str, SCALING_STRING_MAX, "%s|%s|%s:%u", type, flags, address, port);
+  } else {
+    snprintf(str, SCALING_STRING_MAX, "%s|%s|%s:[%u-%u]", type, flags, address, port, port+links-1);
+  }
+}
+
+/* initializes pairs with consecutive port ranges */
+int pairs_init(pair_t *pairs, unsigned pairCount, unsigned links, const char *flags, int pin){
+  char str[SCALING_STRING_MAX];
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  unsigned i;
+
+  for(i=0; i<pairCount; i++){
+    memset(&pairs[i], 0, sizeof(pair_t));
+    pairs[i].links = links;
+    pairs[i].cpuTx = pin ? (2*i)%cpus   : -1;
+    pairs[i].cpuRx = pin ? (2*i+1)%cpus : -1;
+
+    comString(str, "socket_rx", flags, "*", SCALING_PORT_BASE + i*links, links);
+    pairs[i].icomRx = icom_init(str);
+    if(ICOM_IS_ERR(pairs[i].icomRx)){
+      _E("Failed to initialize Rx communicator \"%s\"", str);
+      goto failure;
+    }
+
+    comString(str, "socket_tx", flags, "127.0.0.1", SCALING_PORT_BASE + i*links, links);
+    pairs[i].icomTx = icom_init(str);
+    if(ICOM_IS_ERR(pairs[i].icomTx)){
+      _E("Failed to initialize Tx communicator \"%s\"", str);
+      icom_deinit(pairs[i].icomRx);
+      goto failure;
+    }
+
+    if(hist_init(&pairs[i].latHist) != 0){
+      _E("Failed to allocate histogram");
+      icom_deinit(pairs[i].icomTx);
+      icom_deinit(pairs[i].icomRx);
+      goto failure;
+    }
+  }
+
+  return 0;
+
+failure:
+  while(i-- > 0){
+    hist_deinit(&pairs[i].latHist);
+    icom_deinit(pairs[i].icomTx);
+    icom_deinit(pairs[i].icomRx);
+  }
+  return -1;
+}
+
+void pairs_deinit(pair_t *pairs, unsigned pairCount){
+  for(unsigned i=0; i<pairCount; i++){
+    hist_deinit(&pairs[i].latHist);
+    icom_deinit(pairs[i].icomTx);
+    icom_deinit(pairs[i].icomRx);
+  }
+}
+
+/* runs all the pairs concurrently for the given duration and aggregates */
+int pairs_run(pair_t *pairs, unsigned pairCount, uint32_t size, double duration, result_t *result){
+  pthread_t pidTx[pairCount], pidRx[pairCount];
+  uint64_t start, end = 0, messages = 0;
+  hist_t latHist;
+  int ret = 0;
+
+  if(hist_init(&latHist) != 0){
+    _E("Failed to allocate histogram");
+    return -1;
+  }
+
+  start = stimer_now_ns();
+  for(unsigned i=0; i<pairCount; i++){
+    pairs[i].size     = size;
+    pairs[i].deadline = start + (uint64_t)(duration*1e9);
+    hist_reset(&pairs[i].latHist);
+    pthread_create(&pidRx[i], NULL, thread_recv, &pairs[i]);
+    pthread_create(&pidTx[i], NULL, thread_send, &pairs[i]);
+  }
+
+  for(unsigned i=0; i<pairCount; i++){
+    pthread_join(pidTx[i], NULL);
+    pthread_join(pidRx[i], NULL);
+
+    if(pairs[i].statusTx != ICOM_SUCCESS || pairs[i].statusRx != ICOM_SUCCESS){
+      _E("Pair %u failed (tx: %d, rx: %d)", i, pairs[i].statusTx, pairs[i].statusRx);
+      ret = -1;
+    }
+    if(pairs[i].received != pairs[i].sent){
+      _E("Pair %u received %lu messages, sent %lu", i, pairs[i].received, pairs[i].sent);
+      ret = -1;
+    }
+
+    messages += pairs[i].received*pairs[i].links;
+    end = (pairs[i].end > end) ? pairs[i].end : end;
+    hist_add(&latHist, &pairs[i].latHist);
+  }
+
+  result->msgPerSec   = messages/((end - start)/1e9);
+  result->bytesPerSec = result->msgPerSec*size;
+  result->nsPerMsg    = messages ? (double)(end - start)/messages : 0;
+  result->latP50      = hist_percentile(&latHist, 50.0);
+  result->latP99      = hist_percentile(&latHist, 99.0);
+
+  hist_deinit(&latHist);
+  return ret;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// SHARD MANAGEMENT
+////////////////////////////////////////////////////////////////////////////////
+/* initializes receivers sharing a single port, the n-th bound receiver gets
+ * the connections of core n when steering */
+int shards_init(shard_t *shards, unsigned shardCount, const char *flags, int steer, int pin){
+  char str[SCALING_STRING_MAX];
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  unsigned i;
+
+  snprintf(str, SCALING_STRING_MAX, "socket_rx|%s|server,reuseport%s,timeout_us=%u|*:%u",
+    flags, steer ? "=cpu" : "", SCALING_POLL_USEC, SCALING_PORT_BASE);
+
+  for(i=0; i<shardCount; i++){
+    memset(&shards[i], 0, sizeof(shard_t));
+    shards[i].cpu  = (pin || steer) ? i%cpus : -1;
+    shards[i].icom = icom_init(str);
+    if(ICOM_IS_ERR(shards[i].icom)){
+      _E("Failed to initialize Rx communicator \"%s\"", str);
+      goto failure;
+    }
+  }
+
+  return 0;
+
+failure:
+  while(i-- > 0){
+    icom_deinit(shards[i].icom);
+  }
+  return -1;
+}
+
+void shards_deinit(shard_t *shards, unsigned shardCount){
+  for(unsigned i=0; i<shardCount; i++){
+    icom_deinit(shards[i].icom);
+  }
+}
+
+/* runs the senders against the receivers for the given duration */
+int shards_run(shard_t *shards, unsigned shardCount, unsigned senderCount, const char *flags,
+uint32_t size, double duration, result_t *result, uint32_t *connMin, uint32_t *connMax){
+  pthread_t pidRx[shardCount], pidTx[senderCount];
+  sender_t senders[senderCount];
+  uint64_t start, end = 0, received = 0, sent = 0;
+  int stop = 0, ret = 0;
+
+  *connMin = UINT32_MAX;
+  *connMax = 0;
+
+  start = stimer_now_ns();
+  for(unsigned i=0; i<shardCount; i++){
+    shards[i].stop      = &stop;
+    shards[i].peerFirst = shards[i].peerLast;
+    pthread_create(&pidRx[i], NULL, thread_ingestRecv, &shards[i]);
+  }
+  for(unsigned i=0; i<senderCount; i++){
+    snprintf(senders[i].str, SCALING_STRING_MAX, "socket_tx|%s|127.0.0.1:%u", flags, SCALING_PORT_BASE);
+    senders[i].size     = size;
+    senders[i].deadline = start + (uint64_t)(duration*1e9);
+    pthread_create(&pidTx[i], NULL, thread_ingestSend, &senders[i]);
+  }
+
+  for(unsigned i=0; i<senderCount; i++){
+    pthread_join(pidTx[i], NULL);
+    if(senders[i].status != ICOM_SUCCESS){
+      _E("Sender %u failed (%d)", i, senders[i].status);
+      ret = -1;
+    }
+    sent += senders[i].sent;
+  }
+
+  __atomic_store_n(&stop, 1, __ATOMIC_RELEASE);
+  for(unsigned i=0; i<shardCount; i++){
+    uint32_t conns;
+
+    pthread_join(pidRx[i], NULL);
+    if(shards[i].status != ICOM_SUCCESS){
+      _E("Receiver %u failed (%d)", i, shards[i].status);
+      ret = -1;
+    }
+
+    conns    = shards[i].peerLast - shards[i].peerFirst;
+    *connMin = (conns < *connMin) ? conns : *connMin;
+    *connMax = (conns > *connMax) ? conns : *connMax;
+    received += shards[i].received;
+    end = (shards[i].end > end) ? shards[i].end : end;
+  }
+
+  if(received != sent){
+    _E("Receivers received %lu messages, sent %lu", received, sent);
+    ret = -1;
+  }
+
+  memset(result, 0, sizeof(*result));
+  result->msgPerSec   = (end > start) ? received/((end - start)/1e9) : 0;
+  result->bytesPerSec = result->msgPerSec*size;
+  return ret;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// DISPLAYING RESULTS TO THE TERMINAL
+////////////////////////////////////////////////////////////////////////////////
+static inline void disp_header(const char *title, const char *unit){
+  _I("### %s ###", title);
+  _I("%6s |%10s |%12s |%10s |%11s |%11s |%11s |%11s",
+    unit, "size", "agg msg/s", "agg GB/s", "agg ns/msg", "lat p50 us", "lat p99 us", "efficiency");
+}
+
+static inline void disp_row(unsigned count, uint32_t size, const result_t *result, double efficiency){
+  _I("%6u |%7.1f %-2s |%12.0f |%10.3f |%11.1f |%11.2f |%11.2f |%10.1f%%",
+    count,
+    disp_bytesGetNum(size), disp_bytesGetUnits(size),
+    result->msgPerSec,
+    result->bytesPerSec/1e9,
+    result->nsPerMsg,
+    result->latP50/1000.0,
+    result->latP99/1000.0,
+    100.0*efficiency);
+}
+
+
+static inline void disp_ingestHeader(const char *title){
+  _I("### %s ###", title);
+  _I("%6s |%10s |%12s |%10s |%10s |%10s |%11s",
+    "rx", "size", "agg msg/s", "agg GB/s", "conn min", "conn max", "efficiency");
+}
+
+static inline void disp_ingestRow(unsigned count, uint32_t size, const result_t *result,
+uint32_t connMin, uint32_t connMax, double efficiency){
+  _I("%6u |%7.1f %-2s |%12.0f |%10.3f |%10u |%10u |%10.1f%%",
+    count,
+    disp_bytesGetNum(size), disp_bytesGetUnits(size),
+    result->msgPerSec,
+    result->bytesPerSec/1e9,
+    connMin, connMax,
+    100.0*efficiency);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// EXPERIMENTS / BENCHMARKING
+////////////////////////////////////////////////////////////////////////////////
+/* doubling sweep step, which always includes the maximum */
+static inline unsigned sweep_next(unsigned n, unsigned max){
+  return (n < max && 2*n > max) ? max : 2*n;
+}
+
+/* Single pair with 1..linksMax links. A single thread serves all the links on
+ * either side, so the ideal aggregate throughput stays at the 1 link level. */
+int run_links(unsigned linksMax, uint32_t *sizes, unsigned sizeCount,
+double duration, const char *flags, int pin){
+  double baseline[sizeCount];
+  result_t result;
+  pair_t pair;
+
+  disp_header("LINK SCALING (icom_send fan-out, icom_recv fan-in, icom_nextBuffer)", "links");
+  for(unsigned links=1; links<=linksMax; links=sweep_next(links, linksMax)){
+    if(pairs_init(&pair, 1, links, flags, pin) != 0){
+      return -1;
+    }
+
+    for(unsigned s=0; s<sizeCount; s++){
+      if(pairs_run(&pair, 1, sizes[s], duration, &result) != 0){
+        pairs_deinit(&pair, 1);
+        return -1;
+      }
+      if(links == 1){
+        baseline[s] = result.bytesPerSec;
+      }
+      disp_row(links, sizes[s], &result, result.bytesPerSec/baseline[s]);
+    }
+
+    pairs_deinit(&pair, 1);
+  }
+
+  return 0;
+}
+
+/* 1..pairsMax independent single link pairs, each side on its own thread, so
+ * the ideal aggregate throughput grows linearly with the pair count. */
+int run_pairs(unsigned pairsMax, uint32_t *sizes, unsigned sizeCount,
+double duration, const char *flags, int pin){
+  double baseline[sizeCount];
+  result_t result;
+  pair_t pairs[pairsMax];
+
+  disp_header("PAIR SCALING (independent link pairs, 2 threads per pair)", "pairs");
+  for(unsigned count=1; count<=pairsMax; count=sweep_next(count, pairsMax)){
+    if(pairs_init(pairs, count, 1, flags, pin) != 0){
+      return -1;
+    }
+
+    for(unsigned s=0; s<sizeCount; s++){
+      if(pairs_run(pairs, count, sizes[s], duration, &result) != 0){
+        pairs_deinit(pairs, count);
+        return -1;
+      }
+      if(count == 1){
+        baseline[s] = result.bytesPerSec;
+      }
+      disp_row(count, sizes[s], &result, result.bytesPerSec/(count*baseline[s]));
+    }
+
+    pairs_deinit(pairs, count);
+  }
+
+  return 0;
+}
+
+
+/* A fixed set of senders against 1..shardsMax server receivers sharing a
+ * single port (SO_REUSEPORT), each on its own thread, so the ideal aggregate
+ * throughput grows linearly with the receiver count. The kernel spreads the
+ * connections, the connection counts show how evenly. */
+int run_ingest(unsigned shardsMax, unsigned senderCount, uint32_t *sizes, unsigned sizeCount,
+double duration, const char *flags, int steer, int pin){
+  double baseline[sizeCount];
+  uint32_t connMin, connMax;
+  result_t result;
+  shard_t shards[shardsMax];
+
+  disp_ingestHeader(steer
+    ? "INGEST SCALING (SO_REUSEPORT server receivers, connections steered by CPU)"
+    : "INGEST SCALING (SO_REUSEPORT server receivers, connections hashed)");
+  for(unsigned count=1; count<=shardsMax; count=sweep_next(count, shardsMax)){
+    if(shards_init(shards, count, flags, steer, pin) != 0){
+      return -1;
+    }
+
+    for(unsigned s=0; s<sizeCount; s++){
+      if(shards_run(shards, count, senderCount, flags, sizes[s], duration, &result, &connMin, &connMax) != 0){
+        shards_deinit(shards, count);
+        return -1;
+      }
+      if(count == 1){
+        baseline[s] = result.bytesPerSec;
+      }
+      disp_ingestRow(count, sizes[s], &result, connMin, connMax, result.bytesPerSec/(count*baseline[s]));
+    }
+
+    shards_deinit(shards, count);
+  }
+
+  return 0;
+}
+
+
+static void usage(const char *name){
+  _I("Usage: %s [-m links|pairs|ingest|all] [-l links] [-P pairs] [-R receivers]", name);
+  _I("       [-S senders] [-u] [-z size,...] [-d seconds] [-f flags] [-p]");
+  _I("  -m  sweep to perform (default: all)");
+  _I("  -l  maximum link count (default: %u)", SCALING_LINKS_MAX);
+  _I("  -P  maximum concurrent pair count (default: online CPU count)");
+  _I("  -R  maximum receiver count of the ingest sweep (default: online CPU count)");
+  _I("  -S  sender count of the ingest sweep (default: %u)", SCALING_SENDERS);
+  _I("  -u  steer connections to the receiver of the receiving CPU (ingest sweep,");
+  _I("      receiver N is pinned to CPU N)");
+  _I("  -z  comma separated message sizes in bytes, at least %zu (default:", sizeof(uint64_t));
+  _I("      64,4096,65536,1048576)");
+  _I("  -d  duration of a single measurement (default: %.1f s)", SCALING_DURATION_S);
+  _I("  -f  icom flags of the links (default: default)");
+  _I("  -p  pin the sender and the receiver of pair N to CPUs 2N and 2N+1,");
+  _I("      receiver N of the ingest sweep to CPU N");
+}
+
+int main(int argc, char *argv[]){
+  uint32_t sizes[SCALING_SIZES_MAX] = {64, 4096, 65536, 1048576};
+  unsigned sizeCount = 4;
+  unsigned linksMax = SCALING_LINKS_MAX;
+  unsigned pairsMax = sysconf(_SC_NPROCESSORS_ONLN);
+  unsigned shardsMax = sysconf(_SC_NPROCESSORS_ONLN);
+  unsigned senderCount = SCALING_SENDERS;
+  double duration = SCALING_DURATION_S;
+  const char *flags = "default";
+  int doLinks = 1, doPairs = 1, doIngest = 1;
+  int pin = 0, steer = 0;
+  char *tok;
+  int opt;
+
+  while((opt = getopt(argc, argv, "m:l:P:R:S:uz:d:f:ph")) != -1){
+    switch(opt){
+      case 'm':
+        doLinks = (strcmp(optarg, "links") == 0) || (strcmp(optarg, "all") == 0);
+        doPairs = (strcmp(optarg, "pairs") == 0) || (strcmp(optarg, "all") == 0);
+        doIngest = (strcmp(optarg, "ingest") == 0) || (strcmp(optarg, "all") == 0);
+        if(!doLinks && !doPairs && !doIngest){
+          usage(argv[0]);
+          return 1;
+        }
+        break;
+      case 'l':
+        linksMax = strtoul(optarg, NULL, 0);
+        break;
+      case 'P':
+        pairsMax = strtoul(optarg, NULL, 0);
+        break;
+      case 'R':
+        shardsMax = strtoul(optarg, NULL, 0);
+        break;
+      case 'S':
+        senderCount = strtoul(optarg, NULL, 0);
+        break;
+      case 'u':
+        steer = 1;
+        break;
+      case 'z':
+        sizeCount = 0;
+        for(tok=strtok(optarg, ","); tok && sizeCount<SCALING_SIZES_MAX; tok=strtok(NULL, ",")){
+          sizes[sizeCount++] = strtoul(tok, NULL, 0);
+        }
+        break;
+      case 'd':
+        duration = strtod(optarg, NULL);
+        break;
+      case 'f':
+        flags = optarg;
+        break;
+      case 'p':
+        pin = 1;
+        break;
+      default:
+        usage(argv[0]);
+        return 1;
+    }
+  }
+
+  if(linksMax < 1 || pairsMax < 1 || shardsMax < 1 || senderCount < 1 || sizeCount < 1){
+    usage(argv[0]);
+    return 1;
+  }
+  /* messages carry their send time */
+  for(unsigned s=0; s<sizeCount; s++){
+    if(sizes[s] < sizeof(uint64_t)){
+      usage(argv[0]);
+      return 1;
+    }
+  }
+
+  if(doLinks && run_links(linksMax, sizes, sizeCount, duration, flags, pin) != 0){
+    _E("Link scaling benchmark failed");
+    return 1;
+  }
+  if(doPairs && run_pairs(pairsMax, sizes, sizeCount, duration, flags, pin) != 0){
+    _E("Pair scaling benchmark failed");
+    return 1;
+  }
+  if(doIngest && run_ingest(shardsMax, senderCount, sizes, sizeCount, duration, flags, steer, pin) != 0){
+    _E("Ingest scaling benchmark failed");
+    return 1;
+  }
+
+  return 0;
+}
@@ -5,26 +5,24 @@
 /* private storage for nanoseconds */
 static uint64_t set_ns;
 
-void stimer_set(){
+uint64_t stimer_now_ns(){
   struct timespec now;
-  clock_gettime(CLOCK_REALTIME, &now);
-  set_ns = now.tv_sec*1e+9 + now.tv_nsec;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec*1000000000ull + (uint64_t)now.tv_nsec;
+}
+
+void stimer_set(){
+  set_ns = stimer_now_ns();
 }
 
 uint64_t stimer_get_ns(){
-  struct timespec now;
-  clock_gettime(CLOCK_REALTIME, &now);
-  return (uint64_t)((now.tv_sec*1e+9 + now.tv_nsec)-set_ns);
+  return stimer_now_ns() - set_ns;
 }
 
 uint64_t stimer_get_us(){
-  struct timespec now;
-  clock_gettime(CLOCK_REALTIME, &now);
-  return (uint64_t)(1e-3*((now.tv_sec*1e+9 + now.tv_nsec)-set_ns));
+  return (stimer_now_ns() - set_ns)/1000;
 }
 
 uint64_t stimer_get_ms(){
-  struct timespec now;
-  clock_gettime(CLOCK_REALTIME, &now);
-  return (uint64_t)(1e-6*((now.tv_sec*1e+9 + now.tv_nsec)-set_ns));
+  return (stimer_now_ns() - set_ns)/1000000;
 }
@@ -16,23 +16,109 @@
 /* forward declarations */
 typedef struct icomLink icomLink_t;
 typedef struct icom icom_t;
+typedef struct icomShm icomShm_t;
 
 
+/* capacity of the subscribed topic prefixes (topic option) */
+#ifndef ICOM_TOPICS_SIZE
+  #define ICOM_TOPICS_SIZE 256
+#endif
+
+/** @brief Options of an icom object (see icom_init) */
+typedef struct {
+  int      cpu;          /** core of the threads serving the object, -1 - not set */
+  int      node;         /** NUMA node of the buffers, -1 - not set */
+  int      sndbuf;       /** socket send buffer size (bytes), -1 - system default */
+  int      rcvbuf;       /** socket receive buffer size (bytes), -1 - system default */
+  int      notsentLowat; /** TCP_NOTSENT_LOWAT (bytes), -1 - system default */
+  int      quickack;     /** acknowledge received messages immediately */
+  int      nodelay;      /** disable Nagle's algorithm (default) */
+  int64_t  timeoutUs;    /** receive/send timeout, -1 - timeout flag's default */
+  int      memFlags;     /** allocation policy of the buffers (ICOM_MEM_* flags) */
+  int      server;       /** receivers accept any number of senders on a single port */
+  int      reuseport;    /** receivers share the port (SO_REUSEPORT), 2 - connections are
+                             steered to the receiver of the core which received them */
+  int      balance;      /** link selection of push objects, 0 - round-robin, 1 - the
+                             shortest send queue (SIOCOUTQ) */
+  unsigned topicCount;   /** topic prefixes subscribed by sub objects, 0 - all messages */
+  char     topics[ICOM_TOPICS_SIZE]; /** the prefixes, each one terminated by '\0' */
+  uint32_t iface;        /** IPv4 address (network order) of the multicast interface,
+                             INADDR_ANY - selected by the routing table */
+  int      ttl;          /** multicast TTL (hops), -1 - system default (1) */
+  unsigned channels;     /** links (logical channels) multiplexed over the connection of
+                             the single address, 0 - a connection per link */
+  int      stripe;       /** messages are split across the links (socket links) */
+  int      compressMin;  /** smallest message compressed (compress flag), -1 - default
+                             (LINK_COMPRESS_MIN) */
+  int      compressAdaptive; /** compression is suspended while it does not pay off */
+} icomOptions_t;
+
 /** @brief The main icom (internal communication) encapsulation object */
 typedef struct icom {
   icomType_t    type;            /** communication type */
   icomFlags_t   flags;           /** communication flags */
+  icomOptions_t options;         /** communication options */
   unsigned      comCount;        /** number of communication links */
   icomLink_t   *comConnections;  /** communication links */
   char        **comStrings;      /** strings for the communication links */
+  icomShm_t    *shm;             /** shared memory region (zero copy), or NULL */
+  icom_t       *forward;         /** destination of icom_do (see icom_forward), or NULL */
+  int           forwardCopy;     /** icom_do passes payloads through user space */
+  unsigned      sendLast;        /** link of the last message of a push/req object */
+  unsigned      recvLast;        /** link of the last reply of a req object */
+  uint32_t      msgId;           /** correlation id of the last request sent or message
+                                     received (req/rep objects) */
+  uint32_t      msgIdNext;       /** correlation id of the next request */
 } icom_t;
 
+/** @brief Options of the icom_forward routine */
+typedef struct {
+  uint64_t  count;  /** messages to forward per input link, 0 - until an error occurs */
+  int       copy;   /** pass payloads through user space (disables splicing) */
+} icomForwardOptions_t;
+
+/** @brief Receive wait counters of links with the spin flag */
+typedef struct {
+  uint64_t  spins;     /** non-blocking receive attempts */
+  uint64_t  hits;      /** messages found while spinning */
+  uint64_t  fallbacks; /** spin budget exhausted, the receiver blocked */
+  uint64_t  wakeups;   /** messages found after blocking */
+} icomSpinStats_t;
+
+/** @brief Message loss counters of datagram (udp, multicast) links */
+typedef struct {
+  uint64_t  messages;  /** messages received */
+  uint64_t  lost;      /** messages skipped by the sequence numbers (never received
+                           or incomplete) */
+  uint64_t  gaps;      /** discontinuities of the sequence, i.e. bursts of lost messages */
+} icomLossStats_t;
+
+/** @brief Compression counters of links with the compress flag */
+typedef struct {
+  uint64_t  messages;   /** messages of at least the compress_min size sent */
+  uint64_t  compressed; /** messages sent compressed */
+  uint64_t  bytesIn;    /** bytes of the compressed messages */
+  uint64_t  bytesOut;   /** bytes the compressed messages were sent in */
+  uint64_t  skipped;    /** messages sent as is while compression was suspended
+                            (compress_adaptive option) */
+} icomCompressStats_t;
+
+/** @brief Delta encoding counters of links with the delta flag */
+typedef struct {
+  uint64_t  frames;     /** messages sent */
+  uint64_t  deltas;     /** messages sent as the changed ranges of the previous one */
+  uint64_t  bytesIn;    /** bytes of the messages sent as deltas */
+  uint64_t  bytesOut;   /** bytes the deltas were sent in */
+} icomDeltaStats_t;
+
 /** @brief The header of any communication link which is sent before any
  *  actual data transfer */
 typedef struct {
   icomType_t   type;    /** communication type (4 bytes) */
   icomFlags_t  flags;   /** communication flags (4 bytes) */
   uint32_t     bufSize; /** upcomming buffer size (4 bytes) */
+  uint32_t     id;      /** correlation id of requests and replies, 0 - none (4 bytes) */
+  uint32_t     channel; /** logical channel of multiplexed links (4 bytes) */
 } icomMsgHeader_t;
 
 /** @brief Generic encapsulation object for any communication link */
@@ -47,6 +133,15 @@ typedef struct icomLink {
                                 sender, may correspond to pointer size when zero-copying */
   uint32_t     recvBufSize; /** number of bytes in the received buffer,
                                 corresponds to the actual sender buffer size */
+  icomShm_t   *shm;         /** icom object's shared memory region, or NULL */
+  const icomOptions_t *options; /** icom object's options */
+  icomSpinStats_t spinStats; /** receive wait counters (spin flag) */
+  icomLossStats_t lossStats; /** message loss counters (datagram links) */
+  icomCompressStats_t compressStats; /** compression counters (compress flag) */
+  icomDeltaStats_t deltaStats; /** delta encoding counters (delta flag) */
+  uint32_t     recvPeer;    /** peer of the last received message (server option), 0 - none */
+  uint32_t     recvId;      /** correlation id of the last received message */
+  uint32_t     recvChannel; /** logical channel of the last received message */
   icomStatus_t (*sendHandler)(icomLink_t *link, void *buf, unsigned bufSize);
   icomStatus_t (*sendHandlerSecondary)(icomLink_t *link, void *buf, unsigned bufSize);
   icomStatus_t (*recvHandler)(icomLink_t *link, void **buf, unsigned *bufSize);
@@ -54,6 +149,10 @@ typedef struct icomLink {
   icomStatus_t (*notifyRecvHandler)(icomLink_t *link, void **buf, unsigned *bufSize);
   icomStatus_t (*autoSendAck)(icomLink_t *link, void **buf, unsigned *bufSize);
   icomStatus_t (*autoRecvAck)(icomLink_t *link, void **buf, unsigned *bufSize);
+  icomStatus_t (*releaseHandler)(icomLink_t *link, void *buf);  /** returns a leased buffer to its sender (optional) */
+  icomStatus_t (*reclaimHandler)(icomLink_t *link, int timeoutMs); /** processes returned leases (optional) */
+  icomStatus_t (*forwardHandler)(icomLink_t *link, icomLink_t *out, unsigned outCount); /** forwards a message
+                                without copying it to user space (optional), ICOM_ENOTSUP for foreign links */
 } icomLink_t;
 
 
@@ -69,6 +168,10 @@ typedef struct icomLink {
  *         communications or by using special range syntax:
  *         "socket_tx:127.0.0.1:[9988-9999]". _flags_ parameter determines the
  *         underlying configuration of the links (synchroniztion, zero copy).
+ *         An optional options field, "type|flags|options|comId", holds
+ *         comma-separated "name=value" pairs, e.g. "cpu=4,node=0" (see
+ *         icom_options.h). The supported types, flags and options are
+ *         described in README.md.
  *
  *  @return On success returns an icom object. Otherwise on error, the
  *        ICOM_IS_ERR(ptr) returns true, and the ICOM_PTR_ERR(ptr)
@@ -82,11 +185,47 @@ icom_t* icom_init(const char *comString);
  */
 void icom_deinit(icom_t* icom);
 
+/** @brief Forwards messages received by the in object to the out object,
+ *         i.e., a relay which would icom_recv and icom_send the same buffer.
+ *         Every message received on any of the input links is sent to all
+ *         the output links, the header is rewritten for the output links.
+ *         Socket to socket paths splice the payload through a pipe, so it
+ *         never enters user space (zero-copy messages are resolved and sent
+ *         as regular buffers), other paths fall back to icom_recv/icom_send.
+ *
+ *  @param options Forwarding options, NULL forwards until an error occurs
+ *         with splicing enabled
+ *
+ *  @return Returns status of the first failed forwarding step, or
+ *          ICOM_SUCCESS once options->count messages have been forwarded
+ */
+icomStatus_t icom_forward(icom_t *in, icom_t *out, const icomForwardOptions_t *options);
+
+/** @brief Performs a single forwarding step set up by icom_forward, i.e.,
+ *         forwards a single message from every input link (a single
+ *         reassembled message from striped objects).
+ *
+ *  @return Returns ICOM_EINVAL if the object has no forwarding destination
+ */
 icomStatus_t icom_do(icom_t *icom);
 icomStatus_t icom_send(icom_t *icom, void  *buf, unsigned bufSize);
 icomStatus_t icom_recv1(icom_t *icom);
 icomStatus_t icom_recv2(icom_t *icom, void **buf);
 icomStatus_t icom_recv3(icom_t *icom, void **buf, unsigned *bufSize);
+
+/** @brief Sends the message on a single link of the object, e.g. a logical
+ *         channel (see the channels option), other links are not involved.
+ *
+ *  @return Returns ICOM_EINVAL if the index exceeds the links */
+icomStatus_t icom_sendLink(icom_t *icom, unsigned link, void *buf, unsigned bufSize);
+
+/** @brief Receives the next message of a single link of the object. Messages
+ *         of the other channels (see the channels option) arriving meanwhile
+ *         are queued for their channels.
+ *
+ *  @return Returns ICOM_EINVAL if the index exceeds the links */
+icomStatus_t icom_recvLink(icom_t *icom, unsigned link, void **buf, unsigned *bufSize);
+
 icomStatus_t icom_notify_send(icom_t *icom);
 icomStatus_t icom_notify_recv(icom_t *icom);
 
@@ -95,6 +234,90 @@ icomStatus_t icom_notify_recv(icom_t *icom);
 
 void* icom_nextBuffer(icom_t *icom, void **buf, unsigned *bufSize);
 
+/** @brief Allocates a buffer in the shared memory region of a zero-copy icom
+ *         object. Socket links of such objects share the region with their
+ *         peers on connection, afterwards only offsets of the buffers are
+ *         transferred. Buffers allocated elsewhere are still accepted by
+ *         icom_send, but are copied. Reuse of sent buffers is governed by the
+ *         notify/autonotify flags.
+ *
+ *  @return Returns the buffer, or NULL if the object has no region (e.g. zero
+ *          flag is not set) or the region is exhausted
+ */
+void* icom_alloc(icom_t *icom, unsigned size);
+
+/** @brief Releases a buffer allocated by icom_alloc. */
+void icom_free(icom_t *icom, void *buf);
+
+/** @brief Leases a buffer from the shared memory region of a zero-copy icom
+ *         object. Ownership of the buffer passes to icom_send, which shares it
+ *         with all the (fan-out) links, and the buffer is recycled once every
+ *         receiver releases it. Returned buffers are collected without
+ *         blocking, the call only blocks if the region is exhausted.
+ *
+ *  @return Returns the buffer, or NULL if the object has no region or the
+ *          request cannot be satisfied even with all the leases returned
+ */
+void* icom_lease(icom_t *icom, unsigned size);
+
+/** @brief Returns a leased buffer received by icom_recv to its sender.
+ *         Receivers with the "lease" flag keep received buffers until they
+ *         release them, other receivers release a buffer automatically when
+ *         the next message is received on the same link. Releasing any other
+ *         (e.g. copied) buffer does nothing.
+ */
+icomStatus_t icom_release(icom_t *icom, void *buf);
+
+/** @brief Sums the receive wait counters of all the links. Links with the
+ *         "spin" flag poll the socket with non-blocking receives for
+ *         SPIN_BUDGET_USEC (see icom_config.h) before they block.
+ */
+icomStatus_t icom_getSpinStats(icom_t *icom, icomSpinStats_t *stats);
+
+/** @brief Sums the message loss counters of all the links. Datagram (udp,
+ *         multicast) receivers detect lost messages by the gaps in the
+ *         sequence numbers of the received ones, icom_getId returns the
+ *         sequence number of the last received message.
+ */
+icomStatus_t icom_getLossStats(icom_t *icom, icomLossStats_t *stats);
+
+/** @brief Sums the compression counters of all the links. Links with the
+ *         "compress" flag compress messages of at least the compress_min
+ *         size if they shrink by an eighth at least, receivers decompress
+ *         them regardless of their flags.
+ */
+icomStatus_t icom_getCompressStats(icom_t *icom, icomCompressStats_t *stats);
+
+/** @brief Sums the delta encoding counters of all the links. Links with the
+ *         "delta" flag keep the previous frame and send the ranges which
+ *         changed since (unless they exceed half of the frame), receivers
+ *         patch the frame returned by the previous icom_recv in place, so it
+ *         must not be modified by the application.
+ */
+icomStatus_t icom_getDeltaStats(icom_t *icom, icomDeltaStats_t *stats);
+
+/** @brief Retrieves the sender of the message last returned by icom_recv.
+ *         Receivers with the "server" option accept any number of senders on
+ *         a single port and return their messages as they arrive, replies
+ *         (icom_send) go to the sender of the last received message.
+ *
+ *  @return Returns the id of the sender, unique within the link (ids of
+ *          disconnected senders are not reused), or '0' if the link does not
+ *          serve multiple senders or nothing was received yet
+ */
+uint32_t icom_getPeer(icom_t *icom);
+
+/** @brief Retrieves the correlation id of a req/rep object's last message,
+ *         i.e., the id of the request sent by the last icom_send of a
+ *         requester, or of the message received by the last icom_recv
+ *         (the reply carries the id of its request).
+ *
+ *  @return Returns the id, or '0' if nothing was exchanged yet (datagram
+ *          receivers return the message's sequence number, other objects'
+ *          messages carry no id)
+ */
+uint32_t icom_getId(icom_t *icom);
+
 icomStatus_t icom_setBuffer2(icom_t *icom, void *buf);
 icomStatus_t icom_setBuffer3(icom_t *icom, void *buf, unsigned bufSize);
 icomStatus_t icom_getBuffer2(icom_t *icom, void **buf);
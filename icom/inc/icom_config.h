@@ -6,6 +6,10 @@
 typedef enum {
   TIMEOUT_RCV_USEC=0,
   TIMEOUT_SND_USEC,
+  SHM_REGION_SIZE,   /** shared memory region size of zero-copy objects (uint64_t, bytes) */
+  PIPELINE_QUEUE_DEPTH, /** slots of the queues between pipeline stages (uint64_t, power of two) */
+  PIPELINE_SLOT_SIZE,   /** capacity of a pipeline queue slot (uint64_t, bytes) */
+  SPIN_BUDGET_USEC,     /** time receivers with the spin flag poll before blocking (uint64_t) */
 } icomConfig_t;
 
 
@@ -0,0 +1,22 @@
+#ifndef _ICOM_DELTA_H_
+#define _ICOM_DELTA_H_
+
+#include <stdint.h>
+
+/** @brief Changed bytes of a frame (the wire format of delta messages) */
+typedef struct {
+  uint32_t offset; /** first changed byte */
+  uint32_t length; /** changed bytes */
+} icomDeltaRange_t;
+
+/** @brief Finds the bytes of the frame which differ from the previous one,
+ *         compared 16 bytes at once (SSE2, 64-bit words elsewhere). Ranges
+ *         separated by gap equal bytes at most are merged, i.e. a small gap
+ *         costs fewer bytes than a range of its own.
+ *
+ *  @return Returns the number of ranges, or '-1' if there are more than
+ *          maxRanges of them */
+int icom_deltaScan(const void *prev, const void *next, uint32_t size, uint32_t gap,
+                   icomDeltaRange_t *ranges, unsigned maxRanges);
+
+#endif
@@ -12,8 +12,14 @@ typedef uint32_t icomFlags_t;
 #define ICOM_FLAG_TIMEOUT    (1<<2)
 #define ICOM_FLAG_NOTIFY     (1<<3)
 #define ICOM_FLAG_AUTONOTIFY (1<<4)
-#define ICOM_FLAG_MAX_VALID  ICOM_FLAG_AUTONOTIFY
+#define ICOM_FLAG_LEASE      (1<<5)
+#define ICOM_FLAG_SPIN       (1<<6)
+#define ICOM_FLAG_COMPRESS   (1<<7) /* in headers, marks compressed payloads */
+#define ICOM_FLAG_DELTA      (1<<8) /* in headers, marks changed ranges of a frame */
+#define ICOM_FLAG_MAX_VALID  ICOM_FLAG_DELTA
 #define ICOM_FLAG_ZERO_PROT  ((1<<0)+(1<<1))
+#define ICOM_FLAG_STRIPE     (1<<29) /* internal, marks chunks of striped messages */
+#define ICOM_FLAG_CONTROL    (1<<30) /* internal, marks link control messages */
 #define ICOM_FLAG_INVALID    (1<<31)
 
 
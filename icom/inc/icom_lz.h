@@ -0,0 +1,27 @@
+#ifndef _ICOM_LZ_H_
+#define _ICOM_LZ_H_
+
+#include <stdint.h>
+
+/* entries (log2) of the compressor's match finder, i.e. 4 byte positions */
+#ifndef ICOM_LZ_HASH_LOG
+  #define ICOM_LZ_HASH_LOG 12
+#endif
+
+/** @brief Compresses the buffer into the LZ4 block format (byte-oriented
+ *         LZ77, 64 kB window, greedy matching), fast enough to be used per
+ *         message. Compression gives up as soon as the output would exceed
+ *         the capacity, so a capacity below srcSize bails out early on
+ *         incompressible data.
+ *
+ *  @return Returns the compressed size, or '0' if it exceeds the capacity */
+uint32_t icom_lzCompress(const void *src, uint32_t srcSize, void *dst, uint32_t dstCapacity);
+
+/** @brief Decompresses a LZ4 block, the input is validated (malformed blocks
+ *         never access memory outside of the buffers).
+ *
+ *  @return Returns the decompressed size, or '-1' for malformed blocks and
+ *          blocks exceeding dstCapacity */
+int64_t icom_lzDecompress(const void *src, uint32_t srcSize, void *dst, uint32_t dstCapacity);
+
+#endif
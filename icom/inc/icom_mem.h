@@ -0,0 +1,58 @@
+#ifndef _ICOM_MEM_H_
+#define _ICOM_MEM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "icom_status.h"
+
+struct icomLink;
+
+/* allocation policy flags */
+#define ICOM_MEM_THP      (1<<0) /** transparent huge pages (madvise) */
+#define ICOM_MEM_HUGETLB  (1<<1) /** reserved huge pages, falls back to ICOM_MEM_THP */
+#define ICOM_MEM_LOCK     (1<<2) /** lock the pages in memory (mlock) */
+#define ICOM_MEM_PRETOUCH (1<<3) /** fault the pages in while allocating */
+
+/** @brief Allocates memory on the given NUMA node following the allocation
+ *         policy flags. Node bound allocations are page aligned mappings with
+ *         the node preferred (the kernel falls back to other nodes if the
+ *         node runs out of memory), huge page backed mappings are aligned and
+ *         rounded to huge pages. Negative node without flags allocates with
+ *         malloc.
+ *
+ *  @return Returns the memory or NULL on failure */
+void* icom_memAlloc(size_t size, int node, int flags);
+
+/** @brief Resizes memory allocated by icom_memAlloc, the contents up to the
+ *         smaller of the sizes are preserved. Mappings are kept if the new
+ *         size fits the (rounded) mapping.
+ *
+ *  @return Returns the memory or NULL on failure (the old memory is kept) */
+void* icom_memRealloc(void *mem, size_t oldSize, size_t size, int node, int flags);
+
+/** @brief Releases memory allocated by icom_memAlloc/icom_memRealloc. */
+void icom_memFree(void *mem, size_t size, int node, int flags);
+
+/** @brief Grows (never shrinks) the receive buffer of the link to hold size
+ *         bytes, and a pointer at least. The buffer is preceded by the pointer
+ *         to the link, recvAlloc holds the bytes allocated after it.
+ *
+ *  @return Returns ICOM_SUCCESS or ICOM_ENOMEM (the old buffer is kept) */
+icomStatus_t icom_memGrowRecv(struct icomLink *link, uint32_t *recvAlloc, uint32_t size,
+                              int node, int flags);
+
+/** @brief Binds the (page aligned) mapping to the given NUMA node, pages which
+ *         were not touched yet are allocated on the node.
+ *
+ *  @return Returns '0' on success, '-1' otherwise */
+int icom_memBind(void *mem, size_t size, int node);
+
+/** @brief Faults in all the pages of the memory. */
+void icom_memTouch(void *mem, size_t size);
+
+/** @brief Looks up the NUMA node of the core.
+ *
+ *  @return Returns the node or '-1' if it is unknown */
+int icom_memCpuNode(int cpu);
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef _ICOM_OPTIONS_H_
+#define _ICOM_OPTIONS_H_
+
+#include "icom.h"
+#include "icom_status.h"
+
+/** @brief Sets all the options to their defaults (not set). */
+void icom_initOptions(icomOptions_t *options);
+
+/** @brief Parses the options field of the communication string, i.e.,
+ *         comma-separated "name=value" pairs or "default". Boolean options
+ *         may omit the value ("quickack" equals "quickack=1"), sizes accept
+ *         k/M/G suffixes (binary). Supported options:
+ *           - cpu=<core>           core of the threads serving the object
+ *           - node=<node>          NUMA node of the buffers (defaults to the cpu's node)
+ *           - sndbuf=<size>        SO_SNDBUF
+ *           - rcvbuf=<size>        SO_RCVBUF
+ *           - notsent_lowat=<size> TCP_NOTSENT_LOWAT
+ *           - quickack[=0|1]       TCP_QUICKACK after every received message
+ *           - nodelay=<0|1>        TCP_NODELAY (enabled by default)
+ *           - timeout_us=<usec>    receive/send timeout, implies the timeout flag
+ *           - hugepages[=thp|hugetlb|0] huge page backed buffers
+ *           - mlock[=0|1]          lock the buffers in memory
+ *           - pretouch[=0|1]       fault the buffers in while allocating
+ *           - server[=0|1]         receivers accept any number of senders
+ *           - reuseport[=0|1|cpu]  receivers share the port (SO_REUSEPORT), "cpu"
+ *                                  steers connections to the receiver bound
+ *                                  as the n-th one on the receiving core n
+ *           - balance=<rr|outq>    link of every message sent by zmq_push objects,
+ *                                  round-robin or the shortest send queue
+ *           - topic=<prefix>       topic prefix subscribed by zmq_sub objects (may
+ *                                  repeat), no topic subscribes to every message
+ *           - iface=<ip|*>         local interface of mcast links (sending, joining
+ *                                  the group), "*" follows the routing table
+ *           - ttl=<hops>           IP_MULTICAST_TTL of mcast_tx links
+ *           - channels=<n>         socket links of a single address multiplexed over
+ *                                  one connection (logical channels)
+ *           - stripe[=0|1]         every message is split into chunks sent over
+ *                                  all the socket links at once
+ *           - compress_min=<size>  smallest message compressed (compress flag)
+ *           - compress_adaptive[=0|1] compression is suspended while it does not
+ *                                  pay off (ratio, or time against the link's rate)
+ *
+ *  @return Returns ICOM_SUCCESS, or ICOM_EINVAL for unknown options and
+ *          invalid values */
+icomStatus_t icom_parseOptions(icomOptions_t *options, const char *optionString);
+
+#endif
@@ -0,0 +1,94 @@
+#ifndef _ICOM_PIPELINE_H_
+#define _ICOM_PIPELINE_H_
+
+/* force C linkage if included from C++ */
+#ifdef __cplusplus
+  extern "C" {
+#endif
+
+
+#include <stdint.h>
+#include "icom.h"
+#include "icom_status.h"
+
+/* forward declarations */
+typedef struct icomPipeline icomPipeline_t;
+
+
+/** @brief Processing callback of a pipeline stage.
+ *
+ *  @param ctx     User context of the stage
+ *  @param in      Input message, NULL for source stages
+ *  @param inSize  Input message size
+ *  @param out     Output buffer, NULL for sink stages
+ *  @param outSize Capacity of the output buffer on entry, size of the output
+ *                 message on return
+ *
+ *  @return ICOM_SUCCESS emits the output message, ICOM_EAGAIN drops it
+ *          (e.g. filters), any other status ends the stage and the end of the
+ *          stream is passed to the following in-process stages
+ */
+typedef icomStatus_t (*icomStageFunc_t)(void *ctx, const void *in, unsigned inSize,
+                                        void *out, unsigned *outSize);
+
+/** @brief Description of a pipeline stage */
+typedef struct {
+  const char      *name;  /** stage name (statistics) */
+  icomStageFunc_t  func;  /** processing callback, NULL forwards messages unchanged */
+  void            *ctx;   /** user context passed to the callback */
+  const char      *in;    /** input endpoint's communication string, NULL - previous stage */
+  const char      *out;   /** output endpoint's communication string, NULL - next stage */
+  int              cpu;   /** core the stage is pinned to, -1 - the endpoints' cpu option or not pinned */
+} icomStage_t;
+
+/** @brief Statistics of a pipeline stage */
+typedef struct {
+  uint64_t      messages;    /** messages processed */
+  double        utilisation; /** share of the stage's run time spent in the callback and sending */
+  unsigned      queueDepth;  /** messages waiting in the stage's input queue */
+  unsigned      queueMax;    /** maximum depth of the input queue */
+  int           running;     /** the stage did not end yet */
+  icomStatus_t  status;      /** status which ended the stage */
+} icomStageStats_t;
+
+
+/** @brief Initializes a pipeline of stages, each running on its own thread.
+ *         Adjacent stages (the first one without an output endpoint and the
+ *         second one without an input endpoint) are connected by lock-free
+ *         single producer/single consumer queues, whose slots hold the
+ *         messages, so messages are written by the producer's callback
+ *         directly to the memory read by the consumer's callback. Endpoints
+ *         (process boundaries) are regular icom objects, messages received
+ *         on every link of an input endpoint are processed one by one. Queue
+ *         size is set by the PIPELINE_QUEUE_DEPTH and PIPELINE_SLOT_SIZE
+ *         configuration, the latter limits the message size.
+ *
+ *  @return On success returns a pipeline object. Otherwise on error, the
+ *        ICOM_IS_ERR(ptr) returns true, and the ICOM_PTR_ERR(ptr)
+ *        returns the actual icomStatus_t error code.
+ */
+icomPipeline_t* icom_pipelineInit(const icomStage_t *stages, unsigned stageCount);
+
+/** @brief Starts the stage threads. */
+icomStatus_t icom_pipelineStart(icomPipeline_t *pipeline);
+
+/** @brief Requests all the stages to end. Stages blocked in icom_recv end
+ *         once it returns, i.e., endpoints should use the timeout flag. */
+void icom_pipelineStop(icomPipeline_t *pipeline);
+
+/** @brief Waits until all the stages end. */
+icomStatus_t icom_pipelineJoin(icomPipeline_t *pipeline);
+
+/** @brief Retrieves statistics of a stage, can be used while running. */
+icomStatus_t icom_pipelineStats(icomPipeline_t *pipeline, unsigned stage, icomStageStats_t *stats);
+
+/** @brief Stops and joins the stages and deinitializes the pipeline. */
+void icom_pipelineDeinit(icomPipeline_t *pipeline);
+
+
+/* force C linkage if included from C++ - STOP */
+#ifdef __cplusplus
+  }
+#endif
+
+#endif
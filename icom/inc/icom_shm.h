@@ -0,0 +1,76 @@
+#ifndef _ICOM_SHM_H_
+#define _ICOM_SHM_H_
+
+#include <stdint.h>
+#include <pthread.h>
+
+/* Maximum length of the shared memory object name (including '\0') */
+#ifndef ICOM_SHM_NAME_MAX
+  #define ICOM_SHM_NAME_MAX 64
+#endif
+
+/** @brief Shared memory region of a zero-copy icom object. The region is a
+ *  POSIX shared memory object, which is mapped by the peers of all the socket
+ *  links during the connection set-up, so that only offsets of buffers
+ *  allocated in it have to be sent. */
+typedef struct icomShm {
+  char             name[ICOM_SHM_NAME_MAX]; /** shm_open object name */
+  int              fd;        /** shared memory object's file descriptor */
+  uint8_t         *base;      /** local mapping of the region */
+  uint64_t         size;      /** size of the region in bytes */
+  uint64_t         cookie;    /** random value stored in the region, identifies it to the peers */
+  uint64_t         freeList;  /** offset of the first free block */
+  uint64_t         leases;    /** number of leased buffers not returned yet */
+  pthread_mutex_t  lock;      /** protects the allocator */
+} icomShm_t;
+
+
+/** @brief Creates (and maps) a shared memory region of the given size.
+ *
+ *  @return Returns the region on success, NULL otherwise */
+icomShm_t* icom_shmInit(uint64_t size);
+
+/** @brief Unmaps and removes the shared memory region. */
+void icom_shmDeinit(icomShm_t *shm);
+
+/** @brief Allocates a cache line aligned buffer within the region.
+ *
+ *  @return Returns the buffer or NULL if there is not enough free space */
+void* icom_shmAlloc(icomShm_t *shm, uint64_t size);
+
+/** @brief Releases a buffer allocated by icom_shmAlloc. */
+void icom_shmFree(icomShm_t *shm, void *buf);
+
+/** @brief Allocates a leased buffer, i.e. a reference counted buffer holding
+ *         a single (owner's) reference. The buffer is released once the last
+ *         reference is dropped.
+ *
+ *  @return Returns the buffer or NULL if there is not enough free space */
+void* icom_shmLease(icomShm_t *shm, uint64_t size);
+
+/** @brief Adds a reference to a leased buffer. */
+void icom_shmRef(icomShm_t *shm, void *buf);
+
+/** @brief Drops a reference of a leased buffer, the last one releases it. */
+void icom_shmUnref(icomShm_t *shm, void *buf);
+
+/** @brief Checks if the buffer is a leased buffer of the region.
+ *
+ *  @return Returns '1' if it is, '0' otherwise */
+int icom_shmIsLeased(const icomShm_t *shm, const void *buf);
+
+/** @brief Checks if the buffer lies within the region.
+ *
+ *  @return Returns '1' if it does, '0' otherwise */
+int icom_shmContains(const icomShm_t *shm, const void *buf, uint64_t size);
+
+/** @brief Maps the peer's region by its name, the region must hold the
+ *         peer's cookie (the name alone may match a region of this host).
+ *
+ *  @return Returns the local address of the mapping, NULL on failure */
+void* icom_shmMap(const char *name, uint64_t size, uint64_t cookie);
+
+/** @brief Unmaps the peer's region mapped by icom_shmMap. */
+void icom_shmUnmap(void *base, uint64_t size);
+
+#endif
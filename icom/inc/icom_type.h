@@ -12,6 +12,10 @@ typedef enum {
   ICOM_TYPE_ZMQ_SUB,
   ICOM_TYPE_ZMQ_REQ,
   ICOM_TYPE_ZMQ_REP,
+  ICOM_TYPE_MCAST_TX,
+  ICOM_TYPE_MCAST_RX,
+  ICOM_TYPE_UDP_TX,
+  ICOM_TYPE_UDP_RX,
   ICOM_TYPE_AUTO,
   ICOM_TYPE_NONE
 } icomType_t;
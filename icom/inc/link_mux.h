@@ -0,0 +1,51 @@
+#ifndef _LINK_MUX_H_
+#define _LINK_MUX_H_
+
+#include "icom.h"
+#include "icom_type.h"
+#include "icom_status.h"
+
+#include <stdint.h>
+
+/* message of a channel received ahead of the channel's receive */
+typedef struct icomMuxMsg {
+  struct icomMuxMsg  *next;
+  uint32_t            size;
+  uint32_t            id;     /** correlation id of the message */
+  uint8_t             data[];
+} icomMuxMsg_t;
+
+/* connection shared by the channels of an icom object */
+typedef struct {
+  icomLink_t   link;          /** socket link carrying the channels */
+  icomLink_t  *channels;      /** links of the channels (consecutive) */
+  unsigned     channelCount;
+  unsigned     refs;          /** initialized channels */
+} icomMux_t;
+
+typedef struct {
+  icomMux_t     *mux;
+  unsigned       channel;     /** channel id, i.e. the link's index */
+  uint32_t       recvAlloc;   /** bytes allocated for the receive buffer */
+  int            node;        /** NUMA node of the receive buffer, -1 - any */
+  int            memFlags;    /** allocation policy of the receive buffer */
+  icomMuxMsg_t  *head;        /** messages received ahead, oldest first */
+  icomMuxMsg_t  *tail;
+  unsigned       queued;
+} icomLinkMux_t;
+
+
+/** @brief Sets up the connection of the channels (socket_tx/socket_rx types)
+ *         and its first channel, the link must be the first of the channels.
+ */
+icomStatus_t icom_initMux(icomLink_t *link, unsigned channelCount, icomType_t type,
+                          const char *comString, icomFlags_t flags);
+
+/** @brief Sets up a following channel sharing the first channel's connection. */
+icomStatus_t icom_initMuxChannel(icomLink_t *link, icomLink_t *first, unsigned channel);
+
+/** @brief Releases the channel, the last released channel closes the
+ *         connection. */
+void icom_deinitMux(icomLink_t *link);
+
+#endif
@@ -4,10 +4,107 @@
 #include <stdint.h>
 #include <arpa/inet.h>
 #include <sys/socket.h>
+#include <sys/epoll.h>
 
 #include "icom.h"
 #include "icom_type.h"
 #include "icom_status.h"
+#include "icom_shm.h"
+#include "icom_delta.h"
+
+/* requested capacity of the forwarding (splice) pipes, the kernel limits it
+ * for unprivileged processes (/proc/sys/fs/pipe-max-size) */
+#ifndef LINK_PIPE_SIZE
+  #define LINK_PIPE_SIZE (1024*1024)
+#endif
+
+/* readiness events collected by a single epoll_wait of server links */
+#ifndef LINK_SERVER_EVENTS
+  #define LINK_SERVER_EVENTS 64
+#endif
+
+/* smallest chunk of a striped message (stripe option), smaller messages are
+ * spread over fewer links */
+#ifndef LINK_STRIPE_MIN
+  #define LINK_STRIPE_MIN (64*1024)
+#endif
+
+/* smallest message compressed by links with the compress flag (see the
+ * compress_min option) */
+#ifndef LINK_COMPRESS_MIN
+  #define LINK_COMPRESS_MIN (1024)
+#endif
+
+/* Adaptive compression (compress_adaptive option): after LINK_COMPRESS_MISSES
+ * messages in a row which did not pay off, the next LINK_COMPRESS_BACKOFF
+ * messages are sent as is, the back-off doubles (up to
+ * LINK_COMPRESS_BACKOFF_MAX) with every further failed attempt. Every
+ * LINK_COMPRESS_PROBE-th message is sent as is to time uncompressed sends. */
+#ifndef LINK_COMPRESS_MISSES
+  #define LINK_COMPRESS_MISSES 4
+#endif
+#ifndef LINK_COMPRESS_BACKOFF
+  #define LINK_COMPRESS_BACKOFF 16
+#endif
+#ifndef LINK_COMPRESS_BACKOFF_MAX
+  #define LINK_COMPRESS_BACKOFF_MAX 1024
+#endif
+#ifndef LINK_COMPRESS_PROBE
+  #define LINK_COMPRESS_PROBE 64
+#endif
+
+/* Delta messages (delta flag) carry the ranges of a frame which changed since
+ * the previous one: the frame size, the number of ranges, the ranges and their
+ * bytes. Up to LINK_DELTA_GAP equal bytes between two ranges are sent along,
+ * frames changing in more than LINK_DELTA_RANGES ranges or in more than half
+ * of their bytes are sent whole. The ranges are sent and received with a
+ * single vector each, i.e. LINK_DELTA_RANGES stays below IOV_MAX (1024). */
+#ifndef LINK_DELTA_GAP
+  #define LINK_DELTA_GAP 16
+#endif
+#ifndef LINK_DELTA_RANGES
+  #define LINK_DELTA_RANGES 1000
+#endif
+
+typedef struct {
+  uint32_t  frameSize;                /** size of the patched frame */
+  uint32_t  count;                    /** ranges following the header */
+} icomLinkDelta_t;
+
+/* state of the local shared memory region on the link (zero copy) */
+typedef enum {
+  LINK_SHM_NONE=0,   /** not offered to the peer yet */
+  LINK_SHM_SHARED,   /** mapped by the peer, offsets can be sent */
+  LINK_SHM_FAILED,   /** peer failed to map it, buffers are copied */
+} icomLinkShmState_t;
+
+/* link control messages (ICOM_FLAG_CONTROL in the header) */
+typedef enum {
+  LINK_CTRL_SHM=1,   /** shared memory region offer, answered by an int (1 - mapped) */
+  LINK_CTRL_RELEASE, /** leased buffer returned by the receiver */
+} icomLinkCtrlOp_t;
+
+typedef struct {
+  uint32_t  op;                       /** icomLinkCtrlOp_t */
+  uint32_t  reserved;
+  uint64_t  size;                     /** region size */
+  uint64_t  offset;                   /** released buffer's offset */
+  uint64_t  cookie;                   /** region cookie */
+  char      name[ICOM_SHM_NAME_MAX];  /** region name */
+} icomLinkCtrl_t;
+
+/* Sender connected to a server link, its per-connection state is swapped
+ * into the link's private data while its messages are being received */
+typedef struct {
+  int                fd;
+  uint32_t           id;          /** peer id, unique within the link */
+  icomLinkShmState_t shmState;
+  int                leasePending;
+  uint64_t           leaseOffset;
+  void              *shmPeer;
+  uint64_t           shmPeerSize;
+  int                partial;     /** a partial header arrived (edge triggered until complete) */
+} icomLinkPeer_t;
 
 typedef struct {
   int                fd;
@@ -15,6 +112,53 @@ typedef struct {
   char              *ip;
   uint16_t           port;
   struct sockaddr_in sockaddr;
+  icomFlags_t        flags;       /** configured flags (link->flags follow received headers) */
+  uint32_t           recvAlloc;   /** bytes allocated for the receive buffer */
+  icomLinkShmState_t shmState;    /** local region's state on this link */
+  int                sendZero;    /** message being sent is a region offset */
+  int                sendLease;   /** message being sent is a leased buffer */
+  uint32_t           sendId;      /** correlation id of the message being sent (req/rep) */
+  uint32_t           sendChannel; /** logical channel of the message being sent (channels option) */
+  int                sendCompress;/** message being sent is compressed */
+  void              *compBuf;     /** compressed messages (sent, or received ones) */
+  uint32_t           compAlloc;   /** bytes allocated for them */
+  uint32_t           compMin;     /** smallest message compressed (compress flag) */
+  int                compAdaptive;/** compression is suspended while it does not pay off */
+  unsigned           compMisses;  /** messages in a row compression did not pay off for */
+  unsigned           compSkip;    /** messages left to send as is */
+  unsigned           compBackoff; /** messages sent as is after the next misses */
+  unsigned           compProbe;   /** messages compressed since the last one sent as is */
+  uint64_t           plainPs;     /** send time of uncompressed messages (ps per byte, average) */
+  uint64_t           packedPs;    /** send time of compressed messages, compression included */
+  int                sendDelta;   /** message being sent is a delta of the previous one */
+  unsigned           deltaCount;  /** its ranges */
+  icomDeltaRange_t  *deltaRanges; /** ranges of the delta message being sent or received */
+  void              *deltaBuf;    /** previous frame sent (delta flag), i.e. the peer's copy */
+  uint32_t           deltaAlloc;  /** bytes allocated for it */
+  uint32_t           deltaSize;   /** its size, '0' - the peer's copy is unknown */
+  uint32_t           recvFrame;   /** size of the frame in the receive buffer, '0' - none */
+  int                leasePending;/** last received leased buffer awaits automatic release */
+  uint64_t           leaseOffset; /** offset of that buffer */
+  void              *shmPeer;     /** mapping of the peer's region */
+  uint64_t           shmPeerSize; /** size of the peer's region */
+  int                pipe[2];     /** forwarding pipe (splice), -1 until needed */
+  int                pipeTee[2];  /** duplicates of the forwarded chunks (fan-out) */
+  unsigned           pipeSize;    /** capacity of the forwarding pipes */
+  uint64_t           spinNs;      /** receive spin budget, '0' - spin flag not set */
+  int                node;        /** NUMA node of the receive buffer, -1 - any */
+  int                memFlags;    /** allocation policy of the receive buffer */
+  int                quickack;    /** renew TCP_QUICKACK after every header */
+  uint64_t           timeoutUs;   /** receive/send timeout, '0' - none */
+  int                server;      /** accepts any number of senders (server option) */
+  int                epfd;        /** epoll instance of the listening socket and the peers */
+  icomLinkPeer_t   **peers;       /** connected peers */
+  unsigned           peerCount;
+  unsigned           peerAlloc;
+  icomLinkPeer_t    *peer;        /** peer being served, its state lives in this structure */
+  uint32_t           peerNext;    /** id of the next accepted peer */
+  struct epoll_event events[LINK_SERVER_EVENTS]; /** events of the last epoll_wait */
+  int                eventCount;
+  int                eventIndex;  /** next event to serve */
 } icomLinkSocket_t;
 
 
@@ -22,4 +166,11 @@ icomStatus_t icom_initSocketConnect(icomLink_t *link, icomType_t type, const cha
 icomStatus_t icom_initSocketBind(icomLink_t *link, icomType_t type, const char *comString, icomFlags_t flags);
 void icom_deinitSocket(icomLink_t* connection);
 
+/** @brief Sends the message in chunks, one per link (stripe option). */
+icomStatus_t icom_sendSocketStripe(icomLink_t *links, unsigned count, void *buf, unsigned bufSize);
+
+/** @brief Receives the chunks of a striped message on all the links into the
+ *         first link's buffer. */
+icomStatus_t icom_recvSocketStripe(icomLink_t *links, unsigned count, void **buf, unsigned *bufSize);
+
 #endif
@@ -0,0 +1,79 @@
+#ifndef _LINK_UDP_H_
+#define _LINK_UDP_H_
+
+#include "icom.h"
+#include "icom_type.h"
+#include "icom_status.h"
+
+#include <stdint.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+
+/* largest datagram sent by datagram links (header included), fits the
+ * common 1500 byte MTU without IP fragmentation */
+#ifndef LINK_UDP_DATAGRAM
+  #define LINK_UDP_DATAGRAM 1472
+#endif
+
+/* datagrams sent by a single sendmmsg (no segmentation offload) */
+#ifndef LINK_UDP_BATCH
+  #define LINK_UDP_BATCH 64
+#endif
+
+/* datagrams sent by a single sendmsg with segmentation offload (UDP_SEGMENT),
+ * the kernel limits them to 64 and their total size to 64 kB */
+#ifndef LINK_UDP_GSO_SEGMENTS
+  #define LINK_UDP_GSO_SEGMENTS 64
+#endif
+
+/* buffers received by a single recvmmsg, each one holds a datagram or a
+ * train of coalesced datagrams (UDP_GRO) of up to 64 kB */
+#ifndef LINK_UDP_RECV_BATCH
+  #define LINK_UDP_RECV_BATCH 8
+#endif
+#define LINK_UDP_RECV_SIZE (64*1024)
+
+/* header of every datagram, i.e. a fragment of a message */
+typedef struct {
+  uint32_t  sender;   /** random id of the sending link, a new id restarts the sequence */
+  uint32_t  seq;      /** message sequence number, starts at '1' */
+  uint32_t  bufSize;  /** message size */
+  uint32_t  offset;   /** offset of the fragment's payload within the message */
+} icomUdpHeader_t;
+
+#define LINK_UDP_PAYLOAD (LINK_UDP_DATAGRAM - sizeof(icomUdpHeader_t))
+
+/* fragments of a single segmentation offload send (64 kB of UDP payload) */
+#define LINK_UDP_GSO_MAX ((65507/LINK_UDP_DATAGRAM < LINK_UDP_GSO_SEGMENTS) \
+                          ? 65507/LINK_UDP_DATAGRAM : LINK_UDP_GSO_SEGMENTS)
+
+typedef struct {
+  int             fd;
+  int             node;        /** NUMA node of the receive buffer, -1 - any */
+  int             memFlags;    /** allocation policy of the receive buffer */
+  uint32_t        recvAlloc;   /** bytes allocated for the receive buffer */
+  int             gso;         /** segmentation offload (UDP_SEGMENT) is used */
+  int             gro;         /** receive offload (UDP_GRO) is enabled */
+  uint32_t        sender;      /** id of the sender (the followed one for receivers) */
+  uint32_t        seq;         /** last message sent, or the message being reassembled */
+  uint32_t        seqNext;     /** message expected next, valid once synced */
+  int             synced;      /** a message of the sender was received */
+  int             active;      /** a message is being reassembled */
+  uint32_t        received;    /** payload bytes of the message reassembled so far */
+  uint8_t        *batch;       /** buffers of the receive batch (receivers) */
+  struct mmsghdr *msgs;        /** LINK_UDP_RECV_BATCH messages of recvmmsg */
+  struct iovec    iov[LINK_UDP_RECV_BATCH];
+  uint8_t         control[LINK_UDP_RECV_BATCH][CMSG_SPACE(sizeof(int))];
+  unsigned        batchCount;  /** buffers filled by the last recvmmsg */
+  unsigned        batchIndex;  /** buffer being processed */
+  unsigned        batchOffset; /** next datagram within the buffer */
+} icomLinkUdp_t;
+
+
+icomStatus_t icom_initUdpTx(icomLink_t *link, icomType_t type, const char *comString, icomFlags_t flags);
+icomStatus_t icom_initUdpRx(icomLink_t *link, icomType_t type, const char *comString, icomFlags_t flags);
+icomStatus_t icom_initMcastTx(icomLink_t *link, icomType_t type, const char *comString, icomFlags_t flags);
+icomStatus_t icom_initMcastRx(icomLink_t *link, icomType_t type, const char *comString, icomFlags_t flags);
+void icom_deinitUdp(icomLink_t* link);
+
+#endif
@@ -5,8 +5,52 @@
 #include "icom_type.h"
 #include "icom_status.h"
 
+#include <stdint.h>
+
+/* readiness events collected by a single epoll_wait of publishers */
+#ifndef LINK_ZMQ_EVENTS
+  #define LINK_ZMQ_EVENTS 64
+#endif
+
+/* longest subscribed topic prefix */
+#ifndef LINK_ZMQ_TOPIC_MAX
+  #define LINK_ZMQ_TOPIC_MAX 255
+#endif
+
+typedef struct icomZmqSub icomZmqSub_t;
+
+/* node of the publisher's prefix trie, i.e. the prefix spelled by the path
+ * from the root, which holds the empty prefix */
+typedef struct icomZmqTopic {
+  uint8_t               key;      /** last byte of the prefix */
+  struct icomZmqTopic  *child;    /** first longer prefix */
+  struct icomZmqTopic  *next;     /** next prefix of the same length and parent */
+  icomZmqSub_t        **subs;     /** subscribers of the prefix */
+  unsigned              subCount;
+  unsigned              subAlloc;
+} icomZmqTopic_t;
+
+/* subscriber connected to a publisher */
+struct icomZmqSub {
+  int               fd;
+  uint32_t          id;          /** subscriber id, unique within the link */
+  uint32_t          mark;        /** last message sent to the subscriber */
+  int               failed;      /** sending failed, the subscriber is dropped */
+  icomZmqTopic_t  **topics;      /** subscribed prefixes */
+  unsigned          topicCount;
+  unsigned          topicAlloc;
+};
+
 typedef struct {
-  int  fd;
+  int               fd;          /** listening socket (publishers) */
+  int               epfd;        /** epoll instance of the listening socket and the subscribers */
+  icomZmqSub_t    **subs;        /** connected subscribers */
+  unsigned          subCount;
+  unsigned          subAlloc;
+  uint32_t          subNext;     /** id of the next accepted subscriber */
+  uint32_t          mark;        /** current message, subscribers matching several
+                                     prefixes get it once */
+  icomZmqTopic_t    topics;      /** root of the prefix trie */
 } icomLinkZmq_t;
 
 
@@ -17,6 +61,23 @@ icomStatus_t icom_initZmqSub (icomLink_t *link, icomType_t type, const char *com
 icomStatus_t icom_initZmqReq (icomLink_t *link, icomType_t type, const char *comString, icomFlags_t flags);
 icomStatus_t icom_initZmqRep (icomLink_t *link, icomType_t type, const char *comString, icomFlags_t flags);
 
+/** @brief Sends the message on a single link of the push object, selected
+ *         by the balance option, links refusing the connection are skipped.
+ *
+ *  @return Returns the status of the last attempted link */
+icomStatus_t icom_sendZmqPush(icom_t *icom, void *buf, unsigned bufSize);
+
+/** @brief Sends a request on a single link of the req object (see
+ *         icom_sendZmqPush) tagged with the next correlation id. */
+icomStatus_t icom_sendZmqReq(icom_t *icom, void *buf, unsigned bufSize);
+
+/** @brief Sends a reply to the last request received by the rep object,
+ *         tagged with the request's correlation id. */
+icomStatus_t icom_sendZmqRep(icom_t *icom, void *buf, unsigned bufSize);
+
+/** @brief Receives the next reply on any link of the req object. */
+icomStatus_t icom_recvZmqReq(icom_t *icom, void **buf, unsigned *bufSize);
+
 void icom_deinitZmqPush(icomLink_t* link);
 void icom_deinitZmqPull(icomLink_t* link);
 void icom_deinitZmqPub (icomLink_t* link);
@@ -10,10 +10,16 @@
 #include "icom_macro.h"
 
 #include "config.h"
+#include "icom_shm.h"
+#include "icom_config.h"
+#include "icom_mem.h"
+#include "icom_options.h"
 #include "notification.h"
 #include "string_parser.h"
 
 #include "link_zmq.h"
+#include "link_mux.h"
+#include "link_udp.h"
 #include "link_fifo.h"
 #include "link_socket.h"
 
@@ -22,24 +28,34 @@ icomStatus_t (*icomInitHandlers[])(icomLink_t*, icomType_t, const char*, icomFla
   icom_initSocketConnect,
   icom_initSocketBind,
   icom_initFifo,
+  icom_initFifo,
   icom_initZmqPush,
   icom_initZmqPull,
   icom_initZmqPub,
   icom_initZmqSub,
   icom_initZmqReq,
   icom_initZmqRep,
+  icom_initMcastTx,
+  icom_initMcastRx,
+  icom_initUdpTx,
+  icom_initUdpRx,
 };
 
 void (*icomDeinitHandlers[])(icomLink_t*) = {
   icom_deinitSocket,
   icom_deinitSocket,
   icom_deinitFifo,
+  icom_deinitFifo,
   icom_deinitZmqPush,
   icom_deinitZmqPull,
   icom_deinitZmqPub,
   icom_deinitZmqSub,
   icom_deinitZmqReq,
   icom_deinitZmqRep,
+  icom_deinitUdp,
+  icom_deinitUdp,
+  icom_deinitUdp,
+  icom_deinitUdp,
 };
 
 
@@ -92,6 +108,10 @@ icomStatus_t icom_initGeneric(icomLink_t *connection, icomType_t type, const cha
 }
 
 void icom_deinitGeneric(icomLink_t* connection){
+  if(connection->options && connection->options->channels){
+    icom_deinitMux(connection);
+    return;
+  }
   icomDeinitHandlers[connection->type](connection);
 }
 
@@ -113,7 +133,10 @@ icom_t* icom_init(const char *comString){
 
   /* parse fields in the communication string */
   r = parser_initFields(&fieldArray, &fieldCount, comString, ICOM_DELIMITER);
-  if(r != 0){
+  if(r != 0 || (fieldCount != 3 && fieldCount != 4)){
+    if(r == 0){
+      parser_deinitFields(fieldArray, fieldCount);
+    }
     _E("Failed to parse communication string");
     ret = (icom_t*)ICOM_EINVAL;
     goto failure_initFields;
@@ -139,13 +162,112 @@ icom_t* icom_init(const char *comString){
     goto failure_getFlags;
   }
 
+  /* leases replace notifications (both use the reverse direction) */
+  if((comFlags & ICOM_FLAG_LEASE) && (comFlags & (ICOM_FLAG_NOTIFY | ICOM_FLAG_AUTONOTIFY))){
+    _E("The lease flag cannot be combined with notify/autonotify");
+    ret = (icom_t*)ICOM_EINVAL;
+    goto failure_getFlags;
+  }
+  icom->type        = comType;
+  icom->flags       = comFlags;
+  icom->forward     = NULL;
+  icom->forwardCopy = 0;
+
+  /* get communication options (optional 3rd field) */
+  if(fieldCount == 4){
+    status = icom_parseOptions(&icom->options, fieldArray[2]);
+    if(status != ICOM_SUCCESS){
+      _E("Invalid configuration");
+      ret = (icom_t*)status;
+      goto failure_getOptions;
+    }
+  } else {
+    icom_initOptions(&icom->options);
+  }
+
+  /* pullers (repliers) fair-queue any number of pushers (requesters) */
+  if(comType == ICOM_TYPE_ZMQ_PULL || comType == ICOM_TYPE_ZMQ_REP){
+    icom->options.server = 1;
+  }
+
   /* parse communication strings */
-  r = parser_initStrArray(&icom->comStrings, &icom->comCount, fieldArray[2]);
+  r = parser_initStrArray(&icom->comStrings, &icom->comCount, fieldArray[fieldCount-1]);
   if(r != 0){
     _E("Failed to parse communication string");
     ret = (icom_t*)ICOM_EINVAL;
     goto failure_initStrArray;
   }
+  if((comType == ICOM_TYPE_ZMQ_PULL || comType == ICOM_TYPE_ZMQ_REP) && icom->comCount != 1){
+    _E("Pull/rep objects bind a single address, pushers/requesters connect to it");
+    ret = (icom_t*)ICOM_EINVAL;
+    goto failure_countPull;
+  }
+
+  /* messages are compressed by the socket links' send path */
+  if((comFlags & ICOM_FLAG_COMPRESS)
+  && comType != ICOM_TYPE_SOCKET_TX && comType != ICOM_TYPE_SOCKET_RX
+  && comType != ICOM_TYPE_ZMQ_PUSH  && comType != ICOM_TYPE_ZMQ_PULL
+  && comType != ICOM_TYPE_ZMQ_REQ   && comType != ICOM_TYPE_ZMQ_REP){
+    _E("The compress flag is supported by socket and zmq push/pull/req/rep objects only");
+    ret = (icom_t*)ICOM_EINVAL;
+    goto failure_countPull;
+  }
+
+  /* receivers patch their copy of the previous frame, it must be the only
+   * one of the link (no shared regions, peers or channels) */
+  if((comFlags & ICOM_FLAG_DELTA)
+  && ((comType != ICOM_TYPE_SOCKET_TX && comType != ICOM_TYPE_SOCKET_RX)
+   || (comFlags & (ICOM_FLAG_ZERO | ICOM_FLAG_LEASE))
+   || icom->options.channels || icom->options.server || icom->options.stripe)){
+    _E("The delta flag is supported by copying socket objects only (no zero or lease flags, nor the channels, server and stripe options)");
+    ret = (icom_t*)ICOM_EINVAL;
+    goto failure_countPull;
+  }
+
+  /* striped messages are reassembled from all the links into one buffer */
+  if(icom->options.stripe){
+    if(comType != ICOM_TYPE_SOCKET_TX && comType != ICOM_TYPE_SOCKET_RX){
+      _E("Striping is supported by socket_tx/socket_rx objects only");
+      ret = (icom_t*)ICOM_EINVAL;
+      goto failure_countPull;
+    }
+    if((comFlags & (ICOM_FLAG_ZERO | ICOM_FLAG_NOTIFY | ICOM_FLAG_AUTONOTIFY | ICOM_FLAG_LEASE | ICOM_FLAG_COMPRESS))
+    || icom->options.channels || icom->options.server || icom->options.reuseport){
+      _E("Striping supports the default, timeout and spin flags only (no channels, server or reuseport)");
+      ret = (icom_t*)ICOM_EINVAL;
+      goto failure_countPull;
+    }
+  }
+
+  /* channels are links of the single address (sharing its connection) */
+  if(icom->options.channels){
+    char **strings;
+
+    if(icom->comCount != 1){
+      _E("Channels are multiplexed over the connection of a single address");
+      ret = (icom_t*)ICOM_EINVAL;
+      goto failure_countPull;
+    }
+    strings = (char**)realloc(icom->comStrings, icom->options.channels*sizeof(char*));
+    if(!strings){
+      _E("Failed to allocate memory");
+      ret = (icom_t*)ICOM_ENOMEM;
+      goto failure_countPull;
+    }
+    icom->comStrings = strings;
+    for(; icom->comCount<icom->options.channels; icom->comCount++){
+      icom->comStrings[icom->comCount] = strdup(icom->comStrings[0]);
+      if(!icom->comStrings[icom->comCount]){
+        _E("Failed to allocate memory");
+        ret = (icom_t*)ICOM_ENOMEM;
+        goto failure_countPull;
+      }
+    }
+  }
+  icom->sendLast  = icom->comCount - 1;
+  icom->recvLast  = icom->comCount - 1;
+  icom->msgId     = 0;
+  icom->msgIdNext = 1;
 
   /* allocate memory for connection struct array */
   icom->comConnections = (icomLink_t*)malloc(icom->comCount*sizeof(icomLink_t));
@@ -155,9 +277,43 @@ icom_t* icom_init(const char *comString){
     goto failure_malloc_connections;
   }
 
+  /* zero-copy socket links share a single region with all their peers, links
+   * fall back to copying if it is not available */
+  icom->shm = NULL;
+  if((comFlags & ICOM_FLAG_ZERO)
+  && (comType == ICOM_TYPE_SOCKET_TX || comType == ICOM_TYPE_SOCKET_RX
+   || comType == ICOM_TYPE_ZMQ_PUSH  || comType == ICOM_TYPE_ZMQ_PULL)){
+    uint64_t shmSize;
+    icom_getDefaultConfig(SHM_REGION_SIZE, &shmSize);
+    icom->shm = icom_shmInit(shmSize);
+    if(!icom->shm){
+      _W("Shared memory region not available, zero-copy links will copy");
+    } else if(icom->options.node >= 0){
+      icom_memBind(icom->shm->base, icom->shm->size, icom->options.node);
+    }
+  }
+
   /* initialize selected icom communication */
   for(i=0; i<icom->comCount; i++){
-    status = icom_initGeneric(&(icom->comConnections[i]), comType, icom->comStrings[i], comFlags);
+    icom->comConnections[i].shm            = icom->shm;
+    icom->comConnections[i].options        = &icom->options;
+    icom->comConnections[i].releaseHandler = NULL;
+    icom->comConnections[i].reclaimHandler = NULL;
+    icom->comConnections[i].forwardHandler = NULL;
+    memset(&icom->comConnections[i].spinStats, 0, sizeof(icomSpinStats_t));
+    memset(&icom->comConnections[i].lossStats, 0, sizeof(icomLossStats_t));
+    memset(&icom->comConnections[i].compressStats, 0, sizeof(icomCompressStats_t));
+    memset(&icom->comConnections[i].deltaStats, 0, sizeof(icomDeltaStats_t));
+    icom->comConnections[i].recvPeer       = 0;
+    icom->comConnections[i].recvId         = 0;
+    icom->comConnections[i].recvChannel    = 0;
+    if(icom->options.channels && i > 0){
+      status = icom_initMuxChannel(icom->comConnections+i, icom->comConnections, i);
+    } else if(icom->options.channels){
+      status = icom_initMux(icom->comConnections, icom->comCount, comType, icom->comStrings[i], comFlags);
+    } else {
+      status = icom_initGeneric(&(icom->comConnections[i]), comType, icom->comStrings[i], comFlags);
+    }
     if( status != ICOM_SUCCESS ){
       _E("Failed to initialize connection: %s", icom->comStrings[i]);
       ret = (icom_t*)status;
@@ -175,10 +331,15 @@ failure_initGeneric:
   for(--i; i>=0; i--){
     icom_deinitGeneric(&(icom->comConnections[i]));
   }
+  if(icom->shm){
+    icom_shmDeinit(icom->shm);
+  }
   free(icom->comConnections);
 failure_malloc_connections:
+failure_countPull:
   parser_deinitStrArray(icom->comStrings, icom->comCount);
 failure_initStrArray:
+failure_getOptions:
 failure_getFlags:
 failure_getType:
   parser_deinitFields(fieldArray, fieldCount);
@@ -199,6 +360,11 @@ void icom_deinit(icom_t* icom){
   /* deallocate connection array */
   free(icom->comConnections);
 
+  /* remove shared memory region (peers keep their mappings) */
+  if(icom->shm){
+    icom_shmDeinit(icom->shm);
+  }
+
   /* deallocate communication strings */
   parser_deinitStrArray(icom->comStrings, icom->comCount);
 
@@ -210,8 +376,24 @@ void icom_deinit(icom_t* icom){
 icomStatus_t icom_send(icom_t *icom, void  *buf, unsigned bufSize){
   icomStatus_t status[icom->comCount];
 
-  for(int i=0; i<icom->comCount; i++){
-    status[i] = icom->comConnections[i].sendHandler(icom->comConnections+i, buf, bufSize);
+  /* push objects send every message on a single link */
+  if(icom->type == ICOM_TYPE_ZMQ_PUSH){
+    status[0] = icom_sendZmqPush(icom, buf, bufSize);
+  } else if(icom->type == ICOM_TYPE_ZMQ_REQ){
+    status[0] = icom_sendZmqReq(icom, buf, bufSize);
+  } else if(icom->type == ICOM_TYPE_ZMQ_REP){
+    status[0] = icom_sendZmqRep(icom, buf, bufSize);
+  } else if(icom->options.stripe){
+    status[0] = icom_sendSocketStripe(icom->comConnections, icom->comCount, buf, bufSize);
+  } else {
+    for(int i=0; i<icom->comCount; i++){
+      status[i] = icom->comConnections[i].sendHandler(icom->comConnections+i, buf, bufSize);
+    }
+  }
+
+  /* links hold their own references of a leased buffer, drop the owner's */
+  if(icom->shm && icom_shmIsLeased(icom->shm, buf)){
+    icom_shmUnref(icom->shm, buf);
   }
 
   /* TODO: analyze return values */
@@ -238,22 +420,58 @@ inline icomStatus_t icom_recv2(icom_t *icom, void **buf){
 
 icomStatus_t icom_recv3(icom_t *icom, void **buf, unsigned *bufSize){
   icomStatus_t status[icom->comCount];
+  void *dummyBuf;
+  unsigned dummySize;
 
-  /* Perform all the data receptions in reverse order. The order is reveresed
-   * so that the first buffer in the recvBuf list is returned and, therefore,
-   * the icom_nextBuffer routine indeed would return the next buffer. */
-  for(int i=icom->comCount-1; i>=0; i--){
+  /* replies arrive on any of the requester's links */
+  if(icom->type == ICOM_TYPE_ZMQ_REQ){
+    return icom_recvZmqReq(icom, buf, bufSize);
+  }
+
+  /* chunks of a striped message make up a single buffer */
+  if(icom->options.stripe){
+    icom->msgId = 0;
+    return icom_recvSocketStripe(icom->comConnections, icom->comCount, buf, bufSize);
+  }
+
+  /* Perform all the data receptions in the same order as icom_send sends
+   * them, otherwise messages exceeding socket buffers deadlock the sender on
+   * the first link while we wait on the last one. Only the first link's
+   * buffer is returned, so that the icom_nextBuffer routine indeed would
+   * return the next buffer. */
+  for(int i=0; i<icom->comCount; i++){
     status[i] = icom->comConnections[i].recvHandler(
       icom->comConnections+i,
-      buf,
-      bufSize);
+      (i == 0) ? buf     : &dummyBuf,
+      (i == 0) ? bufSize : &dummySize);
   }
+  icom->msgId = icom->comConnections[0].recvId;
 
   /* TODO: analyze return values */
 
   return status[0];
 }
 
+icomStatus_t icom_sendLink(icom_t *icom, unsigned link, void *buf, unsigned bufSize){
+  if(link >= icom->comCount){
+    _E("Invalid link index (%u)", link);
+    return ICOM_EINVAL;
+  }
+  return icom->comConnections[link].sendHandler(icom->comConnections+link, buf, bufSize);
+}
+
+icomStatus_t icom_recvLink(icom_t *icom, unsigned link, void **buf, unsigned *bufSize){
+  icomStatus_t status;
+
+  if(link >= icom->comCount){
+    _E("Invalid link index (%u)", link);
+    return ICOM_EINVAL;
+  }
+  status = icom->comConnections[link].recvHandler(icom->comConnections+link, buf, bufSize);
+  icom->msgId = icom->comConnections[link].recvId;
+  return status;
+}
+
 icomStatus_t icom_notify_send(icom_t *icom){
   icomStatus_t status[icom->comCount];
 
@@ -272,6 +490,14 @@ icomStatus_t icom_notify_send(icom_t *icom){
 icomStatus_t icom_notify_recv(icom_t *icom){
   icomStatus_t status[icom->comCount];
 
+  /* only the link of the last message owes a notification */
+  if(icom->type == ICOM_TYPE_ZMQ_PUSH){
+    return icom->comConnections[icom->sendLast].notifyRecvHandler(
+      icom->comConnections + icom->sendLast,
+      (void **)NULL,
+      (unsigned *)NULL);
+  }
+
   for(int i=icom->comCount-1; i>=0; i--){
     status[i] = icom->comConnections[i].notifyRecvHandler(
       icom->comConnections+i,
@@ -299,6 +525,11 @@ void* icom_nextBuffer(icom_t *icom, void **buf, unsigned *bufSize){
     return *buf;
   }
 
+  /* a striped message is a single buffer */
+  if(icom->options.stripe){
+    return NULL;
+  }
+
   /* Get ready for some sad (and probably dumb) pointer magic, but at the moment
    * I could not think of anything better :( Imporantly, for zero-copy use case,
    * we cannot determine the buffer's link. Firstly, note that normal buffers
@@ -337,3 +568,215 @@ void* icom_nextBuffer(icom_t *icom, void **buf, unsigned *bufSize){
 
   return NULL;
 }
+
+void* icom_alloc(icom_t *icom, unsigned size){
+  if(!icom->shm){
+    return NULL;
+  }
+  return icom_shmAlloc(icom->shm, size);
+}
+
+void icom_free(icom_t *icom, void *buf){
+  if(icom->shm){
+    icom_shmFree(icom->shm, buf);
+  }
+}
+
+icomStatus_t icom_getSpinStats(icom_t *icom, icomSpinStats_t *stats){
+  memset(stats, 0, sizeof(*stats));
+
+  for(int i=0; i<icom->comCount; i++){
+    icomSpinStats_t *link = &icom->comConnections[i].spinStats;
+    stats->spins     += link->spins;
+    stats->hits      += link->hits;
+    stats->fallbacks += link->fallbacks;
+    stats->wakeups   += link->wakeups;
+  }
+
+  return ICOM_SUCCESS;
+}
+
+icomStatus_t icom_getLossStats(icom_t *icom, icomLossStats_t *stats){
+  memset(stats, 0, sizeof(*stats));
+
+  for(int i=0; i<icom->comCount; i++){
+    icomLossStats_t *link = &icom->comConnections[i].lossStats;
+    stats->messages += link->messages;
+    stats->lost     += link->lost;
+    stats->gaps     += link->gaps;
+  }
+
+  return ICOM_SUCCESS;
+}
+
+icomStatus_t icom_getCompressStats(icom_t *icom, icomCompressStats_t *stats){
+  memset(stats, 0, sizeof(*stats));
+
+  for(int i=0; i<icom->comCount; i++){
+    icomCompressStats_t *link = &icom->comConnections[i].compressStats;
+    stats->messages   += link->messages;
+    stats->compressed += link->compressed;
+    stats->bytesIn    += link->bytesIn;
+    stats->bytesOut   += link->bytesOut;
+    stats->skipped    += link->skipped;
+  }
+
+  return ICOM_SUCCESS;
+}
+
+icomStatus_t icom_getDeltaStats(icom_t *icom, icomDeltaStats_t *stats){
+  memset(stats, 0, sizeof(*stats));
+
+  for(int i=0; i<icom->comCount; i++){
+    icomDeltaStats_t *link = &icom->comConnections[i].deltaStats;
+    stats->frames   += link->frames;
+    stats->deltas   += link->deltas;
+    stats->bytesIn  += link->bytesIn;
+    stats->bytesOut += link->bytesOut;
+  }
+
+  return ICOM_SUCCESS;
+}
+
+uint32_t icom_getPeer(icom_t *icom){
+  return icom->comConnections[0].recvPeer;
+}
+
+uint32_t icom_getId(icom_t *icom){
+  return icom->msgId;
+}
+
+/* processes leases returned on all the links, returns '-1' if no link works */
+static int icom_reclaim(icom_t *icom, int timeoutMs){
+  int working = 0;
+
+  for(int i=0; i<icom->comCount; i++){
+    icomLink_t *link = icom->comConnections+i;
+    if(link->reclaimHandler && link->reclaimHandler(link, timeoutMs) == ICOM_SUCCESS){
+      working++;
+    }
+  }
+
+  return working ? 0 : -1;
+}
+
+void* icom_lease(icom_t *icom, unsigned size){
+  void *buf;
+
+  if(!icom->shm){
+    return NULL;
+  }
+
+  while(1){
+    /* collect returned buffers without blocking */
+    icom_reclaim(icom, 0);
+
+    buf = icom_shmLease(icom->shm, size);
+    if(buf || icom->shm->leases == 0){
+      return buf;
+    }
+
+    /* region exhausted, wait for the receivers to release something */
+    if(icom_reclaim(icom, 1) != 0){
+      _E("No link to collect leased buffers from");
+      return NULL;
+    }
+  }
+}
+
+icomStatus_t icom_release(icom_t *icom, void *buf){
+  icomStatus_t status;
+
+  for(int i=0; i<icom->comCount; i++){
+    icomLink_t *link = icom->comConnections+i;
+    if(!link->releaseHandler){
+      continue;
+    }
+
+    /* only the link which received the buffer recognizes it */
+    status = link->releaseHandler(link, buf);
+    if(status != ICOM_ELOOKUP){
+      return status;
+    }
+  }
+
+  return ICOM_SUCCESS;
+}
+
+/* forwards a single message of the input link through user space */
+static icomStatus_t icom_forwardCopy(icomLink_t *link, icom_t *out){
+  icomStatus_t status;
+  void *buf;
+  unsigned bufSize;
+
+  status = link->recvHandler(link, &buf, &bufSize);
+  if(status != ICOM_SUCCESS){
+    return status;
+  }
+  return icom_send(out, buf, bufSize);
+}
+
+icomStatus_t icom_do(icom_t *icom){
+  icom_t *out = icom->forward;
+  icomStatus_t status, ret = ICOM_SUCCESS;
+  void *buf;
+  unsigned bufSize;
+  int direct;
+
+  if(!out){
+    _E("No forwarding destination, see icom_forward");
+    return ICOM_EINVAL;
+  }
+
+  /* striped messages are reassembled from all the input links */
+  if(icom->options.stripe){
+    status = icom_recv3(icom, &buf, &bufSize);
+    if(status != ICOM_SUCCESS){
+      return status;
+    }
+    return icom_send(out, buf, bufSize);
+  }
+
+  /* Input links are served in order (as icom_recv does), the link handler
+   * refuses before receiving anything if it cannot reach the output links.
+   * Payloads are spliced to every output link, i.e. only to objects which
+   * broadcast whole messages (push, req and rep objects pick a single link,
+   * striped ones split the message) */
+  direct = !icom->forwardCopy && !out->options.stripe
+        && out->type != ICOM_TYPE_ZMQ_PUSH && out->type != ICOM_TYPE_ZMQ_REQ
+        && out->type != ICOM_TYPE_ZMQ_REP;
+  for(int i=0; i<icom->comCount; i++){
+    icomLink_t *link = icom->comConnections+i;
+
+    status = ICOM_ENOTSUP;
+    if(direct && link->forwardHandler){
+      status = link->forwardHandler(link, out->comConnections, out->comCount);
+    }
+    if(status == ICOM_ENOTSUP){
+      status = icom_forwardCopy(link, out);
+    }
+
+    if(status != ICOM_SUCCESS && ret == ICOM_SUCCESS){
+      ret = status;
+    }
+  }
+
+  return ret;
+}
+
+icomStatus_t icom_forward(icom_t *in, icom_t *out, const icomForwardOptions_t *options){
+  uint64_t count = options ? options->count : 0;
+  icomStatus_t status;
+
+  in->forward     = out;
+  in->forwardCopy = options ? options->copy : 0;
+
+  for(uint64_t i=0; (count == 0) || (i < count); i++){
+    status = icom_do(in);
+    if(status != ICOM_SUCCESS){
+      return status;
+    }
+  }
+
+  return ICOM_SUCCESS;
+}
@@ -6,6 +6,10 @@
 /* list of default values available for configuration */
 static uint64_t timeout_rcv_usec = 1000000; // 1 second
 static uint64_t timeout_snd_usec = 1000000; // 1 second
+static uint64_t shm_region_size  = 64*1024*1024; // 64 MB (pages are allocated on touch)
+static uint64_t pipeline_queue_depth = 16;
+static uint64_t pipeline_slot_size   = 1024*1024; // 1 MB (pages are allocated on touch)
+static uint64_t spin_budget_usec     = 50;
 
 
 /* configuration setter procedures */
@@ -32,6 +36,10 @@ struct config_t {
 static struct config_t config[] = {
   {&timeout_rcv_usec, set_uint64_t, get_uint64_t},
   {&timeout_snd_usec, set_uint64_t, get_uint64_t},
+  {&shm_region_size,  set_uint64_t, get_uint64_t},
+  {&pipeline_queue_depth, set_uint64_t, get_uint64_t},
+  {&pipeline_slot_size,   set_uint64_t, get_uint64_t},
+  {&spin_budget_usec,     set_uint64_t, get_uint64_t},
 };
 
 
@@ -0,0 +1,96 @@
+#include <string.h>
+#include <stdint.h>
+#ifdef __SSE2__
+  #include <emmintrin.h>
+#endif
+
+#include "icom_delta.h"
+
+
+#define DELTA_BLOCK  16
+#define DELTA_STRIDE 64   /* bytes of equal data skipped at once */
+
+/* tells whether DELTA_STRIDE bytes are equal */
+static inline int delta_equal(const uint8_t *a, const uint8_t *b){
+#ifdef __SSE2__
+  const __m128i *p = (const __m128i*)a, *q = (const __m128i*)b;
+  __m128i x = _mm_xor_si128(_mm_loadu_si128(p),   _mm_loadu_si128(q));
+  __m128i y = _mm_xor_si128(_mm_loadu_si128(p+1), _mm_loadu_si128(q+1));
+  __m128i z = _mm_xor_si128(_mm_loadu_si128(p+2), _mm_loadu_si128(q+2));
+  __m128i w = _mm_xor_si128(_mm_loadu_si128(p+3), _mm_loadu_si128(q+3));
+  x = _mm_or_si128(_mm_or_si128(x, y), _mm_or_si128(z, w));
+  return _mm_movemask_epi8(_mm_cmpeq_epi8(x, _mm_setzero_si128())) == 0xffff;
+#else
+  uint64_t x[DELTA_STRIDE/sizeof(uint64_t)], y[DELTA_STRIDE/sizeof(uint64_t)], d = 0;
+  memcpy(x, a, sizeof(x));
+  memcpy(y, b, sizeof(y));
+  for(unsigned i=0; i<DELTA_STRIDE/sizeof(uint64_t); i++){
+    d |= x[i] ^ y[i];
+  }
+  return d == 0;
+#endif
+}
+
+/* bit mask of the differing bytes of a block (of up to DELTA_BLOCK bytes) */
+static inline uint32_t delta_diff(const uint8_t *a, const uint8_t *b, uint32_t size){
+  uint32_t mask = 0;
+
+  if(size == DELTA_BLOCK){
+#ifdef __SSE2__
+    __m128i x = _mm_loadu_si128((const __m128i*)a);
+    __m128i y = _mm_loadu_si128((const __m128i*)b);
+    return ~_mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) & 0xffff;
+#else
+    uint64_t x[2], y[2];
+    memcpy(x, a, sizeof(x));
+    memcpy(y, b, sizeof(y));
+    if(x[0] == y[0] && x[1] == y[1]){
+      return 0;
+    }
+#endif
+  }
+
+  for(uint32_t i=0; i<size; i++){
+    mask |= (uint32_t)(a[i] != b[i]) << i;
+  }
+  return mask;
+}
+
+int icom_deltaScan(const void *prev, const void *next, uint32_t size, uint32_t gap,
+icomDeltaRange_t *ranges, unsigned maxRanges){
+  const uint8_t *a = prev, *b = next;
+  uint32_t pos, n, mask, shift, run, start;
+  unsigned count = 0;
+
+  for(pos=0; pos<size; pos+=n){
+    while(size-pos >= DELTA_STRIDE && delta_equal(a+pos, b+pos)){
+      pos += DELTA_STRIDE;
+    }
+    if(pos >= size){
+      break;
+    }
+    n    = (size-pos < DELTA_BLOCK) ? size-pos : DELTA_BLOCK;
+    mask = delta_diff(a+pos, b+pos, n);
+
+    /* runs of differing bytes, continued by the ones of the next block */
+    while(mask){
+      shift = __builtin_ctz(mask);
+      run   = __builtin_ctz(~(mask >> shift));
+      mask &= ~(((1u << run) - 1) << shift);
+      start = pos + shift;
+
+      if(count && start - (ranges[count-1].offset + ranges[count-1].length) <= gap){
+        ranges[count-1].length = start + run - ranges[count-1].offset;
+        continue;
+      }
+      if(count == maxRanges){
+        return -1;
+      }
+      ranges[count].offset = start;
+      ranges[count].length = run;
+      count++;
+    }
+  }
+
+  return count;
+}
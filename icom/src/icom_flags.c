@@ -9,6 +9,10 @@ static const char* icomFlagStrings[] = {
   "timeout",    // ICOM_FLAG_TIMEOUT
   "notify",     // ICOM_FLAG_NOTIFY
   "autonotify", // ICOM_FLAG_AUTONOTIFY
+  "lease",      // ICOM_FLAG_LEASE
+  "spin",       // ICOM_FLAG_SPIN
+  "compress",   // ICOM_FLAG_COMPRESS
+  "delta",      // ICOM_FLAG_DELTA
 //  "prot,zero", // ICOM_FLAG_ZERO | ICOM_FLAG_PROT TODO: create solution for combining flags
 };
 
@@ -0,0 +1,246 @@
+#include <string.h>
+#include <stdint.h>
+
+#include "icom_lz.h"
+
+
+/* LZ4 block format: sequences of a token (literal length, match length - 4),
+ * the literals, a 16-bit little endian offset and length extensions (255
+ * continues). The last sequence has literals only, matches end 5 bytes
+ * before the end and start 12 bytes before it at the latest. */
+#define LZ_MIN_MATCH     4
+#define LZ_LAST_LITERALS 5
+#define LZ_MF_LIMIT      12
+#define LZ_MAX_OFFSET    65535
+#define LZ_SKIP_TRIGGER  6     /* misses before the search starts skipping */
+
+static inline uint32_t lz_read32(const uint8_t *p){
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline uint32_t lz_hash(uint32_t v){
+  return (v * 2654435761u) >> (32 - ICOM_LZ_HASH_LOG);
+}
+
+/* common prefix of the two positions, bounded by limit */
+static inline uint32_t lz_count(const uint8_t *a, const uint8_t *b, const uint8_t *limit){
+  const uint8_t *start = a;
+
+  while(a + sizeof(uint64_t) <= limit){
+    uint64_t x, y;
+    memcpy(&x, a, sizeof(x));
+    memcpy(&y, b, sizeof(y));
+    if(x != y){
+      return (uint32_t)(a - start) + (__builtin_ctzll(x ^ y) >> 3);
+    }
+    a += sizeof(uint64_t);
+    b += sizeof(uint64_t);
+  }
+  while(a < limit && *a == *b){
+    a++;
+    b++;
+  }
+  return (uint32_t)(a - start);
+}
+
+/* writes the length extension of a token nibble */
+static inline uint8_t* lz_writeLength(uint8_t *op, uint32_t length){
+  for(; length >= 255; length -= 255){
+    *op++ = 255;
+  }
+  *op++ = (uint8_t)length;
+  return op;
+}
+
+uint32_t icom_lzCompress(const void *src, uint32_t srcSize, void *dst, uint32_t dstCapacity){
+  uint32_t table[1 << ICOM_LZ_HASH_LOG];
+  const uint8_t *base   = (const uint8_t*)src;
+  const uint8_t *ip     = base;
+  const uint8_t *anchor = base;
+  const uint8_t *end    = base + srcSize;
+  const uint8_t *mflimit, *matchlimit;
+  uint8_t *op   = (uint8_t*)dst;
+  uint8_t *oend = op + dstCapacity;
+  uint32_t literals;
+
+  if(srcSize < LZ_MF_LIMIT + 1){
+    goto lastLiterals;
+  }
+  mflimit    = end - LZ_MF_LIMIT;
+  matchlimit = end - LZ_LAST_LITERALS;
+  memset(table, 0, sizeof(table));
+
+  /* the first position only seeds the table */
+  table[lz_hash(lz_read32(ip))] = 0;
+  ip++;
+
+  while(ip < mflimit){
+    const uint8_t *ref;
+    uint32_t misses = 1 << LZ_SKIP_TRIGGER;
+    uint32_t matchLength;
+    uint8_t *token;
+
+    /* find a match, incompressible regions are skipped faster and faster */
+    while(1){
+      uint32_t h = lz_hash(lz_read32(ip));
+      ref = base + table[h];
+      table[h] = (uint32_t)(ip - base);
+      if(ip - ref <= LZ_MAX_OFFSET && ref < ip && lz_read32(ref) == lz_read32(ip)){
+        break;
+      }
+      ip += misses++ >> LZ_SKIP_TRIGGER;
+      if(ip >= mflimit){
+        goto lastLiterals;
+      }
+    }
+
+    /* extend the match backwards over the pending literals */
+    while(ip > anchor && ref > base && ip[-1] == ref[-1]){
+      ip--;
+      ref--;
+    }
+    literals    = (uint32_t)(ip - anchor);
+    matchLength = LZ_MIN_MATCH + lz_count(ip + LZ_MIN_MATCH, ref + LZ_MIN_MATCH, matchlimit);
+
+    /* token, literals, offset and match length (worst case) */
+    if(op + 1 + literals/255 + 1 + literals + 2 + (matchLength-LZ_MIN_MATCH)/255 + 1 > oend){
+      return 0;
+    }
+    token = op++;
+    if(literals >= 15){
+      *token = 15 << 4;
+      op = lz_writeLength(op, literals - 15);
+    } else {
+      *token = (uint8_t)(literals << 4);
+    }
+    memcpy(op, anchor, literals);
+    op += literals;
+
+    *op++ = (uint8_t)(ip - ref);
+    *op++ = (uint8_t)((ip - ref) >> 8);
+    if(matchLength - LZ_MIN_MATCH >= 15){
+      *token |= 15;
+      op = lz_writeLength(op, matchLength - LZ_MIN_MATCH - 15);
+    } else {
+      *token |= (uint8_t)(matchLength - LZ_MIN_MATCH);
+    }
+
+    ip    += matchLength;
+    anchor = ip;
+
+    /* positions within the match are not searched, seed the one before */
+    if(ip < mflimit){
+      table[lz_hash(lz_read32(ip - 2))] = (uint32_t)(ip - 2 - base);
+    }
+  }
+
+lastLiterals:
+  literals = (uint32_t)(end - anchor);
+  if(op + 1 + literals/255 + 1 + literals > oend){
+    return 0;
+  }
+  if(literals >= 15){
+    *op++ = 15 << 4;
+    op = lz_writeLength(op, literals - 15);
+  } else {
+    *op++ = (uint8_t)(literals << 4);
+  }
+  /* empty input may come without a buffer */
+  if(literals){
+    memcpy(op, anchor, literals);
+    op += literals;
+  }
+
+  return (uint32_t)(op - (uint8_t*)dst);
+}
+
+/* reads the length extension of a token nibble, '-1' on truncated input */
+static inline int64_t lz_readLength(const uint8_t **ip, const uint8_t *iend){
+  int64_t length = 0;
+  uint8_t b;
+
+  do {
+    if(*ip >= iend){
+      return -1;
+    }
+    b = *(*ip)++;
+    length += b;
+  } while(b == 255);
+  return length;
+}
+
+int64_t icom_lzDecompress(const void *src, uint32_t srcSize, void *dst, uint32_t dstCapacity){
+  const uint8_t *ip   = (const uint8_t*)src;
+  const uint8_t *iend = ip + srcSize;
+  uint8_t *op   = (uint8_t*)dst;
+  uint8_t *oend = op + dstCapacity;
+
+  while(ip < iend){
+    uint8_t token = *ip++;
+    int64_t literals = token >> 4, matchLength = token & 15, ext;
+    uint32_t offset;
+    const uint8_t *ref;
+
+    if(literals == 15){
+      ext = lz_readLength(&ip, iend);
+      if(ext < 0) return -1;
+      literals += ext;
+    }
+    if(literals > iend - ip || literals > oend - op){
+      return -1;
+    }
+
+    /* short literals are copied by a single (wider) copy if there is room */
+    if(literals <= 16 && iend - ip >= 16 && oend - op >= 16){
+      memcpy(op, ip, 16);
+    } else if(literals){
+      memcpy(op, ip, literals);
+    }
+    ip += literals;
+    op += literals;
+
+    /* the last sequence has no match */
+    if(ip == iend){
+      break;
+    }
+
+    if(iend - ip < 2){
+      return -1;
+    }
+    offset = ip[0] | (ip[1] << 8);
+    ip += 2;
+    if(offset == 0 || offset > op - (uint8_t*)dst){
+      return -1;
+    }
+    if(matchLength == 15){
+      ext = lz_readLength(&ip, iend);
+      if(ext < 0) return -1;
+      matchLength += ext;
+    }
+    matchLength += LZ_MIN_MATCH;
+    if(matchLength > oend - op){
+      return -1;
+    }
+
+    /* 8 byte copies may overlap the match if the offset is 8 at least, they
+     * repeat the last offset bytes otherwise (overlapping matches) */
+    ref = op - offset;
+    if(offset >= 8 && oend - op >= matchLength + 8){
+      uint8_t *mend = op + matchLength;
+      do {
+        memcpy(op, ref, 8);
+        op  += 8;
+        ref += 8;
+      } while(op < mend);
+      op = mend;
+    } else {
+      while(matchLength--){
+        *op++ = *ref++;
+      }
+    }
+  }
+
+  return op - (uint8_t*)dst;
+}
@@ -0,0 +1,206 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+
+#include "icom.h"
+#include "icom_mem.h"
+#include "notification.h"
+
+/* largest node mbind accepts in the mask below */
+#define MEM_NODE_MAX  (8*sizeof(unsigned long)-1)
+
+/* (default) huge page size, transparent huge pages need aligned regions */
+#define MEM_HUGE_SIZE (2ul*1024*1024)
+
+
+static inline size_t mem_pages(size_t size){
+  size_t page = sysconf(_SC_PAGESIZE);
+  return (size + page - 1) & ~(page - 1);
+}
+
+/* mapping size, huge page backed mappings are rounded to whole huge pages */
+static inline size_t mem_size(size_t size, int flags){
+  if(flags & (ICOM_MEM_THP | ICOM_MEM_HUGETLB)){
+    return (size + MEM_HUGE_SIZE - 1) & ~(MEM_HUGE_SIZE - 1);
+  }
+  return mem_pages(size);
+}
+
+/* maps anonymous memory aligned to the huge page size */
+static void* mem_mapAligned(size_t size){
+  uint8_t *mem, *aligned;
+  size_t head;
+
+  mem = mmap(NULL, size + MEM_HUGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if(mem == MAP_FAILED){
+    return MAP_FAILED;
+  }
+
+  /* trim the unaligned head and the remaining tail */
+  aligned = (uint8_t*)(((uintptr_t)mem + MEM_HUGE_SIZE - 1) & ~(MEM_HUGE_SIZE - 1));
+  head    = aligned - mem;
+  if(head){
+    munmap(mem, head);
+  }
+  munmap(aligned + size, MEM_HUGE_SIZE - head);
+  return aligned;
+}
+
+static void* mem_map(size_t size, int flags){
+  void *mem;
+
+  /* reserved huge pages (vm.nr_hugepages) may run out, transparent huge
+   * pages are used instead */
+  if(flags & ICOM_MEM_HUGETLB){
+    mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if(mem != MAP_FAILED){
+      return mem;
+    }
+    _SW("Failed to map huge pages, falling back to transparent huge pages");
+    flags |= ICOM_MEM_THP;
+  }
+
+  if(flags & ICOM_MEM_THP){
+    mem = mem_mapAligned(size);
+    if(mem != MAP_FAILED && madvise(mem, size, MADV_HUGEPAGE) == -1){
+      _SW("Failed to enable transparent huge pages");
+    }
+    return mem;
+  }
+
+  return mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+}
+
+int icom_memBind(void *mem, size_t size, int node){
+  unsigned long mask;
+
+  if(node < 0 || node > MEM_NODE_MAX){
+    _E("Invalid NUMA node (%d)", node);
+    return -1;
+  }
+
+  /* the node is preferred, so an exhausted node does not kill the process */
+  mask = 1ul << node;
+  if(syscall(SYS_mbind, mem, mem_pages(size), MPOL_PREFERRED, &mask, MEM_NODE_MAX+1, 0) == -1){
+    _SW("Failed to bind memory to NUMA node %d", node);
+    return -1;
+  }
+  return 0;
+}
+
+void icom_memTouch(void *mem, size_t size){
+  size_t page = sysconf(_SC_PAGESIZE);
+  volatile uint8_t *p = (volatile uint8_t*)mem;
+
+  /* writing faults the pages in, reading would map the shared zero page */
+  for(size_t i=0; i<size; i+=page){
+    p[i] = p[i];
+  }
+}
+
+void* icom_memAlloc(size_t size, int node, int flags){
+  size_t mapSize = mem_size(size, flags);
+  void *mem;
+
+  if(node < 0 && !flags){
+    return malloc(size);
+  }
+
+  mem = mem_map(mapSize, flags);
+  if(mem == MAP_FAILED){
+    _SE("Failed to map memory");
+    return NULL;
+  }
+
+  /* pages are allocated on touch, i.e. after the policy is set */
+  if(node >= 0){
+    icom_memBind(mem, mapSize, node);
+  }
+
+  /* locking faults in the whole mapping as well, a failure (RLIMIT_MEMLOCK)
+   * leaves the memory usable */
+  if(flags & ICOM_MEM_LOCK && mlock(mem, mapSize) == -1){
+    _SW("Failed to lock memory (%lu bytes)", mapSize);
+  }
+  if(flags & ICOM_MEM_PRETOUCH){
+    icom_memTouch(mem, mapSize);
+  }
+  return mem;
+}
+
+void* icom_memRealloc(void *mem, size_t oldSize, size_t size, int node, int flags){
+  void *ret;
+
+  if(node < 0 && !flags){
+    return realloc(mem, size);
+  }
+  if(mem && mem_size(size, flags) == mem_size(oldSize, flags)){
+    return mem;
+  }
+
+  ret = icom_memAlloc(size, node, flags);
+  if(ret && mem){
+    memcpy(ret, mem, (oldSize < size) ? oldSize : size);
+    icom_memFree(mem, oldSize, node, flags);
+  }
+  return ret;
+}
+
+void icom_memFree(void *mem, size_t size, int node, int flags){
+  if(!mem){
+    return;
+  }
+  if(node < 0 && !flags){
+    free(mem);
+  } else {
+    munmap(mem, mem_size(size, flags));
+  }
+}
+
+icomStatus_t icom_memGrowRecv(icomLink_t *link, uint32_t *recvAlloc, uint32_t size,
+int node, int flags){
+  uint32_t alloc = (size > sizeof(void*)) ? size : sizeof(void*);
+  void *mem;
+
+  if(alloc <= *recvAlloc){
+    return ICOM_SUCCESS;
+  }
+  mem = icom_memRealloc((uint8_t*)link->recvBuf-sizeof(link), sizeof(link) + *recvAlloc,
+                        sizeof(link) + alloc, node, flags);
+  if(!mem){
+    _E("Failed to allocate memory");
+    return ICOM_ENOMEM;
+  }
+  link->recvBuf = (uint8_t*)mem + sizeof(link);
+  *recvAlloc    = alloc;
+  return ICOM_SUCCESS;
+}
+
+int icom_memCpuNode(int cpu){
+  char path[64];
+  struct dirent *entry;
+  DIR *dir;
+  int node = -1;
+
+  /* the core's sysfs directory holds a link to its node */
+  snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+  dir = opendir(path);
+  if(!dir){
+    return -1;
+  }
+  while((entry = readdir(dir))){
+    if(sscanf(entry->d_name, "node%d", &node) == 1){
+      break;
+    }
+    node = -1;
+  }
+  closedir(dir);
+  return node;
+}
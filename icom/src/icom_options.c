@@ -0,0 +1,358 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <sched.h>
+#include <arpa/inet.h>
+
+#include "icom.h"
+#include "icom_mem.h"
+#include "icom_options.h"
+#include "notification.h"
+#include "string_parser.h"
+
+
+/* option value parsers */
+static icomStatus_t parse_cpu(icomOptions_t *options, const char *value){
+  char *end;
+  long cpu;
+
+  if(!value){
+    return ICOM_EINVAL;
+  }
+  cpu = strtol(value, &end, 10);
+  if(*value == '\0' || *end != '\0' || cpu < 0 || cpu >= CPU_SETSIZE){
+    return ICOM_EINVAL;
+  }
+  options->cpu = (int)cpu;
+  return ICOM_SUCCESS;
+}
+
+/* non-negative size with an optional k/M/G (binary) suffix, within int */
+static icomStatus_t parse_size(const char *value, int *size){
+  char *end;
+  long long ret;
+
+  if(!value){
+    return ICOM_EINVAL;
+  }
+  ret = strtoll(value, &end, 10);
+  if(*value == '\0' || ret < 0){
+    return ICOM_EINVAL;
+  }
+  switch(*end){
+    case 'k': case 'K': ret <<= 10; end++; break;
+    case 'm': case 'M': ret <<= 20; end++; break;
+    case 'g': case 'G': ret <<= 30; end++; break;
+  }
+  if(*end != '\0' || ret > INT32_MAX){
+    return ICOM_EINVAL;
+  }
+  *size = (int)ret;
+  return ICOM_SUCCESS;
+}
+
+/* a missing value enables the option */
+static icomStatus_t parse_bool(const char *value, int *flag){
+  if(!value || strcmp(value, "1") == 0){
+    *flag = 1;
+  } else if(strcmp(value, "0") == 0){
+    *flag = 0;
+  } else {
+    return ICOM_EINVAL;
+  }
+  return ICOM_SUCCESS;
+}
+
+static icomStatus_t parse_sndbuf(icomOptions_t *options, const char *value){
+  return parse_size(value, &options->sndbuf);
+}
+
+static icomStatus_t parse_rcvbuf(icomOptions_t *options, const char *value){
+  return parse_size(value, &options->rcvbuf);
+}
+
+static icomStatus_t parse_notsentLowat(icomOptions_t *options, const char *value){
+  return parse_size(value, &options->notsentLowat);
+}
+
+static icomStatus_t parse_quickack(icomOptions_t *options, const char *value){
+  return parse_bool(value, &options->quickack);
+}
+
+static icomStatus_t parse_nodelay(icomOptions_t *options, const char *value){
+  return parse_bool(value, &options->nodelay);
+}
+
+/* a missing value selects transparent huge pages */
+static icomStatus_t parse_hugepages(icomOptions_t *options, const char *value){
+  options->memFlags &= ~(ICOM_MEM_THP | ICOM_MEM_HUGETLB);
+  if(!value || strcmp(value, "thp") == 0 || strcmp(value, "1") == 0){
+    options->memFlags |= ICOM_MEM_THP;
+  } else if(strcmp(value, "hugetlb") == 0){
+    options->memFlags |= ICOM_MEM_HUGETLB;
+  } else if(strcmp(value, "0") != 0){
+    return ICOM_EINVAL;
+  }
+  return ICOM_SUCCESS;
+}
+
+static icomStatus_t parse_memFlag(icomOptions_t *options, const char *value, int flag){
+  int enable;
+
+  if(parse_bool(value, &enable) != ICOM_SUCCESS){
+    return ICOM_EINVAL;
+  }
+  options->memFlags = enable ? (options->memFlags | flag) : (options->memFlags & ~flag);
+  return ICOM_SUCCESS;
+}
+
+static icomStatus_t parse_mlock(icomOptions_t *options, const char *value){
+  return parse_memFlag(options, value, ICOM_MEM_LOCK);
+}
+
+static icomStatus_t parse_pretouch(icomOptions_t *options, const char *value){
+  return parse_memFlag(options, value, ICOM_MEM_PRETOUCH);
+}
+
+static icomStatus_t parse_server(icomOptions_t *options, const char *value){
+  return parse_bool(value, &options->server);
+}
+
+/* "cpu" steers connections by the receiving core */
+static icomStatus_t parse_reuseport(icomOptions_t *options, const char *value){
+  if(value && strcmp(value, "cpu") == 0){
+    options->reuseport = 2;
+    return ICOM_SUCCESS;
+  }
+  return parse_bool(value, &options->reuseport);
+}
+
+/* "outq" prefers the link with the fewest bytes waiting in its send queue */
+static icomStatus_t parse_balance(icomOptions_t *options, const char *value){
+  if(!value){
+    return ICOM_EINVAL;
+  }
+  if(strcmp(value, "rr") == 0){
+    options->balance = 0;
+  } else if(strcmp(value, "outq") == 0){
+    options->balance = 1;
+  } else {
+    return ICOM_EINVAL;
+  }
+  return ICOM_SUCCESS;
+}
+
+/* appends a subscribed prefix, an empty one matches every message */
+static icomStatus_t parse_topic(icomOptions_t *options, const char *value){
+  size_t used = 0, size;
+
+  if(!value){
+    return ICOM_EINVAL;
+  }
+  for(unsigned i=0; i<options->topicCount; i++){
+    used += strlen(options->topics + used) + 1;
+  }
+  size = strlen(value) + 1;
+  if(used + size > sizeof(options->topics)){
+    _E("Too many topics (%lu bytes at most)", sizeof(options->topics));
+    return ICOM_EINVAL;
+  }
+  memcpy(options->topics + used, value, size);
+  options->topicCount++;
+  return ICOM_SUCCESS;
+}
+
+/* IPv4 address of a local interface, "*" lets the routing table select it */
+static icomStatus_t parse_iface(icomOptions_t *options, const char *value){
+  struct in_addr addr;
+
+  if(!value){
+    return ICOM_EINVAL;
+  }
+  if(strcmp(value, "*") == 0){
+    options->iface = htonl(INADDR_ANY);
+    return ICOM_SUCCESS;
+  }
+  if(inet_aton(value, &addr) == 0){
+    return ICOM_EINVAL;
+  }
+  options->iface = addr.s_addr;
+  return ICOM_SUCCESS;
+}
+
+static icomStatus_t parse_ttl(icomOptions_t *options, const char *value){
+  char *end;
+  long ttl;
+
+  if(!value){
+    return ICOM_EINVAL;
+  }
+  ttl = strtol(value, &end, 10);
+  if(*value == '\0' || *end != '\0' || ttl < 0 || ttl > 255){
+    return ICOM_EINVAL;
+  }
+  options->ttl = (int)ttl;
+  return ICOM_SUCCESS;
+}
+
+static icomStatus_t parse_channels(icomOptions_t *options, const char *value){
+  char *end;
+  long channels;
+
+  if(!value){
+    return ICOM_EINVAL;
+  }
+  channels = strtol(value, &end, 10);
+  if(*value == '\0' || *end != '\0' || channels < 1 || channels > UINT16_MAX){
+    return ICOM_EINVAL;
+  }
+  options->channels = (unsigned)channels;
+  return ICOM_SUCCESS;
+}
+
+static icomStatus_t parse_stripe(icomOptions_t *options, const char *value){
+  return parse_bool(value, &options->stripe);
+}
+
+static icomStatus_t parse_compressMin(icomOptions_t *options, const char *value){
+  return parse_size(value, &options->compressMin);
+}
+
+static icomStatus_t parse_compressAdaptive(icomOptions_t *options, const char *value){
+  return parse_bool(value, &options->compressAdaptive);
+}
+
+static icomStatus_t parse_timeoutUs(icomOptions_t *options, const char *value){
+  char *end;
+  long long timeout;
+
+  if(!value){
+    return ICOM_EINVAL;
+  }
+
+  /* '0' would disable the timeout (SO_RCVTIMEO semantics) */
+  timeout = strtoll(value, &end, 10);
+  if(*value == '\0' || *end != '\0' || timeout <= 0){
+    return ICOM_EINVAL;
+  }
+  options->timeoutUs = timeout;
+  return ICOM_SUCCESS;
+}
+
+static icomStatus_t parse_node(icomOptions_t *options, const char *value){
+  char *end;
+  long node;
+
+  if(!value){
+    return ICOM_EINVAL;
+  }
+  node = strtol(value, &end, 10);
+  if(*value == '\0' || *end != '\0' || node < 0 || node >= 64){
+    return ICOM_EINVAL;
+  }
+  options->node = (int)node;
+  return ICOM_SUCCESS;
+}
+
+
+/* static object for managing option parsers */
+struct option_t {
+  const char *name;
+  icomStatus_t (*parser)(icomOptions_t *options, const char *value);
+};
+
+static struct option_t optionTable[] = {
+  {"cpu",           parse_cpu},
+  {"node",          parse_node},
+  {"sndbuf",        parse_sndbuf},
+  {"rcvbuf",        parse_rcvbuf},
+  {"notsent_lowat", parse_notsentLowat},
+  {"quickack",      parse_quickack},
+  {"nodelay",       parse_nodelay},
+  {"timeout_us",    parse_timeoutUs},
+  {"hugepages",     parse_hugepages},
+  {"mlock",         parse_mlock},
+  {"pretouch",      parse_pretouch},
+  {"server",        parse_server},
+  {"reuseport",     parse_reuseport},
+  {"balance",       parse_balance},
+  {"topic",         parse_topic},
+  {"iface",         parse_iface},
+  {"ttl",           parse_ttl},
+  {"channels",      parse_channels},
+  {"stripe",        parse_stripe},
+  {"compress_min",  parse_compressMin},
+  {"compress_adaptive", parse_compressAdaptive},
+};
+
+
+void icom_initOptions(icomOptions_t *options){
+  options->cpu          = -1;
+  options->node         = -1;
+  options->sndbuf       = -1;
+  options->rcvbuf       = -1;
+  options->notsentLowat = -1;
+  options->quickack     = 0;
+  options->nodelay      = 1;
+  options->timeoutUs    = -1;
+  options->memFlags     = 0;
+  options->server       = 0;
+  options->reuseport    = 0;
+  options->balance      = 0;
+  options->topicCount   = 0;
+  options->iface        = htonl(INADDR_ANY);
+  options->ttl          = -1;
+  options->channels     = 0;
+  options->stripe       = 0;
+  options->compressMin  = -1;
+  options->compressAdaptive = 0;
+}
+
+icomStatus_t icom_parseOptions(icomOptions_t *options, const char *optionString){
+  char **optionStrings;
+  uint32_t optionCount;
+  icomStatus_t status = ICOM_SUCCESS;
+  char *value;
+  int i, j;
+
+  icom_initOptions(options);
+  if(strcmp(optionString, "default") == 0){
+    return ICOM_SUCCESS;
+  }
+
+  if(parser_initFields(&optionStrings, &optionCount, optionString, ',') != 0){
+    _E("Failed to parse option string");
+    return ICOM_EINVAL;
+  }
+
+  for(i=0; i<optionCount && status == ICOM_SUCCESS; i++){
+    /* boolean options may omit the value */
+    value = strchr(optionStrings[i], '=');
+    if(value){
+      *value++ = '\0';
+    }
+
+    for(j=0; j<sizeof(optionTable)/sizeof(*optionTable); j++){
+      if(strcmp(optionStrings[i], optionTable[j].name) == 0){
+        status = optionTable[j].parser(options, value);
+        if(status != ICOM_SUCCESS){
+          _E("Invalid value of the \"%s\" option: \"%s\"", optionStrings[i], value ? value : "");
+        }
+        break;
+      }
+    }
+    if(j == sizeof(optionTable)/sizeof(*optionTable)){
+      _E("Unknown option: \"%s\"", optionStrings[i]);
+      status = ICOM_EINVAL;
+    }
+  }
+
+  parser_deinitFields(optionStrings, optionCount);
+
+  /* buffers follow the threads unless placed explicitly */
+  if(status == ICOM_SUCCESS && options->node < 0 && options->cpu >= 0){
+    options->node = icom_memCpuNode(options->cpu);
+  }
+  return status;
+}
@@ -0,0 +1,520 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+
+#include "icom.h"
+#include "icom_config.h"
+#include "icom_mem.h"
+#include "icom_pipeline.h"
+#include "icom_shm.h"
+#include "notification.h"
+
+/* waiting on a queue spins first, then yields and eventually sleeps */
+#define PIPELINE_SPINS   (128)
+#define PIPELINE_YIELDS  (1024)
+#define PIPELINE_SLEEP_NS (50000)
+
+/* Single producer/single consumer queue, the slots hold the messages. Both
+ * indexes grow monotonically, each is written by one side only. */
+typedef struct {
+  uint64_t   head __attribute__((aligned(64)));  /** next slot to consume */
+  uint64_t   tail __attribute__((aligned(64)));  /** next slot to produce */
+  uint64_t   depthMax __attribute__((aligned(64))); /** maximum observed depth */
+  int        closed;    /** the consumer ended */
+  unsigned   depth;     /** number of slots (power of two) */
+  unsigned   slotSize;  /** capacity of a slot */
+  int        node;      /** NUMA node of the slots, -1 - any */
+  int        memFlags;  /** allocation policy of the slots */
+  unsigned  *sizes;     /** message sizes */
+  uint8_t   *ends;      /** end of stream markers */
+  uint8_t   *data;      /** depth*slotSize bytes */
+} pipelineQueue_t;
+
+typedef struct {
+  icomPipeline_t   *pipeline;
+  char             *name;
+  icomStageFunc_t   func;
+  void             *ctx;
+  int               cpu;
+  icom_t           *in;        /** input endpoint, or NULL */
+  icom_t           *out;       /** output endpoint, or NULL */
+  pipelineQueue_t  *inQueue;   /** queue from the previous stage, or NULL */
+  pipelineQueue_t  *outQueue;  /** queue to the next stage, or NULL */
+  void             *outBuf;    /** output buffer for the output endpoint */
+  unsigned          outBufSize;
+  int               outBufShm;  /** the buffer lies in the endpoint's shared region */
+  int               outLease;   /** a buffer is leased for every message instead */
+  int               outBufNode; /** NUMA node of the buffer otherwise */
+  int               memFlags;   /** allocation policy of the endpoints */
+  pthread_t         thread;
+  uint64_t          messages;
+  uint64_t          busyNs;
+  uint64_t          startNs;
+  uint64_t          endNs;
+  int               running;
+  icomStatus_t      status;
+} pipelineStage_t;
+
+struct icomPipeline {
+  unsigned          stageCount;
+  pipelineStage_t  *stages;
+  int               started;
+  int               stop;
+};
+
+
+static inline uint64_t pipeline_now(void){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec*1000000000ull + ts.tv_nsec;
+}
+
+/* backs off the n-th wait iteration, returns non-zero if the pipeline stops */
+static int pipeline_wait(icomPipeline_t *pipeline, unsigned n){
+  if(n >= PIPELINE_SPINS + PIPELINE_YIELDS){
+    struct timespec ts = {0, PIPELINE_SLEEP_NS};
+    nanosleep(&ts, NULL);
+  } else if(n >= PIPELINE_SPINS){
+    sched_yield();
+  }
+  return __atomic_load_n(&pipeline->stop, __ATOMIC_RELAXED);
+}
+
+static pipelineQueue_t* pipeline_queueInit(unsigned depth, unsigned slotSize, int node, int memFlags){
+  pipelineQueue_t *queue;
+
+  queue = (pipelineQueue_t*)aligned_alloc(64, (sizeof(pipelineQueue_t) + 63) & ~63ul);
+  if(!queue){
+    return NULL;
+  }
+  memset(queue, 0, sizeof(*queue));
+  queue->depth    = depth;
+  queue->slotSize = slotSize;
+  queue->node     = node;
+  queue->memFlags = memFlags;
+  queue->sizes    = (unsigned*)calloc(depth, sizeof(unsigned));
+  queue->ends     = (uint8_t*)calloc(depth, sizeof(uint8_t));
+  queue->data     = (uint8_t*)icom_memAlloc((uint64_t)depth*slotSize, node, memFlags);
+  if(!queue->sizes || !queue->ends || !queue->data){
+    free(queue->sizes);
+    free(queue->ends);
+    icom_memFree(queue->data, (uint64_t)depth*slotSize, node, memFlags);
+    free(queue);
+    return NULL;
+  }
+  return queue;
+}
+
+static void pipeline_queueDeinit(pipelineQueue_t *queue){
+  if(queue){
+    free(queue->sizes);
+    free(queue->ends);
+    icom_memFree(queue->data, (uint64_t)queue->depth*queue->slotSize, queue->node, queue->memFlags);
+    free(queue);
+  }
+}
+
+/* waits for a free slot, returns its buffer or NULL if the pipeline stops
+ * or the consumer ended */
+static uint8_t* pipeline_queueReserve(pipelineStage_t *stage, pipelineQueue_t *queue){
+  uint64_t tail = queue->tail;
+
+  for(unsigned n=0; tail - __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE) >= queue->depth; n++){
+    if(pipeline_wait(stage->pipeline, n) || __atomic_load_n(&queue->closed, __ATOMIC_RELAXED)){
+      return NULL;
+    }
+  }
+  return queue->data + (tail & (queue->depth-1))*(uint64_t)queue->slotSize;
+}
+
+static void pipeline_queueCommit(pipelineQueue_t *queue, unsigned size, int end){
+  uint64_t tail = queue->tail;
+  uint64_t depth;
+
+  queue->sizes[tail & (queue->depth-1)] = size;
+  queue->ends[tail & (queue->depth-1)]  = end;
+  __atomic_store_n(&queue->tail, tail+1, __ATOMIC_RELEASE);
+
+  depth = tail + 1 - __atomic_load_n(&queue->head, __ATOMIC_RELAXED);
+  if(depth > queue->depthMax){
+    __atomic_store_n(&queue->depthMax, depth, __ATOMIC_RELAXED);
+  }
+}
+
+/* waits for a message, returns its buffer or NULL if the pipeline stops */
+static uint8_t* pipeline_queuePeek(pipelineStage_t *stage, pipelineQueue_t *queue, unsigned *size, int *end){
+  uint64_t head = queue->head;
+
+  for(unsigned n=0; __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE) == head; n++){
+    if(pipeline_wait(stage->pipeline, n)){
+      return NULL;
+    }
+  }
+  *size = queue->sizes[head & (queue->depth-1)];
+  *end  = queue->ends[head & (queue->depth-1)];
+  return queue->data + (head & (queue->depth-1))*(uint64_t)queue->slotSize;
+}
+
+static void pipeline_queueRelease(pipelineQueue_t *queue){
+  __atomic_store_n(&queue->head, queue->head+1, __ATOMIC_RELEASE);
+}
+
+/* processes a single input message (NULL for sources), returns ICOM_SUCCESS
+ * to continue */
+static icomStatus_t pipeline_process(pipelineStage_t *stage, const void *in, unsigned inSize){
+  icomStatus_t status;
+  uint8_t *out = NULL;
+  unsigned outSize = 0;
+  uint64_t start;
+
+  /* the callback writes directly to the next stage's queue */
+  if(stage->outQueue){
+    out = pipeline_queueReserve(stage, stage->outQueue);
+    if(!out){
+      return stage->outQueue->closed ? ICOM_EPIPE : ICOM_EINTR;
+    }
+    outSize = stage->outQueue->slotSize;
+  } else if(stage->outLease){
+    out = icom_lease(stage->out, stage->outBufSize);
+    if(!out){
+      _E("Failed to lease a buffer");
+      return ICOM_ENOMEM;
+    }
+    outSize = stage->outBufSize;
+  } else if(stage->out){
+    out     = stage->outBuf;
+    outSize = stage->outBufSize;
+  }
+
+  start = pipeline_now();
+  if(stage->func){
+    status = stage->func(stage->ctx, in, inSize, out, &outSize);
+  } else if(inSize > outSize){
+    _E("Message exceeds the output buffer (%u / %u bytes)", inSize, outSize);
+    status = ICOM_EMSGSIZE;
+  } else {
+    if(out) memcpy(out, in, inSize);
+    outSize = inSize;
+    status  = ICOM_SUCCESS;
+  }
+
+  /* sources end with their last call, which is not a message */
+  if(status == ICOM_SUCCESS || status == ICOM_EAGAIN){
+    __atomic_store_n(&stage->messages, stage->messages + 1, __ATOMIC_RELAXED);
+  }
+
+  if(status == ICOM_SUCCESS){
+    if(stage->outQueue){
+      pipeline_queueCommit(stage->outQueue, outSize, 0);
+    } else if(stage->out){
+      status = icom_send(stage->out, out, outSize);
+    }
+  } else {
+    /* a buffer leased for a message which is not sent returns to the region */
+    if(stage->outLease){
+      icom_shmUnref(stage->out->shm, out);
+    }
+    if(status == ICOM_EAGAIN){
+      status = ICOM_SUCCESS;
+    }
+  }
+
+  __atomic_store_n(&stage->busyNs, stage->busyNs + pipeline_now() - start, __ATOMIC_RELAXED);
+  return status;
+}
+
+static void* pipeline_stage(void *p){
+  pipelineStage_t *stage = (pipelineStage_t*)p;
+  icomStatus_t status = ICOM_SUCCESS;
+  void *buf, *data;
+  unsigned bufSize;
+  int end;
+
+  while(status == ICOM_SUCCESS && !__atomic_load_n(&stage->pipeline->stop, __ATOMIC_RELAXED)){
+    if(stage->inQueue){
+      buf = pipeline_queuePeek(stage, stage->inQueue, &bufSize, &end);
+      if(!buf){
+        status = ICOM_EINTR;
+        break;
+      }
+      /* the previous stage ended, so does this one */
+      if(end){
+        pipeline_queueRelease(stage->inQueue);
+        status = ICOM_EPIPE;
+        break;
+      }
+      status = pipeline_process(stage, buf, bufSize);
+      pipeline_queueRelease(stage->inQueue);
+
+    } else if(stage->in){
+      status = icom_recv(stage->in, &buf, &bufSize);
+      if(status == ICOM_TIMEOUT){
+        status = ICOM_SUCCESS;
+        continue;
+      }
+      if(status != ICOM_SUCCESS){
+        break;
+      }
+
+      /* every link of the endpoint delivers a message */
+      data = NULL;
+      while(status == ICOM_SUCCESS && icom_nextBuffer(stage->in, &data, &bufSize)){
+        status = pipeline_process(stage, data, bufSize);
+      }
+
+    } else {
+      status = pipeline_process(stage, NULL, 0);
+    }
+  }
+
+  /* pass the end of the stream on, the previous stage must not wait for us */
+  if(stage->inQueue){
+    __atomic_store_n(&stage->inQueue->closed, 1, __ATOMIC_RELAXED);
+  }
+  if(stage->outQueue && pipeline_queueReserve(stage, stage->outQueue)){
+    pipeline_queueCommit(stage->outQueue, 0, 1);
+  }
+
+  stage->status = status;
+  __atomic_store_n(&stage->endNs, pipeline_now(), __ATOMIC_RELAXED);
+  __atomic_store_n(&stage->running, 0, __ATOMIC_RELEASE);
+  return NULL;
+}
+
+icomPipeline_t* icom_pipelineInit(const icomStage_t *stages, unsigned stageCount){
+  icomPipeline_t *pipeline, *ret;
+  uint64_t depth, slotSize;
+  unsigned i;
+
+  if(!stages || stageCount == 0){
+    _E("Empty pipeline");
+    return (icomPipeline_t*)ICOM_EINVAL;
+  }
+
+  icom_getDefaultConfig(PIPELINE_QUEUE_DEPTH, &depth);
+  icom_getDefaultConfig(PIPELINE_SLOT_SIZE, &slotSize);
+  if(depth == 0 || (depth & (depth-1)) || slotSize == 0 || slotSize > UINT32_MAX){
+    _E("Invalid pipeline queue configuration (depth %lu, slot %lu bytes)", depth, slotSize);
+    return (icomPipeline_t*)ICOM_EINVAL;
+  }
+
+  pipeline = (icomPipeline_t*)malloc(sizeof(icomPipeline_t));
+  if(!pipeline){
+    _E("Failed to allocate memory");
+    return (icomPipeline_t*)ICOM_ENOMEM;
+  }
+  pipeline->stageCount = stageCount;
+  pipeline->started    = 0;
+  pipeline->stop       = 0;
+  pipeline->stages     = (pipelineStage_t*)calloc(stageCount, sizeof(pipelineStage_t));
+  if(!pipeline->stages){
+    _E("Failed to allocate memory");
+    ret = (icomPipeline_t*)ICOM_ENOMEM;
+    goto failure_stages;
+  }
+
+  for(i=0; i<stageCount; i++){
+    pipelineStage_t *stage = pipeline->stages+i;
+
+    stage->pipeline = pipeline;
+    stage->func     = stages[i].func;
+    stage->ctx      = stages[i].ctx;
+    stage->cpu      = stages[i].cpu;
+    stage->name     = strdup(stages[i].name ? stages[i].name : "");
+    if(!stage->name){
+      _E("Failed to allocate memory");
+      ret = (icomPipeline_t*)ICOM_ENOMEM;
+      goto failure_stage;
+    }
+
+    if(stages[i].in){
+      stage->in = icom_init(stages[i].in);
+      if(ICOM_IS_ERR(stage->in)){
+        _E("Failed to initialize input endpoint of stage %u: %s", i, stages[i].in);
+        ret = (icomPipeline_t*)stage->in;
+        stage->in = NULL;
+        goto failure_stage;
+      }
+    }
+
+    if(stages[i].out){
+      stage->out = icom_init(stages[i].out);
+      if(ICOM_IS_ERR(stage->out)){
+        _E("Failed to initialize output endpoint of stage %u: %s", i, stages[i].out);
+        ret = (icomPipeline_t*)stage->out;
+        stage->out = NULL;
+        goto failure_stage;
+      }
+
+      /* zero-copy endpoints lease a fresh buffer for every message, with
+       * autonotify a single buffer of their region is reused instead (the
+       * next send waits for the receivers), the rest copy the messages */
+      stage->outBufSize = slotSize;
+      stage->outBufNode = stage->out->options.node;
+      stage->outLease   = stage->out->shm
+                       && !(stage->out->flags & (ICOM_FLAG_NOTIFY | ICOM_FLAG_AUTONOTIFY));
+      if(stage->out->flags & ICOM_FLAG_AUTONOTIFY){
+        stage->outBuf    = icom_alloc(stage->out, slotSize);
+        stage->outBufShm = (stage->outBuf != NULL);
+      }
+      if(!stage->outBuf && !stage->outLease){
+        stage->outBuf = icom_memAlloc(slotSize, stage->outBufNode, stage->out->options.memFlags);
+      }
+      if(!stage->outBuf && !stage->outLease){
+        _E("Failed to allocate memory");
+        ret = (icomPipeline_t*)ICOM_ENOMEM;
+        goto failure_stage;
+      }
+    }
+
+    /* stages without a core of their own are served on the endpoints' core */
+    if(stage->cpu < 0 && stage->in){
+      stage->cpu = stage->in->options.cpu;
+    }
+    if(stage->cpu < 0 && stage->out){
+      stage->cpu = stage->out->options.cpu;
+    }
+
+    /* and the queues follow the endpoints' allocation policy */
+    stage->memFlags = stage->in  ? stage->in->options.memFlags  :
+                      stage->out ? stage->out->options.memFlags : 0;
+
+    /* adjacent stages without endpoints share a queue, which is placed on
+     * the consumer's node */
+    if(!stages[i].in && i > 0 && !stages[i-1].out){
+      stage->inQueue = pipeline_queueInit(depth, slotSize, (stage->cpu >= 0) ? icom_memCpuNode(stage->cpu) : -1,
+                                          stage->memFlags);
+      if(!stage->inQueue){
+        _E("Failed to allocate memory");
+        ret = (icomPipeline_t*)ICOM_ENOMEM;
+        goto failure_stage;
+      }
+      pipeline->stages[i-1].outQueue = stage->inQueue;
+    }
+  }
+
+  return pipeline;
+
+
+failure_stage:
+  pipeline->stageCount = i+1;
+  icom_pipelineDeinit(pipeline);
+  return ret;
+failure_stages:
+  free(pipeline);
+  return ret;
+}
+
+icomStatus_t icom_pipelineStart(icomPipeline_t *pipeline){
+  pthread_attr_t attr;
+  cpu_set_t cpus;
+  unsigned i;
+
+  if(pipeline->started){
+    _E("Pipeline already started");
+    return ICOM_EBUSY;
+  }
+
+  for(i=0; i<pipeline->stageCount; i++){
+    pipelineStage_t *stage = pipeline->stages+i;
+
+    /* pinned before it starts, so the stage never runs elsewhere */
+    pthread_attr_init(&attr);
+    if(stage->cpu >= 0){
+      CPU_ZERO(&cpus);
+      CPU_SET(stage->cpu, &cpus);
+      if(pthread_attr_setaffinity_np(&attr, sizeof(cpus), &cpus) != 0){
+        _W("Failed to pin stage %u (%s) to core %d", i, stage->name, stage->cpu);
+      }
+    }
+
+    stage->running = 1;
+    stage->startNs = pipeline_now();
+    if(pthread_create(&stage->thread, &attr, pipeline_stage, stage) != 0){
+      _SE("Failed to start stage %u (%s)", i, stage->name);
+      stage->running = 0;
+      pthread_attr_destroy(&attr);
+      icom_pipelineStop(pipeline);
+      icom_pipelineJoin(pipeline);
+      return ICOM_ERROR;
+    }
+    pthread_attr_destroy(&attr);
+  }
+
+  pipeline->started = 1;
+  return ICOM_SUCCESS;
+}
+
+void icom_pipelineStop(icomPipeline_t *pipeline){
+  __atomic_store_n(&pipeline->stop, 1, __ATOMIC_RELAXED);
+}
+
+icomStatus_t icom_pipelineJoin(icomPipeline_t *pipeline){
+  for(unsigned i=0; i<pipeline->stageCount; i++){
+    if(pipeline->stages[i].thread){
+      pthread_join(pipeline->stages[i].thread, NULL);
+      pipeline->stages[i].thread = 0;
+    }
+  }
+  return ICOM_SUCCESS;
+}
+
+icomStatus_t icom_pipelineStats(icomPipeline_t *pipeline, unsigned index, icomStageStats_t *stats){
+  pipelineStage_t *stage;
+  uint64_t start, end;
+
+  if(index >= pipeline->stageCount){
+    return ICOM_EINVAL;
+  }
+  stage = pipeline->stages+index;
+
+  stats->running  = __atomic_load_n(&stage->running, __ATOMIC_ACQUIRE);
+  stats->status   = stats->running ? ICOM_SUCCESS : stage->status;
+  stats->messages = __atomic_load_n(&stage->messages, __ATOMIC_RELAXED);
+
+  start = stage->startNs;
+  end   = stats->running ? pipeline_now() : __atomic_load_n(&stage->endNs, __ATOMIC_RELAXED);
+  stats->utilisation = (start && end > start)
+    ? (double)__atomic_load_n(&stage->busyNs, __ATOMIC_RELAXED) / (end - start) : 0.0;
+
+  stats->queueDepth = 0;
+  stats->queueMax   = 0;
+  if(stage->inQueue){
+    stats->queueDepth = __atomic_load_n(&stage->inQueue->tail, __ATOMIC_RELAXED)
+                      - __atomic_load_n(&stage->inQueue->head, __ATOMIC_RELAXED);
+    stats->queueMax   = __atomic_load_n(&stage->inQueue->depthMax, __ATOMIC_RELAXED);
+  }
+  return ICOM_SUCCESS;
+}
+
+void icom_pipelineDeinit(icomPipeline_t *pipeline){
+  icom_pipelineStop(pipeline);
+  icom_pipelineJoin(pipeline);
+
+  for(unsigned i=0; i<pipeline->stageCount; i++){
+    pipelineStage_t *stage = pipeline->stages+i;
+
+    if(stage->out){
+      if(stage->outBufShm){
+        icom_free(stage->out, stage->outBuf);
+      } else if(stage->outBuf){
+        icom_memFree(stage->outBuf, stage->outBufSize, stage->outBufNode, stage->out->options.memFlags);
+      }
+      icom_deinit(stage->out);
+    }
+    if(stage->in){
+      icom_deinit(stage->in);
+    }
+    pipeline_queueDeinit(stage->inQueue);
+    free(stage->name);
+  }
+
+  free(pipeline->stages);
+  free(pipeline);
+}
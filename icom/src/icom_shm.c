@@ -0,0 +1,294 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/random.h>
+
+#include "icom_shm.h"
+#include "notification.h"
+
+/* blocks (and buffers) are cache line aligned, every block starts with a
+ * header of the same size, the region starts with a cache line holding the
+ * cookie (the blocks follow) */
+#define SHM_ALIGN      (64)
+#define SHM_NONE       (UINT64_MAX)
+#define SHM_ALLOCATED  (UINT64_MAX-1)
+
+typedef struct {
+  uint64_t size;  /** block size including the header */
+  uint64_t next;  /** offset of the next free block (free list is address ordered) */
+  uint32_t refs;  /** references of a leased block, '0' for other blocks */
+} shmBlock_t;
+
+static unsigned g_shmCounter = 0;
+
+
+static inline shmBlock_t* shm_block(const icomShm_t *shm, uint64_t offset){
+  return (shmBlock_t*)(shm->base + offset);
+}
+
+/* header of a buffer allocated within the region, or NULL */
+static shmBlock_t* shm_allocatedBlock(const icomShm_t *shm, const void *buf){
+  shmBlock_t *block;
+
+  if(!icom_shmContains(shm, buf, 1) || (uint8_t*)buf < shm->base + 2*SHM_ALIGN
+  || ((uint8_t*)buf - shm->base) % SHM_ALIGN){
+    return NULL;
+  }
+  block = (shmBlock_t*)((uint8_t*)buf - SHM_ALIGN);
+  return (block->next == SHM_ALLOCATED) ? block : NULL;
+}
+
+icomShm_t* icom_shmInit(uint64_t size){
+  uint64_t random[2];
+  icomShm_t *shm;
+
+  size = (size + SHM_ALIGN - 1) & ~(uint64_t)(SHM_ALIGN - 1);
+  if(size < 3*SHM_ALIGN){
+    _E("Shared memory region too small");
+    return NULL;
+  }
+
+  shm = (icomShm_t*)malloc(sizeof(icomShm_t));
+  if(!shm){
+    _E("Failed to allocate memory");
+    return NULL;
+  }
+
+  /* unique name within the host, the random part and the cookie tell apart
+   * regions of other hosts (or containers) which may share the pid */
+  if(getrandom(random, sizeof(random), 0) != sizeof(random)){
+    _SE("Failed to get random bytes");
+    goto failure_open;
+  }
+  snprintf(shm->name, sizeof(shm->name), "/icom-%d-%u-%016lx",
+    (int)getpid(), __atomic_fetch_add(&g_shmCounter, 1, __ATOMIC_RELAXED), random[0]);
+  shm->cookie = random[1];
+
+  shm->fd = shm_open(shm->name, O_CREAT | O_EXCL | O_RDWR, 0600);
+  if(shm->fd == -1){
+    _SE("Failed to create shared memory object");
+    goto failure_open;
+  }
+
+  /* pages are allocated on the first touch, so a large region is cheap */
+  if(ftruncate(shm->fd, size) == -1){
+    _SE("Failed to resize shared memory object");
+    goto failure_truncate;
+  }
+
+  shm->base = (uint8_t*)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, shm->fd, 0);
+  if(shm->base == MAP_FAILED){
+    _SE("Failed to map shared memory object");
+    goto failure_truncate;
+  }
+
+  /* a single free block spans the whole region after the cookie */
+  shm->size     = size;
+  shm->freeList = SHM_ALIGN;
+  shm->leases   = 0;
+  memcpy(shm->base, &shm->cookie, sizeof(shm->cookie));
+  shm_block(shm, SHM_ALIGN)->size = size - SHM_ALIGN;
+  shm_block(shm, SHM_ALIGN)->next = SHM_NONE;
+  pthread_mutex_init(&shm->lock, NULL);
+
+  return shm;
+
+failure_truncate:
+  close(shm->fd);
+  shm_unlink(shm->name);
+failure_open:
+  free(shm);
+  return NULL;
+}
+
+void icom_shmDeinit(icomShm_t *shm){
+  pthread_mutex_destroy(&shm->lock);
+  munmap(shm->base, shm->size);
+  close(shm->fd);
+  shm_unlink(shm->name);
+  free(shm);
+}
+
+void* icom_shmAlloc(icomShm_t *shm, uint64_t size){
+  uint64_t need, offset, prev, rest;
+  shmBlock_t *block;
+
+  need = ((size + SHM_ALIGN - 1) & ~(uint64_t)(SHM_ALIGN - 1)) + SHM_ALIGN;
+  if(size == 0 || need < size){
+    return NULL;
+  }
+
+  pthread_mutex_lock(&shm->lock);
+
+  /* first fit */
+  prev = SHM_NONE;
+  for(offset=shm->freeList; offset!=SHM_NONE; offset=block->next){
+    block = shm_block(shm, offset);
+    if(block->size >= need){
+      break;
+    }
+    prev = offset;
+  }
+
+  if(offset == SHM_NONE){
+    pthread_mutex_unlock(&shm->lock);
+    return NULL;
+  }
+
+  /* split the block if the rest can hold at least a cache line */
+  rest = block->size - need;
+  if(rest >= 2*SHM_ALIGN){
+    shm_block(shm, offset+need)->size = rest;
+    shm_block(shm, offset+need)->next = block->next;
+    block->size = need;
+    block->next = offset+need;
+  }
+
+  if(prev == SHM_NONE){
+    shm->freeList = block->next;
+  } else {
+    shm_block(shm, prev)->next = block->next;
+  }
+  block->next = SHM_ALLOCATED;
+  block->refs = 0;
+
+  pthread_mutex_unlock(&shm->lock);
+  return shm->base + offset + SHM_ALIGN;
+}
+
+void icom_shmFree(icomShm_t *shm, void *buf){
+  uint64_t offset, prev, next;
+  shmBlock_t *block;
+
+  if(!buf){
+    return;
+  }
+
+  /* checked under the lock, a concurrent free of the same buffer would insert
+   * it twice otherwise */
+  pthread_mutex_lock(&shm->lock);
+  block = shm_allocatedBlock(shm, buf);
+  if(!block){
+    pthread_mutex_unlock(&shm->lock);
+    _E("Invalid shared memory buffer %p", buf);
+    return;
+  }
+  offset = (uint8_t*)block - shm->base;
+
+  /* insert in address order */
+  prev = SHM_NONE;
+  for(next=shm->freeList; next!=SHM_NONE && next<offset; next=shm_block(shm, next)->next){
+    prev = next;
+  }
+  block->next = next;
+  if(prev == SHM_NONE){
+    shm->freeList = offset;
+  } else {
+    shm_block(shm, prev)->next = offset;
+  }
+
+  /* coalesce with the neighbouring free blocks */
+  if(next != SHM_NONE && offset + block->size == next){
+    block->size += shm_block(shm, next)->size;
+    block->next  = shm_block(shm, next)->next;
+  }
+  if(prev != SHM_NONE && prev + shm_block(shm, prev)->size == offset){
+    shm_block(shm, prev)->size += block->size;
+    shm_block(shm, prev)->next  = block->next;
+  }
+
+  pthread_mutex_unlock(&shm->lock);
+}
+
+void* icom_shmLease(icomShm_t *shm, uint64_t size){
+  void *buf = icom_shmAlloc(shm, size);
+
+  if(buf){
+    ((shmBlock_t*)((uint8_t*)buf - SHM_ALIGN))->refs = 1;
+    __atomic_add_fetch(&shm->leases, 1, __ATOMIC_RELAXED);
+  }
+  return buf;
+}
+
+void icom_shmRef(icomShm_t *shm, void *buf){
+  shmBlock_t *block = shm_allocatedBlock(shm, buf);
+
+  if(block){
+    __atomic_add_fetch(&block->refs, 1, __ATOMIC_ACQ_REL);
+  }
+}
+
+void icom_shmUnref(icomShm_t *shm, void *buf){
+  shmBlock_t *block = shm_allocatedBlock(shm, buf);
+
+  if(!block || __atomic_load_n(&block->refs, __ATOMIC_ACQUIRE) == 0){
+    _E("Invalid leased buffer %p", buf);
+    return;
+  }
+
+  if(__atomic_sub_fetch(&block->refs, 1, __ATOMIC_ACQ_REL) == 0){
+    icom_shmFree(shm, buf);
+    __atomic_sub_fetch(&shm->leases, 1, __ATOMIC_RELAXED);
+  }
+}
+
+int icom_shmIsLeased(const icomShm_t *shm, const void *buf){
+  shmBlock_t *block = shm_allocatedBlock(shm, buf);
+  return block && __atomic_load_n(&block->refs, __ATOMIC_ACQUIRE) > 0;
+}
+
+int icom_shmContains(const icomShm_t *shm, const void *buf, uint64_t size){
+  const uint8_t *p = (const uint8_t*)buf;
+  return (p >= shm->base) && (p < shm->base + shm->size)
+      && (size <= (uint64_t)(shm->base + shm->size - p));
+}
+
+void* icom_shmMap(const char *name, uint64_t size, uint64_t cookie){
+  struct stat st;
+  void *base;
+  int fd;
+
+  if(size < sizeof(cookie)){
+    _E("Shared memory object \"%s\" is too small", name);
+    return NULL;
+  }
+
+  fd = shm_open(name, O_RDWR, 0);
+  if(fd == -1){
+    _SE("Failed to open shared memory object \"%s\"", name);
+    return NULL;
+  }
+
+  if(fstat(fd, &st) == -1 || (uint64_t)st.st_size < size){
+    _E("Shared memory object \"%s\" is smaller than announced", name);
+    close(fd);
+    return NULL;
+  }
+
+  base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if(base == MAP_FAILED){
+    _SE("Failed to map shared memory object \"%s\"", name);
+    return NULL;
+  }
+
+  /* an object of the same name may belong to another (e.g. local) region */
+  if(memcmp(base, &cookie, sizeof(cookie)) != 0){
+    _E("Shared memory object \"%s\" is not the peer's region", name);
+    munmap(base, size);
+    return NULL;
+  }
+
+  return base;
+}
+
+void icom_shmUnmap(void *base, uint64_t size){
+  munmap(base, size);
+}
@@ -12,6 +12,10 @@ static const char* icomTypeStrings[] = {
   "zmq_sub",
   "zmq_req",
   "zmq_rep",
+  "mcast_tx",
+  "mcast_rx",
+  "udp_tx",
+  "udp_rx",
   "auto",
 };
 
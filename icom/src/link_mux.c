@@ -0,0 +1,252 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "icom.h"
+#include "icom_type.h"
+#include "icom_status.h"
+#include "icom_mem.h"
+#include "link_mux.h"
+#include "link_socket.h"
+#include "notification.h"
+
+
+/* Channels are links of an icom object sharing a single socket link, i.e.
+ * one connection, file descriptor and socket buffer. Every message carries
+ * its channel in the header, a channel's receive returns the next message of
+ * the channel and queues the messages of the other channels received on the
+ * way. Received buffers are swapped between the connection and the channel,
+ * so messages arriving in order are not copied. */
+static icomStatus_t mux_nop(icomLink_t *link, void **buf, unsigned *bufSize){
+  return ICOM_SUCCESS;
+}
+
+static icomStatus_t mux_send(icomLink_t *link, void *buf, unsigned bufSize){
+  icomLinkMux_t *pdata = link->pdata;
+  icomLink_t *conn = &pdata->mux->link;
+
+  ((icomLinkSocket_t*)conn->pdata)->sendChannel = pdata->channel;
+  return conn->sendHandler(conn, buf, bufSize);
+}
+
+/* hands the connection's received buffer over to the channel */
+static void mux_swap(icomLink_t *link, icomLink_t *conn){
+  icomLinkMux_t *pdata = link->pdata;
+  icomLinkSocket_t *socket = conn->pdata;
+  void *buf = link->recvBuf;
+  uint32_t alloc = pdata->recvAlloc;
+
+  link->recvBuf     = conn->recvBuf;
+  pdata->recvAlloc  = socket->recvAlloc;
+  conn->recvBuf     = buf;
+  socket->recvAlloc = alloc;
+  socket->recvFrame = 0; /* delta messages need the previous frame */
+
+  /* the buffers point back to their (new) links (icom_nextBuffer) */
+  *(icomLink_t**)((uint8_t*)link->recvBuf - sizeof(link)) = link;
+  *(icomLink_t**)((uint8_t*)conn->recvBuf - sizeof(conn)) = conn;
+
+  link->recvBufSize = conn->recvBufSize;
+  link->recvSize    = conn->recvSize;
+  link->recvId      = conn->recvId;
+}
+
+/* delivers the oldest message received ahead */
+static icomStatus_t mux_dequeue(icomLink_t *link){
+  icomLinkMux_t *pdata = link->pdata;
+  icomMuxMsg_t *msg = pdata->head;
+  icomStatus_t status;
+
+  status = icom_memGrowRecv(link, &pdata->recvAlloc, msg->size, pdata->node, pdata->memFlags);
+  if(status != ICOM_SUCCESS){
+    return status;
+  }
+
+  memcpy(link->recvBuf, msg->data, msg->size);
+  link->recvBufSize = msg->size;
+  link->recvSize    = msg->size;
+  link->recvId      = msg->id;
+
+  pdata->head = msg->next;
+  if(!pdata->head){
+    pdata->tail = NULL;
+  }
+  pdata->queued--;
+  free(msg);
+  return ICOM_SUCCESS;
+}
+
+/* queues the connection's received message for its channel */
+static icomStatus_t mux_enqueue(icomLink_t *link, icomLink_t *conn){
+  icomLinkMux_t *pdata = link->pdata;
+  icomMuxMsg_t *msg;
+
+  msg = (icomMuxMsg_t*)malloc(sizeof(icomMuxMsg_t) + conn->recvBufSize);
+  if(!msg){
+    _E("Failed to allocate memory");
+    return ICOM_ENOMEM;
+  }
+  msg->next = NULL;
+  msg->size = conn->recvBufSize;
+  msg->id   = conn->recvId;
+  memcpy(msg->data, conn->recvBuf, conn->recvBufSize);
+
+  if(pdata->tail){
+    pdata->tail->next = msg;
+  } else {
+    pdata->head = msg;
+  }
+  pdata->tail = msg;
+  pdata->queued++;
+  return ICOM_SUCCESS;
+}
+
+static icomStatus_t mux_recv(icomLink_t *link, void **buf, unsigned *bufSize){
+  icomLinkMux_t *pdata = link->pdata;
+  icomMux_t *mux = pdata->mux;
+  icomLink_t *conn = &mux->link;
+  icomStatus_t ret;
+  unsigned channel;
+  void *connBuf;
+  unsigned connBufSize;
+
+  if(pdata->head){
+    ret = mux_dequeue(link);
+  } else {
+    while(1){
+      ret = conn->recvHandler(conn, &connBuf, &connBufSize);
+      if(ret != ICOM_SUCCESS){
+        return ret;
+      }
+
+      channel = conn->recvChannel;
+      if(channel == pdata->channel){
+        mux_swap(link, conn);
+        break;
+      }
+      if(channel >= mux->channelCount){
+        _W("Dropping message of unknown channel %u", channel);
+        continue;
+      }
+      ret = mux_enqueue(mux->channels + channel, conn);
+      if(ret != ICOM_SUCCESS){
+        return ret;
+      }
+    }
+  }
+  if(ret != ICOM_SUCCESS){
+    return ret;
+  }
+
+  *buf     = link->recvBuf;
+  *bufSize = link->recvBufSize;
+  return ICOM_SUCCESS;
+}
+
+static icomStatus_t mux_initChannel(icomLink_t *link, icomMux_t *mux, unsigned channel){
+  icomLinkMux_t *pdata;
+
+  pdata = (icomLinkMux_t*)calloc(1, sizeof(icomLinkMux_t));
+  if(!pdata){
+    _E("Failed to allocate memory");
+    return ICOM_ENOMEM;
+  }
+  pdata->mux      = mux;
+  pdata->channel  = channel;
+  pdata->node     = link->options ? link->options->node : -1;
+  pdata->memFlags = link->options ? link->options->memFlags : 0;
+
+  link->recvBuf = icom_memAlloc(sizeof(link), pdata->node, pdata->memFlags);
+  if(!link->recvBuf){
+    _E("Failed to allocate memory");
+    free(pdata);
+    return ICOM_ENOMEM;
+  }
+  *(icomLink_t**)link->recvBuf = link;
+  link->recvBuf = (uint8_t*)link->recvBuf + sizeof(link);
+
+  link->pdata       = pdata;
+  link->type        = mux->link.type;
+  link->flags       = mux->link.flags;
+  link->recvSize    = 0;
+  link->recvBufSize = 0;
+  link->sendHandler = mux_send;
+  link->recvHandler = mux_recv;
+  link->autoSendAck = mux_nop;
+  link->autoRecvAck = mux_nop;
+  link->notifySendHandler = mux_nop;
+  link->notifyRecvHandler = mux_nop;
+  mux->refs++;
+  return ICOM_SUCCESS;
+}
+
+icomStatus_t icom_initMux(icomLink_t *link, unsigned channelCount, icomType_t type,
+                          const char *comString, icomFlags_t flags){
+  icomStatus_t ret;
+  icomMux_t *mux;
+
+  /* acknowledgements and leases would have to be multiplexed as well */
+  if(type != ICOM_TYPE_SOCKET_TX && type != ICOM_TYPE_SOCKET_RX){
+    _E("Channels are supported by socket_tx/socket_rx links only");
+    return ICOM_EINVAL;
+  }
+  if(flags & (ICOM_FLAG_ZERO | ICOM_FLAG_NOTIFY | ICOM_FLAG_AUTONOTIFY | ICOM_FLAG_LEASE)){
+    _E("Channels support the default, timeout and spin flags only");
+    return ICOM_EINVAL;
+  }
+  if(link->options && (link->options->server || link->options->reuseport)){
+    _E("Channels do not support the server and reuseport options");
+    return ICOM_EINVAL;
+  }
+
+  mux = (icomMux_t*)calloc(1, sizeof(icomMux_t));
+  if(!mux){
+    _E("Failed to allocate memory");
+    return ICOM_ENOMEM;
+  }
+
+  /* the connection is set up as the first channel would have been */
+  mux->link = *link;
+  ret = (type == ICOM_TYPE_SOCKET_TX)
+      ? icom_initSocketConnect(&mux->link, type, comString, flags)
+      : icom_initSocketBind(&mux->link, type, comString, flags);
+  if(ret != ICOM_SUCCESS){
+    goto failure_initSocket;
+  }
+  mux->channels     = link;
+  mux->channelCount = channelCount;
+
+  ret = mux_initChannel(link, mux, 0);
+  if(ret != ICOM_SUCCESS){
+    goto failure_initChannel;
+  }
+  return ICOM_SUCCESS;
+
+
+failure_initChannel:
+  icom_deinitSocket(&mux->link);
+failure_initSocket:
+  free(mux);
+  return ret;
+}
+
+icomStatus_t icom_initMuxChannel(icomLink_t *link, icomLink_t *first, unsigned channel){
+  return mux_initChannel(link, ((icomLinkMux_t*)first->pdata)->mux, channel);
+}
+
+void icom_deinitMux(icomLink_t *link){
+  icomLinkMux_t *pdata = link->pdata;
+  icomMux_t *mux = pdata->mux;
+
+  while(pdata->head){
+    icomMuxMsg_t *msg = pdata->head;
+    pdata->head = msg->next;
+    free(msg);
+  }
+  icom_memFree((uint8_t*)link->recvBuf-sizeof(link), sizeof(link) + pdata->recvAlloc, pdata->node, pdata->memFlags);
+  free(pdata);
+
+  if(--mux->refs == 0){
+    icom_deinitSocket(&mux->link);
+    free(mux);
+  }
+}
@@ -1,10 +1,16 @@
+#define _GNU_SOURCE
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <unistd.h>
+#include <poll.h>
+#include <time.h>
 #include <arpa/inet.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <netinet/tcp.h>
+#include <linux/filter.h>
 
 #include "icom.h"
 #include "icom_type.h"
@@ -13,8 +19,16 @@
 #include "link_socket.h"
 #include "notification.h"
 #include "config.h"
+#include "icom_config.h"
+#include "icom_mem.h"
+#include "icom_options.h"
+#include "icom_lz.h"
 
 
+static void link_setOption(int fd, int level, int name, int value, const char *optionName);
+static void link_initCompress(icomLink_t *link, icomLinkSocket_t *pdata);
+static void link_initDelta(icomLinkSocket_t *pdata);
+
 static icomStatus_t link_nop(icomLink_t *link, void **buf, unsigned *bufSize) {
   return ICOM_SUCCESS;
 }
@@ -43,21 +57,469 @@ static icomStatus_t link_accept(icomLink_t *link, void **buf, unsigned *bufSize)
   return ICOM_SUCCESS;
 }
 
-static icomStatus_t link_recvHeader(icomLink_t *link, void **buf, unsigned *bufSize) {
+static icomStatus_t link_sendAll(int fd, const void *buf, unsigned size) {
+  int ret;
+
+  while (size > 0) {
+    ret = send(fd, buf, size, 0);
+    if (ret == -1) {
+      if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+        _D("Send timeout");
+        return ICOM_TIMEOUT;
+      }
+      _SE("Send failed");
+      return ICOM_ERROR;
+    }
+    buf   = (const uint8_t*)buf + ret;
+    size -= ret;
+  }
+  return ICOM_SUCCESS;
+}
+
+static icomStatus_t link_recvAll(int fd, void *buf, unsigned size) {
+  int ret;
+
+  while (size > 0) {
+    ret = recv(fd, buf, size, 0);
+    if (ret <= 0) {
+      if ((ret == -1) && ((errno == EAGAIN) || (errno == EWOULDBLOCK))) {
+        _D("Timeout");
+        return ICOM_TIMEOUT;
+      }
+      _SE("Receive failed");
+      return ICOM_ERROR;
+    }
+    buf   = (uint8_t*)buf + ret;
+    size -= ret;
+  }
+  return ICOM_SUCCESS;
+}
+
+/* Waits until the socket is readable (spin flag), i.e., polls it with
+ * non-blocking receives for the spin budget and then blocks in poll. Data,
+ * end of stream and errors are left to the following receive. */
+static icomStatus_t link_spin(icomLink_t *link) {
+  icomLinkSocket_t *pdata = link->pdata;
+  struct timespec ts;
+  struct pollfd pfd;
+  uint64_t now, deadline;
+  uint8_t byte;
+  int ret;
+
+  /* server links spin on their epoll instance instead */
+  if (!pdata->spinNs || pdata->server) {
+    return ICOM_SUCCESS;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  now      = (uint64_t)ts.tv_sec*1000000000ull + ts.tv_nsec;
+  deadline = now + pdata->spinNs;
+  do {
+    link->spinStats.spins++;
+    ret = recv(pdata->fdAccepted, &byte, 1, MSG_PEEK | MSG_DONTWAIT);
+    if (ret != -1 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+      link->spinStats.hits++;
+      return ICOM_SUCCESS;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    now = (uint64_t)ts.tv_sec*1000000000ull + ts.tv_nsec;
+  } while (now < deadline);
+
+  link->spinStats.fallbacks++;
+  pfd = (struct pollfd){pdata->fdAccepted, POLLIN, 0};
+  do {
+    ret = poll(&pfd, 1, pdata->timeoutUs ? (pdata->timeoutUs+999)/1000 : -1);
+  } while (ret == -1 && errno == EINTR);
+  if (ret == -1) {
+    _SE("Failed to poll socket");
+    return ICOM_ERROR;
+  }
+  if (ret == 0) {
+    _D("Timeout");
+    return ICOM_TIMEOUT;
+  }
+  link->spinStats.wakeups++;
+  return ICOM_SUCCESS;
+}
+
+/* Offers the icom object's shared memory region to the peer, which maps it
+ * and replies whether it succeeded. If it did not, buffers are copied. */
+static icomStatus_t link_shareRegion(icomLink_t *link) {
+  icomLinkSocket_t *pdata = link->pdata;
+  icomMsgHeader_t header = {link->type, ICOM_FLAG_CONTROL, sizeof(icomLinkCtrl_t)};
+  icomLinkCtrl_t ctrl;
+  icomStatus_t ret;
+  int mapped;
+
+  memset(&ctrl, 0, sizeof(ctrl));
+  ctrl.op   = LINK_CTRL_SHM;
+  ctrl.size   = link->shm->size;
+  ctrl.cookie = link->shm->cookie;
+  memcpy(ctrl.name, link->shm->name, sizeof(ctrl.name));
+
+  ret = link_sendAll(pdata->fdAccepted, &header, sizeof(header));
+  if (ret != ICOM_SUCCESS) return ret;
+  ret = link_sendAll(pdata->fdAccepted, &ctrl, sizeof(ctrl));
+  if (ret != ICOM_SUCCESS) return ret;
+  ret = link_recvAll(pdata->fdAccepted, &mapped, sizeof(mapped));
+  if (ret != ICOM_SUCCESS) return ret;
+
+  if (mapped == 1) {
+    pdata->shmState = LINK_SHM_SHARED;
+  } else {
+    _W("Peer failed to map shared memory region, falling back to copying");
+    pdata->shmState = LINK_SHM_FAILED;
+  }
+  return ICOM_SUCCESS;
+}
+
+/* handles a control message received instead of a data header */
+static icomStatus_t link_recvControl(icomLink_t *link, icomMsgHeader_t *header) {
+  icomLinkSocket_t *pdata = link->pdata;
+  icomLinkCtrl_t ctrl;
+  icomStatus_t ret;
+  int mapped;
+
+  if (header->bufSize != sizeof(ctrl)) {
+    _E("Invalid control message size (%u)", header->bufSize);
+    return ICOM_ERROR;
+  }
+  ret = link_recvAll(pdata->fdAccepted, &ctrl, sizeof(ctrl));
+  if (ret != ICOM_SUCCESS) return ret;
+
+  switch (ctrl.op) {
+    case LINK_CTRL_SHM:
+      if (pdata->shmPeer) {
+        icom_shmUnmap(pdata->shmPeer, pdata->shmPeerSize);
+      }
+      ctrl.name[sizeof(ctrl.name)-1] = '\0';
+      pdata->shmPeer     = icom_shmMap(ctrl.name, ctrl.size, ctrl.cookie);
+      pdata->shmPeerSize = pdata->shmPeer ? ctrl.size : 0;
+      mapped = (pdata->shmPeer != NULL);
+      return link_sendAll(pdata->fdAccepted, &mapped, sizeof(mapped));
+
+    case LINK_CTRL_RELEASE:
+      if (!link->shm || ctrl.offset >= link->shm->size) {
+        _E("Invalid released buffer (offset %lu)", ctrl.offset);
+        return ICOM_ERROR;
+      }
+      icom_shmUnref(link->shm, link->shm->base + ctrl.offset);
+      return ICOM_SUCCESS;
+
+    default:
+      _E("Unknown control message (%u)", ctrl.op);
+      return ICOM_ERROR;
+  }
+}
+
+static icomStatus_t link_sendRelease(icomLink_t *link, uint64_t offset) {
+  icomLinkSocket_t *pdata = link->pdata;
+  icomMsgHeader_t header = {link->type, ICOM_FLAG_CONTROL, sizeof(icomLinkCtrl_t)};
+  icomLinkCtrl_t ctrl;
+  icomStatus_t ret;
+
+  memset(&ctrl, 0, sizeof(ctrl));
+  ctrl.op     = LINK_CTRL_RELEASE;
+  ctrl.offset = offset;
+
+  ret = link_sendAll(pdata->fdAccepted, &header, sizeof(header));
+  if (ret != ICOM_SUCCESS) return ret;
+  return link_sendAll(pdata->fdAccepted, &ctrl, sizeof(ctrl));
+}
+
+static void link_peerSwitch(icomLinkSocket_t *pdata, icomLinkPeer_t *peer);
+
+static icomStatus_t link_releaseHandler(icomLink_t *link, void *buf) {
+  icomLinkSocket_t *pdata = link->pdata;
+  icomLinkPeer_t *current = pdata->peer;
+  icomStatus_t ret;
+  uint64_t offset;
+
+  /* buffers of this link lie in its mapping of the peer's region */
+  if (!pdata->shmPeer || (uint8_t*)buf < (uint8_t*)pdata->shmPeer
+  ||  (uint8_t*)buf >= (uint8_t*)pdata->shmPeer + pdata->shmPeerSize) {
+    /* server links release buffers of the other peers on their behalf */
+    for (unsigned i=0; pdata->server && i<pdata->peerCount; i++) {
+      icomLinkPeer_t *peer = pdata->peers[i];
+      if (peer != current && peer->shmPeer && (uint8_t*)buf >= (uint8_t*)peer->shmPeer
+      &&  (uint8_t*)buf < (uint8_t*)peer->shmPeer + peer->shmPeerSize) {
+        link_peerSwitch(pdata, peer);
+        ret = link_releaseHandler(link, buf);
+        link_peerSwitch(pdata, current);
+        return ret;
+      }
+    }
+    return ICOM_ELOOKUP;
+  }
+
+  offset = (uint8_t*)buf - (uint8_t*)pdata->shmPeer;
+  if (pdata->leasePending && pdata->leaseOffset == offset) {
+    pdata->leasePending = 0;
+  }
+  return link_sendRelease(link, offset);
+}
+
+/* Processes released buffers queued on the link, waits up to timeoutMs for
+ * the first one. Other messages (e.g. data sent back by the peer) stop the
+ * processing and are left to the receive path, which handles control
+ * messages transparently as well. */
+static icomStatus_t link_reclaimHandler(icomLink_t *link, int timeoutMs) {
+  icomLinkSocket_t *pdata = link->pdata;
   icomMsgHeader_t header;
-  int bytesReceived;
+  struct pollfd pfd;
+  icomStatus_t status;
   int ret;
 
+  if (!pdata->fdAccepted) {
+    return ICOM_SUCCESS;
+  }
+
+  if (timeoutMs > 0) {
+    pfd = (struct pollfd){pdata->fdAccepted, POLLIN, 0};
+    if (poll(&pfd, 1, timeoutMs) == -1) {
+      _SE("Failed to poll socket");
+      return ICOM_ERROR;
+    }
+  }
+
+  while (1) {
+    ret = recv(pdata->fdAccepted, &header, sizeof(header), MSG_PEEK | MSG_DONTWAIT);
+    if (ret == -1) {
+      return ((errno == EAGAIN) || (errno == EWOULDBLOCK)) ? ICOM_SUCCESS : ICOM_ERROR;
+    }
+    if (ret == 0) {
+      return ICOM_ERROR;
+    }
+    if (ret < sizeof(header) || !(header.flags & ICOM_FLAG_CONTROL)) {
+      return ICOM_SUCCESS;
+    }
+
+    status = link_recvAll(pdata->fdAccepted, &header, sizeof(header));
+    if (status != ICOM_SUCCESS) return status;
+    status = link_recvControl(link, &header);
+    if (status != ICOM_SUCCESS) return status;
+  }
+}
+
+/* receives the next data header, control messages are handled transparently */
+static icomStatus_t link_recvMsgHeader(icomLink_t *link, icomMsgHeader_t *header) {
+  icomLinkSocket_t *pdata = link->pdata;
+  icomStatus_t ret;
+
+  while (1) {
+    ret = link_spin(link);
+    if (ret != ICOM_SUCCESS) return ret;
+    ret = link_recvAll(pdata->fdAccepted, header, sizeof(*header));
+    if (ret != ICOM_SUCCESS) return ret;
+
+    if (!(header->flags & ICOM_FLAG_CONTROL)) break;
+    ret = link_recvControl(link, header);
+    if (ret != ICOM_SUCCESS) return ret;
+  }
+
+  _D("Header type: %u; flags: %u; bufSize: %u", header->type, header->flags, header->bufSize);
+
+  /* acknowledge immediately, the kernel falls back to delayed ACKs */
+  if (pdata->quickack) {
+    link_setOption(pdata->fdAccepted, SOL_TCP, TCP_QUICKACK, 1, "TCP_QUICKACK");
+  }
+  return ICOM_SUCCESS;
+}
+
+/* Grows (never shrinks) the input buffer, it must hold a pointer as well */
+static icomStatus_t link_growRecv(icomLink_t *link, uint32_t size) {
+  icomLinkSocket_t *pdata = link->pdata;
+  return icom_memGrowRecv(link, &pdata->recvAlloc, size, pdata->node, pdata->memFlags);
+}
+
+/* grows the buffer of compressed messages */
+static icomStatus_t link_growComp(icomLinkSocket_t *pdata, uint32_t size) {
+  void *mem;
+
+  if (size <= pdata->compAlloc) return ICOM_SUCCESS;
+  mem = realloc(pdata->compBuf, size);
+  if (!mem) {
+    _E("Failed to allocate memory");
+    return ICOM_ENOMEM;
+  }
+  pdata->compBuf   = mem;
+  pdata->compAlloc = size;
+  return ICOM_SUCCESS;
+}
+
+/* ranges of delta messages, allocated with the first one */
+static icomStatus_t link_allocRanges(icomLinkSocket_t *pdata) {
+  if (pdata->deltaRanges) return ICOM_SUCCESS;
+  pdata->deltaRanges = (icomDeltaRange_t*)malloc(LINK_DELTA_RANGES*sizeof(icomDeltaRange_t));
+  if (!pdata->deltaRanges) {
+    _E("Failed to allocate memory");
+    return ICOM_ENOMEM;
+  }
+  return ICOM_SUCCESS;
+}
+
+/* prepares the input buffer for the message announced by the header */
+static icomStatus_t link_setupRecv(icomLink_t *link, icomMsgHeader_t *header) {
+  icomLinkSocket_t *pdata = link->pdata;
+
+  /* Zero-copy messages carry an offset within the peer's region, every
+   * message updates the flags as the sender may fall back to copying */
+  link->flags       = header->flags;
+  link->recvId      = header->id;
+  link->recvChannel = header->channel;
+  link->recvBufSize = header->bufSize;
+  link->recvSize    = (header->flags & ICOM_FLAG_ZERO) ? sizeof(uint64_t) : header->bufSize;
+
+  /* compressed payloads are received aside and decompressed into the buffer */
+  if (header->flags & ICOM_FLAG_COMPRESS) {
+    return link_growComp(pdata, link->recvSize);
+  }
+  /* delta messages patch the frame in the buffer */
+  if (header->flags & ICOM_FLAG_DELTA) {
+    return link_allocRanges(pdata);
+  }
+  return link_growRecv(link, link->recvSize);
+}
+
+static icomStatus_t link_recvHeader(icomLink_t *link, void **buf, unsigned *bufSize) {
+  icomMsgHeader_t header;
+  icomStatus_t ret;
+
   _D("Receiving at link: %p", link);
 
+  ret = link_recvMsgHeader(link, &header);
+  if (ret != ICOM_SUCCESS) return ret;
+  return link_setupRecv(link, &header);
+}
+
+/* decompresses the received payload, i.e. the message size and the block */
+static icomStatus_t link_decompress(icomLink_t *link) {
+  icomLinkSocket_t *pdata = link->pdata;
+  uint32_t size;
+  icomStatus_t ret;
+
+  if (link->recvSize < sizeof(size)) {
+    _E("Invalid compressed message (%u bytes)", link->recvSize);
+    return ICOM_EFAULT;
+  }
+  memcpy(&size, pdata->compBuf, sizeof(size));
+  ret = link_growRecv(link, size);
+  if (ret != ICOM_SUCCESS) return ret;
+
+  if (icom_lzDecompress((uint8_t*)pdata->compBuf + sizeof(size), link->recvSize - sizeof(size),
+                        link->recvBuf, size) != size) {
+    _E("Invalid compressed message (%u bytes of %u bytes)", link->recvSize, size);
+    return ICOM_EFAULT;
+  }
+  link->recvBufSize = size;
+  return ICOM_SUCCESS;
+}
+
+/* receives exactly the bytes of the vector */
+static icomStatus_t link_recvIov(int fd, struct iovec *iov, unsigned count) {
+  struct msghdr msg = {0};
+  ssize_t ret;
+
+  msg.msg_iov    = iov;
+  msg.msg_iovlen = count;
+  while (msg.msg_iovlen > 0) {
+    ret = recvmsg(fd, &msg, 0);
+    if (ret <= 0) {
+      if ((ret == -1) && ((errno == EAGAIN) || (errno == EWOULDBLOCK))) {
+        _D("Timeout");
+        return ICOM_TIMEOUT;
+      }
+      _SE("Receive failed");
+      return ICOM_ERROR;
+    }
+
+    /* skip the filled entries, the partially filled one continues */
+    while (msg.msg_iovlen > 0 && (size_t)ret >= msg.msg_iov->iov_len) {
+      ret -= msg.msg_iov->iov_len;
+      msg.msg_iov++;
+      msg.msg_iovlen--;
+    }
+    if (msg.msg_iovlen > 0) {
+      msg.msg_iov->iov_base  = (uint8_t*)msg.msg_iov->iov_base + ret;
+      msg.msg_iov->iov_len  -= ret;
+    }
+  }
+  return ICOM_SUCCESS;
+}
+
+/* Patches the previous frame in the receive buffer, the changed ranges are
+ * received in place once their table is validated */
+static icomStatus_t link_recvDelta(icomLink_t *link, void **buf, unsigned *bufSize) {
+  icomLinkSocket_t *pdata = link->pdata;
+  struct iovec iov[LINK_DELTA_RANGES];
+  icomLinkDelta_t delta;
+  uint64_t size;
+  icomStatus_t ret;
+
+  if (pdata->server) {
+    _E("Server links do not accept delta messages (the frame is not per peer)");
+    return ICOM_EFAULT;
+  }
+  if (link->recvSize < sizeof(delta)) {
+    _E("Invalid delta message (%u bytes)", link->recvSize);
+    return ICOM_EFAULT;
+  }
+  ret = link_recvAll(pdata->fdAccepted, &delta, sizeof(delta));
+  if (ret != ICOM_SUCCESS) return ret;
+  if (delta.count > LINK_DELTA_RANGES || delta.frameSize != pdata->recvFrame
+  ||  (link->recvSize - sizeof(delta))/sizeof(icomDeltaRange_t) < delta.count) {
+    _E("Invalid delta message (%u ranges of a %u bytes frame, %u bytes held)",
+      delta.count, delta.frameSize, pdata->recvFrame);
+    return ICOM_EFAULT;
+  }
+  ret = link_recvAll(pdata->fdAccepted, pdata->deltaRanges, delta.count*sizeof(icomDeltaRange_t));
+  if (ret != ICOM_SUCCESS) return ret;
+
+  size = sizeof(delta) + delta.count*sizeof(icomDeltaRange_t);
+  for (unsigned i=0; i<delta.count; i++) {
+    icomDeltaRange_t *range = pdata->deltaRanges+i;
+    if (range->offset > delta.frameSize || range->length > delta.frameSize - range->offset) {
+      _E("Invalid delta range (%u bytes at %u)", range->length, range->offset);
+      return ICOM_EFAULT;
+    }
+    iov[i].iov_base = (uint8_t*)link->recvBuf + range->offset;
+    iov[i].iov_len  = range->length;
+    size += range->length;
+  }
+  if (size != link->recvSize) {
+    _E("Invalid delta message (%lu bytes of %u bytes)", size, link->recvSize);
+    return ICOM_EFAULT;
+  }
+
+  /* the frame is unknown until it is patched completely */
+  pdata->recvFrame = 0;
+  ret = link_recvIov(pdata->fdAccepted, iov, delta.count);
+  if (ret != ICOM_SUCCESS) return ret;
+  pdata->recvFrame  = delta.frameSize;
+  link->recvBufSize = delta.frameSize;
+
+  *buf     = link->recvBuf;
+  *bufSize = delta.frameSize;
+  return ICOM_SUCCESS;
+}
+
+static icomStatus_t link_recvData(icomLink_t *link, void **buf, unsigned *bufSize) {
+  int bytesReceived = 0;
+  int ret;
+
   /* Retreive private data structure */
   icomLinkSocket_t *pdata = link->pdata;
+  uint8_t *dst = (link->flags & ICOM_FLAG_COMPRESS) ? pdata->compBuf : link->recvBuf;
 
-  /* Receive header */
-  bytesReceived = 0;
-  do {
-    ret = recv(pdata->fdAccepted, (uint8_t*)&header+bytesReceived, sizeof(header)-bytesReceived, 0);
-    if (ret == -1) {
+  if (link->flags & ICOM_FLAG_DELTA) {
+    return link_recvDelta(link, buf, bufSize);
+  }
+  pdata->recvFrame = 0;
+
+  /* (zero-length messages must not reach recv, which would block on TCP) */
+  while (bytesReceived < link->recvSize) {
+    ret = recv(pdata->fdAccepted, dst+bytesReceived, link->recvSize-bytesReceived, 0);
+    if(ret == -1){
       if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
         _D("Timeout");
         return ICOM_TIMEOUT;
@@ -66,211 +528,1137 @@ static icomStatus_t link_recvHeader(icomLink_t *link, void **buf, unsigned *bufS
       _SE("Receive failed (header)");
       return ICOM_ERROR;
     }
+    if (ret == 0) {
+      _E("Connection closed within a message");
+      return ICOM_ERROR;
+    }
 
     bytesReceived += ret;
-  } while ((ret != -1) && (bytesReceived < sizeof(header)));
+  }
 
-  _D("Link @%p in header buffer @%p  received %u bytes", link, &header, ret);
-  _D("Header type: %u; flags: %u; bufSize: %u", header.type, header.flags, header.bufSize);
+  if (link->flags & ICOM_FLAG_COMPRESS) {
+    ret = link_decompress(link);
+    if (ret != ICOM_SUCCESS) return ret;
+    bytesReceived = link->recvBufSize;
+  }
 
-  /* Reallocate input buffer */
-  if (link->recvBufSize != header.bufSize) {
-    link->recvBufSize =  header.bufSize;
-    link->recvSize    =  (header.flags & ICOM_FLAG_ZERO) ? sizeof(void*) : header.bufSize;
-    link->recvBuf     =  (void*)realloc(link->recvBuf-sizeof(link), sizeof(link) + link->recvBufSize);
-    link->recvBuf     += sizeof(link);
-    link->flags       =  header.flags;
+  /* Translate the offset into the local mapping of the peer's region */
+  if (link->flags & ICOM_FLAG_ZERO) {
+    uint64_t offset = *(uint64_t*)link->recvBuf;
+    if (!pdata->shmPeer || offset > pdata->shmPeerSize
+    ||  link->recvBufSize > pdata->shmPeerSize - offset) {
+      _E("Invalid shared memory buffer (offset %lu, %u bytes)", offset, link->recvBufSize);
+      return ICOM_EFAULT;
+    }
+    *(void**)link->recvBuf = (uint8_t*)pdata->shmPeer + offset;
+
+    /* leased buffers are released with the next message unless the
+     * receiver releases them explicitly */
+    if ((link->flags & ICOM_FLAG_LEASE) && !(pdata->flags & ICOM_FLAG_LEASE)) {
+      pdata->leasePending = 1;
+      pdata->leaseOffset  = offset;
+    }
   }
+
+  /* Setup output arguments */
+  *buf     = (link->flags & ICOM_FLAG_ZERO) ? *(void**)link->recvBuf : link->recvBuf;
+  *bufSize = (link->flags & ICOM_FLAG_ZERO) ? link->recvBufSize      : bytesReceived;
+
+  /* Check if size of requested and sent data is equal */
+  if (!(link->flags & ICOM_FLAG_ZERO) && bytesReceived != link->recvBufSize) {
+    _W("Received partial data (%d bytes / %d bytes)", bytesReceived, link->recvBufSize);
+    return ICOM_PARTIAL;
+  }
+
+  /* delta messages patch copied frames */
+  if (!(link->flags & ICOM_FLAG_ZERO)) pdata->recvFrame = link->recvBufSize;
+
+  _D("Link @%p in buffer @%p  received %u bytes", link, link->recvBuf, *bufSize);
+
   return ICOM_SUCCESS;
 }
 
-static icomStatus_t link_recvData(icomLink_t *link, void **buf, unsigned *bufSize) {
-  int bytesReceived = 0;
+static icomStatus_t link_sendHeader(icomLink_t *link, void **buf, unsigned *bufSize) {
+  /* Retreive private data structure */
+  icomLinkSocket_t *pdata = link->pdata;
+
+  icomFlags_t flags = (link->flags & ~(ICOM_FLAG_ZERO | ICOM_FLAG_CONTROL | ICOM_FLAG_LEASE | ICOM_FLAG_STRIPE | ICOM_FLAG_COMPRESS | ICOM_FLAG_DELTA))
+                    | (pdata->sendZero     ? ICOM_FLAG_ZERO     : 0)
+                    | (pdata->sendLease    ? ICOM_FLAG_LEASE    : 0)
+                    | (pdata->sendCompress ? ICOM_FLAG_COMPRESS : 0)
+                    | (pdata->sendDelta    ? ICOM_FLAG_DELTA    : 0);
+  icomMsgHeader_t header = (icomMsgHeader_t){link->type, flags, *bufSize, pdata->sendId, pdata->sendChannel};
+
+  if (send(pdata->fdAccepted, &header, sizeof(header), 0) == -1) {
+    if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+      _D("Send timeout");
+      return ICOM_TIMEOUT;
+    }
+    _SE("Send failed (header)");
+    return ICOM_ERROR;
+  }
+
+  return ICOM_SUCCESS;
+}
+
+static icomStatus_t link_sendData(icomLink_t *link, void **buf, unsigned *bufSize){
   int ret;
+  unsigned sendSize;
+
+  /* Retreive private data structure */
+  icomLinkSocket_t *pdata = link->pdata;
+
+  _D("Sending data from %p (%u bytes)", *buf, *bufSize);
+
+  /* Send data (offset within the shared region when zero-copying) */
+  if (pdata->sendZero) {
+    uint64_t offset = (uint8_t*)*buf - link->shm->base;
+    ret = send(pdata->fdAccepted, &offset, sizeof(offset), 0);
+    sendSize = sizeof(offset);
+  } else {
+    ret = send(pdata->fdAccepted, *buf, *bufSize, 0);
+    sendSize = *bufSize;
+  }
+  if (ret == -1) {
+    if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+      _D("Send timeout");
+      return ICOM_TIMEOUT;
+    }
+
+    _SE("Send failed (data)");
+    return ICOM_ERROR;
+  }
+
+  /* Check if size of requested and sent data is equal */
+  if (ret != sendSize) {
+    return ICOM_PARTIAL;
+  }
+
+  return ICOM_SUCCESS;
+}
 
+static icomStatus_t link_connect(icomLink_t *link, void **buf, unsigned *bufSize){
   /* Retreive private data structure */
   icomLinkSocket_t *pdata = link->pdata;
 
+  _D();
+
+  /* server links reply to the peer of the last received message */
+  if (!pdata->fdAccepted && pdata->server) {
+    _E("No peer to send to, nothing was received yet");
+    return ICOM_ERROR;
+  }
+
+  /* Connect to the */
+  if (!pdata->fdAccepted) {
+    if (connect(pdata->fd, (struct sockaddr*)&pdata->sockaddr, sizeof(struct sockaddr_in)) == -1) {
+      _SE("Failed to connect socket");
+      if (errno == ECONNREFUSED) {
+        return ICOM_ECONNREFUSED;
+      } else {
+        return ICOM_ERROR;
+      }
+    }
+    pdata->fdAccepted = pdata->fd;
+  }
+
+  return ICOM_SUCCESS;
+}
+
+static icomStatus_t link_sendAck(icomLink_t *link, void **buf, unsigned *bufSize){
+  int ack = 1;
+
+  /* Retreive private data structure */
+  icomLinkSocket_t *pdata = link->pdata;
+
+  if (send(pdata->fdAccepted, &ack, sizeof(ack), 0) == -1) {
+    if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+      _D("Send timeout");
+      return ICOM_TIMEOUT;
+    }
+    _SE("Send failed (ack)");
+    return ICOM_ERROR;
+  }
+
+  return ICOM_SUCCESS;
+}
+
+static icomStatus_t link_recvAck(icomLink_t *link, void **buf, unsigned *bufSize) {
+  int ack;
+  int bytesReceived;
+  int ret;
+
+  _D("Receiving at link: %p", link);
+
+  /* Retreive private data structure */
+  icomLinkSocket_t *pdata = link->pdata;
+
+  ret = link_spin(link);
+  if (ret != ICOM_SUCCESS) return ret;
+
+  /* Receive */
+  bytesReceived = 0;
   do {
-    ret = recv(pdata->fdAccepted, (uint8_t*)(link->recvBuf)+bytesReceived, link->recvSize-bytesReceived, 0);
-    if(ret == -1){
+    ret = recv(pdata->fdAccepted, (uint8_t*)&ack+bytesReceived, sizeof(ack)-bytesReceived, 0);
+    if (ret == -1) {
       if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
         _D("Timeout");
         return ICOM_TIMEOUT;
       }
+      _SE("Receive failed (ack)");
+      return ICOM_ERROR;
+    }
+    if (ret == 0) {
+      _E("Connection closed before the acknowledgement");
+      return ICOM_ERROR;
+    }
+    bytesReceived += ret;
+  } while ((ret != -1) && (bytesReceived < sizeof(ack)));
+
+  if (ack != 1) {
+    return ICOM_ERROR;
+  }
+  return ICOM_SUCCESS;
+}
+
+static uint64_t link_nowNs(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec*1000000000ull + ts.tv_nsec;
+}
+
+/* Adaptive compression: suspends it after a few messages in a row which did
+ * not pay off, a single failed attempt after the back-off suspends it again
+ * for twice as long */
+static void link_compressAdapt(icomLinkSocket_t *pdata, int pays) {
+  if (pays) {
+    pdata->compMisses  = 0;
+    pdata->compBackoff = LINK_COMPRESS_BACKOFF;
+  } else if (++pdata->compMisses >= LINK_COMPRESS_MISSES) {
+    pdata->compSkip    = pdata->compBackoff;
+    pdata->compMisses  = LINK_COMPRESS_MISSES - 1;
+    pdata->compBackoff = (pdata->compBackoff*2 < LINK_COMPRESS_BACKOFF_MAX)
+                       ? pdata->compBackoff*2 : LINK_COMPRESS_BACKOFF_MAX;
+  }
+}
+
+/* Compression pays off if compressed messages are sent faster (per message
+ * byte, compression included) than uncompressed ones, i.e. it follows the
+ * bottleneck, the link or the compression */
+static void link_compressTime(icomLinkSocket_t *pdata, uint64_t ns, uint32_t size) {
+  uint64_t ps = ns*1000 / (size ? size : 1);
+
+  if (pdata->sendCompress) {
+    pdata->packedPs = pdata->packedPs ? (3*pdata->packedPs + ps)/4 : ps;
+    pdata->compProbe++;
+    link_compressAdapt(pdata, pdata->packedPs <= pdata->plainPs);
+  } else {
+    pdata->plainPs = pdata->plainPs ? (3*pdata->plainPs + ps)/4 : ps;
+  }
+}
+
+/* Compresses the message into the link's buffer (the message size followed
+ * by the block) if it shrinks by an eighth at least. Adaptive links send
+ * messages as is while compression is suspended, as well as the first one
+ * and every LINK_COMPRESS_PROBE-th one to follow the uncompressed send time. */
+static void link_compress(icomLink_t *link, void **buf, unsigned *bufSize) {
+  icomLinkSocket_t *pdata = link->pdata;
+  uint32_t capacity, size;
+
+  pdata->sendCompress = 0;
+  if (!(pdata->flags & ICOM_FLAG_COMPRESS) || pdata->sendZero || pdata->sendDelta
+  ||  *bufSize < pdata->compMin) return;
+  link->compressStats.messages++;
+  if (pdata->compAdaptive
+  && (pdata->compSkip || !pdata->plainPs || pdata->compProbe >= LINK_COMPRESS_PROBE)) {
+    if (pdata->compSkip) pdata->compSkip--;
+    pdata->compProbe = 0;
+    link->compressStats.skipped++;
+    return;
+  }
+
+  capacity = *bufSize - *bufSize/8;
+  if (capacity <= sizeof(uint32_t) || link_growComp(pdata, capacity) != ICOM_SUCCESS) return;
+  size = icom_lzCompress(*buf, *bufSize, (uint8_t*)pdata->compBuf + sizeof(uint32_t),
+                         capacity - sizeof(uint32_t));
+  if (!size) {
+    if (pdata->compAdaptive) link_compressAdapt(pdata, 0);
+    return;
+  }
+
+  link->compressStats.compressed++;
+  link->compressStats.bytesIn  += *bufSize;
+  link->compressStats.bytesOut += size + sizeof(uint32_t);
+  memcpy(pdata->compBuf, bufSize, sizeof(uint32_t));
+  *buf     = pdata->compBuf;
+  *bufSize = size + sizeof(uint32_t);
+  pdata->sendCompress = 1;
+}
+
+/* Finds the ranges of the message which changed since the previous one (the
+ * peer's copy), the message is sent as a delta unless they exceed half of it */
+static void link_delta(icomLink_t *link, const void *buf, unsigned bufSize, unsigned *wireSize) {
+  icomLinkSocket_t *pdata = link->pdata;
+  uint64_t size;
+  int count;
+
+  pdata->sendDelta = 0;
+  if (!(pdata->flags & ICOM_FLAG_DELTA) || !bufSize) return;
+  link->deltaStats.frames++;
+  if (bufSize != pdata->deltaSize || link_allocRanges(pdata) != ICOM_SUCCESS) return;
+
+  count = icom_deltaScan(pdata->deltaBuf, buf, bufSize, LINK_DELTA_GAP,
+                         pdata->deltaRanges, LINK_DELTA_RANGES);
+  if (count < 0) return;
+  size = sizeof(icomLinkDelta_t) + count*sizeof(icomDeltaRange_t);
+  for (int i=0; i<count; i++) {
+    size += pdata->deltaRanges[i].length;
+  }
+  if (size > bufSize/2) return;
+
+  link->deltaStats.deltas++;
+  link->deltaStats.bytesIn  += bufSize;
+  link->deltaStats.bytesOut += size;
+  pdata->deltaCount = count;
+  pdata->sendDelta  = 1;
+  *wireSize         = size;
+}
+
+/* sends the delta header, the ranges and their bytes straight from the message */
+static icomStatus_t link_sendDelta(icomLink_t *link, const void *buf, unsigned bufSize, unsigned wireSize) {
+  icomLinkSocket_t *pdata = link->pdata;
+  struct iovec iov[LINK_DELTA_RANGES+2];
+  icomLinkDelta_t delta = {bufSize, pdata->deltaCount};
+  struct msghdr msg = {0};
+  ssize_t ret;
+
+  iov[0].iov_base = &delta;
+  iov[0].iov_len  = sizeof(delta);
+  iov[1].iov_base = pdata->deltaRanges;
+  iov[1].iov_len  = pdata->deltaCount*sizeof(icomDeltaRange_t);
+  for (unsigned i=0; i<pdata->deltaCount; i++) {
+    iov[i+2].iov_base = (uint8_t*)buf + pdata->deltaRanges[i].offset;
+    iov[i+2].iov_len  = pdata->deltaRanges[i].length;
+  }
+  msg.msg_iov    = iov;
+  msg.msg_iovlen = pdata->deltaCount + 2;
+
+  ret = sendmsg(pdata->fdAccepted, &msg, 0);
+  if (ret == -1) {
+    if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+      _D("Send timeout");
+      return ICOM_TIMEOUT;
+    }
+    _SE("Send failed (delta)");
+    return ICOM_ERROR;
+  }
+  if (ret != wireSize) {
+    return ICOM_PARTIAL;
+  }
+  return ICOM_SUCCESS;
+}
+
+/* updates the copy of the peer's frame, i.e. only the changed ranges of deltas */
+static void link_keepFrame(icomLinkSocket_t *pdata, const void *buf, unsigned bufSize) {
+  if (pdata->sendDelta) {
+    for (unsigned i=0; i<pdata->deltaCount; i++) {
+      icomDeltaRange_t *range = pdata->deltaRanges+i;
+      memcpy((uint8_t*)pdata->deltaBuf + range->offset, (const uint8_t*)buf + range->offset, range->length);
+    }
+    return;
+  }
+
+  pdata->deltaSize = 0;
+  if (bufSize > pdata->deltaAlloc) {
+    void *mem = realloc(pdata->deltaBuf, bufSize);
+    if (!mem) {
+      _W("Failed to allocate memory, the next message is sent whole");
+      return;
+    }
+    pdata->deltaBuf   = mem;
+    pdata->deltaAlloc = bufSize;
+  }
+  memcpy(pdata->deltaBuf, buf, bufSize);
+  pdata->deltaSize = bufSize;
+}
+
+static icomStatus_t link_sendHandler(icomLink_t *link, void *buf, unsigned bufSize){
+  icomLinkSocket_t *pdata = link->pdata;
+  void *wireBuf;
+  unsigned wireSize;
+  uint64_t start = 0;
+  icomStatus_t ret;
+  ret = link_connect(link, &buf, &bufSize);
+  if (ret != ICOM_SUCCESS) return ret;
+  if (link->shm && pdata->shmState == LINK_SHM_NONE) {
+    ret = link_shareRegion(link);
+    if (ret != ICOM_SUCCESS) return ret;
+  }
+  pdata->sendZero = (pdata->shmState == LINK_SHM_SHARED)
+                 && icom_shmContains(link->shm, buf, bufSize);
+
+  /* the link holds a reference of a leased buffer until the peer releases it */
+  pdata->sendLease = pdata->sendZero && icom_shmIsLeased(link->shm, buf);
+  if (pdata->sendLease) icom_shmRef(link->shm, buf);
+
+  /* adaptive compression times whole sends (failed compressions excluded),
+   * deltas are not compressed */
+  wireBuf  = buf;
+  wireSize = bufSize;
+  link_delta(link, buf, bufSize, &wireSize);
+  if (pdata->compAdaptive && !pdata->sendZero && !pdata->sendDelta && bufSize >= pdata->compMin) {
+    start = link_nowNs();
+  }
+  link_compress(link, &wireBuf, &wireSize);
+  if (start && !pdata->sendCompress) start = link_nowNs();
+
+  ret = link_sendHeader(link, &wireBuf, &wireSize);
+  if (ret == ICOM_SUCCESS) {
+    ret = pdata->sendDelta ? link_sendDelta(link, buf, bufSize, wireSize)
+                           : link_sendData(link, &wireBuf, &wireSize);
+  }
+  if (ret != ICOM_SUCCESS) {
+    if (pdata->sendLease) icom_shmUnref(link->shm, buf);
+    pdata->deltaSize = 0;
+    return ret;
+  }
+
+  if (start) link_compressTime(pdata, link_nowNs() - start, bufSize);
+  if (pdata->flags & ICOM_FLAG_DELTA) link_keepFrame(pdata, buf, bufSize);
+  ret = link->autoRecvAck(link, buf, &bufSize);
+  if (ret != ICOM_SUCCESS) return ret;
+  return ICOM_SUCCESS;
+}
+
+/* Server links (server option) accept any number of senders on the listening
+ * socket and multiplex them with epoll. The state of the peer being served is
+ * swapped into the private data, so the rest of the link is unaware of it. */
+static void link_peerSwitch(icomLinkSocket_t *pdata, icomLinkPeer_t *peer) {
+  icomLinkPeer_t *current = pdata->peer;
+
+  if (current == peer) return;
+  if (current) {
+    current->shmState     = pdata->shmState;
+    current->leasePending = pdata->leasePending;
+    current->leaseOffset  = pdata->leaseOffset;
+    current->shmPeer      = pdata->shmPeer;
+    current->shmPeerSize  = pdata->shmPeerSize;
+  }
+  pdata->peer         = peer;
+  pdata->fdAccepted   = peer ? peer->fd           : 0;
+  pdata->shmState     = peer ? peer->shmState     : LINK_SHM_NONE;
+  pdata->leasePending = peer ? peer->leasePending : 0;
+  pdata->leaseOffset  = peer ? peer->leaseOffset  : 0;
+  pdata->shmPeer      = peer ? peer->shmPeer      : NULL;
+  pdata->shmPeerSize  = peer ? peer->shmPeerSize  : 0;
+}
+
+/* peers are level triggered (one message per round), edge triggered while
+ * their header is incomplete */
+static icomStatus_t link_peerWatch(icomLinkSocket_t *pdata, icomLinkPeer_t *peer, int partial) {
+  struct epoll_event event;
+
+  event.events   = EPOLLIN | EPOLLRDHUP | (partial ? EPOLLET : 0);
+  event.data.ptr = peer;
+  if (epoll_ctl(pdata->epfd, EPOLL_CTL_MOD, peer->fd, &event) == -1) {
+    _SE("Failed to modify peer");
+    return ICOM_ERROR;
+  }
+  peer->partial = partial;
+  return ICOM_SUCCESS;
+}
+
+static icomStatus_t link_peerAccept(icomLink_t *link) {
+  icomLinkSocket_t *pdata = link->pdata;
+  struct epoll_event event;
+  icomLinkPeer_t *peer, **peers;
+  int fd;
+
+  /* the listening socket is non-blocking, the peer may be gone already */
+  fd = accept4(pdata->fd, NULL, NULL, SOCK_CLOEXEC);
+  if (fd == -1) {
+    if ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == ECONNABORTED)) {
+      return ICOM_SUCCESS;
+    }
+    _SE("Failed to accept socket");
+    return ICOM_ERROR;
+  }
+
+  if (pdata->peerCount == pdata->peerAlloc) {
+    unsigned alloc = pdata->peerAlloc ? 2*pdata->peerAlloc : 8;
+    peers = (icomLinkPeer_t**)realloc(pdata->peers, alloc*sizeof(*peers));
+    if (!peers) {
+      _E("Failed to allocate memory");
+      goto failure_alloc;
+    }
+    pdata->peers     = peers;
+    pdata->peerAlloc = alloc;
+  }
+
+  peer = (icomLinkPeer_t*)malloc(sizeof(icomLinkPeer_t));
+  if (!peer) {
+    _E("Failed to allocate memory");
+    goto failure_alloc;
+  }
+  memset(peer, 0, sizeof(*peer));
+  peer->fd       = fd;
+  peer->id       = pdata->peerNext++;
+  peer->shmState = LINK_SHM_NONE;
+
+  event.events   = EPOLLIN | EPOLLRDHUP;
+  event.data.ptr = peer;
+  if (epoll_ctl(pdata->epfd, EPOLL_CTL_ADD, fd, &event) == -1) {
+    _SE("Failed to register peer");
+    goto failure_epoll;
+  }
+  pdata->peers[pdata->peerCount++] = peer;
+
+  _D("Peer %u connected", peer->id);
+  return ICOM_SUCCESS;
+
+
+failure_epoll:
+  free(peer);
+failure_alloc:
+  close(fd);
+  return ICOM_ENOMEM;
+}
+
+static void link_peerClose(icomLink_t *link, icomLinkPeer_t *peer) {
+  icomLinkSocket_t *pdata = link->pdata;
+
+  _D("Peer %u disconnected", peer->id);
+  if (pdata->peer == peer) {
+    link_peerSwitch(pdata, NULL);
+  }
+
+  epoll_ctl(pdata->epfd, EPOLL_CTL_DEL, peer->fd, NULL);
+  shutdown(peer->fd, SHUT_RDWR);
+  close(peer->fd);
+  if (peer->shmPeer) {
+    icom_shmUnmap(peer->shmPeer, peer->shmPeerSize);
+  }
+
+  /* events collected by the same epoll_wait must not reach the peer */
+  for (int i=pdata->eventIndex; i<pdata->eventCount; i++) {
+    if (pdata->events[i].data.ptr == peer) {
+      pdata->events[i].data.ptr = NULL;
+    }
+  }
+  for (unsigned i=0; i<pdata->peerCount; i++) {
+    if (pdata->peers[i] == peer) {
+      pdata->peers[i] = pdata->peers[--pdata->peerCount];
+      break;
+    }
+  }
+  free(peer);
+}
+
+/* collects readiness events, spins with non-blocking waits first (spin flag) */
+static icomStatus_t link_serverPoll(icomLink_t *link) {
+  icomLinkSocket_t *pdata = link->pdata;
+  struct timespec ts;
+  uint64_t now, deadline;
+  int n;
+
+  pdata->eventIndex = pdata->eventCount = 0;
+
+  if (pdata->spinNs) {
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    now      = (uint64_t)ts.tv_sec*1000000000ull + ts.tv_nsec;
+    deadline = now + pdata->spinNs;
+    do {
+      link->spinStats.spins++;
+      n = epoll_wait(pdata->epfd, pdata->events, LINK_SERVER_EVENTS, 0);
+      if (n > 0) {
+        link->spinStats.hits++;
+        pdata->eventCount = n;
+        return ICOM_SUCCESS;
+      }
+      if (n == -1 && errno != EINTR) {
+        _SE("Failed to wait for peers");
+        return ICOM_ERROR;
+      }
+      clock_gettime(CLOCK_MONOTONIC, &ts);
+      now = (uint64_t)ts.tv_sec*1000000000ull + ts.tv_nsec;
+    } while (now < deadline);
+    link->spinStats.fallbacks++;
+  }
+
+  do {
+    n = epoll_wait(pdata->epfd, pdata->events, LINK_SERVER_EVENTS,
+                   pdata->timeoutUs ? (pdata->timeoutUs+999)/1000 : -1);
+  } while (n == -1 && errno == EINTR);
+  if (n == -1) {
+    _SE("Failed to wait for peers");
+    return ICOM_ERROR;
+  }
+  if (n == 0) {
+    _D("Timeout");
+    return ICOM_TIMEOUT;
+  }
+  if (pdata->spinNs) {
+    link->spinStats.wakeups++;
+  }
+  pdata->eventCount = n;
+  return ICOM_SUCCESS;
+}
+
+/* Switches to the next peer with a message. Peers are served one message
+ * per epoll_wait round (fairness), connections, disconnections and control
+ * messages (which may arrive without any data) are handled on the way. */
+static icomStatus_t link_serverWait(icomLink_t *link) {
+  icomLinkSocket_t *pdata = link->pdata;
+  icomMsgHeader_t header;
+  icomLinkPeer_t *peer;
+  uint32_t events;
+  icomStatus_t ret;
+  int n;
+
+  while (1) {
+    if (pdata->eventIndex == pdata->eventCount) {
+      ret = link_serverPoll(link);
+      if (ret != ICOM_SUCCESS) return ret;
+    }
+
+    events = pdata->events[pdata->eventIndex].events;
+    peer   = pdata->events[pdata->eventIndex++].data.ptr;
+    if ((void*)peer == (void*)pdata) {
+      ret = link_peerAccept(link);
+      if (ret != ICOM_SUCCESS) return ret;
+      continue;
+    }
+    if (!peer) {
+      continue;
+    }
+
+    n = recv(peer->fd, &header, sizeof(header), MSG_PEEK | MSG_DONTWAIT);
+    if (n == -1 && ((errno == EAGAIN) || (errno == EWOULDBLOCK))) {
+      continue;
+    }
+    if (n <= 0) {
+      link_peerClose(link, peer);
+      continue;
+    }
+
+    /* a partial header would block the server on this peer, it is served
+     * once the header is complete (or closed if it never will be), until
+     * then it is only reported when more data arrives */
+    if (n < (int)sizeof(header)) {
+      if (events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+        link_peerClose(link, peer);
+      } else if (!peer->partial && link_peerWatch(pdata, peer, 1) != ICOM_SUCCESS) {
+        link_peerClose(link, peer);
+      }
+      continue;
+    }
+    if (peer->partial && link_peerWatch(pdata, peer, 0) != ICOM_SUCCESS) {
+      link_peerClose(link, peer);
+      continue;
+    }
 
-      _SE("Receive failed (header)");
-      return ICOM_ERROR;
+    link_peerSwitch(pdata, peer);
+    if (header.flags & ICOM_FLAG_CONTROL) {
+      ret = link_recvAll(peer->fd, &header, sizeof(header));
+      if (ret == ICOM_SUCCESS) ret = link_recvControl(link, &header);
+      if (ret != ICOM_SUCCESS) link_peerClose(link, peer);
+      continue;
     }
 
-    bytesReceived += ret;
-  } while ((ret != -1) && (bytesReceived < link->recvSize));
+    link->recvPeer = peer->id;
+    return ICOM_SUCCESS;
+  }
+}
 
-  /* Setup output arguments */
-  *buf     = (link->flags & ICOM_FLAG_ZERO) ? *(void**)link->recvBuf : link->recvBuf;
-  *bufSize = (link->flags & ICOM_FLAG_ZERO) ? link->recvBufSize      : bytesReceived;
+/* everything the server owes the last served peer, then the next peer */
+static icomStatus_t link_serverBegin(icomLink_t *link, void **buf, unsigned *bufSize){
+  icomLinkSocket_t *pdata = link->pdata;
+  icomStatus_t ret = ICOM_SUCCESS;
 
-  /* Check if size of requested and sent data is equal */
-  if (!(link->flags & ICOM_FLAG_ZERO) && bytesReceived != link->recvBufSize) {
-    _W("Received partial data (%d bytes / %d bytes)", bytesReceived, link->recvBufSize);
-    return ICOM_PARTIAL;
+  if (pdata->peer) {
+    ret = link->autoSendAck(link, buf, bufSize);
+    if (ret == ICOM_SUCCESS && pdata->leasePending) {
+      pdata->leasePending = 0;
+      ret = link_sendRelease(link, pdata->leaseOffset);
+    }
+    if (ret == ICOM_TIMEOUT) return ret;
+    if (ret != ICOM_SUCCESS) link_peerClose(link, pdata->peer);
   }
+  return link_serverWait(link);
+}
 
-  _D("Link @%p in buffer @%p  received %u bytes", link, link->recvBuf, *bufSize);
+static icomStatus_t link_initServer(icomLinkSocket_t *pdata) {
+  struct epoll_event event;
+  int flags;
+
+  pdata->epfd = epoll_create1(EPOLL_CLOEXEC);
+  if (pdata->epfd == -1) {
+    _SE("Failed to create epoll instance");
+    return ICOM_ERROR;
+  }
 
+  /* the listening socket is marked by the private data */
+  event.events   = EPOLLIN;
+  event.data.ptr = pdata;
+  flags = fcntl(pdata->fd, F_GETFL);
+  if (flags == -1 || fcntl(pdata->fd, F_SETFL, flags | O_NONBLOCK) == -1
+  ||  epoll_ctl(pdata->epfd, EPOLL_CTL_ADD, pdata->fd, &event) == -1) {
+    _SE("Failed to register listening socket");
+    close(pdata->epfd);
+    pdata->epfd = -1;
+    return ICOM_ERROR;
+  }
   return ICOM_SUCCESS;
 }
 
-static icomStatus_t link_sendHeader(icomLink_t *link, void **buf, unsigned *bufSize) {
-  icomMsgHeader_t header = (icomMsgHeader_t){link->type, link->flags, *bufSize};
+/* Steers connections of the port's receivers by the core which received them,
+ * i.e., the n-th bound socket of the group gets connections of the core n
+ * (the kernel falls back to hashing for cores beyond the group size). */
+static void link_attachSteering(icomLinkSocket_t *pdata) {
+  struct sock_filter code[] = {
+    { BPF_LD  | BPF_W | BPF_ABS, 0, 0, SKF_AD_OFF + SKF_AD_CPU },
+    { BPF_RET | BPF_A,           0, 0, 0 },
+  };
+  struct sock_fprog prog = { sizeof(code)/sizeof(*code), code };
 
-  /* Retreive private data structure */
+  if (setsockopt(pdata->fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog)) == -1) {
+    _SW("Failed to attach connection steering program, connections are hashed");
+  }
+}
+
+static void link_deinitServer(icomLink_t *link) {
   icomLinkSocket_t *pdata = link->pdata;
 
-  if (send(pdata->fdAccepted, &header, sizeof(header), 0) == -1) {
-    if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
-      _D("Send timeout");
-      return ICOM_TIMEOUT;
-    }
-    _SE("Send failed (header)");
-    return ICOM_ERROR;
+  while (pdata->peerCount) {
+    link_peerClose(link, pdata->peers[pdata->peerCount-1]);
   }
+  free(pdata->peers);
+  close(pdata->epfd);
+}
 
+/* everything the receiver owes the peer before the next message */
+static icomStatus_t link_recvBegin(icomLink_t *link, void **buf, unsigned *bufSize){
+  icomStatus_t ret;
+  icomLinkSocket_t *pdata = link->pdata;
+  if (pdata->server) return link_serverBegin(link, buf, bufSize);
+  ret = link_accept(link, buf, bufSize);
+  if (ret != ICOM_SUCCESS) return ret;
+  ret = link->autoSendAck(link, buf, bufSize);
+  if (ret != ICOM_SUCCESS) return ret;
+  if (pdata->leasePending) {
+    pdata->leasePending = 0;
+    ret = link_sendRelease(link, pdata->leaseOffset);
+    if (ret != ICOM_SUCCESS) return ret;
+  }
   return ICOM_SUCCESS;
 }
 
-static icomStatus_t link_sendData(icomLink_t *link, void **buf, unsigned *bufSize){
-  int ret;
-  unsigned sendSize;
-
-  /* Retreive private data structure */
+static icomStatus_t link_recvHandler(icomLink_t *link, void **buf, unsigned *bufSize){
   icomLinkSocket_t *pdata = link->pdata;
+  icomStatus_t ret;
+  ret = link_recvBegin(link, buf, bufSize);
+  if (ret != ICOM_SUCCESS) return ret;
+  ret = link_recvHeader(link, buf, bufSize);
+  if (ret == ICOM_SUCCESS) ret = link_recvData(link, buf, bufSize);
 
-  _D("Sending data from %p (%u bytes)", *buf, *bufSize);
-
-  /* Send data */
-  if (link->flags & ICOM_FLAG_ZERO) {
-    ret = send(pdata->fdAccepted, buf, sizeof(void *), 0);
-    sendSize = sizeof(void *);
-  } else {
-    ret = send(pdata->fdAccepted, *buf, *bufSize, 0);
-    sendSize = *bufSize;
+  /* a broken peer must not stop the server from serving the others */
+  if (ret == ICOM_ERROR && pdata->server && pdata->peer) {
+    link_peerClose(link, pdata->peer);
   }
-  if (ret == -1) {
-    if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
-      _D("Send timeout");
-      return ICOM_TIMEOUT;
-    }
+  return ret;
+}
 
-    _SE("Send failed (data)");
+/* Striped messages (stripe option) are split into consecutive chunks, one per
+ * link. All the chunk headers are sent first, then the chunks are transferred
+ * by non-blocking calls on whichever connection is ready, so the connections
+ * (their windows and the kernel's per-flow processing) progress at once
+ * rather than one after another. The receiver learns the chunk sizes from the
+ * headers and receives the chunks in place into a single buffer. */
+static uint32_t link_stripeChunk(uint32_t bufSize, unsigned count) {
+  uint64_t chunk = ((uint64_t)bufSize + count - 1) / count;
+
+  /* page multiples keep the chunks of the receive buffer page aligned */
+  chunk = (chunk + 4095) & ~4095ull;
+  return (chunk < LINK_STRIPE_MIN) ? LINK_STRIPE_MIN : (uint32_t)chunk;
+}
+
+/* waits for any of the unfinished chunks (fd '-1' - finished) */
+static icomStatus_t link_stripeWait(struct pollfd *pfds, unsigned count, uint64_t timeoutUs) {
+  int ret;
+
+  do {
+    ret = poll(pfds, count, timeoutUs ? (timeoutUs+999)/1000 : -1);
+  } while (ret == -1 && errno == EINTR);
+  if (ret == -1) {
+    _SE("Failed to poll sockets");
     return ICOM_ERROR;
   }
+  if (ret == 0) {
+    _D("Timeout");
+    return ICOM_TIMEOUT;
+  }
+  return ICOM_SUCCESS;
+}
 
-  /* Check if size of requested and sent data is equal */
-  if (ret != sendSize) {
-    return ICOM_PARTIAL;
+icomStatus_t icom_sendSocketStripe(icomLink_t *links, unsigned count, void *buf, unsigned bufSize) {
+  icomLinkSocket_t *pdata;
+  struct pollfd pfds[count];
+  uint32_t offset[count], left[count];
+  uint32_t chunk = link_stripeChunk(bufSize, count);
+  unsigned pending = 0;
+  icomStatus_t ret;
+  ssize_t n;
+
+  for (unsigned i=0; i<count; i++) {
+    pdata = links[i].pdata;
+    ret = link_connect(links+i, &buf, &bufSize);
+    if (ret != ICOM_SUCCESS) return ret;
+
+    offset[i] = ((uint64_t)i*chunk < bufSize) ? i*chunk : bufSize;
+    left[i]   = (bufSize - offset[i] < chunk) ? bufSize - offset[i] : chunk;
+
+    /* every link carries a (possibly empty) chunk, marked by the stripe flag only */
+    icomMsgHeader_t header = {links[i].type, ICOM_FLAG_STRIPE, left[i], 0, 0};
+    ret = link_sendAll(pdata->fdAccepted, &header, sizeof(header));
+    if (ret != ICOM_SUCCESS) return ret;
+
+    pfds[i] = (struct pollfd){left[i] ? pdata->fdAccepted : -1, POLLOUT, 0};
+    pending += (left[i] != 0);
   }
 
+  while (pending) {
+    for (unsigned i=0; i<count; i++) {
+      while (left[i]) {
+        n = send(pfds[i].fd, (uint8_t*)buf + offset[i], left[i], MSG_DONTWAIT);
+        if (n == -1) {
+          if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+          if (errno == EINTR) continue;
+          _SE("Send failed (stripe)");
+          return ICOM_ERROR;
+        }
+        offset[i] += n;
+        left[i]   -= n;
+      }
+      if (!left[i] && pfds[i].fd != -1) {
+        pfds[i].fd = -1;
+        pending--;
+      }
+    }
+    if (pending) {
+      ret = link_stripeWait(pfds, count, ((icomLinkSocket_t*)links->pdata)->timeoutUs);
+      if (ret != ICOM_SUCCESS) return ret;
+    }
+  }
   return ICOM_SUCCESS;
 }
 
-static icomStatus_t link_connect(icomLink_t *link, void **buf, unsigned *bufSize){
-  /* Retreive private data structure */
-  icomLinkSocket_t *pdata = link->pdata;
+icomStatus_t icom_recvSocketStripe(icomLink_t *links, unsigned count, void **buf, unsigned *bufSize) {
+  icomMsgHeader_t header;
+  struct pollfd pfds[count];
+  uint32_t offset[count], left[count];
+  uint64_t total = 0;
+  unsigned pending = 0;
+  icomStatus_t ret;
+  ssize_t n;
+
+  for (unsigned i=0; i<count; i++) {
+    ret = link_recvBegin(links+i, buf, bufSize);
+    if (ret != ICOM_SUCCESS) return ret;
+    ret = link_recvMsgHeader(links+i, &header);
+    if (ret != ICOM_SUCCESS) return ret;
+    /* chunks are plain copies, other flags would size the buffer otherwise */
+    if (header.flags != ICOM_FLAG_STRIPE) {
+      _E("Received a message which is not striped (link %u, flags 0x%x)", i, header.flags);
+      return ICOM_ERROR;
+    }
+    if (i == 0) {
+      links->flags       = header.flags;
+      links->recvId      = header.id;
+      links->recvChannel = header.channel;
+    }
 
-  _D();
+    offset[i] = total;
+    left[i]   = header.bufSize;
+    total    += header.bufSize;
+    if (total > UINT32_MAX) {
+      _E("Striped message exceeds %u bytes", UINT32_MAX);
+      return ICOM_EMSGSIZE;
+    }
+    pfds[i] = (struct pollfd){left[i] ? ((icomLinkSocket_t*)links[i].pdata)->fdAccepted : -1, POLLIN, 0};
+    pending += (left[i] != 0);
+    links[i].recvSize    = 0;
+    links[i].recvBufSize = 0;
+  }
 
-  /* Connect to the */
-  if (!pdata->fdAccepted) {
-    if (connect(pdata->fd, (struct sockaddr*)&pdata->sockaddr, sizeof(struct sockaddr_in)) == -1) {
-      _SE("Failed to connect socket");
-      if (errno == ECONNREFUSED) {
-        return ICOM_ECONNREFUSED;
-      } else {
-        return ICOM_ERROR;
+  /* the whole message is received into the first link's buffer */
+  ret = link_growRecv(links, (uint32_t)total);
+  if (ret != ICOM_SUCCESS) return ret;
+  links->recvSize    = (uint32_t)total;
+  links->recvBufSize = (uint32_t)total;
+
+  while (pending) {
+    for (unsigned i=0; i<count; i++) {
+      while (left[i]) {
+        n = recv(pfds[i].fd, (uint8_t*)links->recvBuf + offset[i], left[i], MSG_DONTWAIT);
+        if (n == -1) {
+          if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+          if (errno == EINTR) continue;
+          _SE("Receive failed (stripe)");
+          return ICOM_ERROR;
+        }
+        if (n == 0) {
+          _E("Connection closed within a striped message (link %u)", i);
+          return ICOM_ERROR;
+        }
+        offset[i] += n;
+        left[i]   -= n;
+      }
+      if (!left[i] && pfds[i].fd != -1) {
+        pfds[i].fd = -1;
+        pending--;
       }
     }
-    pdata->fdAccepted = pdata->fd;
+    if (pending) {
+      ret = link_stripeWait(pfds, count, ((icomLinkSocket_t*)links->pdata)->timeoutUs);
+      if (ret != ICOM_SUCCESS) return ret;
+    }
   }
 
+  *buf     = links->recvBuf;
+  *bufSize = links->recvBufSize;
   return ICOM_SUCCESS;
 }
 
-static icomStatus_t link_sendAck(icomLink_t *link, void **buf, unsigned *bufSize){
-  int ack = 1;
+/* creates the forwarding pipes on first use (the second one only for fan-out) */
+static icomStatus_t link_initPipes(icomLinkSocket_t *pdata, int tee) {
+  int size;
 
-  /* Retreive private data structure */
-  icomLinkSocket_t *pdata = link->pdata;
+  if (pdata->pipe[0] == -1) {
+    if (pipe2(pdata->pipe, O_CLOEXEC) == -1) {
+      _SE("Failed to create forwarding pipe");
+      return ICOM_ERROR;
+    }
 
-  if (send(pdata->fdAccepted, &ack, sizeof(ack), 0) == -1) {
-    if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
-      _D("Send timeout");
-      return ICOM_TIMEOUT;
+    /* larger pipes mean fewer splice calls, the limit may refuse it */
+    if (fcntl(pdata->pipe[1], F_SETPIPE_SZ, LINK_PIPE_SIZE) == -1) {
+      _SW("Failed to resize forwarding pipe");
     }
-    _SE("Send failed (ack)");
-    return ICOM_ERROR;
+    size = fcntl(pdata->pipe[1], F_GETPIPE_SZ);
+    pdata->pipeSize = (size > 0) ? size : 4096;
   }
 
+  if (tee && pdata->pipeTee[0] == -1) {
+    if (pipe2(pdata->pipeTee, O_CLOEXEC) == -1) {
+      _SE("Failed to create forwarding pipe");
+      return ICOM_ERROR;
+    }
+
+    /* a duplicate fits only if both pipes have the same capacity */
+    fcntl(pdata->pipeTee[1], F_SETPIPE_SZ, pdata->pipeSize);
+    if (fcntl(pdata->pipeTee[1], F_GETPIPE_SZ) != pdata->pipeSize) {
+      _E("Failed to resize forwarding pipe");
+      close(pdata->pipeTee[0]);
+      close(pdata->pipeTee[1]);
+      pdata->pipeTee[0] = pdata->pipeTee[1] = -1;
+      return ICOM_ERROR;
+    }
+  }
   return ICOM_SUCCESS;
 }
 
-static icomStatus_t link_recvAck(icomLink_t *link, void **buf, unsigned *bufSize) {
-  int ack;
-  int bytesReceived;
-  int ret;
-
-  _D("Receiving at link: %p", link);
+static void link_deinitPipes(icomLinkSocket_t *pdata) {
+  for (int i=0; i<2; i++) {
+    if (pdata->pipe[i]    != -1) close(pdata->pipe[i]);
+    if (pdata->pipeTee[i] != -1) close(pdata->pipeTee[i]);
+  }
+}
 
-  /* Retreive private data structure */
-  icomLinkSocket_t *pdata = link->pdata;
+/* moves exactly size bytes from the pipe to the socket */
+static icomStatus_t link_splicePipe(int fdPipe, int fdOut, size_t size, unsigned flags) {
+  ssize_t ret;
 
-  /* Receive */
-  bytesReceived = 0;
-  do {
-    ret = recv(pdata->fdAccepted, (uint8_t*)&ack+bytesReceived, sizeof(ack)-bytesReceived, 0);
+  while (size > 0) {
+    ret = splice(fdPipe, NULL, fdOut, NULL, size, SPLICE_F_MOVE | flags);
     if (ret == -1) {
       if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+        _D("Send timeout");
+        return ICOM_TIMEOUT;
+      }
+      _SE("Splice failed (data)");
+      return ICOM_ERROR;
+    }
+    size -= ret;
+  }
+  return ICOM_SUCCESS;
+}
+
+/* moves the payload from the input socket to all the output sockets in
+ * chunks of the pipe's capacity, every output link but the last one gets a
+ * duplicate (tee) of the chunk */
+static icomStatus_t link_splicePayload(icomLink_t *link, icomLink_t *out, unsigned outCount, uint32_t size) {
+  icomLinkSocket_t *pdata = link->pdata;
+  icomStatus_t ret;
+  ssize_t chunk, dup;
+  unsigned more;
+
+  while (size > 0) {
+    chunk = splice(pdata->fdAccepted, NULL, pdata->pipe[1], NULL,
+                   (size < pdata->pipeSize) ? size : pdata->pipeSize, SPLICE_F_MOVE);
+    if (chunk <= 0) {
+      if ((chunk == -1) && ((errno == EAGAIN) || (errno == EWOULDBLOCK))) {
         _D("Timeout");
         return ICOM_TIMEOUT;
       }
-      _SE("Receive failed (ack)");
+      _SE("Splice failed (data)");
       return ICOM_ERROR;
     }
-    bytesReceived += ret;
-  } while ((ret != -1) && (bytesReceived < sizeof(ack)));
+    size -= chunk;
+    more  = (size > 0) ? SPLICE_F_MORE : 0;
 
-  if (ack != 1) {
-    return ICOM_ERROR;
+    for (unsigned i=0; i<outCount-1; i++) {
+      dup = tee(pdata->pipe[0], pdata->pipeTee[1], chunk, 0);
+      if (dup != chunk) {
+        _SE("Failed to duplicate forwarded data (%zd / %zd bytes)", dup, chunk);
+        return ICOM_ERROR;
+      }
+      ret = link_splicePipe(pdata->pipeTee[0], ((icomLinkSocket_t*)out[i].pdata)->fdAccepted, chunk, more);
+      if (ret != ICOM_SUCCESS) return ret;
+    }
+    ret = link_splicePipe(pdata->pipe[0], ((icomLinkSocket_t*)out[outCount-1].pdata)->fdAccepted, chunk, more);
+    if (ret != ICOM_SUCCESS) return ret;
   }
   return ICOM_SUCCESS;
 }
 
-static icomStatus_t link_sendHandler(icomLink_t *link, void *buf, unsigned bufSize){
+/* sends the header of a forwarded payload, rewritten with the output link's
+ * type and flags */
+static icomStatus_t link_forwardHeader(icomLink_t *out, icomMsgHeader_t *header, void **buf, unsigned *bufSize) {
+  icomLinkSocket_t *pout = out->pdata;
   icomStatus_t ret;
-  ret = link_connect(link, &buf, &bufSize);
-  if (ret != ICOM_SUCCESS) return ret;
-  ret = link_sendHeader(link, &buf, &bufSize);
-  if (ret != ICOM_SUCCESS) return ret;
-  ret = link_sendData(link, &buf, &bufSize);
-  if (ret != ICOM_SUCCESS) return ret;
-  ret = link->autoRecvAck(link, buf, &bufSize);
+
+  ret = link_connect(out, buf, bufSize);
   if (ret != ICOM_SUCCESS) return ret;
-  return ICOM_SUCCESS;
+  if (out->shm && pout->shmState == LINK_SHM_NONE) {
+    ret = link_shareRegion(out);
+    if (ret != ICOM_SUCCESS) return ret;
+  }
+  pout->sendZero     = 0;
+  pout->sendLease    = 0;
+  pout->sendCompress = (header->flags & ICOM_FLAG_COMPRESS) != 0;
+  pout->sendDelta    = (header->flags & ICOM_FLAG_DELTA) != 0;
+
+  /* the peer's frame no longer matches the link's own copy (delta flag) */
+  pout->deltaSize = 0;
+  return link_sendHeader(out, buf, bufSize);
 }
 
-static icomStatus_t link_recvHandler(icomLink_t *link, void **buf, unsigned *bufSize){
-  icomStatus_t ret;
-  ret = link_accept(link, buf, bufSize);
+/* Forwards a single message to the output socket links. Payloads are
+ * spliced, zero-copy messages (offsets within the peer's region) and large
+ * fanned out messages are received and sent as regular buffers. Delta
+ * messages are passed on as they are, the receivers patch their frames. */
+static icomStatus_t link_forwardHandler(icomLink_t *link, icomLink_t *out, unsigned outCount) {
+  icomMsgHeader_t header;
+  icomStatus_t ret, status;
+  void *buf;
+  unsigned bufSize;
+
+  /* refuse before receiving, the caller falls back to copying */
+  if (link->recvHandler != link_recvHandler) return ICOM_ENOTSUP;
+  for (unsigned i=0; i<outCount; i++) {
+    if (out[i].forwardHandler != link_forwardHandler || out[i].sendHandler != link_sendHandler) {
+      return ICOM_ENOTSUP;
+    }
+  }
+
+  ret = link_recvBegin(link, &buf, &bufSize);
   if (ret != ICOM_SUCCESS) return ret;
-  ret = link->autoSendAck(link, buf, bufSize);
+  ret = link_recvMsgHeader(link, &header);
   if (ret != ICOM_SUCCESS) return ret;
-  ret = link_recvHeader(link, buf, bufSize);
+
+  ret = link_initPipes(link->pdata, outCount > 1);
   if (ret != ICOM_SUCCESS) return ret;
-  ret = link_recvData(link, buf, bufSize);
+
+  /* Messages pass through user space if they are zero-copy, or if they are
+   * fanned out and exceed the pipe, as receivers read the links in order
+   * (icom_send delivers whole messages link by link) */
+  ((icomLinkSocket_t*)link->pdata)->recvFrame = 0;
+  if ((header.flags & ICOM_FLAG_DELTA)
+  &&  (outCount > 1 && header.bufSize > ((icomLinkSocket_t*)link->pdata)->pipeSize)) {
+    icomLinkSocket_t *pdata = link->pdata;
+
+    ret = link_growComp(pdata, header.bufSize);
+    if (ret == ICOM_SUCCESS) ret = link_recvAll(pdata->fdAccepted, pdata->compBuf, header.bufSize);
+    if (ret != ICOM_SUCCESS) return ret;
+    link->flags = header.flags;
+    bufSize     = header.bufSize;
+
+    for (unsigned i=0; i<outCount; i++) {
+      ret = link_forwardHeader(out+i, &header, &buf, &bufSize);
+      if (ret == ICOM_SUCCESS) {
+        ret = link_sendAll(((icomLinkSocket_t*)out[i].pdata)->fdAccepted, pdata->compBuf, header.bufSize);
+      }
+      if (ret == ICOM_SUCCESS) ret = out[i].autoRecvAck(out+i, NULL, &bufSize);
+      if (ret != ICOM_SUCCESS) return ret;
+    }
+    return ICOM_SUCCESS;
+  }
+  if ((header.flags & ICOM_FLAG_ZERO)
+  ||  (outCount > 1 && header.bufSize > ((icomLinkSocket_t*)link->pdata)->pipeSize)) {
+    ret = link_setupRecv(link, &header);
+    if (ret == ICOM_SUCCESS) ret = link_recvData(link, &buf, &bufSize);
+    if (ret != ICOM_SUCCESS) return ret;
+
+    for (unsigned i=0; i<outCount; i++) {
+      status = out[i].sendHandler(out+i, buf, bufSize);
+      if (status != ICOM_SUCCESS && ret == ICOM_SUCCESS) ret = status;
+    }
+    return ret;
+  }
+  link->flags = header.flags;
+
+  /* headers are rewritten with the output links' type and flags */
+  bufSize = header.bufSize;
+  for (unsigned i=0; i<outCount; i++) {
+    ret = link_forwardHeader(out+i, &header, &buf, &bufSize);
+    if (ret != ICOM_SUCCESS) return ret;
+  }
+
+  ret = link_splicePayload(link, out, outCount, header.bufSize);
   if (ret != ICOM_SUCCESS) return ret;
+
+  for (unsigned i=0; i<outCount; i++) {
+    ret = out[i].autoRecvAck(out+i, NULL, &bufSize);
+    if (ret != ICOM_SUCCESS) return ret;
+  }
   return ICOM_SUCCESS;
 }
 
+static void link_initCompress(icomLink_t *link, icomLinkSocket_t *pdata) {
+  pdata->sendCompress  = 0;
+  pdata->compBuf       = NULL;
+  pdata->compAlloc     = 0;
+  pdata->compMin       = (link->options && link->options->compressMin >= 0)
+                       ? link->options->compressMin : LINK_COMPRESS_MIN;
+  pdata->compAdaptive  = link->options ? link->options->compressAdaptive : 0;
+  pdata->compMisses    = 0;
+  pdata->compSkip      = 0;
+  pdata->compBackoff   = LINK_COMPRESS_BACKOFF;
+  pdata->compProbe     = 0;
+  pdata->plainPs       = 0;
+  pdata->packedPs      = 0;
+}
+
+static void link_initDelta(icomLinkSocket_t *pdata) {
+  pdata->sendDelta   = 0;
+  pdata->deltaCount  = 0;
+  pdata->deltaRanges = NULL;
+  pdata->deltaBuf    = NULL;
+  pdata->deltaAlloc  = 0;
+  pdata->deltaSize   = 0;
+  pdata->recvFrame   = 0;
+}
+
 static icomStatus_t link_autoSendAck(icomLink_t *link, void **buf, unsigned *bufSize){
   link->autoSendAck = link_sendAck;
   return ICOM_SUCCESS;
@@ -281,6 +1669,68 @@ static icomStatus_t link_autoRecvAck(icomLink_t *link, void **buf, unsigned *buf
   return link_recvAck(link, buf, bufSize);
 }
 
+static void link_setOption(int fd, int level, int name, int value, const char *optionName) {
+  if (setsockopt(fd, level, name, &value, sizeof(value)) < 0) {
+    _SW("Failed to set %s option", optionName);
+  }
+}
+
+/* Applies the flags and the per-link options to the (not yet connected or
+ * listening) socket, sockets accepted later inherit them */
+static void link_setOptions(icomLink_t *link, icomLinkSocket_t *pdata, icomFlags_t flags) {
+  const icomOptions_t *options = link->options;
+  icomOptions_t defaults;
+
+  if (!options) {
+    icom_initOptions(&defaults);
+    options = &defaults;
+  }
+
+  /* Nagle's algorithm delays small messages (disabled unless requested) */
+  link_setOption(pdata->fd, SOL_TCP, TCP_NODELAY, options->nodelay, "TCP_NODELAY");
+
+  /* buffer sizes (the kernel doubles the values), set before the connection
+   * to take effect on the window scaling */
+  if (options->sndbuf >= 0) {
+    link_setOption(pdata->fd, SOL_SOCKET, SO_SNDBUF, options->sndbuf, "SO_SNDBUF");
+  }
+  if (options->rcvbuf >= 0) {
+    link_setOption(pdata->fd, SOL_SOCKET, SO_RCVBUF, options->rcvbuf, "SO_RCVBUF");
+  }
+  if (options->notsentLowat >= 0) {
+    link_setOption(pdata->fd, SOL_TCP, TCP_NOTSENT_LOWAT, options->notsentLowat, "TCP_NOTSENT_LOWAT");
+  }
+
+  /* TCP_QUICKACK is not sticky, it is renewed after every received header */
+  pdata->quickack = options->quickack;
+
+  /* set timeout (if requested), the per-link value takes precedence */
+  pdata->timeoutUs = 0;
+  if ((flags & ICOM_FLAG_TIMEOUT) || options->timeoutUs >= 0) {
+    struct timeval timeout;
+    pdata->timeoutUs = (options->timeoutUs >= 0) ? options->timeoutUs : g_timeout_usec;
+    timeout.tv_sec  = pdata->timeoutUs/1000000;
+    timeout.tv_usec = pdata->timeoutUs%1000000;
+    if( setsockopt(pdata->fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) < 0){
+      _SW("Failed to set socket timeout option");
+    }
+    if( setsockopt(pdata->fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout)) < 0){
+      _SW("Failed to set socket timeout option");
+    }
+  }
+
+  /* spin before blocking (if requested), the kernel busy polls device queues
+   * supporting it as well */
+  pdata->spinNs = 0;
+  if(flags & ICOM_FLAG_SPIN){
+    uint64_t spin_usec;
+    icom_getDefaultConfig(SPIN_BUDGET_USEC, &spin_usec);
+    pdata->spinNs = spin_usec*1000;
+    link_setOption(pdata->fd, SOL_SOCKET, SO_BUSY_POLL,
+      (spin_usec < INT32_MAX) ? (int)spin_usec : INT32_MAX, "SO_BUSY_POLL");
+  }
+}
+
 icomStatus_t icom_initSocketConnect(icomLink_t *link, icomType_t type, const char *comString, icomFlags_t flags){
   icomStatus_t ret;
   icomLinkSocket_t *pdata;
@@ -304,6 +1754,12 @@ icomStatus_t icom_initSocketConnect(icomLink_t *link, icomType_t type, const cha
     return ICOM_EINVAL;
   }
 
+  /* only receivers serve multiple peers or share ports */
+  if(link->options && (link->options->server || link->options->reuseport)){
+    _E("The server and reuseport options require a receiver (socket_rx)");
+    return ICOM_EINVAL;
+  }
+
   /* allocating memory for the private link data structure */
   pdata = (icomLinkSocket_t*)malloc(sizeof(icomLinkSocket_t));
   if(!pdata){
@@ -329,24 +1785,8 @@ icomStatus_t icom_initSocketConnect(icomLink_t *link, icomType_t type, const cha
     goto failure_inet_aton;
   }
 
-  /* set TCP protocol's TCP_NODELAY option */
-  int no_delay = 1;
-  if(setsockopt(pdata->fd, SOL_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay)) < 0){
-    _SW("Failed to set TCP_NODELAY option");
-  }
-
-  /* set timeout (if requested) */
-  if(flags & ICOM_FLAG_TIMEOUT){
-    struct timeval timeout;
-    timeout.tv_sec  = g_timeout_usec/1000000;
-    timeout.tv_usec = g_timeout_usec%1000000;
-    if( setsockopt(pdata->fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) < 0){
-      _SW("Failed to set socket timeout option");
-    }
-    if( setsockopt(pdata->fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout)) < 0){
-      _SW("Failed to set socket timeout option");
-    }
-  }
+  /* apply flags and options (accepted sockets inherit them) */
+  link_setOptions(link, pdata, flags);
 
   /* set up handlers */
   link->sendHandler = link_sendHandler;
@@ -380,9 +1820,36 @@ icomStatus_t icom_initSocketConnect(icomLink_t *link, icomType_t type, const cha
   link->type  = type;
   link->recvSize    = 0;
   link->recvBufSize = 0;
-  link->recvBuf     = (void*)malloc(sizeof(link));
+  pdata->node       = link->options ? link->options->node : -1;
+  pdata->memFlags   = link->options ? link->options->memFlags : 0;
+  link->recvBuf     = icom_memAlloc(sizeof(link), pdata->node, pdata->memFlags);
   *(icomLink_t**)link->recvBuf = link;
   link->recvBuf     += sizeof(link);
+  pdata->flags       = flags;
+  pdata->recvAlloc   = 0;
+  pdata->shmState    = LINK_SHM_NONE;
+  pdata->sendZero    = 0;
+  pdata->sendLease   = 0;
+  pdata->sendId      = 0;
+  pdata->sendChannel = 0;
+  link_initCompress(link, pdata);
+  link_initDelta(pdata);
+  pdata->leasePending = 0;
+  link->releaseHandler = link_releaseHandler;
+  link->reclaimHandler = link_reclaimHandler;
+  link->forwardHandler = link_forwardHandler;
+  pdata->shmPeer     = NULL;
+  pdata->shmPeerSize = 0;
+  pdata->pipe[0]     = pdata->pipe[1]    = -1;
+  pdata->pipeTee[0]  = pdata->pipeTee[1] = -1;
+  pdata->pipeSize    = 0;
+  pdata->server      = 0;
+  pdata->epfd        = -1;
+  pdata->peers       = NULL;
+  pdata->peerCount   = pdata->peerAlloc = 0;
+  pdata->peer        = NULL;
+  pdata->peerNext    = 1;
+  pdata->eventCount  = pdata->eventIndex = 0;
 
   return ICOM_SUCCESS;
 
@@ -442,6 +1909,17 @@ icomStatus_t icom_initSocketBind(icomLink_t *link, icomType_t type, const char *
     goto failure_setsockopt;
   }
 
+  /* share the port with other receivers, the kernel spreads the connections */
+  if(link->options && link->options->reuseport){
+    tmp = 1;
+    ret = setsockopt(pdata->fd,SOL_SOCKET,SO_REUSEPORT,&tmp,sizeof(int));
+    if(ret == -1){
+      _SE("Failed to set socket option");
+      ret = (icomStatus_t)errno;
+      goto failure_setsockopt;
+    }
+  }
+
   /* set sender socket */
   memset(&pdata->sockaddr, 0, sizeof(struct sockaddr_in));
   pdata->sockaddr.sin_family = AF_INET;
@@ -454,24 +1932,8 @@ icomStatus_t icom_initSocketBind(icomLink_t *link, icomType_t type, const char *
     goto failure_inet_aton;
   }
 
-  /* set TCP protocol's TCP_NODELAY option */
-  int no_delay = 1;
-  if(setsockopt(pdata->fd, SOL_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay)) < 0){
-    _SW("Failed to set TCP_NODELAY option");
-  }
-
-  /* set timeout (if requested) */
-  if(flags & ICOM_FLAG_TIMEOUT){
-    struct timeval timeout;
-    timeout.tv_sec  = g_timeout_usec/1000000;
-    timeout.tv_usec = g_timeout_usec%1000000;
-    if( setsockopt(pdata->fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) < 0){
-      _SW("Failed to set socket timeout option");
-    }
-    if( setsockopt(pdata->fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout)) < 0){
-      _SW("Failed to set socket timeout option");
-    }
-  }
+  /* apply flags and options (accepted sockets inherit them) */
+  link_setOptions(link, pdata, flags);
 
   /* bind to the IP address */
   if(bind(pdata->fd, (struct sockaddr*)&pdata->sockaddr, sizeof(struct sockaddr_in)) == -1){
@@ -480,12 +1942,19 @@ icomStatus_t icom_initSocketBind(icomLink_t *link, icomType_t type, const char *
     goto failure_bind;
   }
 
-  if(listen(pdata->fd, 1) == -1){
+  /* servers queue connections of any number of senders */
+  if(listen(pdata->fd, (link->options && link->options->server) ? SOMAXCONN : 1) == -1){
     _SE("Failed to mark socket passive");
     ret = (icomStatus_t)errno;
     goto failure_listen;
   };
 
+  /* the program applies to the whole group of the port's receivers (which
+   * exists once the socket listens) */
+  if(link->options && link->options->reuseport == 2){
+    link_attachSteering(pdata);
+  }
+
   /* set up handlers */
   link->recvHandler = link_recvHandler;
   link->sendHandler = (icomStatus_t(*)(icomLink_t*, void*, unsigned))link_error;
@@ -511,13 +1980,56 @@ icomStatus_t icom_initSocketBind(icomLink_t *link, icomType_t type, const char *
   link->type        = type;
   link->recvSize    = 0;
   link->recvBufSize = 0;
-  link->recvBuf     = (void*)malloc(sizeof(link));
+  pdata->node       = link->options ? link->options->node : -1;
+  pdata->memFlags   = link->options ? link->options->memFlags : 0;
+  link->recvBuf     = icom_memAlloc(sizeof(link), pdata->node, pdata->memFlags);
   *(icomLink_t**)link->recvBuf = link;
   link->recvBuf     += sizeof(link);
+  pdata->flags       = flags;
+  pdata->recvAlloc   = 0;
+  pdata->shmState    = LINK_SHM_NONE;
+  pdata->sendZero    = 0;
+  pdata->sendLease   = 0;
+  pdata->sendId      = 0;
+  pdata->sendChannel = 0;
+  link_initCompress(link, pdata);
+  link_initDelta(pdata);
+  pdata->leasePending = 0;
+  link->releaseHandler = link_releaseHandler;
+  link->reclaimHandler = link_reclaimHandler;
+  link->forwardHandler = link_forwardHandler;
+  pdata->shmPeer     = NULL;
+  pdata->shmPeerSize = 0;
+  pdata->pipe[0]     = pdata->pipe[1]    = -1;
+  pdata->pipeTee[0]  = pdata->pipeTee[1] = -1;
+  pdata->pipeSize    = 0;
+  pdata->server      = 0;
+  pdata->epfd        = -1;
+  pdata->peers       = NULL;
+  pdata->peerCount   = pdata->peerAlloc = 0;
+  pdata->peer        = NULL;
+  pdata->peerNext    = 1;
+  pdata->eventCount  = pdata->eventIndex = 0;
+
+  /* senders are accepted and multiplexed while receiving (server option),
+   * the acknowledgements are owed from the very first message */
+  if(link->options && link->options->server){
+    ret = link_initServer(pdata);
+    if(ret != ICOM_SUCCESS){
+      goto failure_initServer;
+    }
+    pdata->server = 1;
+    if(flags & ICOM_FLAG_AUTONOTIFY){
+      link->autoSendAck = link_sendAck;
+    }
+  }
 
   return ICOM_SUCCESS;
 
 
+failure_initServer:
+  icom_memFree(link->recvBuf-sizeof(link), sizeof(link), pdata->node, pdata->memFlags);
+  free(pdata->ip);
 failure_listen:
 failure_bind:
 failure_inet_aton:
@@ -532,7 +2044,10 @@ void icom_deinitSocket(icomLink_t* link){
   /* retreive private data structure */
   icomLinkSocket_t *pdata = (icomLinkSocket_t*)(link->pdata);
 
-  if (link->type == ICOM_TYPE_SOCKET_RX && pdata->fdAccepted) {
+  if (pdata->server) {
+    link_deinitServer(link);
+  }
+  if (pdata->fdAccepted && pdata->fdAccepted != pdata->fd) {
     shutdown(pdata->fdAccepted, SHUT_RDWR);
     close(pdata->fdAccepted);
   }
@@ -540,9 +2055,17 @@ void icom_deinitSocket(icomLink_t* link){
   close(pdata->fd);
   free(pdata->ip);
 
-  if (link->type == ICOM_TYPE_SOCKET_RX && link->recvBuf) {
-    free(link->recvBuf-sizeof(link));
+  /* both link types may receive (bidirectional transfers) */
+  if (link->recvBuf) {
+    icom_memFree(link->recvBuf-sizeof(link), sizeof(link) + pdata->recvAlloc, pdata->node, pdata->memFlags);
+  }
+  if (pdata->shmPeer) {
+    icom_shmUnmap(pdata->shmPeer, pdata->shmPeerSize);
   }
+  link_deinitPipes(pdata);
+  free(pdata->compBuf);
+  free(pdata->deltaRanges);
+  free(pdata->deltaBuf);
 
   free(link->pdata);
 }
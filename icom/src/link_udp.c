@@ -0,0 +1,568 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <sys/uio.h>
+#include <sys/random.h>
+#include <sys/socket.h>
+
+#include "config.h"
+#include "icom.h"
+#include "icom_type.h"
+#include "icom_status.h"
+#include "icom_mem.h"
+#include "link_udp.h"
+#include "notification.h"
+
+
+/* Datagram links send every message without acknowledgements, i.e. the udp
+ * links to a single receiver and the multicast links to a group, so that the
+ * sender's cost does not depend on the number of receivers. Messages are
+ * split into datagrams (fragments) carrying the message's sequence number and
+ * offset, receivers reassemble them in order and skip incomplete messages,
+ * which are accounted as lost (see icom_getLossStats). Links copy the
+ * messages and slow receivers lose them. */
+static icomStatus_t udp_error(icomLink_t *link, void **buf, unsigned *bufSize){
+  return ICOM_ERROR;
+}
+
+static icomStatus_t udp_nop(icomLink_t *link, void **buf, unsigned *bufSize){
+  return ICOM_SUCCESS;
+}
+
+/* describes the following fragments of the message, every fragment is a
+ * header and a slice of the buffer (two vector entries) */
+static unsigned udp_fragments(icomLinkUdp_t *pdata, void *buf, unsigned bufSize, uint32_t *offset,
+                              icomUdpHeader_t *headers, struct iovec *iov, unsigned max){
+  unsigned count = 0;
+  uint32_t size;
+
+  do {
+    size = (bufSize - *offset < LINK_UDP_PAYLOAD) ? bufSize - *offset : LINK_UDP_PAYLOAD;
+    headers[count]  = (icomUdpHeader_t){pdata->sender, pdata->seq, bufSize, *offset};
+    iov[2*count]    = (struct iovec){&headers[count], sizeof(icomUdpHeader_t)};
+    iov[2*count+1]  = (struct iovec){(uint8_t*)buf + *offset, size};
+    *offset += size;
+    count++;
+  } while(count < max && *offset < bufSize);
+
+  return count;
+}
+
+/* sends the fragments by a single syscall, the kernel splits them at the
+ * segment size (all the fragments but the message's last one are full) */
+static icomStatus_t udp_sendGso(icomLinkUdp_t *pdata, struct iovec *iov, unsigned count){
+  struct msghdr msg = {0};
+
+  msg.msg_iov    = iov;
+  msg.msg_iovlen = 2*count;
+  while(sendmsg(pdata->fd, &msg, 0) == -1){
+    if(errno == EINTR || errno == ECONNREFUSED){
+      continue;
+    }
+    if((errno == EAGAIN) || (errno == EWOULDBLOCK)){
+      _D("Timeout");
+      return ICOM_TIMEOUT;
+    }
+
+    /* e.g. devices without checksum offload, the fragments are sent one by one */
+    if(errno == EIO || errno == EINVAL || errno == EOPNOTSUPP){
+      _SW("Segmentation offload failed, disabling it");
+      return ICOM_ENOTSUP;
+    }
+    _SE("Failed to send datagrams");
+    return ICOM_ERROR;
+  }
+  return ICOM_SUCCESS;
+}
+
+static icomStatus_t udp_sendBatch(icomLinkUdp_t *pdata, struct iovec *iov, unsigned count){
+  struct mmsghdr msgs[LINK_UDP_BATCH];
+  int ret;
+
+  memset(msgs, 0, count*sizeof(*msgs));
+  for(unsigned i=0; i<count; i++){
+    msgs[i].msg_hdr.msg_iov    = iov + 2*i;
+    msgs[i].msg_hdr.msg_iovlen = 2;
+  }
+
+  for(unsigned sent=0; sent<count; sent+=ret){
+    ret = sendmmsg(pdata->fd, msgs + sent, count - sent, 0);
+    if(ret == -1){
+      /* a receiver which is not bound (yet) is reported by the next send */
+      if(errno == EINTR || errno == ECONNREFUSED){
+        ret = 0;
+        continue;
+      }
+      if((errno == EAGAIN) || (errno == EWOULDBLOCK)){
+        _D("Timeout");
+        return ICOM_TIMEOUT;
+      }
+      _SE("Failed to send datagrams");
+      return ICOM_ERROR;
+    }
+  }
+  return ICOM_SUCCESS;
+}
+
+static icomStatus_t udp_send(icomLink_t *link, void *buf, unsigned bufSize){
+  icomLinkUdp_t *pdata = link->pdata;
+  icomUdpHeader_t headers[LINK_UDP_BATCH];
+  struct iovec iov[2*LINK_UDP_BATCH];
+  icomStatus_t ret;
+  uint32_t offset = 0;
+  unsigned count, max;
+
+  pdata->seq++;
+
+  /* fragments are batched, so that a large message takes a few syscalls */
+  do {
+    max   = (pdata->gso && LINK_UDP_GSO_MAX < LINK_UDP_BATCH) ? LINK_UDP_GSO_MAX : LINK_UDP_BATCH;
+    count = udp_fragments(pdata, buf, bufSize, &offset, headers, iov, max);
+
+    ret = ICOM_ENOTSUP;
+    if(pdata->gso && count > 1){
+      ret = udp_sendGso(pdata, iov, count);
+      if(ret == ICOM_ENOTSUP){
+        pdata->gso = 0;
+      }
+    }
+    if(ret == ICOM_ENOTSUP){
+      ret = udp_sendBatch(pdata, iov, count);
+    }
+    if(ret != ICOM_SUCCESS){
+      return ret;
+    }
+  } while(offset < bufSize);
+
+  return ICOM_SUCCESS;
+}
+
+/* returns the next received datagram, coalesced datagrams (UDP_GRO) are
+ * split at the segment size */
+static icomStatus_t udp_nextDatagram(icomLinkUdp_t *pdata, uint8_t **datagram, unsigned *size){
+  struct mmsghdr *msg;
+  struct cmsghdr *cmsg;
+  unsigned segment;
+  int n;
+
+  while(pdata->batchIndex >= pdata->batchCount){
+    for(unsigned i=0; i<LINK_UDP_RECV_BATCH; i++){
+      pdata->msgs[i].msg_hdr.msg_controllen = pdata->gro ? sizeof(pdata->control[i]) : 0;
+      pdata->msgs[i].msg_hdr.msg_flags      = 0;
+    }
+
+    /* blocks (or times out) until the first datagram only */
+    n = recvmmsg(pdata->fd, pdata->msgs, LINK_UDP_RECV_BATCH, MSG_WAITFORONE, NULL);
+    if(n == -1){
+      if(errno == EINTR){
+        continue;
+      }
+      if((errno == EAGAIN) || (errno == EWOULDBLOCK)){
+        _D("Timeout");
+        return ICOM_TIMEOUT;
+      }
+      _SE("Failed to receive datagrams");
+      return ICOM_ERROR;
+    }
+    pdata->batchCount  = n;
+    pdata->batchIndex  = 0;
+    pdata->batchOffset = 0;
+  }
+
+  msg     = pdata->msgs + pdata->batchIndex;
+  segment = msg->msg_len;
+  for(cmsg=CMSG_FIRSTHDR(&msg->msg_hdr); cmsg; cmsg=CMSG_NXTHDR(&msg->msg_hdr, cmsg)){
+    if(cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO){
+      segment = *(int*)CMSG_DATA(cmsg);
+    }
+  }
+
+  *datagram = (uint8_t*)pdata->iov[pdata->batchIndex].iov_base + pdata->batchOffset;
+  *size     = (msg->msg_len - pdata->batchOffset < segment) ? msg->msg_len - pdata->batchOffset : segment;
+  pdata->batchOffset += *size;
+  if(pdata->batchOffset >= msg->msg_len || !segment){
+    pdata->batchIndex++;
+    pdata->batchOffset = 0;
+  }
+
+  /* datagrams exceeding the buffer are not ours */
+  if(msg->msg_hdr.msg_flags & MSG_TRUNC){
+    *size = 0;
+  }
+  return ICOM_SUCCESS;
+}
+
+/* prepares the input buffer for the message announced by the fragment */
+static icomStatus_t udp_setupRecv(icomLink_t *link, icomUdpHeader_t *header){
+  icomLinkUdp_t *pdata = link->pdata;
+  icomStatus_t status;
+
+  status = icom_memGrowRecv(link, &pdata->recvAlloc, header->bufSize, pdata->node, pdata->memFlags);
+  if(status != ICOM_SUCCESS){
+    return status;
+  }
+
+  link->recvBufSize = header->bufSize;
+  link->recvSize    = header->bufSize;
+  pdata->seq        = header->seq;
+  pdata->received   = 0;
+  pdata->active     = 1;
+  return ICOM_SUCCESS;
+}
+
+static icomStatus_t udp_recv(icomLink_t *link, void **buf, unsigned *bufSize){
+  icomLinkUdp_t *pdata = link->pdata;
+  icomUdpHeader_t *header;
+  icomStatus_t ret;
+  uint8_t *datagram;
+  unsigned datagramSize;
+  uint32_t size, lost;
+
+  while(1){
+    ret = udp_nextDatagram(pdata, &datagram, &datagramSize);
+    if(ret != ICOM_SUCCESS){
+      return ret;
+    }
+    header = (icomUdpHeader_t*)datagram;
+    size   = datagramSize - sizeof(icomUdpHeader_t);
+    if(datagramSize < sizeof(icomUdpHeader_t) || header->offset > header->bufSize
+    || size > header->bufSize - header->offset){
+      _D("Dropping invalid datagram");
+      continue;
+    }
+
+    /* the first (or a restarted) sender begins the sequence */
+    if(!pdata->synced || header->sender != pdata->sender){
+      if(pdata->synced){
+        _W("Sender of the link changed, restarting the sequence");
+      }
+      pdata->synced  = 1;
+      pdata->sender  = header->sender;
+      pdata->seqNext = header->seq;
+      pdata->seq     = header->seq - 1;
+      pdata->active  = 0;
+    }
+
+    /* fragments of delivered, abandoned and older messages are dropped, the
+     * first fragment of a newer message abandons the incomplete one */
+    if((int32_t)(header->seq - pdata->seqNext) < 0 || (int32_t)(header->seq - pdata->seq) < 0){
+      continue;
+    }
+    if(header->seq != pdata->seq){
+      pdata->seq    = header->seq;
+      pdata->active = 0;
+      if(header->offset == 0){
+        ret = udp_setupRecv(link, header);
+        if(ret != ICOM_SUCCESS){
+          return ret;
+        }
+      }
+    }
+
+    /* fragments are sent in order, a missing one breaks the message */
+    if(!pdata->active){
+      continue;
+    }
+    if(header->offset != pdata->received || header->bufSize != link->recvBufSize){
+      _D("Message %u is incomplete, dropping it", header->seq);
+      pdata->active = 0;
+      continue;
+    }
+    memcpy((uint8_t*)link->recvBuf + header->offset, header + 1, size);
+    pdata->received += size;
+    if(pdata->received < link->recvBufSize){
+      continue;
+    }
+
+    /* every skipped sequence number is a lost message */
+    lost = header->seq - pdata->seqNext;
+    if(lost){
+      _D("Lost %u messages before message %u", lost, header->seq);
+      link->lossStats.lost += lost;
+      link->lossStats.gaps++;
+    }
+    link->lossStats.messages++;
+    pdata->seqNext = header->seq + 1;
+    pdata->active  = 0;
+    link->recvId   = header->seq;
+
+    *buf     = link->recvBuf;
+    *bufSize = link->recvBufSize;
+    return ICOM_SUCCESS;
+  }
+}
+
+static void udp_setOption(int fd, int level, int name, int value, const char *optionName){
+  if(setsockopt(fd, level, name, &value, sizeof(value)) < 0){
+    _SW("Failed to set %s option", optionName);
+  }
+}
+
+/* creates the datagram socket of the address "ip:port" ("*" - any) */
+static icomStatus_t udp_initSocket(icomLink_t *link, icomType_t type, const char *comString,
+                                   icomFlags_t flags, struct sockaddr_in *addr){
+  icomLinkUdp_t *pdata;
+  char ip[sizeof("xxx.xxx.xxx.xxx")];
+  uint16_t port;
+
+  /* messages are copied without acknowledgements */
+  if(flags & (ICOM_FLAG_ZERO | ICOM_FLAG_NOTIFY | ICOM_FLAG_AUTONOTIFY | ICOM_FLAG_LEASE | ICOM_FLAG_SPIN)){
+    _E("Datagram links support the default and timeout flags only");
+    return ICOM_EINVAL;
+  }
+  if(link->options && (link->options->server || link->options->reuseport)){
+    _E("Datagram links do not support the server and reuseport options");
+    return ICOM_EINVAL;
+  }
+
+  if(sscanf(comString, "%15[^:]:%hu", ip, &port) != 2){
+    _E("Failed to parse communication string");
+    return ICOM_EINVAL;
+  }
+  memset(addr, 0, sizeof(*addr));
+  addr->sin_family = AF_INET;
+  addr->sin_port   = htons(port);
+  if(strcmp(ip, "*") == 0 && type == ICOM_TYPE_UDP_RX){
+    addr->sin_addr.s_addr = htonl(INADDR_ANY);
+  } else if(inet_aton(ip, &addr->sin_addr) == 0){
+    _E("Failed to convert IP address");
+    return ICOM_EINVAL;
+  }
+  if((type == ICOM_TYPE_MCAST_TX || type == ICOM_TYPE_MCAST_RX) && !IN_MULTICAST(ntohl(addr->sin_addr.s_addr))){
+    _E("%s is not a multicast group address", ip);
+    return ICOM_EINVAL;
+  }
+
+  pdata = (icomLinkUdp_t*)calloc(1, sizeof(icomLinkUdp_t));
+  if(!pdata){
+    _E("Failed to allocate memory");
+    return ICOM_ENOMEM;
+  }
+  pdata->fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+  if(pdata->fd == -1){
+    _SE("Failed to create socket");
+    free(pdata);
+    return ICOM_ERROR;
+  }
+
+  /* set timeout (if requested), the per-link value takes precedence */
+  if((flags & ICOM_FLAG_TIMEOUT) || (link->options && link->options->timeoutUs >= 0)){
+    int64_t timeoutUs = (link->options && link->options->timeoutUs >= 0) ? link->options->timeoutUs : g_timeout_usec;
+    struct timeval timeout = {timeoutUs/1000000, timeoutUs%1000000};
+    if(setsockopt(pdata->fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) < 0
+    || setsockopt(pdata->fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout)) < 0){
+      _SW("Failed to set socket timeout option");
+    }
+  }
+
+  pdata->node     = link->options ? link->options->node : -1;
+  pdata->memFlags = link->options ? link->options->memFlags : 0;
+
+  link->pdata       = pdata;
+  link->type        = type;
+  link->flags       = flags;
+  link->recvBuf     = NULL;
+  link->recvSize    = 0;
+  link->recvBufSize = 0;
+  link->sendHandler = (icomStatus_t(*)(icomLink_t*, void*, unsigned))udp_error;
+  link->recvHandler = udp_error;
+  link->autoSendAck = udp_nop;
+  link->autoRecvAck = udp_nop;
+  link->notifySendHandler = udp_nop;
+  link->notifyRecvHandler = udp_nop;
+  return ICOM_SUCCESS;
+}
+
+/* connects the sender to the destination (receiver or group) */
+static icomStatus_t udp_initTx(icomLink_t *link, struct sockaddr_in *addr){
+  icomLinkUdp_t *pdata = link->pdata;
+
+  if(link->options && link->options->sndbuf >= 0){
+    udp_setOption(pdata->fd, SOL_SOCKET, SO_SNDBUF, link->options->sndbuf, "SO_SNDBUF");
+  }
+  if(connect(pdata->fd, (struct sockaddr*)addr, sizeof(*addr)) == -1){
+    _SE("Failed to set the destination");
+    return ICOM_ERROR;
+  }
+
+  /* full fragments are the segments of the offloaded sends */
+  pdata->gso = 1;
+  if(setsockopt(pdata->fd, SOL_UDP, UDP_SEGMENT, &(int){LINK_UDP_DATAGRAM}, sizeof(int)) < 0){
+    _SW("Segmentation offload not available");
+    pdata->gso = 0;
+  }
+
+  /* receivers restart their sequence once the sender id changes */
+  if(getrandom(&pdata->sender, sizeof(pdata->sender), 0) != sizeof(pdata->sender)){
+    pdata->sender = (uint32_t)getpid() ^ (uint32_t)(uintptr_t)pdata;
+  }
+  pdata->seq = 0;
+
+  link->sendHandler = udp_send;
+  return ICOM_SUCCESS;
+}
+
+/* binds the receiver, datagrams are received in batches */
+static icomStatus_t udp_initRx(icomLink_t *link, struct sockaddr_in *addr){
+  icomLinkUdp_t *pdata = link->pdata;
+
+  if(link->options && link->options->rcvbuf >= 0){
+    udp_setOption(pdata->fd, SOL_SOCKET, SO_RCVBUF, link->options->rcvbuf, "SO_RCVBUF");
+  }
+  if(bind(pdata->fd, (struct sockaddr*)addr, sizeof(*addr)) == -1){
+    _SE("Failed to bind socket");
+    return ICOM_ERROR;
+  }
+
+  /* coalesced datagrams save per-datagram work of the receive path */
+  pdata->gro = 1;
+  if(setsockopt(pdata->fd, SOL_UDP, UDP_GRO, &(int){1}, sizeof(int)) < 0){
+    _SW("Receive offload not available");
+    pdata->gro = 0;
+  }
+
+  pdata->batch = (uint8_t*)malloc(LINK_UDP_RECV_BATCH*LINK_UDP_RECV_SIZE);
+  pdata->msgs  = (struct mmsghdr*)calloc(LINK_UDP_RECV_BATCH, sizeof(struct mmsghdr));
+  if(!pdata->batch || !pdata->msgs){
+    _E("Failed to allocate memory");
+    return ICOM_ENOMEM;
+  }
+  for(unsigned i=0; i<LINK_UDP_RECV_BATCH; i++){
+    pdata->iov[i] = (struct iovec){pdata->batch + i*LINK_UDP_RECV_SIZE, LINK_UDP_RECV_SIZE};
+    pdata->msgs[i].msg_hdr.msg_iov     = pdata->iov + i;
+    pdata->msgs[i].msg_hdr.msg_iovlen  = 1;
+    pdata->msgs[i].msg_hdr.msg_control = pdata->control[i];
+  }
+
+  link->recvBuf = icom_memAlloc(sizeof(link), pdata->node, pdata->memFlags);
+  if(!link->recvBuf){
+    _E("Failed to allocate memory");
+    return ICOM_ENOMEM;
+  }
+  *(icomLink_t**)link->recvBuf = link;
+  link->recvBuf += sizeof(link);
+
+  link->recvHandler = udp_recv;
+  return ICOM_SUCCESS;
+}
+
+icomStatus_t icom_initUdpTx(icomLink_t *link, icomType_t type, const char *comString, icomFlags_t flags){
+  struct sockaddr_in addr;
+  icomStatus_t ret;
+
+  ret = udp_initSocket(link, type, comString, flags, &addr);
+  if(ret != ICOM_SUCCESS){
+    return ret;
+  }
+  ret = udp_initTx(link, &addr);
+  if(ret != ICOM_SUCCESS){
+    icom_deinitUdp(link);
+  }
+  return ret;
+}
+
+icomStatus_t icom_initUdpRx(icomLink_t *link, icomType_t type, const char *comString, icomFlags_t flags){
+  struct sockaddr_in addr;
+  icomStatus_t ret;
+
+  ret = udp_initSocket(link, type, comString, flags, &addr);
+  if(ret != ICOM_SUCCESS){
+    return ret;
+  }
+  ret = udp_initRx(link, &addr);
+  if(ret != ICOM_SUCCESS){
+    icom_deinitUdp(link);
+  }
+  return ret;
+}
+
+icomStatus_t icom_initMcastTx(icomLink_t *link, icomType_t type, const char *comString, icomFlags_t flags){
+  struct sockaddr_in group;
+  icomLinkUdp_t *pdata;
+  icomStatus_t ret;
+
+  ret = udp_initSocket(link, type, comString, flags, &group);
+  if(ret != ICOM_SUCCESS){
+    return ret;
+  }
+  pdata = link->pdata;
+
+  /* local receivers get the datagrams as well (loopback) */
+  udp_setOption(pdata->fd, IPPROTO_IP, IP_MULTICAST_LOOP, 1, "IP_MULTICAST_LOOP");
+  if(link->options && link->options->ttl >= 0){
+    udp_setOption(pdata->fd, IPPROTO_IP, IP_MULTICAST_TTL, link->options->ttl, "IP_MULTICAST_TTL");
+  }
+  if(link->options && link->options->iface != INADDR_ANY){
+    struct in_addr iface = {link->options->iface};
+    if(setsockopt(pdata->fd, IPPROTO_IP, IP_MULTICAST_IF, &iface, sizeof(iface)) < 0){
+      _SE("Failed to select the multicast interface");
+      ret = ICOM_ERROR;
+      goto failure_setup;
+    }
+  }
+
+  ret = udp_initTx(link, &group);
+  if(ret != ICOM_SUCCESS){
+    goto failure_setup;
+  }
+  return ICOM_SUCCESS;
+
+
+failure_setup:
+  icom_deinitUdp(link);
+  return ret;
+}
+
+icomStatus_t icom_initMcastRx(icomLink_t *link, icomType_t type, const char *comString, icomFlags_t flags){
+  struct sockaddr_in group;
+  struct ip_mreq mreq;
+  icomLinkUdp_t *pdata;
+  icomStatus_t ret;
+
+  ret = udp_initSocket(link, type, comString, flags, &group);
+  if(ret != ICOM_SUCCESS){
+    return ret;
+  }
+  pdata = link->pdata;
+
+  /* any number of local receivers share the group's port, binding the group
+   * address filters out other traffic on the port */
+  udp_setOption(pdata->fd, SOL_SOCKET, SO_REUSEADDR, 1, "SO_REUSEADDR");
+  ret = udp_initRx(link, &group);
+  if(ret != ICOM_SUCCESS){
+    goto failure_setup;
+  }
+
+  mreq.imr_multiaddr        = group.sin_addr;
+  mreq.imr_interface.s_addr = link->options ? link->options->iface : INADDR_ANY;
+  if(setsockopt(pdata->fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0){
+    _SE("Failed to join the multicast group");
+    ret = ICOM_ERROR;
+    goto failure_setup;
+  }
+  return ICOM_SUCCESS;
+
+
+failure_setup:
+  icom_deinitUdp(link);
+  return ret;
+}
+
+void icom_deinitUdp(icomLink_t* link){
+  icomLinkUdp_t *pdata = link->pdata;
+
+  /* closing the socket leaves the group */
+  close(pdata->fd);
+  if(link->recvBuf){
+    icom_memFree(link->recvBuf-sizeof(link), sizeof(link) + pdata->recvAlloc, pdata->node, pdata->memFlags);
+  }
+  free(pdata->batch);
+  free(pdata->msgs);
+  free(pdata);
+}
@@ -1,50 +1,695 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <arpa/inet.h>
+#include <sys/uio.h>
+#include <sys/ioctl.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <netinet/tcp.h>
+#include <linux/sockios.h>
+
+#include "config.h"
 #include "icom.h"
 #include "icom_type.h"
 #include "icom_status.h"
 #include "link_zmq.h"
+#include "link_socket.h"
 #include "notification.h"
 
 
+/* Push/pull objects are implemented natively on top of the socket links,
+ * pushers connect (socket_tx) and pullers bind a server link (socket_rx),
+ * which fair-queues the pushers. Only the link selection of icom_send is
+ * specific to push objects. */
 icomStatus_t icom_initZmqPush(icomLink_t *link, icomType_t type, const char *comString, icomFlags_t flags){
-  return ICOM_NIMPL;
+  return icom_initSocketConnect(link, type, comString, flags);
 }
 
 icomStatus_t icom_initZmqPull(icomLink_t *link, icomType_t type, const char *comString, icomFlags_t flags){
-  return ICOM_NIMPL;
+  if(!link->options || !link->options->server){
+    _E("Pull links require the server option");
+    return ICOM_EINVAL;
+  }
+  return icom_initSocketBind(link, type, comString, flags);
+}
+
+/* bytes waiting in the link's send queue, links which are not connected yet
+ * have none */
+static int zmq_sendQueue(icomLink_t *link){
+  icomLinkSocket_t *pdata = link->pdata;
+  int queued = 0;
+
+  if(pdata->fdAccepted && ioctl(pdata->fdAccepted, SIOCOUTQ, &queued) == -1){
+    return 0;
+  }
+  return queued;
+}
+
+/* the next link in round-robin order wins ties */
+static unsigned zmq_pushSelect(icom_t *icom){
+  unsigned i, link, best = (icom->sendLast + 1) % icom->comCount;
+  int queued, bestQueued;
+
+  if(!icom->options.balance){
+    return best;
+  }
+
+  bestQueued = zmq_sendQueue(icom->comConnections + best);
+  for(i=1; i<icom->comCount && bestQueued; i++){
+    link   = (icom->sendLast + 1 + i) % icom->comCount;
+    queued = zmq_sendQueue(icom->comConnections + link);
+    if(queued < bestQueued){
+      best       = link;
+      bestQueued = queued;
+    }
+  }
+  return best;
+}
+
+/* sends the message (tagged with the correlation id) on a single link */
+static icomStatus_t zmq_sendBalanced(icom_t *icom, void *buf, unsigned bufSize, uint32_t id){
+  icomStatus_t status = ICOM_ERROR;
+  unsigned link = zmq_pushSelect(icom);
+
+  /* workers which are not listening (yet) are skipped in round-robin order */
+  for(unsigned i=0; i<icom->comCount; i++){
+    icom->sendLast = link;
+    ((icomLinkSocket_t*)icom->comConnections[link].pdata)->sendId = id;
+    status = icom->comConnections[link].sendHandler(icom->comConnections + link, buf, bufSize);
+    if(status != ICOM_ECONNREFUSED){
+      break;
+    }
+    _D("Worker %s refused the connection", icom->comStrings[link]);
+    link = (link + 1) % icom->comCount;
+  }
+  return status;
+}
+
+icomStatus_t icom_sendZmqPush(icom_t *icom, void *buf, unsigned bufSize){
+  return zmq_sendBalanced(icom, buf, bufSize, 0);
+}
+
+/* Publishers accept any number of subscribers, which announce their topic
+ * prefixes right after connecting. Subscriptions, connections and
+ * disconnections are processed before every published message, which is
+ * framed once and written to the matching subscribers only. */
+static icomStatus_t zmq_error(icomLink_t *link, void **buf, unsigned *bufSize){
+  return ICOM_ERROR;
+}
+
+static icomStatus_t zmq_nop(icomLink_t *link, void **buf, unsigned *bufSize){
+  return ICOM_SUCCESS;
+}
+
+/* writes the whole frame, the vector is consumed (partial writes) */
+static icomStatus_t zmq_sendFrame(int fd, struct iovec *iov, int iovCount){
+  struct msghdr msg = {0};
+  ssize_t ret;
+
+  msg.msg_iov    = iov;
+  msg.msg_iovlen = iovCount;
+  while(msg.msg_iovlen){
+    ret = sendmsg(fd, &msg, MSG_NOSIGNAL);
+    if(ret == -1){
+      if(errno == EINTR){
+        continue;
+      }
+      return ((errno == EAGAIN) || (errno == EWOULDBLOCK)) ? ICOM_TIMEOUT : ICOM_ERROR;
+    }
+    while(msg.msg_iovlen && (size_t)ret >= msg.msg_iov->iov_len){
+      ret -= msg.msg_iov->iov_len;
+      msg.msg_iov++;
+      msg.msg_iovlen--;
+    }
+    if(msg.msg_iovlen){
+      msg.msg_iov->iov_base  = (uint8_t*)msg.msg_iov->iov_base + ret;
+      msg.msg_iov->iov_len  -= ret;
+    }
+  }
+  return ICOM_SUCCESS;
+}
+
+static icomStatus_t zmq_append(void ***array, unsigned *count, unsigned *alloc, void *item){
+  void **items;
+
+  if(*count == *alloc){
+    unsigned size = *alloc ? 2*(*alloc) : 4;
+    items = (void**)realloc(*array, size*sizeof(void*));
+    if(!items){
+      _E("Failed to allocate memory");
+      return ICOM_ENOMEM;
+    }
+    *array = items;
+    *alloc = size;
+  }
+  (*array)[(*count)++] = item;
+  return ICOM_SUCCESS;
+}
+
+/* finds (or inserts) the trie node of the prefix */
+static icomZmqTopic_t* zmq_topicNode(icomZmqTopic_t *node, const uint8_t *prefix, unsigned size){
+  icomZmqTopic_t *child;
+
+  for(unsigned i=0; i<size; i++){
+    for(child=node->child; child && child->key != prefix[i]; child=child->next);
+    if(!child){
+      child = (icomZmqTopic_t*)calloc(1, sizeof(icomZmqTopic_t));
+      if(!child){
+        _E("Failed to allocate memory");
+        return NULL;
+      }
+      child->key  = prefix[i];
+      child->next = node->child;
+      node->child = child;
+    }
+    node = child;
+  }
+  return node;
+}
+
+static void zmq_topicFree(icomZmqTopic_t *node){
+  icomZmqTopic_t *child, *next;
+
+  for(child=node->child; child; child=next){
+    next = child->next;
+    zmq_topicFree(child);
+    free(child);
+  }
+  free(node->subs);
+}
+
+static icomStatus_t zmq_subscribe(icomLinkZmq_t *pdata, icomZmqSub_t *sub, const uint8_t *prefix, unsigned size){
+  icomZmqTopic_t *node = zmq_topicNode(&pdata->topics, prefix, size);
+  icomStatus_t ret;
+
+  if(!node){
+    return ICOM_ENOMEM;
+  }
+  for(unsigned i=0; i<node->subCount; i++){
+    if(node->subs[i] == sub){
+      return ICOM_SUCCESS;
+    }
+  }
+  ret = zmq_append((void***)&node->subs, &node->subCount, &node->subAlloc, sub);
+  if(ret != ICOM_SUCCESS){
+    return ret;
+  }
+  ret = zmq_append((void***)&sub->topics, &sub->topicCount, &sub->topicAlloc, node);
+  if(ret != ICOM_SUCCESS){
+    node->subCount--;
+  }
+  return ret;
+}
+
+static void zmq_subClose(icomLinkZmq_t *pdata, icomZmqSub_t *sub){
+  _D("Subscriber %u disconnected", sub->id);
+
+  /* the (now empty) trie nodes are kept for the following subscribers */
+  for(unsigned i=0; i<sub->topicCount; i++){
+    icomZmqTopic_t *node = sub->topics[i];
+    for(unsigned j=0; j<node->subCount; j++){
+      if(node->subs[j] == sub){
+        node->subs[j] = node->subs[--node->subCount];
+        break;
+      }
+    }
+  }
+  for(unsigned i=0; i<pdata->subCount; i++){
+    if(pdata->subs[i] == sub){
+      pdata->subs[i] = pdata->subs[--pdata->subCount];
+      break;
+    }
+  }
+
+  epoll_ctl(pdata->epfd, EPOLL_CTL_DEL, sub->fd, NULL);
+  close(sub->fd);
+  free(sub->topics);
+  free(sub);
+}
+
+static icomStatus_t zmq_subAccept(icomLinkZmq_t *pdata){
+  struct epoll_event event;
+  icomZmqSub_t *sub;
+  int fd;
+
+  /* the listening socket is non-blocking, the subscriber may be gone already */
+  fd = accept4(pdata->fd, NULL, NULL, SOCK_CLOEXEC);
+  if(fd == -1){
+    if((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == ECONNABORTED)){
+      return ICOM_EAGAIN;
+    }
+    _SE("Failed to accept socket");
+    return ICOM_ERROR;
+  }
+
+  sub = (icomZmqSub_t*)calloc(1, sizeof(icomZmqSub_t));
+  if(!sub){
+    _E("Failed to allocate memory");
+    goto failure_alloc;
+  }
+  sub->fd   = fd;
+  sub->id   = pdata->subNext++;
+  sub->mark = pdata->mark;
+
+  event.events   = EPOLLIN | EPOLLRDHUP | EPOLLET;
+  event.data.ptr = sub;
+  if(epoll_ctl(pdata->epfd, EPOLL_CTL_ADD, fd, &event) == -1){
+    _SE("Failed to register subscriber");
+    goto failure_epoll;
+  }
+  if(zmq_append((void***)&pdata->subs, &pdata->subCount, &pdata->subAlloc, sub) != ICOM_SUCCESS){
+    epoll_ctl(pdata->epfd, EPOLL_CTL_DEL, fd, NULL);
+    goto failure_epoll;
+  }
+
+  _D("Subscriber %u connected", sub->id);
+  return ICOM_SUCCESS;
+
+
+failure_epoll:
+  free(sub);
+failure_alloc:
+  close(fd);
+  return ICOM_ENOMEM;
+}
+
+/* Receives the queued subscriptions (control messages holding the prefix).
+ * A subscription is only consumed once it arrived completely, so a partial
+ * one never blocks the publisher, the subscriber is edge triggered and comes
+ * back with the rest of it. */
+static icomStatus_t zmq_subRecv(icomLinkZmq_t *pdata, icomZmqSub_t *sub, uint32_t events){
+  uint8_t frame[sizeof(icomMsgHeader_t) + LINK_ZMQ_TOPIC_MAX];
+  icomMsgHeader_t header;
+  icomStatus_t ret;
+  ssize_t n;
+
+  while(1){
+    n = recv(sub->fd, frame, sizeof(frame), MSG_PEEK | MSG_DONTWAIT);
+    if(n == -1 && errno == EINTR){
+      continue;
+    }
+    if(n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)){
+      return ICOM_SUCCESS;
+    }
+    if(n <= 0){
+      return ICOM_ERROR;
+    }
+
+    if((size_t)n >= sizeof(header)){
+      memcpy(&header, frame, sizeof(header));
+      if(!(header.flags & ICOM_FLAG_CONTROL) || header.bufSize > LINK_ZMQ_TOPIC_MAX){
+        _E("Invalid subscription of subscriber %u", sub->id);
+        return ICOM_ERROR;
+      }
+    }
+    if((size_t)n < sizeof(header) || (size_t)n < sizeof(header) + header.bufSize){
+      /* the rest will never come from a closed subscriber */
+      return (events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) ? ICOM_ERROR : ICOM_SUCCESS;
+    }
+
+    n = sizeof(header) + header.bufSize;
+    if(recv(sub->fd, frame, n, MSG_DONTWAIT) != n){
+      return ICOM_ERROR;
+    }
+    ret = zmq_subscribe(pdata, sub, frame + sizeof(header), header.bufSize);
+    if(ret != ICOM_SUCCESS){
+      return ret;
+    }
+  }
+}
+
+/* processes connections, subscriptions and disconnections without waiting */
+static icomStatus_t zmq_pubPoll(icomLinkZmq_t *pdata){
+  struct epoll_event events[LINK_ZMQ_EVENTS];
+  icomStatus_t ret;
+  int n;
+
+  while((n = epoll_wait(pdata->epfd, events, LINK_ZMQ_EVENTS, 0)) > 0){
+    for(int i=0; i<n; i++){
+      if(events[i].data.ptr == (void*)pdata){
+        while((ret = zmq_subAccept(pdata)) == ICOM_SUCCESS);
+        if(ret != ICOM_EAGAIN){
+          return ret;
+        }
+      } else if(zmq_subRecv(pdata, (icomZmqSub_t*)events[i].data.ptr, events[i].events) != ICOM_SUCCESS){
+        zmq_subClose(pdata, (icomZmqSub_t*)events[i].data.ptr);
+      }
+    }
+  }
+  if(n == -1 && errno != EINTR){
+    _SE("Failed to wait for subscribers");
+    return ICOM_ERROR;
+  }
+  return ICOM_SUCCESS;
+}
+
+static icomStatus_t zmq_pubSend(icomLink_t *link, void *buf, unsigned bufSize){
+  icomLinkZmq_t *pdata = link->pdata;
+  icomMsgHeader_t header = {link->type, link->flags, bufSize};
+  icomZmqTopic_t *node = &pdata->topics;
+  struct iovec iov[2];
+  icomStatus_t ret;
+  unsigned depth;
+
+  ret = zmq_pubPoll(pdata);
+  if(ret != ICOM_SUCCESS){
+    return ret;
+  }
+
+  /* walk the prefixes of the message, from the empty one */
+  pdata->mark++;
+  for(depth=0; node; depth++){
+    for(unsigned i=0; i<node->subCount; i++){
+      icomZmqSub_t *sub = node->subs[i];
+      if(sub->mark == pdata->mark){
+        continue;
+      }
+      sub->mark = pdata->mark;
+      iov[0] = (struct iovec){&header, sizeof(header)};
+      iov[1] = (struct iovec){buf, bufSize};
+      if(zmq_sendFrame(sub->fd, iov, 2) != ICOM_SUCCESS){
+        _W("Failed to send to subscriber %u, dropping it", sub->id);
+        sub->failed = 1;
+      }
+    }
+    if(depth == bufSize){
+      break;
+    }
+    for(node=node->child; node && node->key != ((uint8_t*)buf)[depth]; node=node->next);
+  }
+
+  /* a partially written message leaves the stream unusable */
+  for(unsigned i=pdata->subCount; i>0; i--){
+    if(pdata->subs[i-1]->failed){
+      zmq_subClose(pdata, pdata->subs[i-1]);
+    }
+  }
+  return ICOM_SUCCESS;
+}
+
+static void zmq_setOption(int fd, int level, int name, int value, const char *optionName){
+  if(setsockopt(fd, level, name, &value, sizeof(value)) < 0){
+    _SW("Failed to set %s option", optionName);
+  }
 }
 
 icomStatus_t icom_initZmqPub(icomLink_t *link, icomType_t type, const char *comString, icomFlags_t flags){
-  return ICOM_NIMPL;
+  icomStatus_t ret;
+  icomLinkZmq_t *pdata;
+  struct sockaddr_in sockaddr;
+  struct epoll_event event;
+  char ip[sizeof("xxx.xxx.xxx.xxx")];
+  uint16_t port;
+  int64_t timeoutUs;
+
+  /* messages are copied to every subscriber without acknowledgements */
+  if(flags & (ICOM_FLAG_ZERO | ICOM_FLAG_NOTIFY | ICOM_FLAG_AUTONOTIFY | ICOM_FLAG_LEASE)){
+    _E("Publishers support the default, timeout and spin flags only");
+    return ICOM_EINVAL;
+  }
+
+  if(sscanf(comString, "%15[^:]:%hu", ip, &port) != 2){
+    _E("Failed to parse communication string");
+    return ICOM_EINVAL;
+  }
+  memset(&sockaddr, 0, sizeof(sockaddr));
+  sockaddr.sin_family = AF_INET;
+  sockaddr.sin_port   = htons(port);
+  if(strcmp(ip, "*") == 0){
+    sockaddr.sin_addr.s_addr = htonl(INADDR_ANY);
+  } else if(inet_aton(ip, &sockaddr.sin_addr) == 0){
+    _E("Failed to convert IP address");
+    return ICOM_EINVAL;
+  }
+
+  pdata = (icomLinkZmq_t*)calloc(1, sizeof(icomLinkZmq_t));
+  if(!pdata){
+    _E("Failed to allocate memory");
+    return ICOM_ENOMEM;
+  }
+
+  pdata->fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if(pdata->fd == -1){
+    _SE("Failed to create socket");
+    ret = ICOM_ERROR;
+    goto failure_socket;
+  }
+
+  /* accepted sockets inherit the options (they stay blocking), a stalled
+   * subscriber is dropped once the send timeout expires */
+  zmq_setOption(pdata->fd, SOL_SOCKET, SO_REUSEADDR, 1, "SO_REUSEADDR");
+  zmq_setOption(pdata->fd, SOL_TCP, TCP_NODELAY, link->options ? link->options->nodelay : 1, "TCP_NODELAY");
+  if(link->options && link->options->sndbuf >= 0){
+    zmq_setOption(pdata->fd, SOL_SOCKET, SO_SNDBUF, link->options->sndbuf, "SO_SNDBUF");
+  }
+  timeoutUs = (link->options && link->options->timeoutUs >= 0) ? link->options->timeoutUs
+            : (flags & ICOM_FLAG_TIMEOUT) ? (int64_t)g_timeout_usec : 0;
+  if(timeoutUs){
+    struct timeval timeout = {timeoutUs/1000000, timeoutUs%1000000};
+    if(setsockopt(pdata->fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout)) < 0){
+      _SW("Failed to set socket timeout option");
+    }
+  }
+
+  if(bind(pdata->fd, (struct sockaddr*)&sockaddr, sizeof(sockaddr)) == -1){
+    _SE("Failed to bind socket");
+    ret = ICOM_ERROR;
+    goto failure_bind;
+  }
+  if(listen(pdata->fd, SOMAXCONN) == -1){
+    _SE("Failed to mark socket passive");
+    ret = ICOM_ERROR;
+    goto failure_bind;
+  }
+
+  pdata->epfd = epoll_create1(EPOLL_CLOEXEC);
+  if(pdata->epfd == -1){
+    _SE("Failed to create epoll instance");
+    ret = ICOM_ERROR;
+    goto failure_bind;
+  }
+  event.events   = EPOLLIN;
+  event.data.ptr = pdata;
+  if(epoll_ctl(pdata->epfd, EPOLL_CTL_ADD, pdata->fd, &event) == -1){
+    _SE("Failed to register listening socket");
+    ret = ICOM_ERROR;
+    goto failure_epoll;
+  }
+  pdata->subNext = 1;
+
+  link->pdata       = pdata;
+  link->flags       = flags;
+  link->type        = type;
+  link->recvBuf     = NULL;
+  link->recvSize    = 0;
+  link->recvBufSize = 0;
+  link->sendHandler = zmq_pubSend;
+  link->recvHandler = zmq_error;
+  link->autoSendAck = zmq_nop;
+  link->autoRecvAck = zmq_nop;
+  link->notifySendHandler = zmq_nop;
+  link->notifyRecvHandler = zmq_nop;
+  return ICOM_SUCCESS;
+
+
+failure_epoll:
+  close(pdata->epfd);
+failure_bind:
+  close(pdata->fd);
+failure_socket:
+  free(pdata);
+  return ret;
 }
 
+/* Subscribers are regular (receiving) socket links, which connect and
+ * subscribe right away, so that no message published later is missed */
 icomStatus_t icom_initZmqSub(icomLink_t *link, icomType_t type, const char *comString, icomFlags_t flags){
-  return ICOM_NIMPL;
+  static const icomOptions_t all = {.topicCount = 1};
+  const icomOptions_t *options;
+  icomLinkSocket_t *socket;
+  icomMsgHeader_t header;
+  const char *topic;
+  icomStatus_t ret;
+  unsigned size;
+
+  if(flags & (ICOM_FLAG_ZERO | ICOM_FLAG_NOTIFY | ICOM_FLAG_AUTONOTIFY | ICOM_FLAG_LEASE)){
+    _E("Subscribers support the default, timeout and spin flags only");
+    return ICOM_EINVAL;
+  }
+
+  ret = icom_initSocketConnect(link, type, comString, flags);
+  if(ret != ICOM_SUCCESS){
+    return ret;
+  }
+  socket = link->pdata;
+  link->sendHandler = (icomStatus_t(*)(icomLink_t*, void*, unsigned))zmq_error;
+
+  if(connect(socket->fd, (struct sockaddr*)&socket->sockaddr, sizeof(socket->sockaddr)) == -1){
+    _SE("Failed to connect to the publisher");
+    ret = (errno == ECONNREFUSED) ? ICOM_ECONNREFUSED : ICOM_ERROR;
+    goto failure_connect;
+  }
+  socket->fdAccepted = socket->fd;
+
+  /* no topic subscribes to every message (the empty prefix) */
+  options = (link->options && link->options->topicCount) ? link->options : &all;
+  topic   = options->topics;
+  for(unsigned i=0; i<options->topicCount; i++){
+    struct iovec iov[2];
+
+    size = strlen(topic);
+    if(size > LINK_ZMQ_TOPIC_MAX){
+      _E("Topic exceeds %u bytes", LINK_ZMQ_TOPIC_MAX);
+      ret = ICOM_EINVAL;
+      goto failure_connect;
+    }
+    header = (icomMsgHeader_t){type, ICOM_FLAG_CONTROL, size};
+    iov[0] = (struct iovec){&header, sizeof(header)};
+    iov[1] = (struct iovec){(void*)topic, size};
+    ret = zmq_sendFrame(socket->fd, iov, 2);
+    if(ret != ICOM_SUCCESS){
+      _E("Failed to subscribe");
+      goto failure_connect;
+    }
+    topic += size + 1;
+  }
+  return ICOM_SUCCESS;
+
+
+failure_connect:
+  icom_deinitSocket(link);
+  return ret;
 }
 
+/* Requesters are push objects whose messages carry correlation ids, they
+ * receive the replies on whichever link they arrive. Repliers are pull
+ * objects replying to the sender of the last received request. Replies
+ * replace the acknowledgements, so the links copy the messages. */
 icomStatus_t icom_initZmqReq(icomLink_t *link, icomType_t type, const char *comString, icomFlags_t flags){
-  return ICOM_NIMPL;
+  if(flags & (ICOM_FLAG_ZERO | ICOM_FLAG_NOTIFY | ICOM_FLAG_AUTONOTIFY | ICOM_FLAG_LEASE)){
+    _E("Requesters support the default, timeout and spin flags only");
+    return ICOM_EINVAL;
+  }
+  return icom_initSocketConnect(link, type, comString, flags);
 }
 
 icomStatus_t icom_initZmqRep(icomLink_t *link, icomType_t type, const char *comString, icomFlags_t flags){
-  return ICOM_NIMPL;
+  if(flags & (ICOM_FLAG_ZERO | ICOM_FLAG_NOTIFY | ICOM_FLAG_AUTONOTIFY | ICOM_FLAG_LEASE)){
+    _E("Repliers support the default, timeout and spin flags only");
+    return ICOM_EINVAL;
+  }
+  return icom_initZmqPull(link, type, comString, flags);
+}
+
+icomStatus_t icom_sendZmqReq(icom_t *icom, void *buf, unsigned bufSize){
+  uint32_t id = icom->msgIdNext++;
+
+  /* '0' marks messages without an id */
+  if(!icom->msgIdNext){
+    icom->msgIdNext = 1;
+  }
+  icom->msgId = id;
+  return zmq_sendBalanced(icom, buf, bufSize, id);
+}
+
+icomStatus_t icom_sendZmqRep(icom_t *icom, void *buf, unsigned bufSize){
+  icomLink_t *link = icom->comConnections;
+
+  ((icomLinkSocket_t*)link->pdata)->sendId = link->recvId;
+  return link->sendHandler(link, buf, bufSize);
+}
+
+icomStatus_t icom_recvZmqReq(icom_t *icom, void **buf, unsigned *bufSize){
+  struct pollfd pfds[icom->comCount];
+  icomLinkSocket_t *pdata;
+  unsigned links[icom->comCount], count = 0, link;
+  icomStatus_t ret;
+  int n, timeoutMs = -1;
+
+  /* only links which sent a request may receive a reply, the links are
+   * polled in round-robin order starting after the last one served */
+  for(unsigned i=0; i<icom->comCount; i++){
+    link  = (icom->recvLast + 1 + i) % icom->comCount;
+    pdata = icom->comConnections[link].pdata;
+    if(pdata->fdAccepted){
+      pfds[count]  = (struct pollfd){pdata->fdAccepted, POLLIN, 0};
+      links[count] = link;
+      count++;
+      if(pdata->timeoutUs){
+        timeoutMs = (pdata->timeoutUs + 999)/1000;
+      }
+    }
+  }
+  if(!count){
+    _E("No request was sent yet");
+    return ICOM_ERROR;
+  }
+
+  /* a single link blocks (or spins) in the receive itself */
+  link = links[0];
+  if(count > 1){
+    do {
+      n = poll(pfds, count, timeoutMs);
+    } while(n == -1 && errno == EINTR);
+    if(n == -1){
+      _SE("Failed to wait for replies");
+      return ICOM_ERROR;
+    }
+    if(n == 0){
+      _D("Timeout");
+      return ICOM_TIMEOUT;
+    }
+    for(unsigned i=0; i<count; i++){
+      if(pfds[i].revents){
+        link = links[i];
+        break;
+      }
+    }
+  }
+
+  icom->recvLast = link;
+  ret = icom->comConnections[link].recvHandler(icom->comConnections + link, buf, bufSize);
+  if(ret == ICOM_SUCCESS){
+    icom->msgId = icom->comConnections[link].recvId;
+  }
+  return ret;
 }
 
 
 void icom_deinitZmqPush(icomLink_t* link){
+  icom_deinitSocket(link);
 }
 
 void icom_deinitZmqPull(icomLink_t* link){
+  icom_deinitSocket(link);
 }
 
 void icom_deinitZmqPub(icomLink_t* link){
+  icomLinkZmq_t *pdata = link->pdata;
+
+  while(pdata->subCount){
+    zmq_subClose(pdata, pdata->subs[pdata->subCount-1]);
+  }
+  free(pdata->subs);
+  zmq_topicFree(&pdata->topics);
+  close(pdata->epfd);
+  close(pdata->fd);
+  free(pdata);
 }
 
 void icom_deinitZmqSub(icomLink_t* link){
+  icom_deinitSocket(link);
 }
 
 void icom_deinitZmqReq(icomLink_t* link){
+  icom_deinitSocket(link);
 }
 
 void icom_deinitZmqRep(icomLink_t* link){
+  icom_deinitSocket(link);
 }
 
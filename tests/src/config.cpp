@@ -30,3 +30,21 @@ TEST(icom_config, timeout_snd_usec_set){
   EXPECT_TRUE(timeSet_us == timeGet_us);
 }
 
+TEST(icom_config, shm_region_size_set){
+  icomStatus_t status;
+  uint64_t sizeDefault;
+  uint64_t sizeSet = 1024*1024;
+  uint64_t sizeGet = 0xdeadbeef;
+
+  status = icom_getDefaultConfig(SHM_REGION_SIZE, &sizeDefault);
+  EXPECT_TRUE(status == ICOM_SUCCESS);
+
+  status = icom_setDefaultConfig(SHM_REGION_SIZE, &sizeSet);
+  EXPECT_TRUE(status == ICOM_SUCCESS);
+
+  status = icom_getDefaultConfig(SHM_REGION_SIZE, &sizeGet);
+  EXPECT_TRUE(status == ICOM_SUCCESS);
+  EXPECT_TRUE(sizeSet == sizeGet);
+
+  icom_setDefaultConfig(SHM_REGION_SIZE, &sizeDefault);
+}
@@ -0,0 +1,88 @@
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "gtest/gtest.h"
+extern "C" {
+  #include "icom_delta.h"
+}
+
+/* the ranges patch the previous frame into the next one */
+static int delta_patch(const std::vector<uint8_t> &prev, const std::vector<uint8_t> &next,
+uint32_t gap, std::vector<icomDeltaRange_t> &ranges){
+  std::vector<uint8_t> out(prev);
+  int count;
+
+  count = icom_deltaScan(prev.data(), next.data(), next.size(), gap, ranges.data(), ranges.size());
+  if(count < 0){
+    return count;
+  }
+  for(int i=0; i<count; i++){
+    memcpy(out.data() + ranges[i].offset, next.data() + ranges[i].offset, ranges[i].length);
+  }
+  EXPECT_EQ(out, next);
+  return count;
+}
+
+TEST(icom_delta, equal){
+  std::vector<uint8_t> frame(1000, 7);
+  std::vector<icomDeltaRange_t> ranges(4);
+
+  EXPECT_EQ(delta_patch(frame, frame, 0, ranges), 0);
+  EXPECT_EQ(icom_deltaScan(NULL, NULL, 0, 0, ranges.data(), ranges.size()), 0);
+}
+
+TEST(icom_delta, exact_ranges){
+  std::vector<uint8_t> prev(1000, 0), next(prev);
+  std::vector<icomDeltaRange_t> ranges(8);
+
+  /* within a block, across blocks, first and last byte (odd tail) */
+  next[0] = 1;
+  next[21] = next[22] = 1;
+  for(unsigned i=30; i<70; i++){
+    next[i] = 1;
+  }
+  next[999] = 1;
+  ASSERT_EQ(delta_patch(prev, next, 0, ranges), 4);
+  EXPECT_EQ(ranges[0].offset, 0);   EXPECT_EQ(ranges[0].length, 1);
+  EXPECT_EQ(ranges[1].offset, 21);  EXPECT_EQ(ranges[1].length, 2);
+  EXPECT_EQ(ranges[2].offset, 30);  EXPECT_EQ(ranges[2].length, 40);
+  EXPECT_EQ(ranges[3].offset, 999); EXPECT_EQ(ranges[3].length, 1);
+
+  /* ranges separated by the gap at most are merged */
+  ASSERT_EQ(delta_patch(prev, next, 7, ranges), 3);
+  EXPECT_EQ(ranges[1].offset, 21);  EXPECT_EQ(ranges[1].length, 49);
+  ASSERT_EQ(delta_patch(prev, next, 20, ranges), 2);
+  EXPECT_EQ(ranges[0].offset, 0);   EXPECT_EQ(ranges[0].length, 70);
+}
+
+TEST(icom_delta, random_changes){
+  std::vector<uint8_t> prev(64*1024), next;
+  std::vector<icomDeltaRange_t> ranges(1024);
+
+  for(auto &b : prev){
+    b = rand();
+  }
+  for(int run=0; run<100; run++){
+    next = prev;
+    for(int i=0; i<rand()%64; i++){
+      unsigned offset = rand() % next.size();
+      unsigned length = rand() % 100;
+      for(unsigned j=offset; j<offset+length && j<next.size(); j++){
+        next[j]++;
+      }
+    }
+    EXPECT_GE(delta_patch(prev, next, rand()%32, ranges), 0);
+  }
+}
+
+TEST(icom_delta, too_many_ranges){
+  std::vector<uint8_t> prev(4096, 0), next(prev);
+  std::vector<icomDeltaRange_t> ranges(16);
+
+  for(unsigned i=0; i<next.size(); i+=64){
+    next[i] = 1;
+  }
+  EXPECT_EQ(delta_patch(prev, next, 0, ranges), -1);
+  ranges.resize(next.size()/64);
+  EXPECT_EQ(delta_patch(prev, next, 0, ranges), (int)ranges.size());
+}
@@ -0,0 +1,104 @@
+#include <stdlib.h>
+#include <string.h>
+#include "gtest/gtest.h"
+
+extern "C" {
+  #include "icom.h"
+  #include "link_mux.h"
+}
+
+#define MUX_CHANNELS 4
+
+////////////////////////////////////////////////////////////////////////////////
+// TEST-RELATED - INITIALIZATION
+////////////////////////////////////////////////////////////////////////////////
+TEST(link_mux, init){
+  icom_t *icom;
+
+  /* channels share a single connection */
+  icom = icom_init("socket_rx|default|channels=4|*:[8889-8890]");
+  EXPECT_TRUE(ICOM_IS_ERR(icom));
+
+  /* zero copy buffers are owned by the connection */
+  icom = icom_init("socket_rx|zero|channels=4|*:8889");
+  EXPECT_TRUE(ICOM_IS_ERR(icom));
+
+  icom = icom_init("fifo_rx|default|channels=4|/tmp/icom_mux");
+  EXPECT_TRUE(ICOM_IS_ERR(icom));
+
+  icom = icom_init("socket_rx|default|channels=4|*:8889");
+  ASSERT_FALSE(ICOM_IS_ERR(icom));
+  EXPECT_EQ(icom->comCount, MUX_CHANNELS);
+  icom_deinit(icom);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// TEST-RELATED - TRANSFERS
+////////////////////////////////////////////////////////////////////////////////
+TEST(link_mux, transfer){
+  icom_t *icom_rx, *icom_tx;
+  icomStatus_t status;
+  char txBuf[] = "multiplexed message";
+  void *buf = NULL;
+  unsigned size, count = 0;
+
+  icom_rx = icom_init("socket_rx|default|channels=4|*:8889");
+  ASSERT_FALSE(ICOM_IS_ERR(icom_rx));
+  icom_tx = icom_init("socket_tx|default|channels=4|127.0.0.1:8889");
+  ASSERT_FALSE(ICOM_IS_ERR(icom_tx));
+
+  /* every channel sends a message over the same connection */
+  status = icom_send(icom_tx, txBuf, sizeof(txBuf));
+  EXPECT_EQ(status, ICOM_SUCCESS);
+
+  status = icom_recv(icom_rx);
+  EXPECT_EQ(status, ICOM_SUCCESS);
+  while(icom_nextBuffer(icom_rx, &buf, &size)){
+    EXPECT_EQ(size, sizeof(txBuf));
+    EXPECT_EQ(memcmp(buf, txBuf, sizeof(txBuf)), 0);
+    count++;
+  }
+  EXPECT_EQ(count, MUX_CHANNELS);
+
+  icom_deinit(icom_tx);
+  icom_deinit(icom_rx);
+}
+
+TEST(link_mux, transfer_out_of_order){
+  icom_t *icom_rx, *icom_tx;
+  icomStatus_t status;
+  unsigned order[] = {3, 1, 3, 0};
+  unsigned expected[] = {0, 1, 3, 3};
+  char txBuf[32];
+  void *buf;
+  unsigned size;
+
+  icom_rx = icom_init("socket_rx|default|channels=4|*:8889");
+  ASSERT_FALSE(ICOM_IS_ERR(icom_rx));
+  icom_tx = icom_init("socket_tx|default|channels=4|127.0.0.1:8889");
+  ASSERT_FALSE(ICOM_IS_ERR(icom_tx));
+
+  for(unsigned i=0; i<4; i++){
+    snprintf(txBuf, sizeof(txBuf), "channel %u, message %u", order[i], i);
+    status = icom_sendLink(icom_tx, order[i], txBuf, strlen(txBuf)+1);
+    EXPECT_EQ(status, ICOM_SUCCESS);
+  }
+  EXPECT_EQ(icom_sendLink(icom_tx, MUX_CHANNELS, txBuf, 1), ICOM_EINVAL);
+
+  /* channels 3 and 1 are queued while waiting for channel 0 */
+  status = icom_recvLink(icom_rx, 0, &buf, &size);
+  EXPECT_EQ(status, ICOM_SUCCESS);
+  EXPECT_STREQ((char*)buf, "channel 0, message 3");
+  EXPECT_EQ(((icomLinkMux_t*)icom_rx->comConnections[3].pdata)->queued, 2);
+
+  for(unsigned i=1; i<4; i++){
+    status = icom_recvLink(icom_rx, expected[i], &buf, &size);
+    EXPECT_EQ(status, ICOM_SUCCESS);
+    EXPECT_EQ(size, strlen((char*)buf)+1);
+  }
+  EXPECT_STREQ((char*)buf, "channel 3, message 2");
+
+  icom_deinit(icom_tx);
+  icom_deinit(icom_rx);
+}
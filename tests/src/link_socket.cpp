@@ -1,12 +1,19 @@
 #include <stdlib.h>
 #include <time.h>
+#include <unistd.h>
 #include <pthread.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
 #include <vector>
 #include "gtest/gtest.h"
 #include "link_common.h"
 
 extern "C" {
   #include "icom.h"
+  #include "icom_config.h"
+  #include "icom_shm.h"
 }
 
 #define INIT_TEST_COUNT 100
@@ -26,6 +33,21 @@ void* thread_send(void *p){
   return (void*)icom_send(pdata->icom, pdata->buf, pdata->bufSize);
 }
 
+/* connects a plain TCP socket (a hand-made peer) to the local port */
+static int raw_connect(unsigned port){
+  struct sockaddr_in addr = {};
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+  addr.sin_family      = AF_INET;
+  addr.sin_port        = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if(fd != -1 && connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == -1){
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // TEST-RELATED - INITIALIZATION/DEINITIALIZATION
 ////////////////////////////////////////////////////////////////////////////////
@@ -127,6 +149,1025 @@ TEST(link_socket, transfer_100Mb_zero){
     100*1024*1024); // size in bytes
 }
 
+/* messages exceeding socket buffers on multiple links (receive order) */
+TEST(link_socket, transfer_8Mb_multilink_default){
+  link_common_simple(
+    "socket_tx|default|127.0.0.1:[8889-8891]",
+    "socket_rx|default|*:[8889-8891]",
+    8*1024*1024); // size in bytes
+}
+
+/* every message split across the links, reassembled into a single buffer */
+TEST(link_socket, transfer_stripe_default){
+  for(uint32_t size=0; size<12; size++){
+    link_common_simple(
+      "socket_tx|default|stripe|127.0.0.1:[8889-8892]",
+      "socket_rx|default|stripe|*:[8889-8892]",
+      size);
+  }
+  link_common_simple(
+    "socket_tx|default|stripe|127.0.0.1:[8889-8892]",
+    "socket_rx|default|stripe|*:[8889-8892]",
+    8*1024*1024+3); // size in bytes
+}
+
+TEST(link_socket, transfer_stripe_varied){
+  link_common_varied(
+    "socket_tx|timeout|stripe|127.0.0.1:[8889-8890]",
+    "socket_rx|timeout|stripe|*:[8889-8890]",
+    100);
+}
+
+TEST(link_socket, transfer_stripe_100Mb){
+  link_common_simple(
+    "socket_tx|default|stripe|127.0.0.1:[8889-8892]",
+    "socket_rx|default|stripe|*:[8889-8892]",
+    100*1024*1024); // size in bytes
+}
+
+TEST(link_socket, transfer_compress){
+  for(uint32_t size=0; size<12; size++){
+    link_common_simple(
+      "socket_tx|compress|compress_min=0|127.0.0.1:8889",
+      "socket_rx|default|*:8889",
+      size);
+  }
+  link_common_varied(
+    "socket_tx|compress|compress_min=16|127.0.0.1:[8889-8890]",
+    "socket_rx|default|*:[8889-8890]",
+    100);
+  link_common_simple(
+    "socket_tx|compress|127.0.0.1:8889",
+    "socket_rx|default|*:8889",
+    8*1024*1024); // size in bytes
+}
+
+/* sparse frames are compressed, random ones are sent as is */
+TEST(link_socket, compress_stats){
+  icom_t *icom_rx, *icom_tx;
+  icomCompressStats_t stats;
+  std::vector<uint8_t> frame(256*1024, 0);
+  void *buf;
+  unsigned bufSize;
+
+  icom_rx = icom_init("socket_rx|default|*:8889");
+  ASSERT_FALSE(ICOM_IS_ERR(icom_rx));
+  icom_tx = icom_init("socket_tx|compress|127.0.0.1:8889");
+  ASSERT_FALSE(ICOM_IS_ERR(icom_tx));
+
+  for(unsigned i=0; i<frame.size(); i+=1000){
+    frame[i] = i;
+  }
+  EXPECT_EQ(icom_send(icom_tx, frame.data(), frame.size()), ICOM_SUCCESS);
+  EXPECT_EQ(icom_recv(icom_rx, &buf, &bufSize), ICOM_SUCCESS);
+  ASSERT_EQ(bufSize, frame.size());
+  EXPECT_EQ(memcmp(buf, frame.data(), frame.size()), 0);
+
+  for(auto &b : frame){
+    b = rand();
+  }
+  EXPECT_EQ(icom_send(icom_tx, frame.data(), 1024), ICOM_SUCCESS);
+  EXPECT_EQ(icom_recv(icom_rx, &buf, &bufSize), ICOM_SUCCESS);
+  ASSERT_EQ(bufSize, 1024);
+  EXPECT_EQ(memcmp(buf, frame.data(), 1024), 0);
+
+  EXPECT_EQ(icom_getCompressStats(icom_tx, &stats), ICOM_SUCCESS);
+  EXPECT_EQ(stats.messages, 2);
+  EXPECT_EQ(stats.compressed, 1);
+  EXPECT_EQ(stats.bytesIn, frame.size());
+  EXPECT_LT(stats.bytesOut, frame.size()/10);
+
+  icom_deinit(icom_tx);
+  icom_deinit(icom_rx);
+}
+
+/* incompressible messages suspend compression (adaptive) */
+TEST(link_socket, compress_adaptive){
+  icom_t *icom_rx, *icom_tx;
+  icomCompressStats_t stats;
+  std::vector<uint8_t> frame(4096);
+  void *buf;
+  unsigned bufSize;
+
+  icom_rx = icom_init("socket_rx|default|*:8889");
+  ASSERT_FALSE(ICOM_IS_ERR(icom_rx));
+  icom_tx = icom_init("socket_tx|compress|compress_adaptive|127.0.0.1:8889");
+  ASSERT_FALSE(ICOM_IS_ERR(icom_tx));
+
+  for(auto &b : frame){
+    b = rand();
+  }
+  for(int i=0; i<100; i++){
+    EXPECT_EQ(icom_send(icom_tx, frame.data(), frame.size()), ICOM_SUCCESS);
+    EXPECT_EQ(icom_recv(icom_rx, &buf, &bufSize), ICOM_SUCCESS);
+  }
+  EXPECT_EQ(icom_getCompressStats(icom_tx, &stats), ICOM_SUCCESS);
+  EXPECT_EQ(stats.messages, 100);
+  EXPECT_EQ(stats.compressed, 0);
+  EXPECT_GT(stats.skipped, 80);
+
+  icom_deinit(icom_tx);
+  icom_deinit(icom_rx);
+}
+
+TEST(link_socket, transfer_delta){
+  link_common_varied(
+    "socket_tx|delta|127.0.0.1:[8889-8890]",
+    "socket_rx|default|*:[8889-8890]",
+    100);
+}
+
+/* frames of the same size are patched, others are sent whole */
+TEST(link_socket, delta_frames){
+  icom_t *icom_rx, *icom_tx;
+  icomDeltaStats_t stats;
+  std::vector<uint8_t> frame(64*1024);
+  void *buf;
+  unsigned bufSize;
+
+  icom_rx = icom_init("socket_rx|default|*:8889");
+  ASSERT_FALSE(ICOM_IS_ERR(icom_rx));
+  icom_tx = icom_init("socket_tx|delta|127.0.0.1:8889");
+  ASSERT_FALSE(ICOM_IS_ERR(icom_tx));
+
+  for(auto &b : frame){
+    b = rand();
+  }
+  for(int i=0; i<20; i++){
+    /* a few changed words, an unchanged frame and an empty message */
+    for(int j=0; j<10; j++){
+      frame[rand() % frame.size()]++;
+    }
+    unsigned size = (i == 10) ? 0 : frame.size();
+    EXPECT_EQ(icom_send(icom_tx, frame.data(), size), ICOM_SUCCESS);
+    EXPECT_EQ(icom_recv(icom_rx, &buf, &bufSize), ICOM_SUCCESS);
+    ASSERT_EQ(bufSize, size);
+    EXPECT_EQ(memcmp(buf, frame.data(), size), 0);
+
+    EXPECT_EQ(icom_send(icom_tx, frame.data(), frame.size()), ICOM_SUCCESS);
+    EXPECT_EQ(icom_recv(icom_rx, &buf, &bufSize), ICOM_SUCCESS);
+    ASSERT_EQ(bufSize, frame.size());
+    EXPECT_EQ(memcmp(buf, frame.data(), frame.size()), 0);
+  }
+
+  /* all but the first frame and the one after the empty message */
+  EXPECT_EQ(icom_getDeltaStats(icom_tx, &stats), ICOM_SUCCESS);
+  EXPECT_EQ(stats.frames, 39);
+  EXPECT_EQ(stats.deltas, 37);
+  EXPECT_EQ(stats.bytesIn, 37*frame.size());
+  EXPECT_LT(stats.bytesOut, 37*1024);
+
+  icom_deinit(icom_tx);
+  icom_deinit(icom_rx);
+}
+
+TEST(link_socket, init_delta){
+  icom_t *icom;
+
+  icom = icom_init("socket_tx|zero,delta|127.0.0.1:8889");
+  EXPECT_TRUE(ICOM_IS_ERR(icom));
+  icom = icom_init("socket_rx|delta|server|*:8889");
+  EXPECT_TRUE(ICOM_IS_ERR(icom));
+  icom = icom_init("socket_tx|delta|channels=4|127.0.0.1:8889");
+  EXPECT_TRUE(ICOM_IS_ERR(icom));
+  icom = icom_init("zmq_push|delta|127.0.0.1:8889");
+  EXPECT_TRUE(ICOM_IS_ERR(icom));
+}
+
+TEST(link_socket, init_stripe){
+  icom_t *icom;
+
+  icom = icom_init("socket_rx|zero|stripe|*:[8889-8890]");
+  EXPECT_TRUE(ICOM_IS_ERR(icom));
+  icom = icom_init("socket_rx|default|stripe,server|*:8889");
+  EXPECT_TRUE(ICOM_IS_ERR(icom));
+  icom = icom_init("fifo_tx|default|stripe|/tmp/icom_stripe");
+  EXPECT_TRUE(ICOM_IS_ERR(icom));
+}
+
+/* chunks carrying other flags (which would size the buffer differently) are rejected */
+TEST(link_socket, stripe_invalid_flags){
+  icomFlags_t flags[] = {ICOM_FLAG_ZERO, ICOM_FLAG_COMPRESS, ICOM_FLAG_DELTA, ICOM_FLAG_LEASE};
+  std::vector<uint8_t> data(64*1024);
+  unsigned bufSize;
+  void *buf;
+
+  for(icomFlags_t flag : flags){
+    icom_t *icom_rx = icom_init("socket_rx|timeout|stripe|*:[8889-8890]");
+    ASSERT_FALSE(ICOM_IS_ERR(icom_rx));
+    int fds[2] = {raw_connect(8889), raw_connect(8890)};
+    ASSERT_NE(fds[0], -1);
+    ASSERT_NE(fds[1], -1);
+
+    icomMsgHeader_t header = {ICOM_TYPE_SOCKET_TX, ICOM_FLAG_STRIPE | flag, (uint32_t)data.size(), 0, 0};
+    ASSERT_EQ(send(fds[0], &header, sizeof(header), 0), (ssize_t)sizeof(header));
+    ASSERT_EQ(send(fds[0], data.data(), data.size(), 0), (ssize_t)data.size());
+    header = {ICOM_TYPE_SOCKET_TX, ICOM_FLAG_STRIPE, 0, 0, 0};
+    ASSERT_EQ(send(fds[1], &header, sizeof(header), 0), (ssize_t)sizeof(header));
+
+    EXPECT_EQ(icom_recv(icom_rx, &buf, &bufSize), ICOM_ERROR);
+    close(fds[0]);
+    close(fds[1]);
+    icom_deinit(icom_rx);
+  }
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// TEST-RELATED - SHARED MEMORY ZERO COPY
+////////////////////////////////////////////////////////////////////////////////
+TEST(link_socket, transfer_shm_zero){
+  icom_t *icom_tx, *icom_rx;
+  thread_send_t thread_pdata;
+  pthread_t pid;
+  uint8_t *txBuf, *rxBuf;
+  unsigned rxBufSize, links = 0;
+  void *ret, *buf = NULL;
+
+  icom_tx = icom_init("socket_tx|zero|127.0.0.1:[8889-8891]");
+  ASSERT_FALSE(ICOM_IS_ERR(icom_tx));
+  icom_rx = icom_init("socket_rx|zero|*:[8889-8891]");
+  ASSERT_FALSE(ICOM_IS_ERR(icom_rx));
+
+  txBuf = (uint8_t*)icom_alloc(icom_tx, 4096);
+  ASSERT_TRUE(txBuf != NULL);
+  for(int i=0; i<4096; i++){
+    txBuf[i] = rand();
+  }
+
+  thread_pdata = {icom_tx, txBuf, 4096};
+  pthread_create(&pid, NULL, thread_send, &thread_pdata);
+  EXPECT_EQ(icom_recv(icom_rx), ICOM_SUCCESS);
+  pthread_join(pid, &ret);
+  EXPECT_EQ((uint64_t)ret, ICOM_SUCCESS);
+
+  /* every link maps the same region at its own address */
+  while(icom_nextBuffer(icom_rx, &buf, &rxBufSize) && links < 3){
+    rxBuf = (uint8_t*)buf;
+    EXPECT_NE(rxBuf, txBuf);
+    EXPECT_EQ(rxBufSize, 4096);
+    EXPECT_EQ(memcmp(rxBuf, txBuf, 4096), 0);
+    links++;
+  }
+  EXPECT_EQ(links, 3);
+
+  /* the receiver sees sender's writes without another transfer */
+  txBuf[0] ^= 0xff;
+  EXPECT_EQ(rxBuf[0], txBuf[0]);
+
+  icom_free(icom_tx, txBuf);
+  icom_deinit(icom_tx);
+  icom_deinit(icom_rx);
+}
+
+TEST(link_socket, transfer_shm_zero_process){
+  icom_t *icom_tx, *icom_rx;
+  uint8_t *buf;
+  unsigned bufSize;
+  int fds[2], status;
+  char ready;
+  pid_t pid;
+
+  ASSERT_EQ(pipe(fds), 0);
+  pid = fork();
+  ASSERT_NE(pid, -1);
+
+  /* receiver process verifies the pattern and reports through exit status */
+  if(pid == 0){
+    icom_rx = icom_init("socket_rx|zero|*:8889");
+    if(ICOM_IS_ERR(icom_rx) || write(fds[1], "", 1) != 1) _exit(2);
+    if(icom_recv(icom_rx, (void**)&buf, &bufSize) != ICOM_SUCCESS) _exit(3);
+    for(unsigned i=0; i<bufSize; i++){
+      if(buf[i] != (uint8_t)i) _exit(4);
+    }
+    icom_deinit(icom_rx);
+    _exit(bufSize == 1024*1024 ? 0 : 5);
+  }
+
+  ASSERT_EQ(read(fds[0], &ready, 1), 1);
+  icom_tx = icom_init("socket_tx|zero|127.0.0.1:8889");
+  ASSERT_FALSE(ICOM_IS_ERR(icom_tx));
+  buf = (uint8_t*)icom_alloc(icom_tx, 1024*1024);
+  ASSERT_TRUE(buf != NULL);
+  for(unsigned i=0; i<1024*1024; i++){
+    buf[i] = i;
+  }
+  EXPECT_EQ(icom_send(icom_tx, buf, 1024*1024), ICOM_SUCCESS);
+
+  waitpid(pid, &status, 0);
+  EXPECT_TRUE(WIFEXITED(status));
+  EXPECT_EQ(WEXITSTATUS(status), 0);
+
+  icom_free(icom_tx, buf);
+  icom_deinit(icom_tx);
+  close(fds[0]);
+  close(fds[1]);
+}
+
+TEST(link_socket, shm_alloc){
+  uint64_t sizeDefault, size = 1024*1024;
+  void *bufs[4];
+  icom_t *icom;
+
+  icom_getDefaultConfig(SHM_REGION_SIZE, &sizeDefault);
+  icom_setDefaultConfig(SHM_REGION_SIZE, &size);
+  icom = icom_init("socket_tx|zero|127.0.0.1:8889");
+  icom_setDefaultConfig(SHM_REGION_SIZE, &sizeDefault);
+  ASSERT_FALSE(ICOM_IS_ERR(icom));
+
+  /* region is exhausted by four quarters (block headers take space) */
+  for(int i=0; i<3; i++){
+    bufs[i] = icom_alloc(icom, 256*1024);
+    EXPECT_TRUE(bufs[i] != NULL);
+    EXPECT_EQ((uintptr_t)bufs[i] % 64, 0);
+  }
+  EXPECT_TRUE(icom_alloc(icom, 256*1024) == NULL);
+
+  /* freed blocks are reused and coalesced */
+  icom_free(icom, bufs[1]);
+  bufs[3] = icom_alloc(icom, 256*1024);
+  EXPECT_EQ(bufs[3], bufs[1]);
+  for(int i=0; i<3; i++){
+    icom_free(icom, bufs[i == 1 ? 3 : i]);
+  }
+
+  /* repeated frees and pointers outside of allocated buffers are ignored */
+  icom_free(icom, bufs[2]);
+  icom_free(icom, (uint8_t*)bufs[0] - 64);
+  icom_free(icom, (uint8_t*)bufs[0] + 8);
+  bufs[0] = icom_alloc(icom, 1000*1024);
+  EXPECT_TRUE(bufs[0] != NULL);
+  EXPECT_TRUE(icom_alloc(icom, 256*1024) == NULL);
+  icom_free(icom, bufs[0]);
+
+  /* objects without the zero flag have no region */
+  icom_deinit(icom);
+  icom = icom_init("socket_tx|default|127.0.0.1:8889");
+  ASSERT_FALSE(ICOM_IS_ERR(icom));
+  EXPECT_TRUE(icom_alloc(icom, 64) == NULL);
+  icom_deinit(icom);
+}
+
+/* regions are identified by their cookie, not just by their name */
+TEST(link_socket, shm_map_cookie){
+  icomShm_t *shm = icom_shmInit(1024*1024);
+  void *base;
+
+  ASSERT_TRUE(shm != NULL);
+  base = icom_shmMap(shm->name, shm->size, shm->cookie);
+  ASSERT_TRUE(base != NULL);
+  icom_shmUnmap(base, shm->size);
+
+  EXPECT_TRUE(icom_shmMap(shm->name, shm->size, shm->cookie + 1) == NULL);
+  icom_shmDeinit(shm);
+}
+
+typedef struct {
+  icom_t    *icom;
+  unsigned   size;
+  unsigned   count;
+} thread_lease_t;
+
+/* leases, fills (with the message index) and sends buffers */
+void* thread_lease(void *p){
+  thread_lease_t *pdata = (thread_lease_t*)p;
+  icomStatus_t status = ICOM_SUCCESS;
+  uint8_t *buf;
+
+  for(unsigned i=0; i<pdata->count && status == ICOM_SUCCESS; i++){
+    buf = (uint8_t*)icom_lease(pdata->icom, pdata->size);
+    if(!buf){
+      return (void*)ICOM_ENOMEM;
+    }
+    memset(buf, i, pdata->size);
+    status = icom_send(pdata->icom, buf, pdata->size);
+  }
+  return (void*)status;
+}
+
+/* the region holds three leases only, so buffers must be recycled */
+static icom_t* lease_initTx(const char *str){
+  uint64_t sizeDefault, size = 1024*1024;
+  icom_t *icom;
+
+  icom_getDefaultConfig(SHM_REGION_SIZE, &sizeDefault);
+  icom_setDefaultConfig(SHM_REGION_SIZE, &size);
+  icom = icom_init(str);
+  icom_setDefaultConfig(SHM_REGION_SIZE, &sizeDefault);
+  return icom;
+}
+
+TEST(link_socket, transfer_lease_fanout){
+  thread_lease_t thread_pdata;
+  icom_t *icom_tx, *icom_rx;
+  pthread_t pid;
+  void *buf, *bufs[3], *ret;
+  unsigned bufSize, links;
+
+  icom_tx = lease_initTx("socket_tx|zero|127.0.0.1:[8889-8891]");
+  ASSERT_FALSE(ICOM_IS_ERR(icom_tx));
+  icom_rx = icom_init("socket_rx|zero,lease|*:[8889-8891]");
+  ASSERT_FALSE(ICOM_IS_ERR(icom_rx));
+
+  thread_pdata = {icom_tx, 256*1024, 20};
+  pthread_create(&pid, NULL, thread_lease, &thread_pdata);
+
+  for(unsigned i=0; i<thread_pdata.count; i++){
+    ASSERT_EQ(icom_recv(icom_rx), ICOM_SUCCESS);
+
+    /* all the links share a single leased buffer */
+    buf = NULL; links = 0;
+    while(links < 3 && icom_nextBuffer(icom_rx, &buf, &bufSize)){
+      EXPECT_EQ(bufSize, thread_pdata.size);
+      EXPECT_EQ(((uint8_t*)buf)[0], (uint8_t)i);
+      EXPECT_EQ(((uint8_t*)buf)[bufSize-1], (uint8_t)i);
+      bufs[links++] = buf;
+    }
+    ASSERT_EQ(links, 3);
+
+    for(unsigned j=0; j<3; j++){
+      EXPECT_EQ(icom_release(icom_rx, bufs[j]), ICOM_SUCCESS);
+    }
+  }
+
+  pthread_join(pid, &ret);
+  EXPECT_EQ((uint64_t)ret, ICOM_SUCCESS);
+  icom_deinit(icom_tx);
+  icom_deinit(icom_rx);
+}
+
+TEST(link_socket, transfer_lease_partial_release){
+  icom_t *icom_tx, *icom_rx;
+  void *buf, *bufs[3];
+  unsigned bufSize, links = 0;
+  thread_lease_t thread_pdata;
+  pthread_t pid;
+  void *ret;
+
+  icom_tx = lease_initTx("socket_tx|zero|127.0.0.1:[8889-8891]");
+  ASSERT_FALSE(ICOM_IS_ERR(icom_tx));
+  icom_rx = icom_init("socket_rx|zero,lease|*:[8889-8891]");
+  ASSERT_FALSE(ICOM_IS_ERR(icom_rx));
+
+  thread_pdata = {icom_tx, 256*1024, 1};
+  pthread_create(&pid, NULL, thread_lease, &thread_pdata);
+  ASSERT_EQ(icom_recv(icom_rx), ICOM_SUCCESS);
+  pthread_join(pid, &ret);
+  EXPECT_EQ((uint64_t)ret, ICOM_SUCCESS);
+
+  buf = NULL;
+  while(links < 3 && icom_nextBuffer(icom_rx, &buf, &bufSize)){
+    bufs[links++] = buf;
+  }
+  ASSERT_EQ(links, 3);
+
+  /* the buffer is recycled only after the last receiver releases it */
+  EXPECT_EQ(icom_release(icom_rx, bufs[0]), ICOM_SUCCESS);
+  EXPECT_EQ(icom_release(icom_rx, bufs[1]), ICOM_SUCCESS);
+  usleep(10000);
+  buf = icom_lease(icom_tx, 64);
+  EXPECT_EQ(icom_tx->shm->leases, 2);
+
+  EXPECT_EQ(icom_release(icom_rx, bufs[2]), ICOM_SUCCESS);
+  usleep(10000);
+  icom_shmUnref(icom_tx->shm, buf);
+  buf = icom_lease(icom_tx, 64);
+  EXPECT_EQ(icom_tx->shm->leases, 1);
+  icom_shmUnref(icom_tx->shm, buf);
+
+  icom_deinit(icom_tx);
+  icom_deinit(icom_rx);
+}
+
+TEST(link_socket, transfer_lease_auto_release){
+  thread_lease_t thread_pdata;
+  icom_t *icom_tx, *icom_rx;
+  pthread_t pid;
+  uint8_t *buf;
+  unsigned bufSize;
+  void *ret;
+
+  icom_tx = lease_initTx("socket_tx|zero|127.0.0.1:8889");
+  ASSERT_FALSE(ICOM_IS_ERR(icom_tx));
+  icom_rx = icom_init("socket_rx|zero|*:8889");
+  ASSERT_FALSE(ICOM_IS_ERR(icom_rx));
+
+  /* every icom_recv releases the previous buffer */
+  thread_pdata = {icom_tx, 256*1024, 100};
+  pthread_create(&pid, NULL, thread_lease, &thread_pdata);
+  for(unsigned i=0; i<thread_pdata.count; i++){
+    ASSERT_EQ(icom_recv(icom_rx, (void**)&buf, &bufSize), ICOM_SUCCESS);
+    EXPECT_EQ(bufSize, thread_pdata.size);
+    EXPECT_EQ(buf[0], (uint8_t)i);
+  }
+
+  pthread_join(pid, &ret);
+  EXPECT_EQ((uint64_t)ret, ICOM_SUCCESS);
+  icom_deinit(icom_tx);
+  icom_deinit(icom_rx);
+}
+
+TEST(link_socket, init_lease_notify){
+  EXPECT_TRUE(ICOM_IS_ERR(icom_init("socket_tx|zero,lease,notify|127.0.0.1:8889")));
+  EXPECT_TRUE(ICOM_IS_ERR(icom_init("socket_rx|zero,lease,autonotify|*:8889")));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// TEST-RELATED - FORWARDING
+////////////////////////////////////////////////////////////////////////////////
+static const unsigned forwardSizes[] = {0, 1, 4096, 100000, 8*1024*1024};
+#define FORWARD_COUNT (sizeof(forwardSizes)/sizeof(forwardSizes[0]))
+
+typedef struct {
+  icom_t    *icom;
+  uint8_t   *buf;
+} thread_forwardSend_t;
+
+typedef struct {
+  icom_t    *in;
+  icom_t    *out;
+  icomForwardOptions_t options;
+} thread_forward_t;
+
+void* thread_forwardSend(void *p){
+  thread_forwardSend_t *pdata = (thread_forwardSend_t*)p;
+  icomStatus_t status = ICOM_SUCCESS;
+
+  for(unsigned i=0; i<FORWARD_COUNT && status == ICOM_SUCCESS; i++){
+    status = icom_send(pdata->icom, pdata->buf, forwardSizes[i]);
+  }
+  return (void*)status;
+}
+
+void* thread_forward(void *p){
+  thread_forward_t *pdata = (thread_forward_t*)p;
+  return (void*)icom_forward(pdata->in, pdata->out, &pdata->options);
+}
+
+/* tx -> (in -> out relay) -> rx, every message received on an input link is
+ * forwarded to all the output links */
+static void link_forward(const char *txStr, const char *inStr, const char *outStr,
+                         const char *rxStr, int copy){
+  thread_forwardSend_t sendPdata;
+  thread_forward_t forwardPdata;
+  pthread_t pidSend, pidForward;
+  icom_t *icom_tx, *icom_in, *icom_out, *icom_rx;
+  uint8_t *txBuf, *rxBuf;
+  unsigned rxBufSize, links, copies, buffers;
+  void *ret, *buf;
+
+  icom_rx  = icom_init(rxStr);
+  ASSERT_FALSE(ICOM_IS_ERR(icom_rx));
+  icom_out = icom_init(outStr);
+  ASSERT_FALSE(ICOM_IS_ERR(icom_out));
+  icom_in  = icom_init(inStr);
+  ASSERT_FALSE(ICOM_IS_ERR(icom_in));
+  icom_tx  = icom_init(txStr);
+  ASSERT_FALSE(ICOM_IS_ERR(icom_tx));
+
+  /* zero-copy senders send buffers of their region */
+  txBuf = (uint8_t*)icom_alloc(icom_tx, forwardSizes[FORWARD_COUNT-1]);
+  if(!txBuf){
+    txBuf = (uint8_t*)malloc(forwardSizes[FORWARD_COUNT-1]);
+  }
+  for(unsigned i=0; i<forwardSizes[FORWARD_COUNT-1]; i++){
+    txBuf[i] = rand();
+  }
+
+  sendPdata    = {icom_tx, txBuf};
+  forwardPdata = {icom_in, icom_out, {FORWARD_COUNT, copy}};
+  pthread_create(&pidSend,    NULL, thread_forwardSend, &sendPdata);
+  pthread_create(&pidForward, NULL, thread_forward,     &forwardPdata);
+
+  /* every input link delivers its own copy of each message (the sizes
+   * identify the messages, the buffer is shared with the sender thread),
+   * striped objects a single reassembled one */
+  copies  = icom_in->options.stripe ? 1 : icom_in->comCount;
+  buffers = icom_rx->options.stripe ? 1 : icom_rx->comCount;
+  for(unsigned i=0; i<FORWARD_COUNT*copies; i++){
+    ASSERT_EQ(icom_recv(icom_rx, &buf, &rxBufSize), ICOM_SUCCESS);
+
+    links = 0;
+    do {
+      rxBuf = (uint8_t*)buf;
+      ASSERT_EQ(rxBufSize, forwardSizes[i/copies]);
+      EXPECT_EQ(memcmp(rxBuf, txBuf, rxBufSize), 0);
+      links++;
+    } while(links < buffers && icom_nextBuffer(icom_rx, &buf, &rxBufSize));
+    EXPECT_EQ(links, buffers);
+  }
+
+  pthread_join(pidSend, &ret);
+  EXPECT_EQ((uint64_t)ret, ICOM_SUCCESS);
+  pthread_join(pidForward, &ret);
+  EXPECT_EQ((uint64_t)ret, ICOM_SUCCESS);
+
+  if(icom_tx->shm){
+    icom_free(icom_tx, txBuf);
+  } else {
+    free(txBuf);
+  }
+  icom_deinit(icom_tx);
+  icom_deinit(icom_in);
+  icom_deinit(icom_out);
+  icom_deinit(icom_rx);
+}
+
+TEST(link_socket, forward_splice){
+  link_forward(
+    "socket_tx|default|127.0.0.1:8889", "socket_rx|default|*:8889",
+    "socket_tx|default|127.0.0.1:8890", "socket_rx|default|*:8890", 0);
+}
+
+TEST(link_socket, forward_splice_multilink){
+  link_forward(
+    "socket_tx|default|127.0.0.1:[8889-8890]", "socket_rx|default|*:[8889-8890]",
+    "socket_tx|default|127.0.0.1:[8891-8893]", "socket_rx|default|*:[8891-8893]", 0);
+}
+
+/* striped messages are reassembled before they are forwarded */
+TEST(link_socket, forward_stripe_in){
+  link_forward(
+    "socket_tx|default|stripe|127.0.0.1:[8889-8890]", "socket_rx|default|stripe|*:[8889-8890]",
+    "socket_tx|default|127.0.0.1:[8891-8892]", "socket_rx|default|*:[8891-8892]", 0);
+}
+
+/* forwarded messages are split across the links of a striped output */
+TEST(link_socket, forward_stripe_out){
+  link_forward(
+    "socket_tx|default|127.0.0.1:[8889-8890]", "socket_rx|default|*:[8889-8890]",
+    "socket_tx|default|stripe|127.0.0.1:[8891-8892]", "socket_rx|default|stripe|*:[8891-8892]", 0);
+}
+
+TEST(link_socket, forward_copy_multilink){
+  link_forward(
+    "socket_tx|default|127.0.0.1:[8889-8890]", "socket_rx|default|*:[8889-8890]",
+    "socket_tx|default|127.0.0.1:[8891-8893]", "socket_rx|default|*:[8891-8893]", 1);
+}
+
+/* zero-copy input is resolved and copied to the output links */
+TEST(link_socket, forward_zero){
+  link_forward(
+    "socket_tx|zero|127.0.0.1:8889", "socket_rx|zero|*:8889",
+    "socket_tx|default|127.0.0.1:[8890-8891]", "socket_rx|default|*:[8890-8891]", 0);
+}
+
+/* delta messages are passed on as they are, the receivers patch their frames */
+TEST(link_socket, forward_delta){
+  icom_t *icom_tx, *icom_in, *icom_out, *icom_rx;
+  icomForwardOptions_t options = {1, 0};
+  icomDeltaStats_t stats;
+  std::vector<uint8_t> frame(64*1024);
+  unsigned bufSize, links;
+  void *buf;
+
+  icom_rx  = icom_init("socket_rx|default|*:[8890-8891]");
+  ASSERT_FALSE(ICOM_IS_ERR(icom_rx));
+  icom_out = icom_init("socket_tx|default|127.0.0.1:[8890-8891]");
+  ASSERT_FALSE(ICOM_IS_ERR(icom_out));
+  icom_in  = icom_init("socket_rx|default|*:8889");
+  ASSERT_FALSE(ICOM_IS_ERR(icom_in));
+  icom_tx  = icom_init("socket_tx|delta|127.0.0.1:8889");
+  ASSERT_FALSE(ICOM_IS_ERR(icom_tx));
+
+  for(int i=0; i<10; i++){
+    frame[rand() % frame.size()]++;
+    ASSERT_EQ(icom_send(icom_tx, frame.data(), frame.size()), ICOM_SUCCESS);
+    ASSERT_EQ(icom_forward(icom_in, icom_out, &options), ICOM_SUCCESS);
+    ASSERT_EQ(icom_recv(icom_rx), ICOM_SUCCESS);
+
+    buf   = NULL;
+    links = 0;
+    while(icom_nextBuffer(icom_rx, &buf, &bufSize) && links < icom_rx->comCount){
+      ASSERT_EQ(bufSize, frame.size());
+      EXPECT_EQ(memcmp(buf, frame.data(), frame.size()), 0);
+      links++;
+    }
+    EXPECT_EQ(links, icom_rx->comCount);
+  }
+  EXPECT_EQ(icom_getDeltaStats(icom_tx, &stats), ICOM_SUCCESS);
+  EXPECT_EQ(stats.deltas, 9);
+
+  icom_deinit(icom_tx);
+  icom_deinit(icom_in);
+  icom_deinit(icom_out);
+  icom_deinit(icom_rx);
+}
+
+TEST(link_socket, forward_no_destination){
+  icom_t *icom = icom_init("socket_rx|default|*:8889");
+  ASSERT_FALSE(ICOM_IS_ERR(icom));
+  EXPECT_EQ(icom_do(icom), ICOM_EINVAL);
+  icom_deinit(icom);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// TEST-RELATED - SPIN RECEIVE
+////////////////////////////////////////////////////////////////////////////////
+TEST(link_socket, transfer_varied_spin){
+  link_common_varied(
+    "socket_tx|spin|127.0.0.1:8889",
+    "socket_rx|spin|*:8889",
+    100); // test count
+}
+
+void* thread_sendDelayed(void *p){
+  usleep(20000);
+  return thread_send(p);
+}
+
+TEST(link_socket, spin_stats){
+  icom_t *icom_tx, *icom_rx;
+  thread_send_t thread_pdata;
+  icomSpinStats_t stats;
+  pthread_t pid;
+  uint32_t txBuf = 0xdeadbeef;
+  unsigned bufSize;
+  void *ret, *buf;
+
+  icom_tx = icom_init("socket_tx|default|127.0.0.1:8889");
+  ASSERT_FALSE(ICOM_IS_ERR(icom_tx));
+  icom_rx = icom_init("socket_rx|spin|*:8889");
+  ASSERT_FALSE(ICOM_IS_ERR(icom_rx));
+
+  /* the message is already queued (found by the first spin), the receiver
+   * blocks in accept until the sender connects */
+  ASSERT_EQ(icom_send(icom_tx, &txBuf, sizeof(txBuf)), ICOM_SUCCESS);
+  ASSERT_EQ(icom_recv(icom_rx, &buf, &bufSize), ICOM_SUCCESS);
+  EXPECT_EQ(*(uint32_t*)buf, txBuf);
+
+  ASSERT_EQ(icom_getSpinStats(icom_rx, &stats), ICOM_SUCCESS);
+  EXPECT_EQ(stats.hits, 1);
+  EXPECT_EQ(stats.fallbacks, 0);
+
+  /* the message arrives long after the spin budget (blocks) */
+  thread_pdata = {icom_tx, &txBuf, sizeof(txBuf)};
+  pthread_create(&pid, NULL, thread_sendDelayed, &thread_pdata);
+  ASSERT_EQ(icom_recv(icom_rx, &buf, &bufSize), ICOM_SUCCESS);
+  pthread_join(pid, &ret);
+  EXPECT_EQ(*(uint32_t*)buf, txBuf);
+
+  ASSERT_EQ(icom_getSpinStats(icom_rx, &stats), ICOM_SUCCESS);
+  EXPECT_EQ(stats.hits, 1);
+  EXPECT_EQ(stats.fallbacks, 1);
+  EXPECT_EQ(stats.wakeups, 1);
+  EXPECT_GE(stats.spins, 2);
+
+  icom_deinit(icom_tx);
+  icom_deinit(icom_rx);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// TEST-RELATED - SERVER (MULTIPLE SENDERS ON A SINGLE PORT)
+////////////////////////////////////////////////////////////////////////////////
+#define SERVER_SENDERS 4
+
+typedef struct {
+  const char *str;
+  uint32_t    index;
+  uint32_t    count;
+  int         reply;   /** waits for the server's reply to every message */
+  uint32_t    errors;
+} thread_server_t;
+
+/* sends (index, sequence number) pairs */
+void* thread_serverSend(void *p){
+  thread_server_t *pdata = (thread_server_t*)p;
+  icomStatus_t status = ICOM_SUCCESS;
+  uint32_t local[2], *msg = local;
+  unsigned bufSize;
+  void *buf;
+
+  icom_t *icom = icom_init(pdata->str);
+  if(ICOM_IS_ERR(icom)){
+    return (void*)icom;
+  }
+  if(icom->shm){
+    msg = (uint32_t*)icom_alloc(icom, sizeof(local));
+  }
+
+  for(uint32_t i=0; i<pdata->count && status == ICOM_SUCCESS; i++){
+    msg[0] = pdata->index;
+    msg[1] = i;
+    status = icom_send(icom, msg, sizeof(local));
+    if(status == ICOM_SUCCESS && pdata->reply){
+      status = icom_recv(icom, &buf, &bufSize);
+      if(status == ICOM_SUCCESS && (bufSize != sizeof(uint32_t) || *(uint32_t*)buf != pdata->index)){
+        pdata->errors++;
+      }
+    }
+  }
+
+  icom_deinit(icom);
+  return (void*)status;
+}
+
+static void link_server(const char *txStr, const char *rxStr, uint32_t count, int reply){
+  thread_server_t senders[SERVER_SENDERS];
+  pthread_t pids[SERVER_SENDERS];
+  uint32_t next[SERVER_SENDERS] = {0};
+  uint32_t peers[SERVER_SENDERS] = {0};
+  unsigned bufSize;
+  void *buf, *ret;
+
+  icom_t *icom = icom_init(rxStr);
+  ASSERT_FALSE(ICOM_IS_ERR(icom));
+  EXPECT_EQ(icom_getPeer(icom), 0);
+
+  for(uint32_t i=0; i<SERVER_SENDERS; i++){
+    senders[i] = {txStr, i, count, reply, 0};
+    pthread_create(pids+i, NULL, thread_serverSend, senders+i);
+  }
+
+  /* messages of every sender arrive in order, each sender has its own id */
+  for(uint32_t i=0; i<SERVER_SENDERS*count; i++){
+    ASSERT_EQ(icom_recv(icom, &buf, &bufSize), ICOM_SUCCESS);
+    ASSERT_EQ(bufSize, 2*sizeof(uint32_t));
+    uint32_t index = ((uint32_t*)buf)[0];
+    ASSERT_LT(index, SERVER_SENDERS);
+    EXPECT_EQ(((uint32_t*)buf)[1], next[index]++);
+
+    uint32_t peer = icom_getPeer(icom);
+    EXPECT_NE(peer, 0);
+    if(!peers[index]){
+      peers[index] = peer;
+    }
+    EXPECT_EQ(peer, peers[index]);
+
+    if(reply){
+      ASSERT_EQ(icom_send(icom, &index, sizeof(index)), ICOM_SUCCESS);
+    }
+  }
+
+  /* the last message is acknowledged (autonotify) by the following receive,
+   * which times out once all the senders disconnect */
+  EXPECT_EQ(icom_recv(icom, &buf, &bufSize), ICOM_TIMEOUT);
+
+  for(uint32_t i=0; i<SERVER_SENDERS; i++){
+    pthread_join(pids[i], &ret);
+    EXPECT_EQ((icomStatus_t)(uintptr_t)ret, ICOM_SUCCESS);
+    EXPECT_EQ(senders[i].errors, 0);
+    EXPECT_EQ(next[i], count);
+    for(uint32_t j=0; j<i; j++){
+      EXPECT_NE(peers[i], peers[j]);
+    }
+  }
+
+  icom_deinit(icom);
+}
+
+TEST(link_socket, server_default){
+  link_server("socket_tx|default|127.0.0.1:8889", "socket_rx|default|server,timeout_us=100000|*:8889", 1000, 0);
+}
+
+TEST(link_socket, server_autonotify){
+  link_server("socket_tx|autonotify|127.0.0.1:8889", "socket_rx|autonotify|server,timeout_us=100000|*:8889", 1000, 0);
+}
+
+TEST(link_socket, server_zero){
+  link_server("socket_tx|zero,autonotify|127.0.0.1:8889", "socket_rx|zero,autonotify|server,timeout_us=100000|*:8889", 1000, 0);
+}
+
+TEST(link_socket, server_spin){
+  link_server("socket_tx|default|127.0.0.1:8889", "socket_rx|spin|server,timeout_us=100000|*:8889", 1000, 0);
+}
+
+TEST(link_socket, server_reply){
+  link_server("socket_tx|default|127.0.0.1:8889", "socket_rx|default|server,timeout_us=100000|*:8889", 100, 1);
+}
+
+TEST(link_socket, server_disconnect){
+  uint32_t txBuf = 0xdeadbeef;
+  unsigned bufSize;
+  void *buf;
+
+  icom_t *icom_rx = icom_init("socket_rx|default|server,timeout_us=50000|*:8889");
+  ASSERT_FALSE(ICOM_IS_ERR(icom_rx));
+
+  /* nothing to reply to yet */
+  EXPECT_EQ(icom_send(icom_rx, &txBuf, sizeof(txBuf)), ICOM_ERROR);
+
+  for(uint32_t i=1; i<=3; i++){
+    icom_t *icom_tx = icom_init("socket_tx|default|127.0.0.1:8889");
+    ASSERT_FALSE(ICOM_IS_ERR(icom_tx));
+    ASSERT_EQ(icom_send(icom_tx, &txBuf, sizeof(txBuf)), ICOM_SUCCESS);
+    icom_deinit(icom_tx);
+
+    /* the sender is gone, its queued message is still delivered */
+    ASSERT_EQ(icom_recv(icom_rx, &buf, &bufSize), ICOM_SUCCESS);
+    EXPECT_EQ(*(uint32_t*)buf, txBuf);
+    EXPECT_EQ(icom_getPeer(icom_rx), i);
+  }
+
+  /* disconnections are not reported, the server waits for more senders */
+  EXPECT_EQ(icom_recv(icom_rx, &buf, &bufSize), ICOM_TIMEOUT);
+  icom_deinit(icom_rx);
+
+  EXPECT_TRUE(ICOM_IS_ERR(icom_init("socket_tx|default|server|127.0.0.1:8889")));
+}
+
+/* peers which stall or vanish within a message do not stop the server */
+TEST(link_socket, server_broken_peer){
+  icomMsgHeader_t header = {ICOM_TYPE_SOCKET_TX, ICOM_FLAG_DEFAULT, 100, 0, 0};
+  uint8_t data[10] = {0};
+  uint32_t txBuf = 0xdeadbeef;
+  unsigned bufSize, received = 0;
+  icomStatus_t status;
+  void *buf;
+
+  icom_t *icom_rx = icom_init("socket_rx|default|server,timeout_us=200000|*:8889");
+  ASSERT_FALSE(ICOM_IS_ERR(icom_rx));
+
+  /* a partial header, the peer stays connected */
+  int fdStalled = raw_connect(8889);
+  ASSERT_NE(fdStalled, -1);
+  ASSERT_EQ(send(fdStalled, &header, 4, 0), 4);
+
+  /* a header and a part of the payload, then the peer is gone */
+  int fdClosed = raw_connect(8889);
+  ASSERT_NE(fdClosed, -1);
+  ASSERT_EQ(send(fdClosed, &header, sizeof(header), 0), (ssize_t)sizeof(header));
+  ASSERT_EQ(send(fdClosed, data, sizeof(data), 0), (ssize_t)sizeof(data));
+  close(fdClosed);
+
+  icom_t *icom_tx = icom_init("socket_tx|default|127.0.0.1:8889");
+  ASSERT_FALSE(ICOM_IS_ERR(icom_tx));
+  ASSERT_EQ(icom_send(icom_tx, &txBuf, sizeof(txBuf)), ICOM_SUCCESS);
+
+  /* the broken message is reported, the good one delivered */
+  while((status = icom_recv(icom_rx, &buf, &bufSize)) != ICOM_TIMEOUT){
+    if(status == ICOM_SUCCESS){
+      EXPECT_EQ(bufSize, sizeof(txBuf));
+      EXPECT_EQ(*(uint32_t*)buf, txBuf);
+      received++;
+    }
+  }
+  EXPECT_EQ(received, 1);
+
+  close(fdStalled);
+  icom_deinit(icom_tx);
+  icom_deinit(icom_rx);
+}
+
+typedef struct {
+  icom_t    *icom;
+  uint32_t   received;
+} thread_shard_t;
+
+/* receives until the senders are gone (timeout) */
+void* thread_shardRecv(void *p){
+  thread_shard_t *pdata = (thread_shard_t*)p;
+  unsigned bufSize;
+  void *buf;
+
+  while(icom_recv(pdata->icom, &buf, &bufSize) == ICOM_SUCCESS){
+    pdata->received++;
+  }
+  return NULL;
+}
+
+static void link_reuseport(const char *rxStr){
+  thread_shard_t shards[2];
+  thread_server_t senders[SERVER_SENDERS];
+  pthread_t pidsRx[2], pidsTx[SERVER_SENDERS];
+  void *ret;
+
+  /* receivers of the same port share it */
+  for(unsigned i=0; i<2; i++){
+    shards[i] = {icom_init(rxStr), 0};
+    ASSERT_FALSE(ICOM_IS_ERR(shards[i].icom));
+  }
+
+  for(uint32_t i=0; i<SERVER_SENDERS; i++){
+    senders[i] = {"socket_tx|default|127.0.0.1:8889", i, 100, 0, 0};
+    pthread_create(pidsTx+i, NULL, thread_serverSend, senders+i);
+  }
+  for(unsigned i=0; i<2; i++){
+    pthread_create(pidsRx+i, NULL, thread_shardRecv, shards+i);
+  }
+
+  for(uint32_t i=0; i<SERVER_SENDERS; i++){
+    pthread_join(pidsTx[i], &ret);
+    EXPECT_EQ((icomStatus_t)(uintptr_t)ret, ICOM_SUCCESS);
+  }
+  for(unsigned i=0; i<2; i++){
+    pthread_join(pidsRx[i], &ret);
+    icom_deinit(shards[i].icom);
+  }
+
+  /* every connection is served by one of them */
+  EXPECT_EQ(shards[0].received + shards[1].received, SERVER_SENDERS*100);
+}
+
+TEST(link_socket, reuseport){
+  link_reuseport("socket_rx|default|server,reuseport,timeout_us=100000|*:8889");
+
+  EXPECT_TRUE(ICOM_IS_ERR(icom_init("socket_tx|default|reuseport|127.0.0.1:8889")));
+}
+
+TEST(link_socket, reuseport_cpu){
+  link_reuseport("socket_rx|default|server,reuseport=cpu,timeout_us=100000|*:8889");
+}
 
 ////////////////////////////////////////////////////////////////////////////////
 // TEST-RELATED - FAN-IN COMMUNICATION
@@ -0,0 +1,235 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include "gtest/gtest.h"
+
+#include <vector>
+
+extern "C" {
+  #include "icom.h"
+  #include "link_udp.h"
+}
+
+#define MCAST_RECEIVERS 3
+#define MCAST_GROUP     "239.255.0.1"
+#define MCAST_PORT      8889
+
+////////////////////////////////////////////////////////////////////////////////
+// UTILITIES
+////////////////////////////////////////////////////////////////////////////////
+
+/* sends a hand-made fragment to the group (loss injection) */
+static void mcast_sendFragment(int fd, uint32_t seq, uint32_t bufSize, uint32_t offset, uint32_t size){
+  struct sockaddr_in group = {};
+  std::vector<uint8_t> datagram(sizeof(icomUdpHeader_t) + size, (uint8_t)seq);
+  icomUdpHeader_t header = {0x1234, seq, bufSize, offset};
+
+  group.sin_family = AF_INET;
+  group.sin_port   = htons(MCAST_PORT);
+  inet_aton(MCAST_GROUP, &group.sin_addr);
+  memcpy(datagram.data(), &header, sizeof(header));
+  ASSERT_EQ(sendto(fd, datagram.data(), datagram.size(), 0, (struct sockaddr*)&group, sizeof(group)),
+            (ssize_t)datagram.size());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// TESTS
+////////////////////////////////////////////////////////////////////////////////
+
+TEST(link_udp, mcast_init){
+  icom_t *icom;
+
+  /* unicast addresses, acknowledged transfers and server options are refused */
+  icom = icom_init("mcast_tx|default|127.0.0.1:8889");
+  ASSERT_EQ((icomStatus_t)(uintptr_t)icom, ICOM_EINVAL);
+  icom = icom_init("mcast_rx|zero|" MCAST_GROUP ":8889");
+  ASSERT_EQ((icomStatus_t)(uintptr_t)icom, ICOM_EINVAL);
+  icom = icom_init("mcast_rx|default|server|" MCAST_GROUP ":8889");
+  ASSERT_EQ((icomStatus_t)(uintptr_t)icom, ICOM_EINVAL);
+  icom = icom_init("mcast_tx|default|iface=localhost|" MCAST_GROUP ":8889");
+  ASSERT_EQ((icomStatus_t)(uintptr_t)icom, ICOM_EINVAL);
+
+  icom = icom_init("mcast_tx|default|iface=127.0.0.1,ttl=0|" MCAST_GROUP ":8889");
+  ASSERT_FALSE(ICOM_IS_ERR(icom));
+  ASSERT_EQ(icom->type, ICOM_TYPE_MCAST_TX);
+  icom_deinit(icom);
+
+  icom = icom_init("mcast_rx|timeout|iface=127.0.0.1|" MCAST_GROUP ":8889");
+  ASSERT_FALSE(ICOM_IS_ERR(icom));
+  ASSERT_EQ(icom->type, ICOM_TYPE_MCAST_RX);
+  icom_deinit(icom);
+}
+
+TEST(link_udp, mcast_fanout){
+  icom_t *rx[MCAST_RECEIVERS], *tx;
+  icomLossStats_t stats;
+  unsigned sizes[] = {0, 1, LINK_UDP_PAYLOAD, LINK_UDP_PAYLOAD+1, 100000};
+  unsigned bufSize;
+  void *buf;
+
+  /* receivers join before the first message is sent */
+  for(unsigned i=0; i<MCAST_RECEIVERS; i++){
+    rx[i] = icom_init("mcast_rx|timeout|iface=127.0.0.1,rcvbuf=1M|" MCAST_GROUP ":8889");
+    ASSERT_FALSE(ICOM_IS_ERR(rx[i]));
+  }
+  tx = icom_init("mcast_tx|default|iface=127.0.0.1|" MCAST_GROUP ":8889");
+  ASSERT_FALSE(ICOM_IS_ERR(tx));
+
+  for(unsigned i=0; i<sizeof(sizes)/sizeof(*sizes); i++){
+    std::vector<uint8_t> msg(sizes[i]);
+    for(unsigned j=0; j<sizes[i]; j++){
+      msg[j] = (uint8_t)(i + j*7);
+    }
+    ASSERT_EQ(icom_send(tx, msg.data(), sizes[i]), ICOM_SUCCESS);
+
+    /* every receiver gets the single copy sent */
+    for(unsigned r=0; r<MCAST_RECEIVERS; r++){
+      ASSERT_EQ(icom_recv(rx[r], &buf, &bufSize), ICOM_SUCCESS);
+      ASSERT_EQ(bufSize, sizes[i]);
+      ASSERT_EQ(memcmp(buf, msg.data(), sizes[i]), 0);
+      ASSERT_EQ(icom_getId(rx[r]), i+1);
+    }
+  }
+
+  for(unsigned r=0; r<MCAST_RECEIVERS; r++){
+    ASSERT_EQ(icom_recv(rx[r], &buf, &bufSize), ICOM_TIMEOUT);
+    ASSERT_EQ(icom_getLossStats(rx[r], &stats), ICOM_SUCCESS);
+    ASSERT_EQ(stats.messages, sizeof(sizes)/sizeof(*sizes));
+    ASSERT_EQ(stats.lost, 0u);
+    ASSERT_EQ(stats.gaps, 0u);
+    icom_deinit(rx[r]);
+  }
+  icom_deinit(tx);
+}
+
+TEST(link_udp, mcast_gaps){
+  icomLossStats_t stats;
+  struct in_addr iface;
+  unsigned bufSize;
+  void *buf;
+  int fd;
+
+  icom_t *rx = icom_init("mcast_rx|timeout|iface=127.0.0.1|" MCAST_GROUP ":8889");
+  ASSERT_FALSE(ICOM_IS_ERR(rx));
+
+  fd = socket(AF_INET, SOCK_DGRAM, 0);
+  ASSERT_NE(fd, -1);
+  inet_aton("127.0.0.1", &iface);
+  ASSERT_EQ(setsockopt(fd, IPPROTO_IP, IP_MULTICAST_IF, &iface, sizeof(iface)), 0);
+
+  /* the 2nd message misses its last fragment, the 3rd one is lost, the late
+   * fragment of the 2nd message is dropped */
+  mcast_sendFragment(fd, 1, 16, 0, 16);
+  mcast_sendFragment(fd, 2, 32, 0, 16);
+  mcast_sendFragment(fd, 4, 8, 0, 8);
+  mcast_sendFragment(fd, 2, 32, 16, 16);
+  mcast_sendFragment(fd, 5, 32, 0, 16);
+  mcast_sendFragment(fd, 5, 32, 16, 16);
+
+  ASSERT_EQ(icom_recv(rx, &buf, &bufSize), ICOM_SUCCESS);
+  ASSERT_EQ(bufSize, 16u);
+  ASSERT_EQ(icom_getId(rx), 1u);
+  ASSERT_EQ(((uint8_t*)buf)[15], 1);
+  ASSERT_EQ(icom_recv(rx, &buf, &bufSize), ICOM_SUCCESS);
+  ASSERT_EQ(bufSize, 8u);
+  ASSERT_EQ(icom_getId(rx), 4u);
+  ASSERT_EQ(icom_recv(rx, &buf, &bufSize), ICOM_SUCCESS);
+  ASSERT_EQ(bufSize, 32u);
+  ASSERT_EQ(icom_getId(rx), 5u);
+  ASSERT_EQ(((uint8_t*)buf)[31], 5);
+  ASSERT_EQ(icom_recv(rx, &buf, &bufSize), ICOM_TIMEOUT);
+
+  ASSERT_EQ(icom_getLossStats(rx, &stats), ICOM_SUCCESS);
+  ASSERT_EQ(stats.messages, 3u);
+  ASSERT_EQ(stats.lost, 2u);
+  ASSERT_EQ(stats.gaps, 1u);
+
+  close(fd);
+  icom_deinit(rx);
+}
+
+TEST(link_udp, udp_init){
+  icom_t *icom;
+
+  icom = icom_init("udp_tx|default|*:8889");
+  ASSERT_EQ((icomStatus_t)(uintptr_t)icom, ICOM_EINVAL);
+  icom = icom_init("udp_rx|notify|*:8889");
+  ASSERT_EQ((icomStatus_t)(uintptr_t)icom, ICOM_EINVAL);
+
+  icom = icom_init("udp_rx|timeout|*:[8889-8891]");
+  ASSERT_FALSE(ICOM_IS_ERR(icom));
+  ASSERT_EQ(icom->type, ICOM_TYPE_UDP_RX);
+  ASSERT_EQ(icom->comCount, 3u);
+  icom_deinit(icom);
+}
+
+TEST(link_udp, udp_transfer){
+  unsigned sizes[] = {0, 7, LINK_UDP_PAYLOAD, 3*LINK_UDP_PAYLOAD+5, 64*1024, 128*1024};
+  icomLossStats_t stats;
+  unsigned bufSize;
+  void *buf;
+
+  icom_t *rx = icom_init("udp_rx|timeout|rcvbuf=1M|*:8889");
+  ASSERT_FALSE(ICOM_IS_ERR(rx));
+  icom_t *tx = icom_init("udp_tx|default|127.0.0.1:8889");
+  ASSERT_FALSE(ICOM_IS_ERR(tx));
+
+  for(unsigned i=0; i<sizeof(sizes)/sizeof(*sizes); i++){
+    std::vector<uint8_t> msg(sizes[i]);
+    for(unsigned j=0; j<sizes[i]; j++){
+      msg[j] = (uint8_t)(i*13 + j);
+    }
+    ASSERT_EQ(icom_send(tx, msg.data(), sizes[i]), ICOM_SUCCESS);
+    ASSERT_EQ(icom_recv(rx, &buf, &bufSize), ICOM_SUCCESS);
+    ASSERT_EQ(bufSize, sizes[i]);
+    ASSERT_EQ(memcmp(buf, msg.data(), sizes[i]), 0);
+    ASSERT_EQ(icom_getId(rx), i+1);
+  }
+
+  /* large messages are sent by the offloaded path (loopback supports it) */
+  ASSERT_TRUE(((icomLinkUdp_t*)tx->comConnections[0].pdata)->gso);
+  ASSERT_EQ(icom_recv(rx, &buf, &bufSize), ICOM_TIMEOUT);
+  ASSERT_EQ(icom_getLossStats(rx, &stats), ICOM_SUCCESS);
+  ASSERT_EQ(stats.messages, sizeof(sizes)/sizeof(*sizes));
+  ASSERT_EQ(stats.lost, 0u);
+
+  icom_deinit(tx);
+  icom_deinit(rx);
+}
+
+TEST(link_udp, udp_overflow){
+  const unsigned count = 64, size = 16*1024;
+  std::vector<uint8_t> msg(size, 0x5a);
+  icomLossStats_t stats;
+  unsigned bufSize, received = 0;
+  void *buf;
+
+  /* the receiver's socket buffer overflows, the sender does not block */
+  icom_t *rx = icom_init("udp_rx|timeout|rcvbuf=64k|*:8889");
+  ASSERT_FALSE(ICOM_IS_ERR(rx));
+  icom_t *tx = icom_init("udp_tx|default|127.0.0.1:8889");
+  ASSERT_FALSE(ICOM_IS_ERR(tx));
+  for(unsigned i=0; i<count; i++){
+    ASSERT_EQ(icom_send(tx, msg.data(), size), ICOM_SUCCESS);
+  }
+  while(icom_recv(rx, &buf, &bufSize) == ICOM_SUCCESS){
+    ASSERT_EQ(bufSize, size);
+    received++;
+  }
+  ASSERT_GT(received, 0u);
+  ASSERT_LT(received, count);
+
+  /* the losses are detected by the next message */
+  ASSERT_EQ(icom_send(tx, msg.data(), size), ICOM_SUCCESS);
+  ASSERT_EQ(icom_recv(rx, &buf, &bufSize), ICOM_SUCCESS);
+  ASSERT_EQ(icom_getId(rx), count+1);
+  ASSERT_EQ(icom_getLossStats(rx, &stats), ICOM_SUCCESS);
+  ASSERT_EQ(stats.messages, received+1);
+  ASSERT_EQ(stats.messages + stats.lost, count+1);
+  ASSERT_GE(stats.gaps, 1u);
+
+  icom_deinit(tx);
+  icom_deinit(rx);
+}
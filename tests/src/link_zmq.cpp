@@ -0,0 +1,577 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "gtest/gtest.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+extern "C" {
+  #include "icom.h"
+  #include "link_zmq.h"
+}
+
+#define PUSH_WORKERS 3
+#define PUSH_COUNT   300
+
+////////////////////////////////////////////////////////////////////////////////
+// UTILITIES
+////////////////////////////////////////////////////////////////////////////////
+
+typedef struct {
+  icom_t    *icom;
+  unsigned   delayUs;  /** processing time of a message */
+  uint32_t   count;    /** messages received */
+  uint32_t   last;     /** sequence number of the last message */
+  uint32_t   errors;   /** out of order messages */
+} thread_pull_t;
+
+/* receives until the pushers go quiet (timeout_us option) */
+void* thread_pull(void *p){
+  thread_pull_t *pdata = (thread_pull_t*)p;
+  icomStatus_t status;
+  unsigned bufSize;
+  void *buf;
+
+  while((status = icom_recv(pdata->icom, &buf, &bufSize)) == ICOM_SUCCESS){
+    uint32_t seq = *(uint32_t*)buf;
+    if(pdata->count && seq <= pdata->last){
+      pdata->errors++;
+    }
+    pdata->last = seq;
+    pdata->count++;
+    if(pdata->delayUs){
+      usleep(pdata->delayUs);
+    }
+  }
+  return (void*)status;
+}
+
+/* pushes sequence numbers in messages of the given size to pull workers bound
+ * to consecutive ports, returns the workers' counters */
+static void link_push(const char *txStr, const char *rxStr, unsigned size,
+                      thread_pull_t *workers, unsigned workerCount){
+  pthread_t pids[workerCount];
+  char str[128];
+  void *ret;
+
+  /* workers listen before the pusher connects */
+  for(unsigned i=0; i<workerCount; i++){
+    snprintf(str, sizeof(str), "%s%u", rxStr, 8889+i);
+    workers[i].icom = icom_init(str);
+    ASSERT_FALSE(ICOM_IS_ERR(workers[i].icom));
+    pthread_create(pids+i, NULL, thread_pull, workers+i);
+  }
+
+  icom_t *icom = icom_init(txStr);
+  ASSERT_FALSE(ICOM_IS_ERR(icom));
+  uint32_t *msg = (uint32_t*)(icom->shm ? icom_alloc(icom, size) : calloc(1, size));
+  ASSERT_TRUE(msg != NULL);
+
+  for(uint32_t i=0; i<PUSH_COUNT; i++){
+    msg[0] = i;
+    ASSERT_EQ(icom_send(icom, msg, size), ICOM_SUCCESS);
+  }
+
+  /* the last messages are acknowledged (autonotify) by the following receives,
+   * which time out */
+  for(unsigned i=0; i<workerCount; i++){
+    pthread_join(pids[i], &ret);
+    EXPECT_EQ((icomStatus_t)(uintptr_t)ret, ICOM_TIMEOUT);
+    EXPECT_EQ(workers[i].errors, 0);
+    icom_deinit(workers[i].icom);
+  }
+
+  if(icom->shm){
+    icom_free(icom, msg);
+  } else {
+    free(msg);
+  }
+  icom_deinit(icom);
+}
+
+static void link_pushRoundRobin(const char *txStr, const char *rxStr){
+  thread_pull_t workers[PUSH_WORKERS] = {};
+
+  link_push(txStr, rxStr, sizeof(uint32_t), workers, PUSH_WORKERS);
+
+  /* every worker gets every PUSH_WORKERS-th message */
+  for(unsigned i=0; i<PUSH_WORKERS; i++){
+    EXPECT_EQ(workers[i].count, PUSH_COUNT/PUSH_WORKERS);
+    EXPECT_EQ(workers[i].last, PUSH_COUNT - PUSH_WORKERS + i);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// TEST-RELATED - INITIALIZATION/DEINITIALIZATION
+////////////////////////////////////////////////////////////////////////////////
+TEST(link_zmq, init){
+  icom_t *icom;
+
+  icom = icom_init("zmq_push|default|127.0.0.1:[8889-8891]");
+  ASSERT_FALSE(ICOM_IS_ERR(icom));
+  EXPECT_EQ(icom->comCount, 3);
+  icom_deinit(icom);
+
+  /* pullers serve any number of pushers on a single address */
+  icom = icom_init("zmq_pull|default|*:8889");
+  ASSERT_FALSE(ICOM_IS_ERR(icom));
+  EXPECT_EQ(icom->options.server, 1);
+  icom_deinit(icom);
+
+  EXPECT_TRUE(ICOM_IS_ERR(icom_init("zmq_pull|default|*:[8889-8890]")));
+  EXPECT_TRUE(ICOM_IS_ERR(icom_init("zmq_push|default|server|127.0.0.1:8889")));
+  EXPECT_TRUE(ICOM_IS_ERR(icom_init("zmq_push|default|balance=lru|127.0.0.1:8889")));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// TEST-RELATED - LOAD BALANCING (PUSH)
+////////////////////////////////////////////////////////////////////////////////
+TEST(link_zmq, push_default){
+  link_pushRoundRobin(
+    "zmq_push|default|127.0.0.1:[8889-8891]",
+    "zmq_pull|default|timeout_us=100000|*:");
+}
+
+TEST(link_zmq, push_autonotify){
+  link_pushRoundRobin(
+    "zmq_push|autonotify|127.0.0.1:[8889-8891]",
+    "zmq_pull|autonotify|timeout_us=100000|*:");
+}
+
+TEST(link_zmq, push_zero){
+  link_pushRoundRobin(
+    "zmq_push|zero,autonotify|127.0.0.1:[8889-8891]",
+    "zmq_pull|zero,autonotify|timeout_us=100000|*:");
+}
+
+/* a slow worker's full send queue diverts the messages to the idle one */
+TEST(link_zmq, push_outq){
+  thread_pull_t workers[2] = {};
+  workers[0].delayUs = 2000;
+
+  link_push(
+    "zmq_push|default|balance=outq,sndbuf=64k|127.0.0.1:[8889-8890]",
+    "zmq_pull|default|rcvbuf=64k,timeout_us=100000|*:",
+    64*1024, workers, 2);
+
+  EXPECT_EQ(workers[0].count + workers[1].count, PUSH_COUNT);
+  EXPECT_GT(workers[1].count, workers[0].count);
+}
+
+/* workers which are not up are skipped */
+TEST(link_zmq, push_refused){
+  thread_pull_t worker = {};
+  pthread_t pid;
+  uint32_t msg;
+  void *ret;
+
+  worker.icom = icom_init("zmq_pull|default|timeout_us=100000|*:8889");
+  ASSERT_FALSE(ICOM_IS_ERR(worker.icom));
+  pthread_create(&pid, NULL, thread_pull, &worker);
+
+  icom_t *icom = icom_init("zmq_push|default|127.0.0.1:8890,127.0.0.1:8889");
+  ASSERT_FALSE(ICOM_IS_ERR(icom));
+  for(msg=0; msg<PUSH_COUNT; msg++){
+    ASSERT_EQ(icom_send(icom, &msg, sizeof(msg)), ICOM_SUCCESS);
+  }
+
+  pthread_join(pid, &ret);
+  EXPECT_EQ(worker.count, PUSH_COUNT);
+  EXPECT_EQ(worker.errors, 0);
+  icom_deinit(worker.icom);
+  icom_deinit(icom);
+}
+
+/* forwarded messages are balanced as well (no splicing to all the workers) */
+TEST(link_zmq, push_forward){
+  thread_pull_t workers[2] = {};
+  icomForwardOptions_t options = {PUSH_COUNT, 0};
+  pthread_t pids[2];
+  char str[128];
+  void *ret;
+
+  for(unsigned i=0; i<2; i++){
+    snprintf(str, sizeof(str), "zmq_pull|default|timeout_us=100000|*:%u", 8889+i);
+    workers[i].icom = icom_init(str);
+    ASSERT_FALSE(ICOM_IS_ERR(workers[i].icom));
+    pthread_create(pids+i, NULL, thread_pull, workers+i);
+  }
+  icom_t *out = icom_init("zmq_push|default|127.0.0.1:[8889-8890]");
+  ASSERT_FALSE(ICOM_IS_ERR(out));
+  icom_t *in = icom_init("socket_rx|default|*:8891");
+  ASSERT_FALSE(ICOM_IS_ERR(in));
+  icom_t *tx = icom_init("socket_tx|default|127.0.0.1:8891");
+  ASSERT_FALSE(ICOM_IS_ERR(tx));
+
+  /* the relay runs in this thread, small messages fit the socket buffers */
+  for(uint32_t msg=0; msg<PUSH_COUNT; msg++){
+    ASSERT_EQ(icom_send(tx, &msg, sizeof(msg)), ICOM_SUCCESS);
+  }
+  EXPECT_EQ(icom_forward(in, out, &options), ICOM_SUCCESS);
+
+  for(unsigned i=0; i<2; i++){
+    pthread_join(pids[i], &ret);
+    EXPECT_EQ(workers[i].count, PUSH_COUNT/2);
+    EXPECT_EQ(workers[i].errors, 0);
+    icom_deinit(workers[i].icom);
+  }
+  icom_deinit(tx);
+  icom_deinit(in);
+  icom_deinit(out);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// TEST-RELATED - FAIR QUEUING (PULL)
+////////////////////////////////////////////////////////////////////////////////
+void* thread_push(void *p){
+  icomStatus_t status = ICOM_SUCCESS;
+  uint32_t msg[2] = {(uint32_t)(uintptr_t)p, 0};
+
+  icom_t *icom = icom_init("zmq_push|default|127.0.0.1:8889");
+  if(ICOM_IS_ERR(icom)){
+    return (void*)icom;
+  }
+  for(; msg[1]<PUSH_COUNT && status == ICOM_SUCCESS; msg[1]++){
+    status = icom_send(icom, msg, sizeof(msg));
+  }
+  icom_deinit(icom);
+  return (void*)status;
+}
+
+TEST(link_zmq, pull_pushers){
+  pthread_t pids[PUSH_WORKERS];
+  uint32_t next[PUSH_WORKERS] = {0};
+  unsigned bufSize;
+  void *buf, *ret;
+
+  icom_t *icom = icom_init("zmq_pull|default|timeout_us=100000|*:8889");
+  ASSERT_FALSE(ICOM_IS_ERR(icom));
+  for(uintptr_t i=0; i<PUSH_WORKERS; i++){
+    pthread_create(pids+i, NULL, thread_push, (void*)i);
+  }
+
+  /* messages of every pusher arrive in order */
+  for(unsigned i=0; i<PUSH_WORKERS*PUSH_COUNT; i++){
+    ASSERT_EQ(icom_recv(icom, &buf, &bufSize), ICOM_SUCCESS);
+    ASSERT_EQ(bufSize, 2*sizeof(uint32_t));
+    uint32_t index = ((uint32_t*)buf)[0];
+    ASSERT_LT(index, PUSH_WORKERS);
+    EXPECT_EQ(((uint32_t*)buf)[1], next[index]++);
+    EXPECT_NE(icom_getPeer(icom), 0);
+  }
+  EXPECT_EQ(icom_recv(icom, &buf, &bufSize), ICOM_TIMEOUT);
+
+  for(unsigned i=0; i<PUSH_WORKERS; i++){
+    pthread_join(pids[i], &ret);
+    EXPECT_EQ((icomStatus_t)(uintptr_t)ret, ICOM_SUCCESS);
+  }
+  icom_deinit(icom);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// TEST-RELATED - PUBLISH/SUBSCRIBE
+////////////////////////////////////////////////////////////////////////////////
+
+/* receives until the publisher goes quiet (timeout_us option) */
+static std::vector<std::string> link_subRecv(icom_t *icom){
+  std::vector<std::string> msgs;
+  unsigned bufSize;
+  void *buf;
+
+  while(icom_recv(icom, &buf, &bufSize) == ICOM_SUCCESS){
+    msgs.push_back(std::string((char*)buf, bufSize));
+  }
+  return msgs;
+}
+
+typedef struct {
+  icom_t    *icom;
+  void      *buf;
+  unsigned   bufSize;
+} thread_publish_t;
+
+void* thread_publish(void *p){
+  thread_publish_t *pdata = (thread_publish_t*)p;
+  return (void*)icom_send(pdata->icom, pdata->buf, pdata->bufSize);
+}
+
+static void link_publish(icom_t *icom, const char *msg){
+  ASSERT_EQ(icom_send(icom, (void*)msg, strlen(msg)), ICOM_SUCCESS);
+}
+
+TEST(link_zmq, pub_init){
+  EXPECT_TRUE(ICOM_IS_ERR(icom_init("zmq_pub|zero|*:8889")));
+  EXPECT_TRUE(ICOM_IS_ERR(icom_init("zmq_sub|autonotify|127.0.0.1:8889")));
+
+  /* subscribers connect right away */
+  EXPECT_EQ((icomStatus_t)(uintptr_t)icom_init("zmq_sub|default|127.0.0.1:8889"), ICOM_ECONNREFUSED);
+}
+
+TEST(link_zmq, pub_topics){
+  const char *msgs[] = {"weather.sun", "news.local", "sport", "weather.rain", ""};
+  icom_t *pub, *subs[4];
+
+  pub = icom_init("zmq_pub|default|*:8889");
+  ASSERT_FALSE(ICOM_IS_ERR(pub));
+  subs[0] = icom_init("zmq_sub|default|topic=weather,timeout_us=100000|127.0.0.1:8889");
+  subs[1] = icom_init("zmq_sub|default|topic=news,topic=sport,timeout_us=100000|127.0.0.1:8889");
+  subs[2] = icom_init("zmq_sub|default|timeout_us=100000|127.0.0.1:8889");
+  subs[3] = icom_init("zmq_sub|default|topic=weather,topic=weather.rain,topic=,timeout_us=100000|127.0.0.1:8889");
+  for(icom_t *sub : subs){
+    ASSERT_FALSE(ICOM_IS_ERR(sub));
+  }
+
+  for(const char *msg : msgs){
+    link_publish(pub, msg);
+  }
+
+  /* subscribers matching several prefixes get a message once */
+  EXPECT_EQ(link_subRecv(subs[0]), std::vector<std::string>({"weather.sun", "weather.rain"}));
+  EXPECT_EQ(link_subRecv(subs[1]), std::vector<std::string>({"news.local", "sport"}));
+  EXPECT_EQ(link_subRecv(subs[2]), std::vector<std::string>(msgs, msgs+5));
+  EXPECT_EQ(link_subRecv(subs[3]), std::vector<std::string>(msgs, msgs+5));
+
+  for(icom_t *sub : subs){
+    icom_deinit(sub);
+  }
+  icom_deinit(pub);
+}
+
+TEST(link_zmq, pub_join_leave){
+  icom_t *pub, *early, *late;
+
+  pub = icom_init("zmq_pub|default|*:8889");
+  ASSERT_FALSE(ICOM_IS_ERR(pub));
+  icomLinkZmq_t *pdata = (icomLinkZmq_t*)pub->comConnections[0].pdata;
+
+  /* publishing without subscribers drops the message */
+  link_publish(pub, "topic.0");
+
+  early = icom_init("zmq_sub|default|topic=topic,timeout_us=100000|127.0.0.1:8889");
+  ASSERT_FALSE(ICOM_IS_ERR(early));
+  link_publish(pub, "topic.1");
+
+  late = icom_init("zmq_sub|default|topic=topic,timeout_us=100000|127.0.0.1:8889");
+  ASSERT_FALSE(ICOM_IS_ERR(late));
+  link_publish(pub, "topic.2");
+  EXPECT_EQ(pdata->subCount, 2);
+
+  EXPECT_EQ(link_subRecv(early), std::vector<std::string>({"topic.1", "topic.2"}));
+  icom_deinit(early);
+  link_publish(pub, "topic.3");
+  EXPECT_EQ(pdata->subCount, 1);
+
+  EXPECT_EQ(link_subRecv(late), std::vector<std::string>({"topic.2", "topic.3"}));
+  icom_deinit(late);
+  icom_deinit(pub);
+}
+
+/* a subscription arriving in parts does not hold the publisher up */
+TEST(link_zmq, pub_partial_subscription){
+  icomMsgHeader_t header = {ICOM_TYPE_ZMQ_SUB, ICOM_FLAG_CONTROL, 0, 0, 0};
+  struct sockaddr_in addr = {};
+  icom_t *pub, *sub;
+
+  pub = icom_init("zmq_pub|default|*:8889");
+  ASSERT_FALSE(ICOM_IS_ERR(pub));
+  icomLinkZmq_t *pdata = (icomLinkZmq_t*)pub->comConnections[0].pdata;
+  sub = icom_init("zmq_sub|default|topic=topic,timeout_us=100000|127.0.0.1:8889");
+  ASSERT_FALSE(ICOM_IS_ERR(sub));
+
+  addr.sin_family      = AF_INET;
+  addr.sin_port        = htons(8889);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  ASSERT_EQ(connect(fd, (struct sockaddr*)&addr, sizeof(addr)), 0);
+  ASSERT_EQ(send(fd, &header, 4, 0), 4);
+  usleep(10000);
+  link_publish(pub, "topic.1");
+
+  /* the rest of the subscription completes it */
+  ASSERT_EQ(send(fd, (uint8_t*)&header + 4, sizeof(header) - 4, 0), (ssize_t)sizeof(header) - 4);
+  usleep(10000);
+  link_publish(pub, "topic.2");
+  EXPECT_EQ(pdata->subCount, 2);
+
+  /* a subscriber gone within its subscription is dropped */
+  ASSERT_EQ(send(fd, &header, 4, 0), 4);
+  close(fd);
+  usleep(10000);
+  link_publish(pub, "topic.3");
+  EXPECT_EQ(pdata->subCount, 1);
+
+  EXPECT_EQ(link_subRecv(sub), std::vector<std::string>({"topic.1", "topic.2", "topic.3"}));
+  icom_deinit(sub);
+  icom_deinit(pub);
+}
+
+TEST(link_zmq, pub_large){
+  std::vector<uint8_t> msg(4*1024*1024, 0xa5);
+  unsigned bufSize;
+  void *buf;
+
+  icom_t *pub = icom_init("zmq_pub|default|*:8889");
+  ASSERT_FALSE(ICOM_IS_ERR(pub));
+  icom_t *sub = icom_init("zmq_sub|default|timeout_us=1000000|127.0.0.1:8889");
+  ASSERT_FALSE(ICOM_IS_ERR(sub));
+
+  /* the publisher blocks until the subscriber drains the socket */
+  thread_publish_t publish = {pub, msg.data(), (unsigned)msg.size()};
+  pthread_t pid;
+  void *ret;
+  pthread_create(&pid, NULL, thread_publish, &publish);
+  ASSERT_EQ(icom_recv(sub, &buf, &bufSize), ICOM_SUCCESS);
+  EXPECT_EQ(bufSize, msg.size());
+  EXPECT_EQ(memcmp(buf, msg.data(), msg.size()), 0);
+  pthread_join(pid, &ret);
+  EXPECT_EQ((icomStatus_t)(uintptr_t)ret, ICOM_SUCCESS);
+
+  icom_deinit(sub);
+  icom_deinit(pub);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// TEST-RELATED - REQUEST/REPLY
+////////////////////////////////////////////////////////////////////////////////
+#define REQ_COUNT  600
+#define REQ_WINDOW 30
+
+typedef struct {
+  icom_t    *icom;
+  unsigned   delayUs;  /** processing time of a request */
+  uint32_t   count;    /** requests served */
+} thread_rep_t;
+
+/* replies with the doubled request until the requesters go quiet */
+void* thread_rep(void *p){
+  thread_rep_t *pdata = (thread_rep_t*)p;
+  icomStatus_t status;
+  unsigned bufSize;
+  uint32_t reply;
+  void *buf;
+
+  while((status = icom_recv(pdata->icom, &buf, &bufSize)) == ICOM_SUCCESS){
+    reply = 2*(*(uint32_t*)buf);
+    if(pdata->delayUs){
+      usleep(pdata->delayUs);
+    }
+    status = icom_send(pdata->icom, &reply, sizeof(reply));
+    if(status != ICOM_SUCCESS){
+      break;
+    }
+    pdata->count++;
+  }
+  return (void*)status;
+}
+
+/* keeps REQ_WINDOW requests in flight, returns the number of replies which
+ * overtook an older request */
+static void link_reqRep(const char *reqStr, const char **repStrs, thread_rep_t *workers,
+                        unsigned workerCount, unsigned *overtaken){
+  pthread_t pids[workerCount];
+  std::map<uint32_t, uint32_t> pending;
+  unsigned bufSize;
+  void *buf, *ret;
+
+  for(unsigned i=0; i<workerCount; i++){
+    workers[i].icom = icom_init(repStrs[i]);
+    ASSERT_FALSE(ICOM_IS_ERR(workers[i].icom));
+    pthread_create(pids+i, NULL, thread_rep, workers+i);
+  }
+
+  icom_t *icom = icom_init(reqStr);
+  ASSERT_FALSE(ICOM_IS_ERR(icom));
+  EXPECT_EQ(icom_getId(icom), 0);
+
+  *overtaken = 0;
+  for(uint32_t i=0; i<REQ_COUNT; i+=REQ_WINDOW){
+    for(uint32_t j=i; j<i+REQ_WINDOW; j++){
+      ASSERT_EQ(icom_send(icom, &j, sizeof(j)), ICOM_SUCCESS);
+      ASSERT_NE(icom_getId(icom), 0);
+      ASSERT_EQ(pending.count(icom_getId(icom)), 0);
+      pending[icom_getId(icom)] = j;
+    }
+
+    /* replies are matched by their correlation ids */
+    for(uint32_t j=0; j<REQ_WINDOW; j++){
+      ASSERT_EQ(icom_recv(icom, &buf, &bufSize), ICOM_SUCCESS);
+      ASSERT_EQ(bufSize, sizeof(uint32_t));
+      auto request = pending.find(icom_getId(icom));
+      ASSERT_NE(request, pending.end());
+      EXPECT_EQ(*(uint32_t*)buf, 2*request->second);
+      if(request != pending.begin()){
+        (*overtaken)++;
+      }
+      pending.erase(request);
+    }
+  }
+  EXPECT_TRUE(pending.empty());
+  icom_deinit(icom);
+
+  for(unsigned i=0; i<workerCount; i++){
+    pthread_join(pids[i], &ret);
+    EXPECT_EQ((icomStatus_t)(uintptr_t)ret, ICOM_TIMEOUT);
+    icom_deinit(workers[i].icom);
+  }
+}
+
+TEST(link_zmq, req_init){
+  unsigned bufSize;
+  void *buf;
+
+  EXPECT_TRUE(ICOM_IS_ERR(icom_init("zmq_rep|default|*:[8889-8890]")));
+  EXPECT_TRUE(ICOM_IS_ERR(icom_init("zmq_rep|autonotify|*:8889")));
+  EXPECT_TRUE(ICOM_IS_ERR(icom_init("zmq_req|zero|127.0.0.1:8889")));
+
+  /* replies follow requests */
+  icom_t *icom = icom_init("zmq_req|default|127.0.0.1:8889");
+  ASSERT_FALSE(ICOM_IS_ERR(icom));
+  EXPECT_EQ(icom_recv(icom, &buf, &bufSize), ICOM_ERROR);
+  icom_deinit(icom);
+}
+
+TEST(link_zmq, req_rep){
+  const char *repStrs[] = {"zmq_rep|default|timeout_us=100000|*:8889"};
+  thread_rep_t workers[1] = {};
+  unsigned overtaken;
+
+  link_reqRep("zmq_req|default|127.0.0.1:8889", repStrs, workers, 1, &overtaken);
+  EXPECT_EQ(workers[0].count, REQ_COUNT);
+  EXPECT_EQ(overtaken, 0);
+}
+
+/* a slow worker's replies are overtaken by the others' */
+TEST(link_zmq, req_rep_pool){
+  const char *repStrs[] = {
+    "zmq_rep|default|timeout_us=100000|*:8889",
+    "zmq_rep|default|timeout_us=100000|*:8890",
+    "zmq_rep|spin|timeout_us=100000|*:8891"};
+  thread_rep_t workers[3] = {};
+  unsigned overtaken;
+  workers[0].delayUs = 1000;
+
+  link_reqRep("zmq_req|default|127.0.0.1:[8889-8891]", repStrs, workers, 3, &overtaken);
+  for(thread_rep_t &worker : workers){
+    EXPECT_EQ(worker.count, REQ_COUNT/3);
+  }
+  EXPECT_GT(overtaken, 0);
+}
+
+/* workers sharing the port, the kernel spreads the requester's connections */
+TEST(link_zmq, req_rep_reuseport){
+  const char *repStrs[] = {
+    "zmq_rep|default|reuseport,timeout_us=100000|*:8889",
+    "zmq_rep|default|reuseport,timeout_us=100000|*:8889"};
+  thread_rep_t workers[2] = {};
+  unsigned overtaken;
+
+  link_reqRep("zmq_req|default|127.0.0.1:8889,127.0.0.1:8889,127.0.0.1:8889,127.0.0.1:8889",
+    repStrs, workers, 2, &overtaken);
+  EXPECT_EQ(workers[0].count + workers[1].count, REQ_COUNT);
+}
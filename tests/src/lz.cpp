@@ -0,0 +1,92 @@
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "gtest/gtest.h"
+extern "C" {
+  #include "icom_lz.h"
+}
+
+/* compresses and decompresses the buffer, returns the compressed size */
+static uint32_t lz_roundtrip(const std::vector<uint8_t> &src){
+  std::vector<uint8_t> comp(src.size() + src.size()/255 + 16);
+  std::vector<uint8_t> out(src.size());
+  uint32_t size;
+
+  size = icom_lzCompress(src.data(), src.size(), comp.data(), comp.size());
+  EXPECT_GT(size, 0);
+  EXPECT_EQ(icom_lzDecompress(comp.data(), size, out.data(), out.size()), (int64_t)src.size());
+  EXPECT_EQ(out, src);
+  return size;
+}
+
+TEST(icom_lz, empty_and_short){
+  for(unsigned size=0; size<32; size++){
+    std::vector<uint8_t> src(size);
+    for(unsigned i=0; i<size; i++){
+      src[i] = i % 3;
+    }
+    lz_roundtrip(src);
+  }
+
+  /* empty messages may come without buffers */
+  uint8_t token[2];
+  ASSERT_EQ(icom_lzCompress(NULL, 0, token, sizeof(token)), 1);
+  EXPECT_EQ(icom_lzDecompress(token, 1, NULL, 0), 0);
+}
+
+TEST(icom_lz, text){
+  const char *line = "timestamp=1700000000 sensor=lidar status=ok temperature=41.5\n";
+  std::vector<uint8_t> src;
+
+  while(src.size() < 64*1024){
+    src.insert(src.end(), line, line + strlen(line));
+  }
+  EXPECT_LT(lz_roundtrip(src), src.size()/10);
+}
+
+TEST(icom_lz, sparse){
+  std::vector<uint8_t> src(1024*1024, 0);
+
+  /* long runs (overlapping matches) with a few samples */
+  for(unsigned i=0; i<src.size(); i+=997){
+    src[i] = rand();
+  }
+  EXPECT_LT(lz_roundtrip(src), src.size()/10);
+}
+
+TEST(icom_lz, random){
+  std::vector<uint8_t> src(256*1024);
+  std::vector<uint8_t> comp(src.size());
+
+  for(auto &b : src){
+    b = rand();
+  }
+  lz_roundtrip(src);
+
+  /* incompressible data gives up once the capacity is exceeded */
+  EXPECT_EQ(icom_lzCompress(src.data(), src.size(), comp.data(), src.size() - src.size()/8), 0);
+}
+
+TEST(icom_lz, malformed){
+  std::vector<uint8_t> src(4096, 'a');
+  std::vector<uint8_t> comp(src.size());
+  std::vector<uint8_t> out(src.size());
+  uint32_t size;
+
+  size = icom_lzCompress(src.data(), src.size(), comp.data(), comp.size());
+  ASSERT_GT(size, 0);
+
+  /* too small output buffer, truncated input, offset before the output */
+  EXPECT_EQ(icom_lzDecompress(comp.data(), size, out.data(), out.size()-1), -1);
+  EXPECT_EQ(icom_lzDecompress(comp.data(), size-1, out.data(), out.size()), -1);
+  uint8_t invalid[] = {0x14, 'a', 0x10, 0x00, 0x00};
+  EXPECT_EQ(icom_lzDecompress(invalid, 4, out.data(), out.size()), -1);
+
+  /* random input never crashes */
+  for(int i=0; i<1000; i++){
+    for(auto &b : comp){
+      b = rand();
+    }
+    icom_lzDecompress(comp.data(), rand() % comp.size(), out.data(), out.size());
+  }
+}
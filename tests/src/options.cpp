@@ -0,0 +1,286 @@
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <netinet/tcp.h>
+#include <linux/mempolicy.h>
+#include <vector>
+#include "gtest/gtest.h"
+#include "link_common.h"
+extern "C" {
+  #include "icom.h"
+  #include "icom_mem.h"
+  #include "icom_options.h"
+  #include "link_socket.h"
+}
+
+TEST(icom_options, default_options){
+  icomOptions_t options;
+
+  EXPECT_EQ(icom_parseOptions(&options, "default"), ICOM_SUCCESS);
+  EXPECT_EQ(options.cpu, -1);
+  EXPECT_EQ(options.node, -1);
+}
+
+TEST(icom_options, cpu_node){
+  icomOptions_t options;
+
+  EXPECT_EQ(icom_parseOptions(&options, "cpu=0,node=0"), ICOM_SUCCESS);
+  EXPECT_EQ(options.cpu, 0);
+  EXPECT_EQ(options.node, 0);
+
+  /* buffers follow the core unless placed explicitly */
+  EXPECT_EQ(icom_parseOptions(&options, "cpu=0"), ICOM_SUCCESS);
+  EXPECT_EQ(options.cpu, 0);
+  EXPECT_EQ(options.node, icom_memCpuNode(0));
+}
+
+TEST(icom_options, socket){
+  icomOptions_t options;
+
+  EXPECT_EQ(icom_parseOptions(&options, "default"), ICOM_SUCCESS);
+  EXPECT_EQ(options.sndbuf, -1);
+  EXPECT_EQ(options.quickack, 0);
+  EXPECT_EQ(options.nodelay, 1);
+  EXPECT_EQ(options.timeoutUs, -1);
+
+  EXPECT_EQ(icom_parseOptions(&options,
+    "sndbuf=4M,rcvbuf=512k,quickack,notsent_lowat=128K,timeout_us=500,nodelay=0"), ICOM_SUCCESS);
+  EXPECT_EQ(options.sndbuf, 4*1024*1024);
+  EXPECT_EQ(options.rcvbuf, 512*1024);
+  EXPECT_EQ(options.notsentLowat, 128*1024);
+  EXPECT_EQ(options.quickack, 1);
+  EXPECT_EQ(options.nodelay, 0);
+  EXPECT_EQ(options.timeoutUs, 500);
+}
+
+TEST(icom_options, mem_policy){
+  icomOptions_t options;
+
+  EXPECT_EQ(icom_parseOptions(&options, "default"), ICOM_SUCCESS);
+  EXPECT_EQ(options.memFlags, 0);
+  EXPECT_EQ(icom_parseOptions(&options, "hugepages,mlock,pretouch"), ICOM_SUCCESS);
+  EXPECT_EQ(options.memFlags, ICOM_MEM_THP | ICOM_MEM_LOCK | ICOM_MEM_PRETOUCH);
+  EXPECT_EQ(icom_parseOptions(&options, "hugepages=thp,hugepages=hugetlb,pretouch=0"), ICOM_SUCCESS);
+  EXPECT_EQ(options.memFlags, ICOM_MEM_HUGETLB);
+  EXPECT_EQ(icom_parseOptions(&options, "hugepages=0"), ICOM_SUCCESS);
+  EXPECT_EQ(options.memFlags, 0);
+}
+
+TEST(icom_options, reuseport){
+  icomOptions_t options;
+
+  EXPECT_EQ(icom_parseOptions(&options, "default"), ICOM_SUCCESS);
+  EXPECT_EQ(options.reuseport, 0);
+  EXPECT_EQ(icom_parseOptions(&options, "server,reuseport"), ICOM_SUCCESS);
+  EXPECT_EQ(options.server, 1);
+  EXPECT_EQ(options.reuseport, 1);
+  EXPECT_EQ(icom_parseOptions(&options, "reuseport=cpu"), ICOM_SUCCESS);
+  EXPECT_EQ(options.reuseport, 2);
+  EXPECT_EQ(icom_parseOptions(&options, "reuseport=ring"), ICOM_EINVAL);
+}
+
+TEST(icom_options, topic){
+  icomOptions_t options;
+  char topics[sizeof("topic=") + ICOM_TOPICS_SIZE];
+
+  EXPECT_EQ(icom_parseOptions(&options, "default"), ICOM_SUCCESS);
+  EXPECT_EQ(options.topicCount, 0);
+  EXPECT_EQ(icom_parseOptions(&options, "topic=weather,topic=,topic=news.local"), ICOM_SUCCESS);
+  EXPECT_EQ(options.topicCount, 3);
+  EXPECT_EQ(memcmp(options.topics, "weather\0\0news.local", sizeof("weather\0\0news.local")), 0);
+
+  /* the prefixes share a fixed capacity */
+  memset(topics, 'x', sizeof(topics));
+  memcpy(topics, "topic=", 6);
+  topics[sizeof(topics)-1] = '\0';
+  EXPECT_EQ(icom_parseOptions(&options, topics), ICOM_EINVAL);
+  EXPECT_EQ(icom_parseOptions(&options, "topic"), ICOM_EINVAL);
+}
+
+TEST(icom_options, multicast){
+  icomOptions_t options;
+
+  EXPECT_EQ(icom_parseOptions(&options, "default"), ICOM_SUCCESS);
+  EXPECT_EQ(options.iface, htonl(INADDR_ANY));
+  EXPECT_EQ(options.ttl, -1);
+  EXPECT_EQ(icom_parseOptions(&options, "iface=127.0.0.1,ttl=4"), ICOM_SUCCESS);
+  EXPECT_EQ(options.iface, htonl(INADDR_LOOPBACK));
+  EXPECT_EQ(options.ttl, 4);
+  EXPECT_EQ(icom_parseOptions(&options, "iface=*"), ICOM_SUCCESS);
+  EXPECT_EQ(options.iface, htonl(INADDR_ANY));
+
+  EXPECT_EQ(icom_parseOptions(&options, "iface=eth0"), ICOM_EINVAL);
+  EXPECT_EQ(icom_parseOptions(&options, "ttl=256"), ICOM_EINVAL);
+  EXPECT_EQ(icom_parseOptions(&options, "ttl"), ICOM_EINVAL);
+}
+
+TEST(icom_options, invalid){
+  icomOptions_t options;
+
+  EXPECT_EQ(icom_parseOptions(&options, "cpu"), ICOM_EINVAL);
+  EXPECT_EQ(icom_parseOptions(&options, "sndbuf=4T"), ICOM_EINVAL);
+  EXPECT_EQ(icom_parseOptions(&options, "sndbuf=4G"), ICOM_EINVAL);
+  EXPECT_EQ(icom_parseOptions(&options, "quickack=yes"), ICOM_EINVAL);
+  EXPECT_EQ(icom_parseOptions(&options, "timeout_us=0"), ICOM_EINVAL);
+  EXPECT_EQ(icom_parseOptions(&options, "hugepages=1G"), ICOM_EINVAL);
+  EXPECT_EQ(icom_parseOptions(&options, "cpu=x"), ICOM_EINVAL);
+  EXPECT_EQ(icom_parseOptions(&options, "cpu=-1"), ICOM_EINVAL);
+  EXPECT_EQ(icom_parseOptions(&options, "node=64"), ICOM_EINVAL);
+  EXPECT_EQ(icom_parseOptions(&options, "cpu=0,core=1"), ICOM_EINVAL);
+}
+
+TEST(icom_options, init){
+  icom_t *icom;
+
+  icom = icom_init("socket_rx|default|cpu=0,node=0|*:8889");
+  ASSERT_FALSE(ICOM_IS_ERR(icom));
+  EXPECT_EQ(icom->comCount, 1);
+  EXPECT_EQ(icom->options.cpu, 0);
+  EXPECT_EQ(icom->options.node, 0);
+  icom_deinit(icom);
+
+  EXPECT_TRUE(ICOM_IS_ERR(icom_init("socket_rx|default|node=x|*:8889")));
+  EXPECT_TRUE(ICOM_IS_ERR(icom_init("socket_rx|default|node=0|x|*:8889")));
+  EXPECT_TRUE(ICOM_IS_ERR(icom_init("socket_rx|default")));
+}
+
+TEST(icom_options, transfer_node){
+  link_common_simple(
+    "socket_tx|default|node=0|127.0.0.1:8889",
+    "socket_rx|default|node=0|*:8889",
+    8*1024*1024); // size in bytes
+  link_common_simple(
+    "socket_tx|zero|node=0|127.0.0.1:8889",
+    "socket_rx|zero|node=0|*:8889",
+    1024*1024); // size in bytes
+}
+
+TEST(icom_options, mem_node){
+  unsigned size = 3*4096 + 100;
+  uint8_t *mem;
+  int node = -1;
+
+  mem = (uint8_t*)icom_memAlloc(size, 0, 0);
+  ASSERT_TRUE(mem != NULL);
+  memset(mem, 0xa5, size);
+  ASSERT_EQ(syscall(SYS_get_mempolicy, &node, NULL, 0, mem, MPOL_F_NODE | MPOL_F_ADDR), 0);
+  EXPECT_EQ(node, 0);
+
+  /* contents survive growing */
+  mem = (uint8_t*)icom_memRealloc(mem, size, 4*size, 0, 0);
+  ASSERT_TRUE(mem != NULL);
+  EXPECT_EQ(mem[0], 0xa5);
+  EXPECT_EQ(mem[size-1], 0xa5);
+  icom_memFree(mem, 4*size, 0, 0);
+}
+
+/* number of resident pages of the (page aligned) memory */
+static unsigned mem_resident(void *mem, size_t size){
+  size_t page = sysconf(_SC_PAGESIZE);
+  std::vector<unsigned char> pages((size + page - 1)/page);
+  unsigned count = 0;
+
+  if(mincore(mem, size, pages.data()) != 0){
+    return 0;
+  }
+  for(unsigned char p : pages){
+    count += p & 1;
+  }
+  return count;
+}
+
+TEST(icom_options, mem_policy_alloc){
+  size_t page = sysconf(_SC_PAGESIZE), size = 3*1024*1024;
+  uint8_t *mem;
+
+  /* mappings are faulted in on the first touch */
+  mem = (uint8_t*)icom_memAlloc(size, -1, ICOM_MEM_THP);
+  ASSERT_TRUE(mem != NULL);
+  EXPECT_EQ((uintptr_t)mem % (2*1024*1024), 0);
+  EXPECT_LT(mem_resident(mem, size), size/page);
+  icom_memFree(mem, size, -1, ICOM_MEM_THP);
+
+  mem = (uint8_t*)icom_memAlloc(size, -1, ICOM_MEM_THP | ICOM_MEM_PRETOUCH);
+  ASSERT_TRUE(mem != NULL);
+  EXPECT_EQ(mem_resident(mem, size), size/page);
+
+  /* growing within the rounded mapping keeps it */
+  EXPECT_EQ(icom_memRealloc(mem, size, 4*1024*1024, -1, ICOM_MEM_THP | ICOM_MEM_PRETOUCH), mem);
+  icom_memFree(mem, 4*1024*1024, -1, ICOM_MEM_THP | ICOM_MEM_PRETOUCH);
+
+  /* reserved huge pages or a fallback, locking may exceed RLIMIT_MEMLOCK */
+  mem = (uint8_t*)icom_memAlloc(size, 0, ICOM_MEM_HUGETLB | ICOM_MEM_LOCK);
+  ASSERT_TRUE(mem != NULL);
+  memset(mem, 0xa5, size);
+  icom_memFree(mem, size, 0, ICOM_MEM_HUGETLB | ICOM_MEM_LOCK);
+}
+
+static int socket_option(icom_t *icom, int level, int name){
+  int value = -1;
+  socklen_t size = sizeof(value);
+  getsockopt(((icomLinkSocket_t*)icom->comConnections[0].pdata)->fd, level, name, &value, &size);
+  return value;
+}
+
+TEST(icom_options, socket_apply){
+  icom_t *icom;
+  struct timeval timeout;
+  socklen_t size = sizeof(timeout);
+
+  icom = icom_init("socket_tx|default|sndbuf=64k,rcvbuf=64k,notsent_lowat=16k,nodelay=0,timeout_us=1500000|127.0.0.1:8889");
+  ASSERT_FALSE(ICOM_IS_ERR(icom));
+
+  /* the kernel doubles the buffer sizes (bookkeeping overhead) */
+  EXPECT_EQ(socket_option(icom, SOL_SOCKET, SO_SNDBUF), 2*64*1024);
+  EXPECT_EQ(socket_option(icom, SOL_SOCKET, SO_RCVBUF), 2*64*1024);
+  EXPECT_EQ(socket_option(icom, SOL_TCP, TCP_NOTSENT_LOWAT), 16*1024);
+  EXPECT_EQ(socket_option(icom, SOL_TCP, TCP_NODELAY), 0);
+
+  getsockopt(((icomLinkSocket_t*)icom->comConnections[0].pdata)->fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, &size);
+  EXPECT_EQ(timeout.tv_sec, 1);
+  EXPECT_EQ(timeout.tv_usec, 500000);
+  icom_deinit(icom);
+
+  icom = icom_init("socket_tx|default|127.0.0.1:8889");
+  ASSERT_FALSE(ICOM_IS_ERR(icom));
+  EXPECT_NE(socket_option(icom, SOL_TCP, TCP_NODELAY), 0);
+  icom_deinit(icom);
+}
+
+/* per-link timeout without the timeout flag */
+TEST(icom_options, timeout_us){
+  struct timespec start, end;
+  icom_t *icom;
+  void *buf;
+  unsigned bufSize;
+
+  icom = icom_init("socket_rx|default|timeout_us=20000|*:8889");
+  ASSERT_FALSE(ICOM_IS_ERR(icom));
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  EXPECT_EQ(icom_recv(icom, &buf, &bufSize), ICOM_TIMEOUT);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  EXPECT_LT((end.tv_sec - start.tv_sec)*1000000000l + (end.tv_nsec - start.tv_nsec), 500000000l);
+
+  icom_deinit(icom);
+}
+
+TEST(icom_options, transfer_tuned){
+  link_common_varied(
+    "socket_tx|default|sndbuf=4M,rcvbuf=4M,notsent_lowat=128k|127.0.0.1:8889",
+    "socket_rx|default|quickack,rcvbuf=4M|*:8889",
+    100); // test count
+}
+
+TEST(icom_options, transfer_mem_policy){
+  link_common_simple(
+    "socket_tx|default|127.0.0.1:8889",
+    "socket_rx|default|hugepages,pretouch|*:8889",
+    8*1024*1024); // size in bytes
+  link_common_varied(
+    "socket_tx|default|127.0.0.1:8889",
+    "socket_rx|default|hugepages=hugetlb,mlock|*:8889",
+    100); // test count
+}
@@ -0,0 +1,204 @@
+#include <string.h>
+#include <unistd.h>
+#include "gtest/gtest.h"
+extern "C" {
+  #include "icom.h"
+  #include "icom_config.h"
+  #include "icom_pipeline.h"
+}
+
+#define PIPELINE_COUNT 10000
+
+////////////////////////////////////////////////////////////////////////////////
+// UTILITIES
+////////////////////////////////////////////////////////////////////////////////
+
+typedef struct {
+  unsigned  count;     /** messages produced/consumed */
+  unsigned  limit;     /** messages to produce/consume, 0 - unlimited */
+  unsigned  errors;    /** unexpected messages */
+  uint32_t  expected;  /** next expected value (sinks) */
+  uint32_t  step;      /** expected increment (sinks) */
+} stage_t;
+
+/* produces messages holding a sequence number */
+static icomStatus_t stage_source(void *ctx, const void *in, unsigned inSize, void *out, unsigned *outSize){
+  stage_t *stage = (stage_t*)ctx;
+
+  if(stage->limit && stage->count == stage->limit){
+    return ICOM_EPIPE;
+  }
+  memcpy(out, &stage->count, sizeof(uint32_t));
+  *outSize = sizeof(uint32_t);
+  stage->count++;
+  return ICOM_SUCCESS;
+}
+
+/* drops odd sequence numbers */
+static icomStatus_t stage_filter(void *ctx, const void *in, unsigned inSize, void *out, unsigned *outSize){
+  if(*(const uint32_t*)in & 1){
+    return ICOM_EAGAIN;
+  }
+  memcpy(out, in, inSize);
+  *outSize = inSize;
+  return ICOM_SUCCESS;
+}
+
+/* checks the sequence numbers */
+static icomStatus_t stage_sink(void *ctx, const void *in, unsigned inSize, void *out, unsigned *outSize){
+  stage_t *stage = (stage_t*)ctx;
+
+  if(inSize != sizeof(uint32_t) || *(const uint32_t*)in != stage->expected){
+    stage->errors++;
+  }
+  stage->expected += stage->step;
+  stage->count++;
+  return (stage->limit && stage->count == stage->limit) ? ICOM_EPIPE : ICOM_SUCCESS;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// TEST-RELATED - IN-PROCESS STAGES
+////////////////////////////////////////////////////////////////////////////////
+TEST(icom_pipeline, chain){
+  stage_t source = {0, PIPELINE_COUNT, 0, 0, 0};
+  stage_t sink   = {0, 0, 0, 0, 2};
+  icomStageStats_t stats;
+  icomStage_t stages[] = {
+    {"source", stage_source, &source, NULL, NULL,  0},
+    {"filter", stage_filter, NULL,    NULL, NULL,  0},
+    {"copy",   NULL,         NULL,    NULL, NULL, -1},
+    {"sink",   stage_sink,   &sink,   NULL, NULL,  0},
+  };
+
+  icomPipeline_t *pipeline = icom_pipelineInit(stages, 4);
+  ASSERT_FALSE(ICOM_IS_ERR(pipeline));
+  ASSERT_EQ(icom_pipelineStart(pipeline), ICOM_SUCCESS);
+  ASSERT_EQ(icom_pipelineJoin(pipeline), ICOM_SUCCESS);
+
+  EXPECT_EQ(sink.count, PIPELINE_COUNT/2);
+  EXPECT_EQ(sink.errors, 0);
+
+  /* the end of the stream passes through all the stages */
+  ASSERT_EQ(icom_pipelineStats(pipeline, 0, &stats), ICOM_SUCCESS);
+  EXPECT_EQ(stats.messages, PIPELINE_COUNT);
+  EXPECT_EQ(stats.status, ICOM_EPIPE);
+  EXPECT_FALSE(stats.running);
+  EXPECT_EQ(stats.queueMax, 0);
+
+  ASSERT_EQ(icom_pipelineStats(pipeline, 1, &stats), ICOM_SUCCESS);
+  EXPECT_EQ(stats.messages, PIPELINE_COUNT);
+  EXPECT_GT(stats.queueMax, 0);
+  EXPECT_LE(stats.queueMax, 16);
+
+  ASSERT_EQ(icom_pipelineStats(pipeline, 3, &stats), ICOM_SUCCESS);
+  EXPECT_EQ(stats.messages, PIPELINE_COUNT/2);
+  EXPECT_EQ(stats.queueDepth, 0);
+  EXPECT_GE(stats.utilisation, 0.0);
+  EXPECT_LE(stats.utilisation, 1.0);
+
+  EXPECT_EQ(icom_pipelineStats(pipeline, 4, &stats), ICOM_EINVAL);
+  icom_pipelineDeinit(pipeline);
+}
+
+TEST(icom_pipeline, stop){
+  stage_t source = {0, 0, 0, 0, 0};
+  stage_t sink   = {0, 0, 0, 0, 1};
+  icomStageStats_t stats;
+  icomStage_t stages[] = {
+    {"source", stage_source, &source, NULL, NULL, -1},
+    {"sink",   stage_sink,   &sink,   NULL, NULL, -1},
+  };
+
+  icomPipeline_t *pipeline = icom_pipelineInit(stages, 2);
+  ASSERT_FALSE(ICOM_IS_ERR(pipeline));
+  ASSERT_EQ(icom_pipelineStart(pipeline), ICOM_SUCCESS);
+  EXPECT_EQ(icom_pipelineStart(pipeline), ICOM_EBUSY);
+
+  usleep(10000);
+  ASSERT_EQ(icom_pipelineStats(pipeline, 1, &stats), ICOM_SUCCESS);
+  EXPECT_TRUE(stats.running);
+
+  icom_pipelineStop(pipeline);
+  ASSERT_EQ(icom_pipelineJoin(pipeline), ICOM_SUCCESS);
+  ASSERT_EQ(icom_pipelineStats(pipeline, 1, &stats), ICOM_SUCCESS);
+  EXPECT_FALSE(stats.running);
+  EXPECT_EQ(sink.errors, 0);
+  EXPECT_GT(sink.count, 0);
+
+  icom_pipelineDeinit(pipeline);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// TEST-RELATED - ENDPOINTS
+////////////////////////////////////////////////////////////////////////////////
+TEST(icom_pipeline, endpoints){
+  stage_t source = {0, PIPELINE_COUNT, 0, 0, 0};
+  stage_t sink   = {0, PIPELINE_COUNT, 0, 0, 1};
+  icomStageStats_t stats;
+  icomStage_t stages[] = {
+    {"source", stage_source, &source, NULL, "socket_tx|default|127.0.0.1:8889", -1},
+    {"relay",  NULL,         NULL,    "socket_rx|timeout|*:8889", NULL,         -1},
+    {"sink",   stage_sink,   &sink,   NULL, NULL,                               -1},
+  };
+
+  icomPipeline_t *pipeline = icom_pipelineInit(stages, 3);
+  ASSERT_FALSE(ICOM_IS_ERR(pipeline));
+  ASSERT_EQ(icom_pipelineStart(pipeline), ICOM_SUCCESS);
+
+  /* the relay ends once its receive times out after the stop request */
+  do {
+    usleep(1000);
+    ASSERT_EQ(icom_pipelineStats(pipeline, 2, &stats), ICOM_SUCCESS);
+  } while(stats.running);
+  icom_pipelineStop(pipeline);
+  ASSERT_EQ(icom_pipelineJoin(pipeline), ICOM_SUCCESS);
+
+  EXPECT_EQ(sink.count, PIPELINE_COUNT);
+  EXPECT_EQ(sink.errors, 0);
+
+  /* the relay stage is not connected to the source by a queue */
+  ASSERT_EQ(icom_pipelineStats(pipeline, 1, &stats), ICOM_SUCCESS);
+  EXPECT_EQ(stats.queueMax, 0);
+
+  icom_pipelineDeinit(pipeline);
+}
+
+/* every message is sent in a buffer of its own, none is overwritten in flight */
+TEST(icom_pipeline, endpoints_zero){
+  stage_t source = {0, PIPELINE_COUNT, 0, 0, 0};
+  stage_t sink   = {0, PIPELINE_COUNT, 0, 0, 1};
+  icomStageStats_t stats;
+  icomStage_t stages[] = {
+    {"source", stage_source, &source, NULL, "socket_tx|zero|127.0.0.1:8889", -1},
+    {"relay",  NULL,         NULL,    "socket_rx|zero,timeout|*:8889", NULL, -1},
+    {"sink",   stage_sink,   &sink,   NULL, NULL,                            -1},
+  };
+
+  icomPipeline_t *pipeline = icom_pipelineInit(stages, 3);
+  ASSERT_FALSE(ICOM_IS_ERR(pipeline));
+  ASSERT_EQ(icom_pipelineStart(pipeline), ICOM_SUCCESS);
+
+  do {
+    usleep(1000);
+    ASSERT_EQ(icom_pipelineStats(pipeline, 2, &stats), ICOM_SUCCESS);
+  } while(stats.running);
+  icom_pipelineStop(pipeline);
+  ASSERT_EQ(icom_pipelineJoin(pipeline), ICOM_SUCCESS);
+
+  EXPECT_EQ(sink.count, PIPELINE_COUNT);
+  EXPECT_EQ(sink.errors, 0);
+
+  icom_pipelineDeinit(pipeline);
+}
+
+TEST(icom_pipeline, invalid_config){
+  uint64_t depth, depthInvalid = 3;
+  icomStage_t stage = {"source", stage_source, NULL, NULL, NULL, -1};
+
+  EXPECT_TRUE(ICOM_IS_ERR(icom_pipelineInit(&stage, 0)));
+
+  icom_getDefaultConfig(PIPELINE_QUEUE_DEPTH, &depth);
+  icom_setDefaultConfig(PIPELINE_QUEUE_DEPTH, &depthInvalid);
+  EXPECT_TRUE(ICOM_IS_ERR(icom_pipelineInit(&stage, 1)));
+  icom_setDefaultConfig(PIPELINE_QUEUE_DEPTH, &depth);
+}